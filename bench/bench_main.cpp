@@ -0,0 +1,64 @@
+#include "benchmarks.h"
+
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace {
+    struct Benchmark {
+        const char* name;
+        std::function<void()> function;
+    };
+
+    const std::vector<Benchmark> BENCHMARKS = {
+        {"culling", [] { benchmarks::runCullingBenchmark(); }},
+        {"draw_sort", [] {
+            benchmarks::runDrawSortBenchmark(10000);
+            benchmarks::runDrawSortBenchmark(100000);
+        }},
+        {"occlusion", [] { benchmarks::runOcclusionBenchmark(); }},
+        {"lod", [] { benchmarks::runLodBenchmark(); }},
+        {"mesh_optimizer", [] { benchmarks::runMeshOptimizerBenchmark(); }},
+        {"vertex_compression", [] { benchmarks::runVertexCompressionBenchmark(); }},
+        {"meshlet", [] { benchmarks::runMeshletBenchmark(); }},
+        {"bvh", [] { benchmarks::runBVHBenchmark(); }},
+        {"transform", [] { benchmarks::runTransformBenchmark(); }},
+    };
+}
+
+// runs the benchmarks named in the arguments, or all of them, without a window or a gpu
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        bool found = false;
+
+        for (const auto& benchmark : BENCHMARKS) {
+            found |= std::strcmp(benchmark.name, argv[i]) == 0;
+        }
+
+        if (!found) {
+            fmt::println("unknown benchmark {}, available:", argv[i]);
+
+            for (const auto& benchmark : BENCHMARKS) {
+                fmt::println("  {}", benchmark.name);
+            }
+
+            return 1;
+        }
+    }
+
+    for (const auto& benchmark : BENCHMARKS) {
+        bool selected = argc == 1;
+
+        for (int i = 1; i < argc; i++) {
+            selected |= std::strcmp(benchmark.name, argv[i]) == 0;
+        }
+
+        if (selected) {
+            benchmark.function();
+        }
+    }
+
+    return 0;
+}
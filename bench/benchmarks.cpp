@@ -0,0 +1,860 @@
+#include "benchmarks.h"
+
+#include "components/transform.h"
+#include "draw_sort.h"
+#include "dynamic_bvh.h"
+#include "frustum_culler.h"
+#include "mesh_fixtures.h"
+#include "mesh_lod.h"
+#include "mesh_optimizer.h"
+#include "mesh_quantization.h"
+#include "mesh_types.h"
+#include "meshlet_builder.h"
+#include "occlusion_culler.h"
+#include "thread_pool.h"
+#include "transform_hierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <fmt/core.h>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+namespace {
+    template<typename F>
+    float measure(uint32_t iterations, F&& function) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            function();
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+
+        // average time in milliseconds
+        return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.f / iterations;
+    }
+}
+
+void benchmarks::runCullingBenchmark(uint32_t objectCount, uint32_t iterations) {
+    struct Object {
+        glm::vec3 origin;
+        glm::vec3 extents;
+        float sphereRadius;
+        glm::mat4 transform;
+    };
+
+    // generate random objects around the camera
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> position(-200.f, 200.f);
+    std::uniform_real_distribution<float> size(0.1f, 3.f);
+    std::uniform_real_distribution<float> angle(0.f, glm::two_pi<float>());
+
+    std::vector<Object> objects(objectCount);
+
+    for (auto& object : objects) {
+        object.origin = glm::vec3(size(generator), size(generator), size(generator)) * 0.5f;
+        object.extents = glm::vec3(size(generator), size(generator), size(generator));
+        object.sphereRadius = glm::length(object.extents);
+
+        object.transform = glm::translate(glm::mat4(1.f), glm::vec3(position(generator), position(generator), position(generator)));
+        object.transform = glm::rotate(object.transform, angle(generator), glm::normalize(glm::vec3(1.f, 2.f, 3.f)));
+        object.transform = glm::scale(object.transform, glm::vec3(size(generator)));
+    }
+
+    // same projection setup as the camera component (reversed depth)
+    glm::vec3 viewPosition(0.f, 5.f, 20.f);
+    glm::mat4 view = glm::lookAt(viewPosition, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 projection = glm::perspective(glm::radians(70.f), 16.f / 9.f, 1000.f, 0.1f);
+    glm::mat4 viewProjection = projection * view;
+
+    FrustumCuller::Frustum frustum = FrustumCuller::extractFrustum(viewProjection, viewPosition, projection[1][1]);
+
+    // reference implementation
+    std::vector<uint32_t> referenceVisible;
+    float referenceTime = measure(iterations, [&]() {
+        referenceVisible.clear();
+
+        for (uint32_t i = 0; i < objectCount; i++) {
+            if (FrustumCuller::isVisibleProjected(objects[i].origin, objects[i].extents, objects[i].transform, viewProjection)) {
+                referenceVisible.push_back(i);
+            }
+        }
+    });
+
+    FrustumCuller culler;
+    culler.resize(objectCount);
+
+    float boundsTime = measure(iterations, [&]() {
+        for (uint32_t i = 0; i < objectCount; i++) {
+            culler.setBounds(i, objects[i].origin, objects[i].extents, objects[i].sphereRadius, objects[i].transform);
+        }
+    });
+
+    fmt::println("culling benchmark: {} objects, {} iterations", objectCount, iterations);
+    fmt::println("  projected corners: {:.4f} ms, {} visible", referenceTime, referenceVisible.size());
+    fmt::println("  world bounds update: {:.4f} ms", boundsTime);
+
+    std::vector<uint32_t> scalarVisible;
+    culler.cull(frustum, 0.f, scalarVisible, FrustumCuller::Path::SCALAR);
+
+    auto runPath = [&](FrustumCuller::Path path, const char* name) {
+        std::vector<uint32_t> visible;
+        float time = measure(iterations, [&]() {
+            culler.cull(frustum, 0.f, visible, path);
+        });
+
+        // objects only the reference keeps, the projected test accepts boxes
+        // crossing the camera plane since the perspective divide flips their corners
+        uint32_t referenceOnly = 0;
+        std::vector<bool> kept(objectCount, false);
+        for (auto index : visible) {
+            kept[index] = true;
+        }
+        for (auto index : referenceVisible) {
+            referenceOnly += !kept[index];
+        }
+
+        fmt::println("  {}: {:.4f} ms ({:.2f}x), {} visible, {} only in reference, {}",
+                     name, time, referenceTime / time, visible.size(), referenceOnly,
+                     visible == scalarVisible ? "matches scalar" : "MISMATCH with scalar");
+    };
+
+    runPath(FrustumCuller::Path::SCALAR, "scalar");
+    runPath(FrustumCuller::Path::SSE, "sse");
+
+    if (FrustumCuller::isAVXSupported()) {
+        runPath(FrustumCuller::Path::AVX, "avx");
+    }
+
+    // screen size cutoff
+    std::vector<uint32_t> visible;
+    float time = measure(iterations, [&]() {
+        culler.cull(frustum, 0.01f, visible);
+    });
+
+    fmt::println("  auto with 1% screen size cutoff: {:.4f} ms, {} visible", time, visible.size());
+}
+
+void benchmarks::runDrawSortBenchmark(uint32_t objectCount, uint32_t iterations) {
+    struct Material {
+        uint32_t id;
+        uint32_t pipelineId;
+    };
+
+    // mirrors the fields of GLTFRenderObject used for sorting
+    struct Object {
+        const Material* material;
+        const void* indexBuffer;
+        uint32_t meshId;
+        float viewDepth;
+    };
+
+    std::mt19937 generator(42);
+
+    // a few hundred materials and meshes, like a typical gltf scene
+    std::vector<Material> materials(256);
+    for (uint32_t i = 0; i < materials.size(); i++) {
+        materials[i] = Material{i, i % 4};
+    }
+
+    std::vector<uint64_t> meshHandles(512);
+    std::uniform_int_distribution<uint32_t> materialIndex(0, materials.size() - 1);
+    std::uniform_int_distribution<uint32_t> meshIndex(0, meshHandles.size() - 1);
+    std::uniform_real_distribution<float> depth(0.1f, 1000.f);
+
+    std::vector<Object> objects(objectCount);
+    for (auto& object : objects) {
+        uint32_t mesh = meshIndex(generator);
+
+        object.material = &materials[materialIndex(generator)];
+        object.indexBuffer = &meshHandles[mesh];
+        object.meshId = mesh;
+        object.viewDepth = depth(generator);
+    }
+
+    std::vector<uint32_t> indices(objectCount);
+
+    auto resetIndices = [&]() {
+        for (uint32_t i = 0; i < objectCount; i++) {
+            indices[i] = i;
+        }
+    };
+
+    // current comparator
+    float comparatorTime = measure(iterations, [&]() {
+        resetIndices();
+
+        std::sort(indices.begin(), indices.end(), [&](const auto& iA, const auto& iB) {
+            const Object& A = objects[iA];
+            const Object& B = objects[iB];
+
+            if (A.material == B.material) {
+                return A.indexBuffer < B.indexBuffer;
+            } else {
+                return A.material < B.material;
+            }
+        });
+    });
+
+    std::vector<drawsort::Entry> entries(objectCount);
+    std::vector<drawsort::Entry> scratch;
+
+    auto buildKeys = [&](bool transparent) {
+        for (uint32_t i = 0; i < objectCount; i++) {
+            const Object& object = objects[i];
+
+            uint64_t key = transparent
+                ? drawsort::makeTransparentKey(object.material->pipelineId, object.material->id, object.meshId, object.viewDepth)
+                : drawsort::makeOpaqueKey(object.material->pipelineId, object.material->id, object.meshId, object.viewDepth);
+
+            entries[i] = drawsort::Entry{key, i};
+        }
+    };
+
+    float radixTime = measure(iterations, [&]() {
+        buildKeys(false);
+        drawsort::radixSort(entries, scratch);
+    });
+
+    float keySortTime = measure(iterations, [&]() {
+        buildKeys(false);
+        std::stable_sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+            return a.key < b.key;
+        });
+    });
+
+    // validate against a comparison sort on the same keys
+    auto validate = [&](bool transparent) {
+        buildKeys(transparent);
+        std::vector<drawsort::Entry> expected = entries;
+        std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) {
+            return a.key < b.key;
+        });
+
+        drawsort::radixSort(entries, scratch);
+
+        for (uint32_t i = 0; i < objectCount; i++) {
+            if (entries[i].key != expected[i].key || entries[i].index != expected[i].index) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    bool opaqueValid = validate(false);
+    bool transparentValid = validate(true);
+
+    // transparent objects must end up back to front, up to the depth quantization (15 mantissa bits)
+    bool backToFront = true;
+    for (uint32_t i = 1; i < objectCount; i++) {
+        backToFront &= objects[entries[i - 1].index].viewDepth >= objects[entries[i].index].viewDepth * (1.f - 1.f / (1 << 15));
+    }
+
+    fmt::println("draw sort benchmark: {} objects, {} iterations", objectCount, iterations);
+    fmt::println("  std::sort pointer comparator: {:.4f} ms", comparatorTime);
+    fmt::println("  keys + std::stable_sort: {:.4f} ms", keySortTime);
+    fmt::println("  keys + radix sort: {:.4f} ms ({:.2f}x)", radixTime, comparatorTime / radixTime);
+    fmt::println("  radix sort {}, transparent order {}",
+                 opaqueValid && transparentValid ? "matches stable sort" : "MISMATCH with stable sort",
+                 backToFront ? "back to front" : "NOT back to front");
+}
+
+void benchmarks::runOcclusionBenchmark(uint32_t blockCount, uint32_t propCount, uint32_t iterations) {
+    struct Box {
+        glm::vec3 center;
+        glm::vec3 extents;
+    };
+
+    // unit cube shared by every building
+    const std::vector<glm::vec3> cubePositions{
+        {-1.f, -1.f, -1.f}, {1.f, -1.f, -1.f}, {1.f, 1.f, -1.f}, {-1.f, 1.f, -1.f},
+        {-1.f, -1.f, 1.f}, {1.f, -1.f, 1.f}, {1.f, 1.f, 1.f}, {-1.f, 1.f, 1.f}
+    };
+
+    const std::vector<uint32_t> cubeIndices{
+        0, 1, 2, 0, 2, 3, // back
+        4, 6, 5, 4, 7, 6, // front
+        0, 3, 7, 0, 7, 4, // left
+        1, 5, 6, 1, 6, 2, // right
+        3, 2, 6, 3, 6, 7, // top
+        0, 4, 5, 0, 5, 1  // bottom
+    };
+
+    // one building per block, streets in between
+    const float blockSize = 20.f;
+    const float cityExtent = blockCount * blockSize * 0.5f;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> footprint(6.f, 9.f);
+    std::uniform_real_distribution<float> height(4.f, 30.f);
+    std::uniform_real_distribution<float> propPosition(-cityExtent, cityExtent);
+    std::uniform_real_distribution<float> propSize(0.3f, 1.5f);
+
+    std::vector<Box> buildings;
+    std::vector<glm::mat4> buildingTransforms;
+
+    for (uint32_t x = 0; x < blockCount; x++) {
+        for (uint32_t z = 0; z < blockCount; z++) {
+            Box building;
+            building.extents = glm::vec3(footprint(generator), height(generator), footprint(generator));
+            building.center = glm::vec3(
+                (x + 0.5f) * blockSize - cityExtent,
+                building.extents.y,
+                (z + 0.5f) * blockSize - cityExtent
+            );
+
+            buildings.push_back(building);
+            buildingTransforms.push_back(glm::scale(glm::translate(glm::mat4(1.f), building.center), building.extents));
+        }
+    }
+
+    std::vector<Box> props(propCount);
+
+    for (auto& prop : props) {
+        prop.extents = glm::vec3(propSize(generator));
+        prop.center = glm::vec3(propPosition(generator), prop.extents.y, propPosition(generator));
+    }
+
+    // street level camera looking down a street, same projection setup as the camera component (reversed depth)
+    glm::vec3 viewPosition(-cityExtent + 2.f, 1.8f, 0.5f);
+    glm::mat4 view = glm::lookAt(viewPosition, viewPosition + glm::vec3(1.f, 0.f, 0.35f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 projection = glm::perspective(glm::radians(70.f), 16.f / 9.f, 1000.f, 0.1f);
+    glm::mat4 viewProjection = projection * view;
+
+    // props inside the frustum are the occlusion candidates
+    FrustumCuller frustumCuller;
+    frustumCuller.resize(propCount);
+
+    for (uint32_t i = 0; i < propCount; i++) {
+        frustumCuller.setBounds(i, glm::vec3(0.f), props[i].extents, glm::length(props[i].extents), glm::translate(glm::mat4(1.f), props[i].center));
+    }
+
+    std::vector<uint32_t> candidates;
+    frustumCuller.cull(FrustumCuller::extractFrustum(viewProjection, viewPosition, projection[1][1]), 0.f, candidates);
+
+    OcclusionCuller culler;
+
+    auto addOccluders = [&]() {
+        culler.beginFrame(viewProjection);
+
+        for (auto& transform : buildingTransforms) {
+            culler.addOccluder(cubePositions.data(), cubeIndices.data(), cubeIndices.size(), transform);
+        }
+    };
+
+    float setupTime = measure(iterations, addOccluders);
+
+    auto runPath = [&](OcclusionCuller::Path path, ThreadPool* threadPool) {
+        float time = measure(iterations, [&]() {
+            addOccluders();
+            culler.rasterize(threadPool, path);
+        });
+
+        return time - setupTime;
+    };
+
+    ThreadPool threadPool;
+
+    float scalarTime = runPath(OcclusionCuller::Path::SCALAR, nullptr);
+    float sseTime = runPath(OcclusionCuller::Path::SSE, nullptr);
+    float threadedTime = runPath(OcclusionCuller::Path::AUTO, &threadPool);
+
+    std::vector<uint32_t> visible;
+    float testTime = measure(iterations, [&]() {
+        visible.clear();
+
+        for (auto index : candidates) {
+            if (culler.isVisible(glm::vec3(0.f), props[index].extents, glm::translate(glm::mat4(1.f), props[index].center))) {
+                visible.push_back(index);
+            }
+        }
+    });
+
+    fmt::println("occlusion benchmark: {} buildings, {} props, {} iterations", buildings.size(), propCount, iterations);
+    fmt::println("  occluder setup: {:.4f} ms, {} polygons", setupTime, culler.getPolygonCount());
+    fmt::println("  rasterize scalar: {:.4f} ms", scalarTime);
+    fmt::println("  rasterize sse: {:.4f} ms ({:.2f}x)", sseTime, scalarTime / sseTime);
+    fmt::println("  rasterize {} workers: {:.4f} ms ({:.2f}x)", threadPool.getWorkerCount(), threadedTime, scalarTime / threadedTime);
+    fmt::println("  test: {:.4f} ms, {} in frustum, {} visible, {} occluded", testTime, candidates.size(), visible.size(), candidates.size() - visible.size());
+}
+
+void benchmarks::runLodBenchmark(uint32_t segmentCount) {
+    fixtures::Mesh sphere = fixtures::createSphere(segmentCount);
+    fixtures::Mesh grid = fixtures::createGrid(segmentCount / 2, segmentCount / 2, [](float u, float v) {
+        return glm::vec3(u * 2.f - 1.f, v * 2.f - 1.f, 1.f);
+    });
+
+    std::vector<MeshLod> sphereLods;
+    std::vector<uint32_t> sphereLodIndices;
+
+    float sphereTime = measure(1, [&]() {
+        meshlod::buildLods(sphere.vertices, sphere.indices, sphereLods, sphereLodIndices);
+    });
+
+    std::vector<MeshLod> gridLods;
+    std::vector<uint32_t> gridLodIndices;
+
+    float gridTime = measure(1, [&]() {
+        meshlod::buildLods(grid.vertices, grid.indices, gridLods, gridLodIndices);
+    });
+
+    fmt::println("lod benchmark: {} sphere triangles in {:.2f} ms, {} grid triangles in {:.2f} ms", sphere.indices.size() / 3, sphereTime, grid.indices.size() / 3, gridTime);
+
+    for (uint32_t i = 0; i < sphereLods.size(); i++) {
+        fmt::println("  sphere lod {}: {} triangles, error {:.5f}", i + 1, sphereLods[i].indexCount / 3, sphereLods[i].error);
+    }
+}
+
+void benchmarks::runMeshOptimizerBenchmark(uint32_t sphereCount, uint32_t segmentCount) {
+    fixtures::Mesh mesh = fixtures::createUnweldedSpheres(sphereCount, segmentCount);
+    auto& [vertices, indices] = mesh;
+    uint32_t triangleCount = indices.size() / 3;
+
+    auto report = [&](const char* step, const std::vector<uint32_t>& stepIndices, const std::vector<Vertex>& stepVertices, float time) {
+        fmt::println("  {}: {:.2f} ms, acmr {:.3f}, atvr {:.3f}, overdraw {:.3f}", step, time, meshopt::computeACMR(stepIndices), meshopt::computeATVR(stepIndices), meshopt::computeOverdraw(stepIndices, stepVertices));
+    };
+
+    fmt::println("mesh optimizer benchmark: {} triangles, {} vertices", triangleCount, vertices.size());
+    report("authored", indices, vertices, 0.f);
+
+    float deduplicateTime = measure(1, [&]() {
+        meshopt::deduplicateVertices(indices, vertices);
+    });
+
+    report("deduplicated", indices, vertices, deduplicateTime);
+
+    float vertexCacheTime = measure(1, [&]() {
+        meshopt::optimizeVertexCache(indices, vertices.size());
+    });
+
+    report("vertex cache", indices, vertices, vertexCacheTime);
+
+    float overdrawTime = measure(1, [&]() {
+        meshopt::optimizeOverdraw(indices, vertices);
+    });
+
+    report("overdraw", indices, vertices, overdrawTime);
+
+    uint32_t vertexCount = 0;
+
+    float vertexFetchTime = measure(1, [&]() {
+        vertexCount = meshopt::optimizeVertexFetch(vertices, indices);
+    });
+
+    vertices.resize(vertexCount);
+
+    report("vertex fetch", indices, vertices, vertexFetchTime);
+
+    fmt::println("  {} vertices left", vertexCount);
+}
+
+void benchmarks::runVertexCompressionBenchmark(uint32_t vertexCount) {
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    std::uniform_real_distribution<float> texCoord(0.f, 1.f);
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(vertexCount);
+
+    // a building sized box, so position steps are in the millimeter range
+    glm::vec3 size(120.f, 40.f, 80.f);
+
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        Vertex vertex;
+        vertex.position = glm::vec3(unit(random), unit(random), unit(random)) * size * 0.5f;
+
+        do {
+            vertex.normal = glm::vec3(unit(random), unit(random), unit(random));
+        } while (glm::length(vertex.normal) < 0.01f);
+
+        vertex.normal = glm::normalize(vertex.normal);
+        vertex.uvX = texCoord(random);
+        vertex.uvY = texCoord(random);
+        vertices.push_back(vertex);
+    }
+
+    meshquant::PositionRange range = meshquant::getPositionRange(vertices);
+    std::vector<CompactVertex> compact;
+
+    float time = measure(1, [&]() {
+        compact = meshquant::compressVertices(vertices, range);
+    });
+
+    // a typical closed mesh has about twice as many triangles as vertices
+    size_t indexCount = vertexCount * 6;
+    size_t fullSize = vertexCount * sizeof(Vertex) + indexCount * sizeof(uint32_t);
+    size_t compactSize = vertexCount * sizeof(CompactVertex) + indexCount * sizeof(uint32_t);
+    size_t shortSize = 65536 * sizeof(CompactVertex) + 65536 * 6 * sizeof(uint16_t);
+    size_t shortFullSize = 65536 * sizeof(Vertex) + 65536 * 6 * sizeof(uint32_t);
+
+    fmt::println("vertex compression benchmark: {} vertices in {:.2f} ms", vertices.size(), time);
+    fmt::println("  {} vertex mesh: {:.1f} MB compact, {:.1f} MB full", vertexCount, compactSize / 1048576.f, fullSize / 1048576.f);
+    fmt::println("  65536 vertex mesh with 16 bit indices: {:.2f} MB compact, {:.2f} MB full with 32 bit indices", shortSize / 1048576.f, shortFullSize / 1048576.f);
+}
+
+void benchmarks::runMeshletBenchmark(uint32_t segmentCount) {
+    fixtures::Mesh sphere = fixtures::createSphere(segmentCount);
+    auto& [vertices, indices] = sphere;
+
+    // the loader builds meshlets from cache optimized surfaces
+    meshopt::optimizeVertexCache(indices, vertices.size());
+
+    std::vector<Meshlet> meshletList;
+
+    float time = measure(1, [&]() {
+        meshlets::build(vertices, indices, meshletList);
+    });
+
+    // limits, coverage and cone correctness are checked in tests/meshlet_tests.cpp
+    uint32_t vertexTotal = 0;
+    std::vector<uint32_t> vertexMeshlet(vertices.size(), std::numeric_limits<uint32_t>::max());
+
+    for (uint32_t m = 0; m < meshletList.size(); m++) {
+        const Meshlet& meshlet = meshletList[m];
+
+        for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.triangleCount * 3; i++) {
+            if (vertexMeshlet[indices[i]] != m) {
+                vertexMeshlet[indices[i]] = m;
+                vertexTotal++;
+            }
+        }
+    }
+
+    fmt::println("meshlet benchmark: {} triangles in {} meshlets in {:.2f} ms", indices.size() / 3, meshletList.size(), time);
+    fmt::println("  average {:.1f} vertices, {:.1f} triangles",
+        (float)vertexTotal / meshletList.size(), indices.size() / 3.f / meshletList.size());
+
+    // up close the camera sees less than half of the sphere, from far away cones miss the meshlets near the silhouette
+    for (float distance : {1.5f, 3.f, 10.f, 100.f}) {
+        uint32_t culledMeshlets = 0;
+        uint32_t culledTriangles = 0;
+
+        for (glm::vec3 direction : {glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::normalize(glm::vec3(1.f, -2.f, 3.f))}) {
+            for (const Meshlet& meshlet : meshletList) {
+                if (meshlets::isBackfacing(meshlet, direction * distance)) {
+                    culledMeshlets++;
+                    culledTriangles += meshlet.triangleCount;
+                }
+            }
+        }
+
+        // three views of every meshlet and triangle
+        float meshletShare = culledMeshlets * 100.f / (meshletList.size() * 3);
+        float triangleShare = culledTriangles * 100.f / indices.size();
+
+        fmt::println("  distance {}: {:.1f}% of meshlets, {:.1f}% of triangles cone culled", distance, meshletShare, triangleShare);
+    }
+}
+
+void benchmarks::runBVHBenchmark(uint32_t maxObjectCount, uint32_t queryCount) {
+    for (uint32_t objectCount = 10000; objectCount <= maxObjectCount; objectCount *= 10) {
+        std::mt19937 random(13);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+        // constant density, about 3 objects per 1000 cubic units
+        float worldSize = std::cbrt((float)objectCount) * 7.f;
+
+        auto randomPoint = [&]() {
+            return glm::vec3(unit(random), unit(random), unit(random)) * worldSize;
+        };
+
+        auto randomDirection = [&]() {
+            glm::vec3 direction;
+
+            do {
+                direction = glm::vec3(unit(random), unit(random), unit(random)) * 2.f - 1.f;
+            } while (glm::length(direction) < 0.01f || glm::length(direction) > 1.f);
+
+            return glm::normalize(direction);
+        };
+
+        auto randomBox = [&](const glm::vec3& center) {
+            glm::vec3 halfSize = glm::vec3(unit(random), unit(random), unit(random)) * 0.75f + 0.25f;
+
+            return DynamicBVH::AABB{center - halfSize, center + halfSize};
+        };
+
+        std::vector<DynamicBVH::AABB> boxes(objectCount);
+        std::vector<int32_t> proxies(objectCount);
+
+        for (auto& box : boxes) {
+            box = randomBox(randomPoint());
+        }
+
+        DynamicBVH bvh;
+
+        float buildTime = measure(1, [&]() {
+            for (uint32_t i = 0; i < objectCount; i++) {
+                proxies[i] = bvh.insert(boxes[i], i);
+            }
+        });
+
+        int32_t buildHeight = bvh.getHeight();
+        float buildAreaRatio = bvh.getAreaRatio();
+
+        // a frame where a tenth of the objects drift and one in a hundred teleports
+        uint32_t reinsertCount = 0;
+
+        float updateTime = measure(1, [&]() {
+            for (uint32_t i = 0; i < objectCount; i += 10) {
+                glm::vec3 offset = i % 100 == 0 ? randomPoint() - boxes[i].min : randomDirection() * 0.05f;
+
+                boxes[i].min += offset;
+                boxes[i].max += offset;
+                reinsertCount += bvh.update(proxies[i], boxes[i]);
+            }
+        });
+
+        // half of the objects leave and come back
+        float churnTime = measure(1, [&]() {
+            for (uint32_t i = 0; i < objectCount; i += 2) {
+                bvh.remove(proxies[i]);
+            }
+
+            for (uint32_t i = 0; i < objectCount; i += 2) {
+                proxies[i] = bvh.insert(boxes[i], i);
+            }
+        });
+
+        fmt::println("bvh benchmark: {} objects", objectCount);
+        fmt::println("  build: {:.2f} ms, height {}, area ratio {:.1f}", buildTime, buildHeight, buildAreaRatio);
+        fmt::println("  update: {:.3f} ms for {} moved objects, {} reinserted", updateTime, objectCount / 10, reinsertCount);
+        fmt::println("  remove and insert {}: {:.2f} ms, height {}, area ratio {:.1f}",
+            objectCount / 2, churnTime, bvh.getHeight(), bvh.getAreaRatio());
+
+        // frustum queries from random cameras inside the world
+        std::vector<FrustumCuller::Frustum> frustums(queryCount);
+
+        for (auto& frustum : frustums) {
+            glm::vec3 position = randomPoint();
+            glm::mat4 view = glm::lookAt(position, position + randomDirection(), glm::vec3(0.f, 1.f, 0.f));
+            glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 200.f, 0.1f);
+
+            frustum = FrustumCuller::extractFrustum(projection * view, position, projection[1][1]);
+        }
+
+        std::vector<uint32_t> results;
+        uint32_t resultCount = 0;
+
+        float frustumTime = measure(1, [&]() {
+            for (const auto& frustum : frustums) {
+                results.clear();
+                bvh.queryFrustum(frustum, results);
+                resultCount += results.size();
+            }
+        });
+
+        fmt::println("  frustum: {:.4f} ms per query, {:.0f} objects each", frustumTime / queryCount, (float)resultCount / queryCount);
+
+        // rays through the world
+        std::vector<std::pair<glm::vec3, glm::vec3>> rays(queryCount);
+
+        for (auto& ray : rays) {
+            ray = {randomPoint(), randomDirection()};
+        }
+
+        float maxRayDistance = worldSize;
+        uint32_t hitCount = 0;
+
+        float rayTime = measure(1, [&]() {
+            for (const auto& [origin, direction] : rays) {
+                hitCount += bvh.raycast(origin, direction, maxRayDistance).has_value();
+            }
+        });
+
+        fmt::println("  raycast: {:.4f} ms per ray, {} of {} hit", rayTime / queryCount, hitCount, queryCount);
+
+        // sphere overlaps and nearest neighbours around random points
+        std::vector<glm::vec3> points(queryCount);
+
+        for (auto& point : points) {
+            point = randomPoint();
+        }
+
+        float sphereRadius = 10.f;
+        resultCount = 0;
+
+        float sphereTime = measure(1, [&]() {
+            for (const auto& point : points) {
+                results.clear();
+                bvh.querySphere(point, sphereRadius, results);
+                resultCount += results.size();
+            }
+        });
+
+        fmt::println("  sphere: {:.4f} ms per query, {:.1f} objects each", sphereTime / queryCount, (float)resultCount / queryCount);
+
+        uint32_t foundCount = 0;
+
+        float nearestTime = measure(1, [&]() {
+            for (const auto& point : points) {
+                foundCount += bvh.findNearest(point, worldSize).has_value();
+            }
+        });
+
+        fmt::println("  nearest: {:.4f} ms per query, {} of {} found", nearestTime / queryCount, foundCount, queryCount);
+    }
+}
+
+void benchmarks::runTransformBenchmark(uint32_t entityCount, uint32_t frameCount) {
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    // one in a hundred entities is a root, the others get a random parent created before them
+    uint32_t rootCount = std::max(entityCount / 100, 1u);
+    std::vector<uint32_t> parents(entityCount, TransformHierarchy::NO_PARENT);
+
+    for (uint32_t i = rootCount; i < entityCount; i++) {
+        parents[i] = std::uniform_int_distribution<uint32_t>(0, i - 1)(random);
+    }
+
+    // scene entities keep their transforms in creation order and their children as pointers
+    struct Node {
+        Transform* transform;
+        std::vector<Node*> children;
+    };
+
+    std::vector<Transform> transforms(entityCount);
+    std::vector<std::unique_ptr<Node>> nodes(entityCount);
+
+    for (uint32_t i = 0; i < entityCount; i++) {
+        Transform& transform = transforms[i];
+
+        transform.position = (glm::vec3(unit(random), unit(random), unit(random)) * 2.f - 1.f) * 10.f;
+        transform.rotation = glm::quat(glm::vec3(unit(random), unit(random), unit(random)) * glm::two_pi<float>());
+        transform.scale = glm::vec3(0.9f + unit(random) * 0.2f);
+
+        nodes[i] = std::make_unique<Node>(Node{&transform, {}});
+
+        if (parents[i] != TransformHierarchy::NO_PARENT) {
+            nodes[parents[i]]->children.push_back(nodes[i].get());
+        }
+    }
+
+    // the previous propagation, every transform rebuilt recursively on every pass
+    uint32_t changedCount = 0;
+
+    auto propagateRecursive = [&](auto& self, Node& node, const glm::mat4& parentMatrix) -> void {
+        Transform& transform = *node.transform;
+        glm::mat4 oldGlobalMatrix = transform.globalMatrix;
+
+        transform.updateLocalMatrix();
+        transform.globalMatrix = parentMatrix * transform.localMatrix;
+        changedCount += transform.globalMatrix != oldGlobalMatrix;
+
+        for (auto child : node.children) {
+            self(self, *child, transform.globalMatrix);
+        }
+    };
+
+    auto propagateAll = [&]() {
+        for (uint32_t i = 0; i < rootCount; i++) {
+            propagateRecursive(propagateRecursive, *nodes[i], glm::mat4(1.f));
+        }
+    };
+
+    // depth first copy for the hierarchy, as the scene sorts its transform storage
+    std::vector<Transform> sortedTransforms(entityCount);
+    std::vector<uint32_t> sortedIndices(entityCount);
+    std::vector<std::pair<Node*, uint32_t>> stack;
+    uint32_t maxDepth = 0;
+    TransformHierarchy hierarchy;
+
+    float rebuildTime = measure(1, [&]() {
+        hierarchy.clear();
+
+        for (uint32_t root = rootCount; root-- > 0;) {
+            stack.push_back({nodes[root].get(), TransformHierarchy::NO_PARENT});
+        }
+
+        while (!stack.empty()) {
+            auto [node, parent] = stack.back();
+            stack.pop_back();
+
+            uint32_t index = node->transform - transforms.data();
+            uint32_t sortedIndex = hierarchy.getNodeCount();
+
+            sortedTransforms[sortedIndex] = *node->transform;
+            sortedIndices[index] = sortedIndex;
+            hierarchy.addNode(sortedTransforms[sortedIndex], parent);
+
+            // pushed in reverse so children keep their order
+            for (auto it = node->children.rbegin(); it != node->children.rend(); it++) {
+                stack.push_back({*it, sortedIndex});
+            }
+        }
+    });
+
+    for (uint32_t i = 0; i < entityCount; i++) {
+        uint32_t depth = 0;
+
+        for (uint32_t parent = parents[i]; parent != TransformHierarchy::NO_PARENT; parent = parents[parent]) {
+            depth++;
+        }
+
+        maxDepth = std::max(maxDepth, depth);
+    }
+
+    std::vector<Entity*> changedEntities;
+
+    float firstRecursiveTime = measure(1, propagateAll);
+    float firstPropagationTime = measure(1, [&]() {
+        hierarchy.propagate(changedEntities);
+    });
+
+    fmt::println("transform benchmark: {} entities, {} roots, max depth {}, {} frames of two propagations", entityCount, rootCount, maxDepth, frameCount);
+    fmt::println("  rebuild: {:.2f} ms, first propagation {:.2f} ms, recursive pass {:.2f} ms", rebuildTime, firstPropagationTime, firstRecursiveTime);
+
+    for (float movingShare : {0.f, 0.001f, 0.01f, 0.1f, 1.f}) {
+        uint32_t movingCount = (uint32_t)(entityCount * movingShare);
+
+        // both sides replay the same moves
+        std::vector<uint32_t> moving(movingCount * frameCount);
+
+        for (auto& index : moving) {
+            index = std::uniform_int_distribution<uint32_t>(0, entityCount - 1)(random);
+        }
+
+        auto move = [&](std::vector<Transform>& target, uint32_t frame, bool sorted) {
+            for (uint32_t i = frame * movingCount; i < (frame + 1) * movingCount; i++) {
+                Transform& transform = target[sorted ? sortedIndices[moving[i]] : moving[i]];
+
+                transform.translate(glm::vec3(0.f, 0.f, 1.f), 0.01f);
+                transform.rotate(glm::vec3(0.f, 1.f, 0.f), 1.f);
+            }
+        };
+
+        // the scene propagates after the update and the late update of its scripts
+        uint32_t frame = 0;
+        changedCount = 0;
+
+        float recursiveTime = measure(frameCount, [&]() {
+            move(transforms, frame++, false);
+            propagateAll();
+            propagateAll();
+        });
+
+        uint32_t recursiveChangedCount = changedCount;
+        uint64_t updatedCount = 0;
+        frame = 0;
+        changedCount = 0;
+
+        float hierarchyTime = measure(frameCount, [&]() {
+            move(sortedTransforms, frame++, true);
+            hierarchy.propagate(changedEntities);
+            updatedCount += hierarchy.getUpdatedCount();
+            hierarchy.propagate(changedEntities);
+        });
+
+        fmt::println("  {:.1f}% moving: recursive {:.3f} ms, dirty flags {:.3f} ms per frame, {:.0f} transforms recomputed and {} changed per frame",
+            movingShare * 100.f, recursiveTime, hierarchyTime, (float)updatedCount / frameCount, recursiveChangedCount / frameCount);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// cpu microbenchmarks, results are printed to stdout
+namespace benchmarks {
+    // compares the batched frustum culler against the per object projected box test
+    void runCullingBenchmark(uint32_t objectCount = 50000, uint32_t iterations = 100);
+
+    // compares radix sorted draw keys against the pointer comparator std::sort
+    void runDrawSortBenchmark(uint32_t objectCount, uint32_t iterations = 20);
+
+    // rasterizes the buildings of a synthetic city as occluders and tests props scattered
+    // between them, correctness is covered by tests/occlusion_culler_tests.cpp
+    void runOcclusionBenchmark(uint32_t blockCount = 24, uint32_t propCount = 20000, uint32_t iterations = 50);
+
+    // builds the lod chain of a uv sphere with a seam and of an open grid, the error bounds
+    // are checked in tests/mesh_lod_tests.cpp
+    void runLodBenchmark(uint32_t segmentCount = 384);
+
+    // optimizes a shuffled cluster of overlapping spheres with duplicated vertices, reports acmr,
+    // atvr and overdraw after every step, tests/mesh_optimizer_tests.cpp covers correctness
+    void runMeshOptimizerBenchmark(uint32_t sphereCount = 24, uint32_t segmentCount = 48);
+
+    // compresses random vertices into the compact format and reports the geometry size against
+    // full vertices, decoding errors are checked in tests/mesh_quantization_tests.cpp
+    void runVertexCompressionBenchmark(uint32_t vertexCount = 1000000);
+
+    // splits a cache optimized sphere into meshlets and reports their average fill and the share
+    // culled by normal cones from several distances
+    void runMeshletBenchmark(uint32_t segmentCount = 512);
+
+    // builds, moves and queries dynamic bvhs of 10k objects and every tenfold up to maxObjectCount,
+    // query results are checked against brute force in tests/dynamic_bvh_tests.cpp
+    void runBVHBenchmark(uint32_t maxObjectCount = 1000000, uint32_t queryCount = 1000);
+
+    // propagates a random forest of mostly static transforms, comparing the recursive full update
+    // against the depth first hierarchy with dirty flags, tests/transform_hierarchy_tests.cpp checks
+    // that both end with the same matrices
+    void runTransformBenchmark(uint32_t entityCount = 100000, uint32_t frameCount = 100);
+}
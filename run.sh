@@ -10,6 +10,13 @@ while [[ "$#" -gt 0 ]]; do
     case $1 in
         --target) TARGET="$2"; shift;; # Choose between game and editor apps
         --debug) ARGS="$ARGS --debug";; # Enables validation layers
+        --occlusion-culling) ARGS="$ARGS --occlusion-culling";; # Culls objects hidden by large occluders on the cpu
+        --compact-vertices) ARGS="$ARGS --compact-vertices";; # Uploads gltf meshes as 16 byte quantized vertices
+        --headless) ARGS="$ARGS --headless";; # Renders offscreen without a window, game only
+        --resolution|--frames|--output|--scene) ARGS="$ARGS $1=$2"; shift;; # Headless run options
+        --benchmark|--report) ARGS="$ARGS $1=$2"; shift;; # Flythrough benchmark camera path and json report path
+        --target-fps) ARGS="$ARGS $1=$2"; shift;; # Scales the render resolution to hold the frame rate
+        --icd) ENV_VARS="$ENV_VARS VK_DRIVER_FILES=$2"; shift;; # Vulkan driver manifest, e.g. lavapipe's lvp_icd json
         *) echo "Unknown argument: $1"; exit 1 ;;
     esac
     shift
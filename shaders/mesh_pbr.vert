@@ -42,23 +42,67 @@ layout(buffer_reference, std430) readonly buffer VertexBuffer {
 	Vertex vertices[];
 };
 
+layout(buffer_reference, std430) readonly buffer CompactVertexBuffer { 
+	uvec4 vertices[];
+};
+
+const uint VERTEX_FORMAT_COMPACT = 1;
+
+// positions are unorm16 over the mesh bounds, normals octahedral snorm16 and uvs half floats
+Vertex decodeCompactVertex(uvec4 packed, vec3 positionOffset, vec3 positionScale) {
+	vec2 positionXY = unpackUnorm2x16(packed.x);
+	float positionZ = unpackUnorm2x16(packed.y).x;
+
+	vec2 octahedral = unpackSnorm2x16(packed.z);
+	vec3 normal = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+	float fold = max(-normal.z, 0.0);
+	normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+
+	vec2 uv = unpackHalf2x16(packed.w);
+
+	Vertex v;
+	v.position = positionOffset + vec3(positionXY, positionZ) * positionScale;
+	v.normal = normalize(normal);
+	v.uvX = uv.x;
+	v.uvY = uv.y;
+
+	return v;
+}
+
+layout(buffer_reference, std430) readonly buffer InstanceBuffer { 
+	mat4 worldMatrices[];
+};
+
 //push constants block
 layout( push_constant ) uniform constants
 {
-	mat4 render_matrix;
 	VertexBuffer vertexBuffer;
+	InstanceBuffer instanceBuffer;
+	vec4 positionOffset;
+	vec3 positionScale;
+	uint vertexFormat;
 } PushConstants;
 
 void main() 
 {
-	Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+	Vertex v;
+
+	if (PushConstants.vertexFormat == VERTEX_FORMAT_COMPACT) {
+		CompactVertexBuffer compactVertices = CompactVertexBuffer(PushConstants.vertexBuffer);
+		v = decodeCompactVertex(compactVertices.vertices[gl_VertexIndex], PushConstants.positionOffset.xyz, PushConstants.positionScale);
+	} else {
+		v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+	}
+
+	// gl_InstanceIndex includes the draw's first instance
+	mat4 renderMatrix = PushConstants.instanceBuffer.worldMatrices[gl_InstanceIndex];
 	
 	vec4 position = vec4(v.position, 1.0);
 
-	gl_Position = sceneData.viewproj * PushConstants.render_matrix * position;
+	gl_Position = sceneData.viewproj * renderMatrix * position;
 
-	outNormal = mat3(transpose(inverse(PushConstants.render_matrix))) * v.normal;
+	outNormal = mat3(transpose(inverse(renderMatrix))) * v.normal;
 	outUV.x = v.uvX;
 	outUV.y = v.uvY;
-	outFragWorldPos = vec3(PushConstants.render_matrix * vec4(v.position, 1.0));
+	outFragWorldPos = vec3(renderMatrix * vec4(v.position, 1.0));
 }
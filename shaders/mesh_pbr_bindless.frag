@@ -0,0 +1,47 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive : require
+// needed for the unsized texture array
+#extension GL_EXT_nonuniform_qualifier : require
+#include "pbr_lighting.glsl"
+
+struct MaterialData {
+    vec4 colorFactors;
+    vec4 metalRoughFactors;
+    vec4 emissiveFactors;
+    float emissiveStrength;
+    float normalScale;
+    float occlusionStrength;
+    uint colorTex;
+    uint metalRoughTex;
+    uint normalTex;
+    uint emissiveTex;
+    uint occlusionTex;
+};
+
+// every material lives in one buffer, textures are indexed from one array
+layout(std430, set = 1, binding = 0) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+} materialBuffer;
+
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+// the index is uniform across a draw, so texture indexing needs no nonuniform qualifier
+layout(push_constant) uniform constants {
+    layout(offset = 48) uint materialIndex;
+} PushConstants;
+
+void main()
+{
+    MaterialData materialData = materialBuffer.materials[PushConstants.materialIndex];
+
+    SurfaceData surface;
+    surface.baseColor = materialData.colorFactors * texture(textures[materialData.colorTex], inUV);
+    surface.normalSample = texture(textures[materialData.normalTex], inUV).xyz;
+    surface.roughness = materialData.metalRoughFactors.y * texture(textures[materialData.metalRoughTex], inUV).g;
+    surface.metallic = materialData.metalRoughFactors.x * texture(textures[materialData.metalRoughTex], inUV).b;
+    surface.occlusion = 1.0 + materialData.occlusionStrength * (texture(textures[materialData.occlusionTex], inUV).r - 1.0);
+    surface.emissive = materialData.emissiveFactors.xyz * texture(textures[materialData.emissiveTex], inUV).xyz * materialData.emissiveStrength;
+
+    outFragColor = vec4(shadeSurface(surface), surface.baseColor.a);
+}
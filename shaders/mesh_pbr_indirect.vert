@@ -0,0 +1,119 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_buffer_reference : require
+
+// #include "input_structures.glsl"
+
+
+layout(set = 0, binding = 0) uniform SceneData {   
+
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	vec4 ambientColor;
+	vec4 sunlightDirection; //w for sun power
+	vec4 sunlightColor;
+	vec4 viewPosition;
+	vec4 data;
+} sceneData;
+
+layout(set = 1, binding = 0) uniform GLTFMaterialData {   
+
+    vec4 colorFactors;
+    vec4 metalRoughFactors;
+    vec4 emissiveFactors;
+    float emissiveStrength;
+    float normalScale;
+} materialData;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec3 outFragWorldPos;
+
+struct Vertex {
+    vec3 position;
+    float uvX;
+    vec3 normal;
+    float uvY;
+}; 
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer { 
+	Vertex vertices[];
+};
+
+layout(buffer_reference, std430) readonly buffer CompactVertexBuffer { 
+	uvec4 vertices[];
+};
+
+const uint VERTEX_FORMAT_COMPACT = 1;
+
+// positions are unorm16 over the mesh bounds, normals octahedral snorm16 and uvs half floats
+Vertex decodeCompactVertex(uvec4 packed, vec3 positionOffset, vec3 positionScale) {
+	vec2 positionXY = unpackUnorm2x16(packed.x);
+	float positionZ = unpackUnorm2x16(packed.y).x;
+
+	vec2 octahedral = unpackSnorm2x16(packed.z);
+	vec3 normal = vec3(octahedral, 1.0 - abs(octahedral.x) - abs(octahedral.y));
+	float fold = max(-normal.z, 0.0);
+	normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+
+	vec2 uv = unpackHalf2x16(packed.w);
+
+	Vertex v;
+	v.position = positionOffset + vec3(positionXY, positionZ) * positionScale;
+	v.normal = normalize(normal);
+	v.uvX = uv.x;
+	v.uvY = uv.y;
+
+	return v;
+}
+
+struct ObjectData {
+	mat4 worldMatrix;
+	vec4 boundsOrigin;
+	vec4 boundsExtents;
+	VertexBuffer vertexBuffer;
+	uint firstIndex;
+	uint indexCount;
+	uint drawBucket;
+	uint bucketOffset;
+	int vertexOffset;
+	uint vertexFormat;
+	vec4 positionOffset;
+	vec4 positionScale;
+};
+
+layout(buffer_reference, std430) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+};
+
+//push constants block
+layout( push_constant ) uniform constants
+{
+	ObjectBuffer objectBuffer;
+} PushConstants;
+
+void main() 
+{
+	// first instance of the indirect draw holds the object index
+	ObjectData object = PushConstants.objectBuffer.objects[gl_InstanceIndex];
+
+	Vertex v;
+
+	if (object.vertexFormat == VERTEX_FORMAT_COMPACT) {
+		CompactVertexBuffer compactVertices = CompactVertexBuffer(object.vertexBuffer);
+		v = decodeCompactVertex(compactVertices.vertices[gl_VertexIndex], object.positionOffset.xyz, object.positionScale.xyz);
+	} else {
+		v = object.vertexBuffer.vertices[gl_VertexIndex];
+	}
+	
+	vec4 position = vec4(v.position, 1.0);
+
+	gl_Position = sceneData.viewproj * object.worldMatrix * position;
+
+	outNormal = mat3(transpose(inverse(object.worldMatrix))) * v.normal;
+	outUV.x = v.uvX;
+	outUV.y = v.uvY;
+	outFragWorldPos = vec3(object.worldMatrix * vec4(v.position, 1.0));
+}
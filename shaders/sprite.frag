@@ -3,9 +3,10 @@
 layout(set = 0, binding = 0) uniform sampler2D colorTex;
 
 layout(location = 0) in vec2 inUV;
+layout(location = 1) in vec4 inTint;
 
 layout(location = 0) out vec4 outFragColor;
 
 void main() {
-    outFragColor = texture(colorTex, inUV);
+    outFragColor = texture(colorTex, inUV) * inTint;
 }
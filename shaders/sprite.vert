@@ -11,26 +11,40 @@ struct Vertex {
     float uvY;
 };
 
+struct SpriteInstance {
+    mat4 transform;
+    vec4 uvRect;
+    vec4 tint;
+};
+
 layout(buffer_reference, std430) readonly buffer VertexBuffer {
     Vertex vertices[];
 };
 
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    SpriteInstance instances[];
+};
+
 layout(push_constant) uniform constants
 {
-    mat4 worldMatrix;
+    mat4 projection;
     VertexBuffer vertexBuffer;
+    InstanceBuffer instanceBuffer;
 } PushConstants;
 
 layout(location = 0) out vec2 outUV;
+layout(location = 1) out vec4 outTint;
 
 void main()
 {
     Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+    SpriteInstance instance = PushConstants.instanceBuffer.instances[gl_InstanceIndex];
 
     vec4 position = vec4(v.position.x, v.position.y, 1.0, 1.0);
 
-    gl_Position = PushConstants.worldMatrix * position;
+    gl_Position = PushConstants.projection * instance.transform * position;
 
-    outUV.x = v.uvX;
-    outUV.y = v.uvY;
+    // map quad uvs into the sprite's atlas region
+    outUV = mix(instance.uvRect.xy, instance.uvRect.zw, vec2(v.uvX, v.uvY));
+    outTint = instance.tint;
 }
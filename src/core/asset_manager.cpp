@@ -13,7 +13,11 @@
 #include "glm/trigonometric.hpp"
 #include <glm/gtc/packing.hpp>
 
+#include <chrono>
+
 AssetManager::AssetManager(VulkanEngine& vkEngine) : mVkEngine(vkEngine) {
+    mSpriteAtlas = std::make_unique<SpriteAtlas>(mVkEngine, VK_FORMAT_R8G8B8A8_SRGB);
+
     loadDefaultSamplers();
     loadDefaultMeshes();
     loadDefaultImages();
@@ -25,6 +29,8 @@ AssetManager::~AssetManager() {
 }
 
 void AssetManager::loadImage(const std::filesystem::path& filename, VkFormat format, bool computeRelated) {
+    PROFILE_SCOPE_DETAIL("load image", filename.string());
+
     auto& target = computeRelated ? mComputeImages : mImages;
 
     if (target.contains(filename.stem())) {
@@ -58,6 +64,10 @@ void AssetManager::loadImage(const std::filesystem::path& filename, VkFormat for
         false
     );
 
+    if (!computeRelated) {
+        mSpriteAtlas->addImage(filename.stem(), data, width, height);
+    }
+
     stbi_image_free(data);
 }
 
@@ -79,6 +89,8 @@ void AssetManager::loadComputeEffectTextures() {
 }
 
 void AssetManager::loadGltf(const std::string& name) {
+    PROFILE_SCOPE_DETAIL("load gltf", name);
+
     if (mLoadedGltfs.contains(name)) {
         return;
     }
@@ -97,12 +109,15 @@ void AssetManager::loadGltf(const std::string& name) {
 }
 
 void AssetManager::renderToCubemap(
-    AllocatedImage& src,
-    AllocatedImage& dest,
+    VkCommandBuffer commandBuffer,
+    const AllocatedImage& src,
+    const AllocatedImage& dest,
     Pipeline *pipeline,
     VkExtent2D destSize,
     uint32_t mipLevel,
-    bool flipViewport
+    bool flipViewport,
+    uint32_t firstFace,
+    uint32_t faceCount
 ) {
     // setup projection and view matrices
     glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
@@ -126,9 +141,7 @@ void AssetManager::renderToCubemap(
     destSize.width >>= mipLevel;
     destSize.height >>= mipLevel;
 
-    fmt::println("dest size: {} {}, mip: {}", destSize.width, destSize.height, mipLevel);
-
-    auto cubeMesh = mMeshes["cube"];
+    auto& cubeMesh = mMeshes["cube"];
 
     // create push constants
     SkyboxLoadPushConstants captureConstants{};
@@ -136,81 +149,53 @@ void AssetManager::renderToCubemap(
     captureConstants.mipLevel = mipLevel;
     captureConstants.totalMips = dest.mipLevels;
 
-    // transition cubemap to color attachment layout
-    mVkEngine.immediateSubmit([&](VkCommandBuffer commandBuffer) {
-        vkutil::transitionImage(commandBuffer, dest.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-    });
-
-    for (uint32_t i = 0; i < 6; i++) {
+    // set dynamic viewport and scissor, shared by every face
+    VkViewport viewport{};
+    viewport.x = 0.f;
+    viewport.y = flipViewport ? destSize.height : 0.f;
+    viewport.width = destSize.width;
+    viewport.height = flipViewport ? -(float)(destSize.height) : destSize.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset.x = 0;
+    scissor.offset.y = 0;
+    scissor.extent.width = destSize.width;
+    scissor.extent.height = destSize.height;
+
+    // push descriptor set
+    DescriptorWriter writer;
+    std::vector<VkWriteDescriptorSet> descriptorWrites = writer.writeImage(0, src.imageView, mDefaultSamplers["linear"], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+                                                                .getWrites();
+
+    for (uint32_t i = firstFace; i < firstFace + faceCount; i++) {
         captureConstants.projViewMatrix = captureProjection * glm::mat4(glm::mat3(captureViews[i]));
 
-        // create cubemap face view
-        VkImageView cubeFaceView;
-
-        VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(VK_FORMAT_R16G16B16A16_SFLOAT, dest.image, VK_IMAGE_ASPECT_COLOR_BIT);
-        viewInfo.subresourceRange.baseArrayLayer = i;
-        viewInfo.subresourceRange.layerCount = 1;
-        viewInfo.subresourceRange.baseMipLevel = mipLevel;
-        viewInfo.subresourceRange.levelCount = 1;
-
-        VK_CHECK(vkCreateImageView(mVkEngine.getDevice(), &viewInfo, nullptr, &cubeFaceView));
-
         // render to cube face
-        mVkEngine.immediateSubmit([&](VkCommandBuffer commandBuffer) {
-            VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(cubeFaceView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-
-            VkRenderingInfo renderInfo = vkinit::rendering_info(destSize, &colorAttachment, nullptr);
-
-            vkCmdBeginRendering(commandBuffer, &renderInfo);
-
-            // set dynamic viewport and scissor
-            VkViewport viewport{};
-            viewport.x = 0.f;
-            viewport.y = flipViewport ? destSize.height : 0.f;
-            viewport.width = destSize.width;
-            viewport.height = flipViewport ? -(float)(destSize.height) : destSize.height;
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-
-            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(dest.faceViews[mipLevel * 6 + i], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-            VkRect2D scissor{};
-            scissor.offset.x = 0;
-            scissor.offset.y = 0;
-            scissor.extent.width = destSize.width;
-            scissor.extent.height = destSize.height;
+        VkRenderingInfo renderInfo = vkinit::rendering_info(destSize, &colorAttachment, nullptr);
 
-            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        vkCmdBeginRendering(commandBuffer, &renderInfo);
 
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
-            // bind index buffer
-            vkCmdBindIndexBuffer(commandBuffer, cubeMesh.meshBuffers.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+        // bind index buffer
+        vkCmdBindIndexBuffer(commandBuffer, cubeMesh.meshBuffers.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-            // push descriptor set
-            DescriptorWriter writer;
-            std::vector<VkWriteDescriptorSet> descriptorWrites = writer.writeImage(0, src.imageView, mDefaultSamplers["linear"], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
-                                                                        .getWrites();
+        vkCmdPushDescriptorSetKHR(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, (uint32_t)descriptorWrites.size(), descriptorWrites.data());
 
-            vkCmdPushDescriptorSetKHR(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, (uint32_t)descriptorWrites.size(), descriptorWrites.data());
+        // push constants
+        vkCmdPushConstants(commandBuffer, pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SkyboxLoadPushConstants), &captureConstants);
 
-            // push constants
-            vkCmdPushConstants(commandBuffer, pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SkyboxLoadPushConstants), &captureConstants);
+        // draw
+        vkCmdDrawIndexed(commandBuffer, cubeMesh.surfaces[0].count, 1, cubeMesh.meshBuffers.firstIndex + cubeMesh.surfaces[0].startIndex, cubeMesh.meshBuffers.vertexOffset, 0);
 
-            // draw
-            vkCmdDrawIndexed(commandBuffer, cubeMesh.surfaces[0].count, 1, cubeMesh.surfaces[0].startIndex, 0, 0);
-
-            vkCmdEndRendering(commandBuffer);
-        }, true);
-
-        // destroy cubemap face view
-        vkDestroyImageView(mVkEngine.getDevice(), cubeFaceView, nullptr);
+        vkCmdEndRendering(commandBuffer);
     }
-
-    // transition cubemap to shader read layout
-    mVkEngine.immediateSubmit([&](VkCommandBuffer commandBuffer) {
-        vkutil::transitionImage(commandBuffer, dest.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    });
 }
 
 void AssetManager::saveSkyboxToFile(const SkyboxAsset& skybox) {
@@ -423,7 +408,75 @@ void AssetManager::saveSkyboxToFile(const SkyboxAsset& skybox) {
     }
 }
 
+uint32_t AssetManager::precomputeSkyboxMaps(SkyboxAsset& skybox, bool submitPerFace) {
+    // every transition and face draw is one command, normally all of them are recorded into one
+    // submission with barriers between the maps making each one readable before the next samples it
+    std::vector<std::function<void(VkCommandBuffer)>> commands;
+
+    auto addPass = [&](const AllocatedImage& src, const AllocatedImage& dest, PipelineResourceManager::PipelineType type, VkExtent2D size, uint32_t mip, bool flipViewport) {
+        Pipeline* pipeline = mVkEngine.getPipelineResourceManager().getPipeline(type);
+
+        if (!submitPerFace) {
+            commands.push_back([=, this, &src, &dest](VkCommandBuffer commandBuffer) {
+                renderToCubemap(commandBuffer, src, dest, pipeline, size, mip, flipViewport);
+            });
+
+            return;
+        }
+
+        for (uint32_t face = 0; face < 6; face++) {
+            commands.push_back([=, this, &src, &dest](VkCommandBuffer commandBuffer) {
+                renderToCubemap(commandBuffer, src, dest, pipeline, size, mip, flipViewport, face, 1);
+            });
+        }
+    };
+
+    auto addTransition = [&](const AllocatedImage& image, VkImageLayout currentLayout, VkImageLayout newLayout) {
+        commands.push_back([=, &image](VkCommandBuffer commandBuffer) {
+            vkutil::transitionImage(commandBuffer, image.image, currentLayout, newLayout);
+        });
+    };
+
+    addTransition(skybox.envMap, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    addTransition(skybox.irrMap, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    addTransition(skybox.prefilteredEnvMap, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    for (uint32_t mip = 0; mip < skybox.envMap.mipLevels; mip++) {
+        addPass(skybox.hdrImage, skybox.envMap, PipelineResourceManager::PipelineType::EQUI_TO_CUBE, SkyboxAsset::ENV_MAP_SIZE, mip, true);
+    }
+
+    addTransition(skybox.envMap, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    addPass(skybox.envMap, skybox.irrMap, PipelineResourceManager::PipelineType::ENV_TO_IRR, SkyboxAsset::IRR_MAP_SIZE, 0, false);
+
+    for (uint32_t mip = 0; mip < 5; mip++) {
+        addPass(skybox.envMap, skybox.prefilteredEnvMap, PipelineResourceManager::PipelineType::PREFILTER_ENV, SkyboxAsset::PREFILTERED_ENV_MAP_SIZE, mip, false);
+    }
+
+    addTransition(skybox.irrMap, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    addTransition(skybox.prefilteredEnvMap, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    if (!submitPerFace) {
+        mVkEngine.immediateSubmit([&](VkCommandBuffer commandBuffer) {
+            for (auto& command : commands) {
+                command(commandBuffer);
+            }
+        });
+
+        return 1;
+    }
+
+    // the old path, a blocking submit and queue idle wait for every face and transition
+    for (auto& command : commands) {
+        mVkEngine.immediateSubmit(std::move(command), true);
+    }
+
+    return (uint32_t)commands.size();
+}
+
 void AssetManager::loadSkybox(const std::string& name) {
+    PROFILE_SCOPE_DETAIL("load skybox", name);
+
     if (mSkyboxes.contains(name)) {
         return;
     }
@@ -442,6 +495,8 @@ void AssetManager::loadSkybox(const std::string& name) {
         return;
     }
 
+    auto loadStart = std::chrono::high_resolution_clock::now();
+
     // load hdr image using stb
     int width, height, nrChannels;
     float* data = stbi_loadf(filePath.string().c_str(), &width, &height, &nrChannels, 4);
@@ -460,6 +515,8 @@ void AssetManager::loadSkybox(const std::string& name) {
         false
     );
 
+    stbi_image_free(data);
+
     // create environment map
     skybox.envMap = mVkEngine.createCubemap(
         SkyboxAsset::ENV_MAP_SIZE,
@@ -469,17 +526,6 @@ void AssetManager::loadSkybox(const std::string& name) {
         true
     );
 
-    for (int i = 0; i < skybox.envMap.mipLevels; i++) {
-        renderToCubemap(
-            skybox.hdrImage,
-            skybox.envMap,
-            mVkEngine.getPipelineResourceManager().getPipeline(PipelineResourceManager::PipelineType::EQUI_TO_CUBE),
-            SkyboxAsset::ENV_MAP_SIZE,
-            i,
-            true
-        );
-    }
-
     // create irradiance cube map
     skybox.irrMap = mVkEngine.createCubemap(
         SkyboxAsset::IRR_MAP_SIZE,
@@ -487,13 +533,6 @@ void AssetManager::loadSkybox(const std::string& name) {
         VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
     );
 
-    renderToCubemap(
-        skybox.envMap,
-        skybox.irrMap,
-        mVkEngine.getPipelineResourceManager().getPipeline(PipelineResourceManager::PipelineType::ENV_TO_IRR),
-        SkyboxAsset::IRR_MAP_SIZE
-    );
-
     // create prefiltered environment map
     skybox.prefilteredEnvMap = mVkEngine.createCubemap(
         SkyboxAsset::PREFILTERED_ENV_MAP_SIZE,
@@ -503,16 +542,32 @@ void AssetManager::loadSkybox(const std::string& name) {
         true
     );
 
-    for (uint32_t mip = 0; mip < 5; mip++) {
-        renderToCubemap(
-            skybox.envMap,
-            skybox.prefilteredEnvMap,
-            mVkEngine.getPipelineResourceManager().getPipeline(PipelineResourceManager::PipelineType::PREFILTER_ENV),
-            SkyboxAsset::PREFILTERED_ENV_MAP_SIZE,
-            mip
+    auto uploadEnd = std::chrono::high_resolution_clock::now();
+
+    if (mVkEngine.getEngineConfig().compareSkyboxPrecompute) {
+        auto perFaceStart = std::chrono::high_resolution_clock::now();
+        uint32_t perFaceSubmissions = precomputeSkyboxMaps(skybox, true);
+        auto perFaceEnd = std::chrono::high_resolution_clock::now();
+
+        fmt::println(
+            "skybox {}: per face precompute {:.2f} ms in {} submissions",
+            name,
+            std::chrono::duration_cast<std::chrono::microseconds>(perFaceEnd - perFaceStart).count() / 1000.f,
+            perFaceSubmissions
         );
     }
 
+    auto precomputeStart = std::chrono::high_resolution_clock::now();
+    precomputeSkyboxMaps(skybox, false);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    fmt::println(
+        "skybox {}: decode and upload {:.2f} ms, precompute {:.2f} ms in one submission",
+        name,
+        std::chrono::duration_cast<std::chrono::microseconds>(uploadEnd - loadStart).count() / 1000.f,
+        std::chrono::duration_cast<std::chrono::microseconds>(end - precomputeStart).count() / 1000.f
+    );
+
     // set brdf lut image
     skybox.brdfLut = mDefaultImages["brdflut"];
 
@@ -719,8 +774,7 @@ void AssetManager::freeResources() {
     }
 
     for (auto& [k, v] : mMeshes) {
-        mVkEngine.destroyBuffer(v.meshBuffers.indexBuffer);
-        mVkEngine.destroyBuffer(v.meshBuffers.vertexBuffer);
+        mVkEngine.getGeometryPool().free(v.meshBuffers);
     }
 
     for (auto& [k, v] : mSkyboxes) {
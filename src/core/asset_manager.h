@@ -3,6 +3,7 @@
 #include <unordered_map>
 #include <vk_loader.h>
 #include <memory.h>
+#include "sprite_atlas.h"
 
 class VulkanEngine;
 
@@ -60,6 +61,14 @@ public:
         return &mDefaultSamplers[name];
     }
 
+    const SpriteRegion *getSpriteRegion(const std::string& name) {
+        return mSpriteAtlas->getRegion(name);
+    }
+
+    SpriteAtlas& getSpriteAtlas() {
+        return *mSpriteAtlas;
+    }
+
     AllocatedImage *getDefaultImage(const std::string& name) {
         if (!mDefaultImages.contains(name)) {
             return nullptr;
@@ -74,7 +83,10 @@ private:
     void loadDefaultSamplers();
     void loadComputeEffectTextures();
 
-    void renderToCubemap(AllocatedImage& src, AllocatedImage& dest, Pipeline *pipeline, VkExtent2D destSize, uint32_t mipLevel = 0, bool flipViewport = false);
+    // records the face draws of one mip, all 6 by default, dest must be in color attachment layout
+    void renderToCubemap(VkCommandBuffer commandBuffer, const AllocatedImage& src, const AllocatedImage& dest, Pipeline *pipeline, VkExtent2D destSize, uint32_t mipLevel = 0, bool flipViewport = false, uint32_t firstFace = 0, uint32_t faceCount = 6);
+    // renders the environment, irradiance and prefiltered maps, returns the number of submissions
+    uint32_t precomputeSkyboxMaps(SkyboxAsset& skybox, bool submitPerFace);
     void freeResources();
 
     void saveSkyboxToFile(const SkyboxAsset& skybox);
@@ -91,6 +103,9 @@ private:
     std::unordered_map<std::string, AllocatedImage> mComputeImages;
     std::unordered_map<std::string, SkyboxAsset> mSkyboxes;
 
+    // sprite images are also packed here for batched drawing
+    std::unique_ptr<SpriteAtlas> mSpriteAtlas;
+
     // default data
     std::unordered_map<std::string, MeshAsset> mMeshes;
     std::unordered_map<std::string, AllocatedImage> mDefaultImages;
@@ -0,0 +1,233 @@
+#include "camera_path.h"
+
+#include <nlohmann/json.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+#include <glm/gtx/spline.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+static std::vector<std::pair<int, InputState>> activeStates(const std::unordered_map<int, InputState>& states) {
+    std::vector<std::pair<int, InputState>> active;
+
+    for (auto& [code, state] : states) {
+        if (state != InputState::IDLE) {
+            active.emplace_back(code, state);
+        }
+    }
+
+    // unordered map iteration order isn't stable between runs, keep the files diffable
+    std::sort(active.begin(), active.end());
+
+    return active;
+}
+
+static void setStates(std::unordered_map<int, InputState>& states, const std::vector<std::pair<int, InputState>>& active) {
+    for (auto& [code, state] : states) {
+        state = InputState::IDLE;
+    }
+
+    for (auto& [code, state] : active) {
+        states[code] = state;
+    }
+}
+
+static std::vector<std::pair<int, InputState>> statesFromJson(const nlohmann::json& j) {
+    std::vector<std::pair<int, InputState>> states;
+
+    for (auto& entry : j) {
+        states.emplace_back(entry[0].get<int>(), (InputState)entry[1].get<int>());
+    }
+
+    return states;
+}
+
+static nlohmann::json statesToJson(const std::vector<std::pair<int, InputState>>& states) {
+    nlohmann::json j = nlohmann::json::array();
+
+    for (auto& [code, state] : states) {
+        j.push_back({code, (int)state});
+    }
+
+    return j;
+}
+
+std::optional<CameraPath> CameraPath::load(const std::filesystem::path& path) {
+    std::ifstream file(path);
+
+    if (!file.is_open()) {
+        fmt::println("Failed to open camera path {}", path.string());
+        return std::nullopt;
+    }
+
+    nlohmann::json pathJson = nlohmann::json::parse(file, nullptr, false);
+
+    if (pathJson.is_discarded() || !pathJson.is_object()) {
+        fmt::println("Camera path {} is not valid json", path.string());
+        return std::nullopt;
+    }
+
+    CameraPath cameraPath;
+    cameraPath.mTimeStep = pathJson.value("TimeStep", DEFAULT_TIME_STEP);
+
+    if (cameraPath.mTimeStep <= 0.f) {
+        cameraPath.mTimeStep = DEFAULT_TIME_STEP;
+    }
+
+    if (pathJson.contains("Keyframes")) {
+        for (auto& keyframeJson : pathJson["Keyframes"]) {
+            Keyframe keyframe{};
+            keyframe.time = keyframeJson["Time"];
+
+            auto position = keyframeJson["Position"];
+            keyframe.position = glm::vec3(position[0], position[1], position[2]);
+
+            auto rotation = keyframeJson["Rotation"];
+
+            if (rotation.size() == 4) {
+                keyframe.rotation = glm::quat(rotation[0], rotation[1], rotation[2], rotation[3]);
+            } else {
+                keyframe.rotation = glm::quat(glm::vec3(rotation[0], rotation[1], rotation[2]));
+            }
+
+            cameraPath.mKeyframes.push_back(keyframe);
+        }
+
+        // hand written paths don't have to be in order
+        std::stable_sort(cameraPath.mKeyframes.begin(), cameraPath.mKeyframes.end(), [](const Keyframe& a, const Keyframe& b) {
+            return a.time < b.time;
+        });
+    }
+
+    if (pathJson.contains("Input")) {
+        for (auto& frameJson : pathJson["Input"]) {
+            InputFrame frame{};
+            frame.keys = statesFromJson(frameJson["Keys"]);
+            frame.buttons = statesFromJson(frameJson["Buttons"]);
+            frame.mouseDelta = glm::vec<2, double>(frameJson["MouseDelta"][0], frameJson["MouseDelta"][1]);
+            frame.mousePosition = glm::vec<2, double>(frameJson["MousePosition"][0], frameJson["MousePosition"][1]);
+            frame.wheelDelta = frameJson["WheelDelta"];
+
+            cameraPath.mInputFrames.push_back(std::move(frame));
+        }
+    }
+
+    if (cameraPath.mKeyframes.empty() && cameraPath.mInputFrames.empty()) {
+        fmt::println("Camera path {} has no keyframes or input", path.string());
+        return std::nullopt;
+    }
+
+    return cameraPath;
+}
+
+bool CameraPath::save(const std::filesystem::path& path) const {
+    std::ofstream outFile(path);
+
+    if (!outFile.is_open()) {
+        fmt::println("Failed to open {} for writing", path.string());
+        return false;
+    }
+
+    nlohmann::json pathJson;
+    pathJson["TimeStep"] = mTimeStep;
+    pathJson["Keyframes"] = nlohmann::json::array();
+    pathJson["Input"] = nlohmann::json::array();
+
+    for (auto& keyframe : mKeyframes) {
+        pathJson["Keyframes"].push_back({
+            {"Time", keyframe.time},
+            {"Position", {keyframe.position.x, keyframe.position.y, keyframe.position.z}},
+            {"Rotation", {keyframe.rotation.w, keyframe.rotation.x, keyframe.rotation.y, keyframe.rotation.z}}
+        });
+    }
+
+    for (auto& frame : mInputFrames) {
+        pathJson["Input"].push_back({
+            {"Keys", statesToJson(frame.keys)},
+            {"Buttons", statesToJson(frame.buttons)},
+            {"MouseDelta", {frame.mouseDelta.x, frame.mouseDelta.y}},
+            {"MousePosition", {frame.mousePosition.x, frame.mousePosition.y}},
+            {"WheelDelta", frame.wheelDelta}
+        });
+    }
+
+    outFile << pathJson.dump(4);
+
+    fmt::println("Saved camera path with {} keyframes and {} input frames to {}", mKeyframes.size(), mInputFrames.size(), path.string());
+
+    return true;
+}
+
+void CameraPath::addFrame(float deltaTime, std::optional<glm::mat4> cameraMatrix, const Input& input) {
+    if (cameraMatrix) {
+        glm::vec3 scale;
+        glm::vec3 skew;
+        glm::vec4 perspective;
+
+        Keyframe keyframe{};
+        keyframe.time = mRecordedTime;
+        glm::decompose(*cameraMatrix, scale, keyframe.rotation, keyframe.position, skew, perspective);
+
+        mKeyframes.push_back(keyframe);
+    }
+
+    InputFrame frame{};
+    frame.keys = activeStates(input.keyStates);
+    frame.buttons = activeStates(input.mouse.buttonStates);
+    frame.mouseDelta = input.mouse.deltaPosition;
+    frame.mousePosition = input.mouse.position;
+    frame.wheelDelta = input.mouse.deltaWheel;
+
+    mInputFrames.push_back(std::move(frame));
+
+    mRecordedTime += deltaTime;
+    mTimeStep = mRecordedTime / mInputFrames.size();
+}
+
+glm::mat4 CameraPath::sample(float time) const {
+    if (mKeyframes.empty()) {
+        return glm::mat4(1.f);
+    }
+
+    // index of the first keyframe after time, clamped to the ends of the path
+    auto next = std::upper_bound(mKeyframes.begin(), mKeyframes.end(), time, [](float time, const Keyframe& keyframe) {
+        return time < keyframe.time;
+    });
+
+    uint32_t last = mKeyframes.size() - 1;
+    uint32_t i2 = std::min<uint32_t>(next - mKeyframes.begin(), last);
+    uint32_t i1 = i2 > 0 ? i2 - 1 : 0;
+    uint32_t i0 = i1 > 0 ? i1 - 1 : 0;
+    uint32_t i3 = std::min(i2 + 1, last);
+
+    const Keyframe& k1 = mKeyframes[i1];
+    const Keyframe& k2 = mKeyframes[i2];
+
+    float length = k2.time - k1.time;
+    float t = length > 0.f ? std::clamp((time - k1.time) / length, 0.f, 1.f) : 0.f;
+
+    glm::vec3 position = glm::catmullRom(mKeyframes[i0].position, k1.position, k2.position, mKeyframes[i3].position, t);
+    glm::quat rotation = glm::slerp(k1.rotation, k2.rotation, t);
+
+    return glm::translate(glm::mat4(1.f), position) * glm::toMat4(rotation);
+}
+
+void CameraPath::applyInput(uint32_t frame, Input& input) const {
+    // past the end of the recording nothing is pressed
+    if (frame >= mInputFrames.size()) {
+        setStates(input.keyStates, {});
+        setStates(input.mouse.buttonStates, {});
+        input.mouse.deltaPosition = glm::vec<2, double>(0.0);
+        input.mouse.deltaWheel = 0.0;
+
+        return;
+    }
+
+    const InputFrame& inputFrame = mInputFrames[frame];
+
+    setStates(input.keyStates, inputFrame.keys);
+    setStates(input.mouse.buttonStates, inputFrame.buttons);
+    input.mouse.deltaPosition = inputFrame.mouseDelta;
+    input.mouse.position = inputFrame.mousePosition;
+    input.mouse.deltaWheel = inputFrame.wheelDelta;
+}
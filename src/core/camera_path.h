@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vk_types.h"
+#include "vk_window.h"
+
+#include <filesystem>
+#include <optional>
+
+// camera flythrough stored as json, keyframes are either written by hand or recorded
+// every frame together with the input that reached the scene, so scripted scenes
+// replay the same way
+//
+// {
+//     "TimeStep": 0.0166,
+//     "Keyframes": [{"Time": 0.0, "Position": [x, y, z], "Rotation": [x, y, z] or [w, x, y, z]}],
+//     "Input": [{"Keys": [[scancode, state]], "Buttons": [[button, state]], "MouseDelta": [x, y], "MousePosition": [x, y], "WheelDelta": 0.0}]
+// }
+//
+// euler rotations are in radians like scene transforms, keys are platform scancodes
+class CameraPath {
+public:
+    static constexpr float DEFAULT_TIME_STEP = 1.f / 60.f;
+
+    struct Keyframe {
+        float time;
+        glm::vec3 position;
+        glm::quat rotation;
+    };
+
+    // only keys and buttons that aren't idle are stored
+    struct InputFrame {
+        std::vector<std::pair<int, InputState>> keys;
+        std::vector<std::pair<int, InputState>> buttons;
+        glm::vec<2, double> mouseDelta{};
+        glm::vec<2, double> mousePosition{};
+        double wheelDelta = 0.0;
+    };
+
+    static std::optional<CameraPath> load(const std::filesystem::path& path);
+    bool save(const std::filesystem::path& path) const;
+
+    // appends a recorded frame, frames without a camera only record input
+    void addFrame(float deltaTime, std::optional<glm::mat4> cameraMatrix, const Input& input);
+
+    // position on a catmull-rom spline through the keyframes, rotation slerped between them
+    glm::mat4 sample(float time) const;
+
+    // overwrites the states in input with the recorded frame, every key missing from it is idle
+    void applyInput(uint32_t frame, Input& input) const;
+
+    bool hasKeyframes() const {
+        return !mKeyframes.empty();
+    }
+
+    uint32_t getInputFrameCount() const {
+        return mInputFrames.size();
+    }
+
+    float getDuration() const {
+        return mKeyframes.empty() ? 0.f : mKeyframes.back().time;
+    }
+
+    // average frame time of a recording, replays step it at a fixed rate
+    float getTimeStep() const {
+        return mTimeStep;
+    }
+
+private:
+    std::vector<Keyframe> mKeyframes;
+    std::vector<InputFrame> mInputFrames;
+
+    float mTimeStep = DEFAULT_TIME_STEP;
+    float mRecordedTime = 0.f;
+};
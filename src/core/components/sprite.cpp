@@ -9,6 +9,13 @@ nlohmann::json componentToJson<Sprite>(const Sprite& component) {
     nlohmann::json j;
 
     j[type]["Name"] = component.name;
+    j[type]["Layer"] = component.layer;
+    j[type]["Tint"] = std::vector<float> {
+        component.tint.r,
+        component.tint.g,
+        component.tint.b,
+        component.tint.a
+    };
 
     return j;
 }
@@ -19,5 +26,15 @@ Sprite componentFromJson(const nlohmann::json& j) {
 
     newSprite.name = j["Name"];
 
+    // older scenes only store the name
+    if (j.contains("Layer")) {
+        newSprite.layer = j["Layer"];
+    }
+
+    if (j.contains("Tint")) {
+        auto tint = j["Tint"];
+        newSprite.tint = glm::vec4(tint[0], tint[1], tint[2], tint[3]);
+    }
+
     return newSprite;
 }
@@ -1,8 +1,16 @@
 #pragma once
 
 struct AllocatedImage;
+struct SpriteRegion;
 
 struct Sprite {
     AllocatedImage *image = nullptr;
     std::string name = "";
+
+    // atlas region the image was packed into
+    const SpriteRegion *region = nullptr;
+
+    // sprites are drawn layer by layer, lower layers first
+    int layer = 0;
+    glm::vec4 tint{1.f};
 };
@@ -1,23 +1,44 @@
 #include "transform.h"
 #include "utils.h"
+#include "transform_hierarchy.h"
 
 glm::mat4 Transform::getRotationMatrix() {
     return glm::toMat4(rotation);
 }
 
-void Transform::update(glm::mat4 parentMatrix) {
+void Transform::updateLocalMatrix() {
     localMatrix = glm::translate(glm::mat4(1.f), position) *
                   getRotationMatrix() *
                   glm::scale(glm::mat4(1.f), scale);
 
-    globalMatrix = parentMatrix * localMatrix;
-
     forward = glm::rotate(rotation, glm::vec3(0.f, 0.f, 1.f));
     right = glm::rotate(rotation, glm::vec3(1.f, 0.f, 0.f));
 }
 
+void Transform::markDirty() {
+    if (hierarchy != nullptr) {
+        hierarchy->markDirty(*this);
+    }
+}
+
+void Transform::setPosition(const glm::vec3& newPosition) {
+    position = newPosition;
+    markDirty();
+}
+
+void Transform::setRotation(const glm::quat& newRotation) {
+    rotation = newRotation;
+    markDirty();
+}
+
+void Transform::setScale(const glm::vec3& newScale) {
+    scale = newScale;
+    markDirty();
+}
+
 void Transform::translate(glm::vec3 direction, float distance) {
     position += direction * distance;
+    markDirty();
 }
 
 void Transform::rotate(glm::vec3 axis, float degrees) {
@@ -26,6 +47,7 @@ void Transform::rotate(glm::vec3 axis, float degrees) {
 
     forward = glm::rotate(rotation, glm::vec3(0.f, 0.f, 1.f));
     right = glm::rotate(rotation, glm::vec3(1.f, 0.f, 0.f));
+    markDirty();
 }
 
 Transform::Transform() {}
@@ -1,5 +1,8 @@
 #pragma once
 
+// forward reference
+class TransformHierarchy;
+
 struct Transform {
     glm::vec3 position{};
     glm::quat rotation = glm::quat(glm::vec3(0.f, 0.f, 0.f));
@@ -11,12 +14,22 @@ struct Transform {
     glm::vec3 forward;
     glm::vec3 right;
 
+    // set by the scene when it rebuilds its hierarchy, writes have to mark the transform dirty
+    TransformHierarchy* hierarchy = nullptr;
+    uint32_t hierarchyIndex = 0;
+
     Transform();
     Transform(const Transform&) = default;
     Transform(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
 
     glm::mat4 getRotationMatrix();
-    void update(glm::mat4 parentMatrix);
+    // rebuilds the local matrix and directions, the global matrix is left to the hierarchy
+    void updateLocalMatrix();
+    void markDirty();
+
+    void setPosition(const glm::vec3& newPosition);
+    void setRotation(const glm::quat& newRotation);
+    void setScale(const glm::vec3& newScale);
     void translate(glm::vec3 direction, float distance);
     void rotate(glm::vec3 axis, float degrees);
 };
@@ -93,6 +93,14 @@ void ComputeEffect::parseConfig(const std::filesystem::path& path) {
     nlohmann::json effectJson;
     file >> effectJson;
 
+    if (effectJson.contains("priority")) {
+        if (!effectJson["priority"].is_number_integer()) {
+            fmt::println("Error: priority should be an integer");
+        } else {
+            mPriority = effectJson["priority"];
+        }
+    }
+
     if (!effectJson.contains("subpasses") || !effectJson["subpasses"].is_array()) {
         fmt::println("Error: 'subpasses' is missing or not an array in the JSON.");
         return;
@@ -249,6 +257,7 @@ void ComputeEffect::parseConfig(const std::filesystem::path& path) {
 // TODO: see about generalizing descriptor writes
 void ComputeEffect::addSubpass(const std::filesystem::path& path) {
     Subpass newSubpass{};
+    newSubpass.name = path.stem().string();
 
     fmt::println("now loading subpass: {}", path.c_str());
 
@@ -321,12 +330,16 @@ void ComputeEffect::addSubpass(const std::filesystem::path& path) {
     mSubpasses.push_back(newSubpass);
 }
 
-void ComputeEffect::execute(VkCommandBuffer commandBuffer, Context context, bool sync) {
+void ComputeEffect::execute(VkCommandBuffer commandBuffer, Context context, bool sync, uint32_t profilerScope) {
     if (!mEnabled) {
         return;
     }
 
+    GPUProfiler& profiler = mVkEngine.getGPUProfiler();
+
     for (unsigned int i = 0; i < mSubpasses.size(); i++) {
+        uint32_t subpassScope = profiler.beginScope(commandBuffer, mSubpasses[i].name, profilerScope);
+
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mSubpasses[i].pipeline);
 
         DescriptorWriter writer;
@@ -390,6 +403,8 @@ void ComputeEffect::execute(VkCommandBuffer commandBuffer, Context context, bool
             mSubpasses[i].localSize.z
         );
 
+        profiler.endScope(commandBuffer, subpassScope);
+
         if (i < mSubpasses.size() - 1) {
             synchronizeWithCompute(commandBuffer);
         }
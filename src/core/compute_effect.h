@@ -5,6 +5,7 @@
 #include <span>
 #include <string>
 #include <filesystem>
+#include <optional>
 
 #include "spirv_reflect.h"
 
@@ -58,14 +59,34 @@ public:
         std::vector<BindingData> bindings;
         EditableSubpassInfo editableInfo;
         glm::vec3 localSize;
+
+        std::string name;
     };
 
     ComputeEffect(const std::filesystem::path& path, VulkanEngine& vkEngine);
     ~ComputeEffect();
 
-    void execute(VkCommandBuffer commandBuffer, Context context, bool sync);
+    // every subpass is timed in its own gpu profiler scope under profilerScope
+    void execute(VkCommandBuffer commandBuffer, Context context, bool sync, uint32_t profilerScope);
     void drawGui();
 
+    const std::string& getName() const {
+        return mName;
+    }
+
+    bool isEnabled() const {
+        return mEnabled;
+    }
+
+    void setEnabled(bool enabled) {
+        mEnabled = enabled;
+    }
+
+    // effects without a priority are never turned off to save gpu time
+    std::optional<int> getPriority() const {
+        return mPriority;
+    }
+
 protected:
     void createPipelineLayout();
     void synchronizeWithCompute(VkCommandBuffer commandBuffer);
@@ -82,4 +103,6 @@ protected:
 
     std::string mName;
     bool mEnabled = true;
+    // lower priority effects are turned off first when the gpu is over budget
+    std::optional<int> mPriority;
 };
@@ -1,4 +1,5 @@
 #include "compute_effects_manager.h"
+#include "vk_engine.h"
 #include <imgui.h>
 #include <fstream>
 #include <nlohmann/json.hpp>
@@ -74,14 +75,58 @@ void ComputeEffectsManager::loadEffect(const std::filesystem::path& path) {
     fmt::println("Successfully loaded effect: {}", name);
 }
 
-void ComputeEffectsManager::executeEffects(VkCommandBuffer commandBuffer, ComputeEffect::Context context) {
+void ComputeEffectsManager::executeEffects(VkCommandBuffer commandBuffer, ComputeEffect::Context context, uint32_t profilerScope) {
+    GPUProfiler& profiler = mVkEngine.getGPUProfiler();
+
     for (uint32_t i = 0; i < mEffectOrder.size(); i++) {
         bool sync = i != mEffectOrder.size() - 1;
 
-        mEffects[mEffectOrder[i]]->execute(commandBuffer, context, sync);
+        uint32_t effectScope = profiler.beginScope(commandBuffer, mEffectOrder[i], profilerScope);
+        mEffects[mEffectOrder[i]]->execute(commandBuffer, context, sync, effectScope);
+        profiler.endScope(commandBuffer, effectScope);
     }
 }
 
+bool ComputeEffectsManager::stepDownEffect() {
+    ComputeEffect* lowest = nullptr;
+
+    for (auto& name : mEffectOrder) {
+        ComputeEffect* effect = mEffects[name].get();
+
+        if (!effect->isEnabled() || !effect->getPriority()) {
+            continue;
+        }
+
+        if (lowest == nullptr || *effect->getPriority() < *lowest->getPriority()) {
+            lowest = effect;
+        }
+    }
+
+    if (lowest == nullptr) {
+        return false;
+    }
+
+    lowest->setEnabled(false);
+    mSteppedDownEffects.push_back(lowest->getName());
+
+    return true;
+}
+
+bool ComputeEffectsManager::stepUpEffect() {
+    if (mSteppedDownEffects.empty()) {
+        return false;
+    }
+
+    mEffects[mSteppedDownEffects.back()]->setEnabled(true);
+    mSteppedDownEffects.pop_back();
+
+    return true;
+}
+
+void ComputeEffectsManager::restoreEffects() {
+    while (stepUpEffect()) {}
+}
+
 void ComputeEffectsManager::drawGui() {
     if (ImGui::Begin("Compute Effects")) {
         for (auto& [k, v] : mEffects) {
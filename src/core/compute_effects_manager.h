@@ -6,9 +6,19 @@ class ComputeEffectsManager {
 public:
     ComputeEffectsManager(VulkanEngine& vkEngine);
     void loadEffect(const std::filesystem::path& path);
-    void executeEffects(VkCommandBuffer commandBuffer, ComputeEffect::Context context);
+    void executeEffects(VkCommandBuffer commandBuffer, ComputeEffect::Context context, uint32_t profilerScope);
     void drawGui();
 
+    // turns off the enabled effect with the lowest priority, false when none is left
+    bool stepDownEffect();
+    // turns the last effect stepped down back on, false when none was stepped down
+    bool stepUpEffect();
+    void restoreEffects();
+
+    uint32_t getSteppedDownCount() const {
+        return mSteppedDownEffects.size();
+    }
+
 private:
     void loadEffects();
     void parseGlobalConfig();
@@ -17,4 +27,7 @@ private:
 
     std::unordered_map<std::string, std::unique_ptr<ComputeEffect>> mEffects;
     std::vector<std::string> mEffectOrder;
+
+    // effects turned off by stepDownEffect, in the order they were turned off
+    std::vector<std::string> mSteppedDownEffects;
 };
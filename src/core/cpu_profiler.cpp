@@ -0,0 +1,194 @@
+#include "cpu_profiler.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+std::atomic<bool> CPUProfiler::sCapturing = false;
+std::atomic<uint32_t> CPUProfiler::sGeneration = 0;
+uint64_t CPUProfiler::sCaptureStart = 0;
+
+std::mutex CPUProfiler::sBuffersMutex;
+std::vector<std::unique_ptr<CPUProfiler::ThreadBuffer>> CPUProfiler::sBuffers;
+thread_local CPUProfiler::ThreadBuffer* CPUProfiler::tThreadBuffer = nullptr;
+
+static void escapeJson(std::string& out, const char* string) {
+    for (const char* c = string; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            out += '\\';
+        }
+
+        // control characters can't appear in json strings
+        out += (unsigned char)*c < 0x20 ? ' ' : *c;
+    }
+}
+
+CPUProfiler::Zone::Zone(const char* name, std::string_view detail) : mName(name), mActive(isCapturing()) {
+    if (!mActive) {
+        return;
+    }
+
+    // keep the end of long details such as paths
+    if (detail.size() >= DETAIL_SIZE) {
+        detail = detail.substr(detail.size() - (DETAIL_SIZE - 1));
+    }
+
+    if (!detail.empty()) {
+        std::memcpy(mDetail, detail.data(), detail.size());
+    }
+
+    mDetail[detail.size()] = '\0';
+
+    mStart = now();
+}
+
+CPUProfiler::Zone::~Zone() {
+    if (mActive) {
+        record(mName, mDetail, mStart, now());
+    }
+}
+
+uint64_t CPUProfiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CPUProfiler::ThreadBuffer& CPUProfiler::getThreadBuffer() {
+    if (tThreadBuffer == nullptr) {
+        std::scoped_lock lock(sBuffersMutex);
+
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->threadId = sBuffers.size();
+        buffer->threadName = fmt::format("thread {}", buffer->threadId);
+
+        tThreadBuffer = buffer.get();
+        sBuffers.push_back(std::move(buffer));
+    }
+
+    return *tThreadBuffer;
+}
+
+void CPUProfiler::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = getThreadBuffer();
+
+    std::scoped_lock lock(sBuffersMutex);
+    buffer.threadName = name;
+}
+
+void CPUProfiler::record(const char* name, const char* detail, uint64_t start, uint64_t end) {
+    ThreadBuffer& buffer = getThreadBuffer();
+    uint32_t generation = sGeneration.load(std::memory_order_acquire);
+
+    // first event of a new capture on this thread
+    if (buffer.generation.load(std::memory_order_relaxed) != generation) {
+        if (!buffer.events) {
+            buffer.events = std::make_unique<Event[]>(EVENTS_PER_THREAD);
+        }
+
+        buffer.count.store(0, std::memory_order_relaxed);
+        buffer.droppedCount.store(0, std::memory_order_relaxed);
+        buffer.generation.store(generation, std::memory_order_release);
+    }
+
+    uint32_t index = buffer.count.load(std::memory_order_relaxed);
+
+    if (index >= EVENTS_PER_THREAD) {
+        buffer.droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event& event = buffer.events[index];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    std::memcpy(event.detail, detail, DETAIL_SIZE);
+
+    // publish the event to the thread writing the capture
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void CPUProfiler::startCapture() {
+    sCaptureStart = now();
+    sGeneration.fetch_add(1, std::memory_order_release);
+    sCapturing.store(true, std::memory_order_release);
+
+    fmt::println("Started cpu trace capture");
+}
+
+bool CPUProfiler::stopCapture(const std::filesystem::path& path) {
+    sCapturing.store(false, std::memory_order_release);
+
+    uint32_t generation = sGeneration.load(std::memory_order_acquire);
+
+    std::ofstream outFile(path);
+
+    if (!outFile.is_open()) {
+        fmt::println("Failed to open {} for writing", path.string());
+        return false;
+    }
+
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    uint32_t eventCount = 0;
+    uint32_t droppedCount = 0;
+
+    std::scoped_lock lock(sBuffersMutex);
+
+    for (auto& buffer : sBuffers) {
+        if (buffer->generation.load(std::memory_order_acquire) != generation) {
+            continue;
+        }
+
+        // zones still open on other threads land after the count read here and are left out
+        uint32_t count = std::min(buffer->count.load(std::memory_order_acquire), EVENTS_PER_THREAD);
+        droppedCount += buffer->droppedCount.load(std::memory_order_relaxed);
+
+        json += first ? "" : ",\n";
+        json += fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"", buffer->threadId);
+        escapeJson(json, buffer->threadName.c_str());
+        json += "\"}}";
+        first = false;
+
+        for (uint32_t i = 0; i < count; i++) {
+            const Event& event = buffer->events[i];
+
+            // left over from a zone that was recording when the capture restarted
+            if (event.start < sCaptureStart) {
+                continue;
+            }
+
+            json += ",\n{\"name\":\"";
+            escapeJson(json, event.name);
+
+            // microseconds with nanosecond precision
+            json += fmt::format(
+                "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}",
+                buffer->threadId,
+                (event.start - sCaptureStart) / 1000.0,
+                (event.end - event.start) / 1000.0
+            );
+
+            if (event.detail[0] != '\0') {
+                json += ",\"args\":{\"detail\":\"";
+                escapeJson(json, event.detail);
+                json += "\"}";
+            }
+
+            json += '}';
+            eventCount++;
+        }
+    }
+
+    json += "\n]}\n";
+    outFile << json;
+
+    fmt::println("Wrote {} cpu trace events to {}", eventCount, path.string());
+
+    if (droppedCount > 0) {
+        fmt::println("Dropped {} events, thread buffers were full", droppedCount);
+    }
+
+    return true;
+}
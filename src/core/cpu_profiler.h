@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+// times the enclosing scope, name must outlive the capture (string literals)
+#define PROFILE_SCOPE(name) CPUProfiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+// detail is copied into the event, e.g. the path of a loaded asset
+#define PROFILE_SCOPE_DETAIL(name, detail) CPUProfiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name, detail)
+
+// scoped cpu zones recorded into per thread buffers while a capture runs and written out
+// as chrome trace json (chrome://tracing, ui.perfetto.dev)
+//
+// every buffer only has one writer, so recording takes no locks, the capture is read
+// through the buffers' published event counts
+class CPUProfiler {
+public:
+    static constexpr uint32_t EVENTS_PER_THREAD = 32768;
+    static constexpr uint32_t DETAIL_SIZE = 32;
+
+    class Zone {
+    public:
+        Zone(const char* name, std::string_view detail = {});
+        ~Zone();
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        const char* mName;
+        char mDetail[DETAIL_SIZE];
+        uint64_t mStart;
+        bool mActive;
+    };
+
+    // shown as the thread's track name in the trace
+    static void setThreadName(const std::string& name);
+
+    static void startCapture();
+    // stops the capture and writes every recorded event, returns false if the file can't be written
+    static bool stopCapture(const std::filesystem::path& path);
+
+    static bool isCapturing() {
+        return sCapturing.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Event {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+        char detail[DETAIL_SIZE];
+    };
+
+    struct ThreadBuffer {
+        uint32_t threadId;
+        std::string threadName;
+
+        // allocated on the thread's first event
+        std::unique_ptr<Event[]> events;
+
+        // capture the events belong to, reset by the writer when a new capture starts
+        std::atomic<uint32_t> generation = 0;
+        std::atomic<uint32_t> count = 0;
+        std::atomic<uint32_t> droppedCount = 0;
+    };
+
+    static ThreadBuffer& getThreadBuffer();
+    static void record(const char* name, const char* detail, uint64_t start, uint64_t end);
+
+    // nanoseconds on a monotonic clock
+    static uint64_t now();
+
+    // buffers outlive their threads so a capture can still be written after a thread exits,
+    // the mutex only guards registration and thread names
+    static std::mutex sBuffersMutex;
+    static std::vector<std::unique_ptr<ThreadBuffer>> sBuffers;
+    static thread_local ThreadBuffer* tThreadBuffer;
+
+    static std::atomic<bool> sCapturing;
+    static std::atomic<uint32_t> sGeneration;
+    static uint64_t sCaptureStart;
+};
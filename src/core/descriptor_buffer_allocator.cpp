@@ -0,0 +1,174 @@
+#include "descriptor_buffer_allocator.h"
+
+#include "vk_engine.h"
+
+#include <algorithm>
+
+DescriptorBufferAllocator::DescriptorBufferAllocator(VulkanEngine& vkEngine, VkDeviceSize alignment, uint32_t maxBlockCount)
+    : mVkEngine(vkEngine), mAlignment(alignment), mMaxBlockCount(std::max(maxBlockCount, 1u)) {
+    // blocks are never reallocated, so mapped pointers stay valid while the chain grows
+    mBlocks.reserve(mMaxBlockCount);
+
+    addBlock(BLOCK_SIZE);
+}
+
+DescriptorBufferAllocator::~DescriptorBufferAllocator() {
+    for (auto& block : mBlocks) {
+        mVkEngine.destroyBuffer(block.buffer);
+    }
+}
+
+void DescriptorBufferAllocator::addBlock(VkDeviceSize minSize) {
+    Block block;
+    block.size = std::max(BLOCK_SIZE, alignedSize(minSize, mAlignment));
+    block.buffer = mVkEngine.createBuffer(
+        block.size,
+        VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+
+    mBlocks.push_back(block);
+}
+
+DescriptorAllocation DescriptorBufferAllocator::allocate(VkDeviceSize size) {
+    std::scoped_lock lock(mMutex);
+
+    size = alignedSize(size, mAlignment);
+
+    DescriptorAllocation allocation{};
+
+    // reuse a freed set of the same size
+    auto freeList = mFreeLists.find(size);
+
+    if (freeList != mFreeLists.end() && !freeList->second.empty()) {
+        allocation = freeList->second.back();
+        freeList->second.pop_back();
+
+        mFreeListSize -= size;
+    } else {
+        // bump allocate from the first block with enough space left
+        uint32_t blockIndex = 0;
+
+        while (blockIndex < mBlocks.size() && mBlocks[blockIndex].top + size > mBlocks[blockIndex].size) {
+            blockIndex++;
+        }
+
+        if (blockIndex == mBlocks.size()) {
+            if (mBlocks.size() >= mMaxBlockCount) {
+                fmt::println("descriptor buffer allocator out of memory, {} blocks in use", mBlocks.size());
+                return DescriptorAllocation{};
+            }
+
+            addBlock(size);
+        }
+
+        Block& block = mBlocks[blockIndex];
+
+        allocation.bufferIndex = blockIndex;
+        allocation.offset = block.top;
+        allocation.size = size;
+
+        block.top += size;
+    }
+
+    mAllocatedSize += size;
+    mAllocationCount++;
+
+    return allocation;
+}
+
+void DescriptorBufferAllocator::free(const DescriptorAllocation& allocation) {
+    if (allocation.size == 0) {
+        return;
+    }
+
+    std::scoped_lock lock(mMutex);
+
+    mAllocatedSize -= allocation.size;
+    mAllocationCount--;
+
+    Block& block = mBlocks[allocation.bufferIndex];
+
+    // sets at the top go straight back to the block
+    if (allocation.offset + allocation.size == block.top) {
+        block.top = allocation.offset;
+        trimBlock(allocation.bufferIndex);
+        return;
+    }
+
+    mFreeLists[allocation.size].push_back(allocation);
+    mFreeListSize += allocation.size;
+}
+
+void DescriptorBufferAllocator::trimBlock(uint32_t blockIndex) {
+    Block& block = mBlocks[blockIndex];
+
+    // lower the top past free list entries that now end at it
+    bool trimmed = true;
+
+    while (trimmed && block.top > 0) {
+        trimmed = false;
+
+        for (auto& [size, freeList] : mFreeLists) {
+            auto it = std::find_if(freeList.begin(), freeList.end(), [&](const DescriptorAllocation& entry) {
+                return entry.bufferIndex == blockIndex && entry.offset + entry.size == block.top;
+            });
+
+            if (it == freeList.end()) {
+                continue;
+            }
+
+            block.top = it->offset;
+            mFreeListSize -= it->size;
+
+            *it = freeList.back();
+            freeList.pop_back();
+
+            trimmed = true;
+            break;
+        }
+    }
+}
+
+char* DescriptorBufferAllocator::getData(const DescriptorAllocation& allocation) {
+    std::scoped_lock lock(mMutex);
+
+    return (char*)mBlocks[allocation.bufferIndex].buffer.allocInfo.pMappedData + allocation.offset;
+}
+
+void DescriptorBufferAllocator::bind(VkCommandBuffer commandBuffer) {
+    std::scoped_lock lock(mMutex);
+
+    std::vector<VkDescriptorBufferBindingInfoEXT> bindingInfos(mBlocks.size());
+
+    for (uint32_t i = 0; i < mBlocks.size(); i++) {
+        bindingInfos[i].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+        bindingInfos[i].address = mBlocks[i].buffer.deviceAddress;
+        bindingInfos[i].usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+        bindingInfos[i].pNext = nullptr;
+    }
+
+    vkCmdBindDescriptorBuffersEXT(commandBuffer, bindingInfos.size(), bindingInfos.data());
+}
+
+DescriptorBufferAllocator::Stats DescriptorBufferAllocator::getStats() {
+    std::scoped_lock lock(mMutex);
+
+    Stats stats;
+    stats.allocatedSize = mAllocatedSize;
+    stats.freeListSize = mFreeListSize;
+    stats.blockCount = mBlocks.size();
+    stats.allocationCount = mAllocationCount;
+
+    for (auto& block : mBlocks) {
+        stats.capacity += block.size;
+    }
+
+    stats.occupancy = (float)stats.allocatedSize / stats.capacity;
+
+    // share of the free space that only sets of a matching size can use
+    VkDeviceSize freeSize = stats.capacity - stats.allocatedSize;
+    stats.fragmentation = freeSize > 0 ? (float)stats.freeListSize / freeSize : 0.f;
+
+    return stats;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "vk_types.h"
+#include "volk.h"
+
+#include <mutex>
+
+// forward reference
+class VulkanEngine;
+
+// sub-allocates descriptor sets from a chain of descriptor buffers, freed ranges are kept
+// in free lists per aligned size, since sets only come in as many sizes as there are layouts
+class DescriptorBufferAllocator {
+public:
+    static constexpr VkDeviceSize BLOCK_SIZE = 4 * 1024 * 1024;
+
+    struct Stats {
+        VkDeviceSize capacity = 0;
+        VkDeviceSize allocatedSize = 0;
+        // freed space below the top of a block, only reusable by sets of the same size
+        VkDeviceSize freeListSize = 0;
+        uint32_t blockCount = 0;
+        uint32_t allocationCount = 0;
+
+        float occupancy = 0.f;
+        float fragmentation = 0.f;
+    };
+
+    DescriptorBufferAllocator(VulkanEngine& vkEngine, VkDeviceSize alignment, uint32_t maxBlockCount);
+    ~DescriptorBufferAllocator();
+
+    // returns an allocation with size 0 when every block is full and no more can be bound
+    DescriptorAllocation allocate(VkDeviceSize size);
+
+    // the caller makes sure no frame in flight still reads the set
+    void free(const DescriptorAllocation& allocation);
+
+    // mapped memory of the allocation
+    char* getData(const DescriptorAllocation& allocation);
+
+    // binds every block, block i is bound at buffer index i
+    void bind(VkCommandBuffer commandBuffer);
+
+    Stats getStats();
+
+private:
+    struct Block {
+        AllocatedBuffer buffer;
+        VkDeviceSize size;
+        // bump pointer, everything above it is free
+        VkDeviceSize top = 0;
+    };
+
+    void addBlock(VkDeviceSize minSize);
+    void trimBlock(uint32_t blockIndex);
+
+    VulkanEngine& mVkEngine;
+
+    VkDeviceSize mAlignment;
+    uint32_t mMaxBlockCount;
+
+    // sets are allocated from the scene loading thread while the render thread binds blocks
+    std::mutex mMutex;
+
+    std::vector<Block> mBlocks;
+    std::unordered_map<VkDeviceSize, std::vector<DescriptorAllocation>> mFreeLists;
+
+    VkDeviceSize mAllocatedSize = 0;
+    VkDeviceSize mFreeListSize = 0;
+    uint32_t mAllocationCount = 0;
+};
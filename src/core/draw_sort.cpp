@@ -0,0 +1,114 @@
+#include "draw_sort.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+    // bit layout
+    constexpr uint32_t PASS_BITS = 2;
+    constexpr uint32_t PIPELINE_BITS = 6;
+    constexpr uint32_t MATERIAL_BITS = 16;
+    constexpr uint32_t MESH_BITS = 16;
+    constexpr uint32_t DEPTH_BITS = 24;
+
+    // pass ids, opaque draws come before transparent ones
+    constexpr uint64_t OPAQUE_PASS = 0;
+    constexpr uint64_t TRANSPARENT_PASS = 1;
+
+    static_assert(PASS_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64);
+
+    constexpr uint64_t mask(uint32_t bits) {
+        return (uint64_t(1) << bits) - 1;
+    }
+}
+
+uint32_t drawsort::quantizeDepth(float viewDepth) {
+    // bit patterns of non negative floats sort like the floats themselves,
+    // keeping the top 24 bits keeps the order with reduced precision
+    viewDepth = std::max(viewDepth, 0.f);
+
+    uint32_t bits;
+    std::memcpy(&bits, &viewDepth, sizeof(float));
+
+    return bits >> (32 - DEPTH_BITS);
+}
+
+uint64_t drawsort::makeOpaqueKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, float viewDepth) {
+    uint64_t key = OPAQUE_PASS;
+    key = (key << PIPELINE_BITS) | (pipelineId & mask(PIPELINE_BITS));
+    key = (key << MATERIAL_BITS) | (materialId & mask(MATERIAL_BITS));
+    key = (key << MESH_BITS) | (meshId & mask(MESH_BITS));
+    key = (key << DEPTH_BITS) | quantizeDepth(viewDepth);
+
+    return key;
+}
+
+uint64_t drawsort::makeTransparentKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, float viewDepth) {
+    uint64_t key = TRANSPARENT_PASS;
+    key = (key << DEPTH_BITS) | (mask(DEPTH_BITS) - quantizeDepth(viewDepth));
+    key = (key << PIPELINE_BITS) | (pipelineId & mask(PIPELINE_BITS));
+    key = (key << MATERIAL_BITS) | (materialId & mask(MATERIAL_BITS));
+    key = (key << MESH_BITS) | (meshId & mask(MESH_BITS));
+
+    return key;
+}
+
+void drawsort::radixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch) {
+    constexpr uint32_t DIGIT_BITS = 8;
+    constexpr uint32_t DIGIT_COUNT = 64 / DIGIT_BITS;
+    constexpr uint32_t BUCKET_COUNT = 1 << DIGIT_BITS;
+
+    size_t count = entries.size();
+
+    if (count < 2) {
+        return;
+    }
+
+    scratch.resize(count);
+
+    // build histograms for all digits in a single pass
+    std::array<std::array<uint32_t, BUCKET_COUNT>, DIGIT_COUNT> histograms{};
+
+    for (const auto& entry : entries) {
+        for (uint32_t digit = 0; digit < DIGIT_COUNT; digit++) {
+            histograms[digit][(entry.key >> (digit * DIGIT_BITS)) & (BUCKET_COUNT - 1)]++;
+        }
+    }
+
+    Entry* source = entries.data();
+    Entry* destination = scratch.data();
+
+    for (uint32_t digit = 0; digit < DIGIT_COUNT; digit++) {
+        auto& histogram = histograms[digit];
+
+        // skip digits where all keys fall into the same bucket
+        uint32_t firstBucket = (source[0].key >> (digit * DIGIT_BITS)) & (BUCKET_COUNT - 1);
+
+        if (histogram[firstBucket] == count) {
+            continue;
+        }
+
+        // exclusive prefix sum
+        uint32_t offset = 0;
+
+        for (auto& bucket : histogram) {
+            uint32_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+
+        // scatter
+        for (size_t i = 0; i < count; i++) {
+            uint32_t bucket = (source[i].key >> (digit * DIGIT_BITS)) & (BUCKET_COUNT - 1);
+            destination[histogram[bucket]++] = source[i];
+        }
+
+        std::swap(source, destination);
+    }
+
+    // result ended up in the scratch buffer
+    if (source != entries.data()) {
+        entries.swap(scratch);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// packed 64-bit draw sort keys, sorted with an lsd radix sort
+namespace drawsort {
+    struct Entry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    // maps a non negative view depth to 24 bits, preserving order
+    uint32_t quantizeDepth(float viewDepth);
+
+    // opaque: pass | pipeline | material | mesh | depth (front to back inside a state bucket)
+    uint64_t makeOpaqueKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, float viewDepth);
+
+    // transparent: pass | inverted depth | pipeline | material | mesh (back to front first)
+    uint64_t makeTransparentKey(uint32_t pipelineId, uint32_t materialId, uint32_t meshId, float viewDepth);
+
+    // stable sort by key, scratch is resized as needed and kept for reuse
+    void radixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch);
+}
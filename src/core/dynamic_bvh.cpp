@@ -0,0 +1,642 @@
+#include "dynamic_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <utility>
+
+static DynamicBVH::AABB combine(const DynamicBVH::AABB& a, const DynamicBVH::AABB& b) {
+    return DynamicBVH::AABB{glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+static float getArea(const DynamicBVH::AABB& box) {
+    glm::vec3 size = box.max - box.min;
+
+    return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool contains(const DynamicBVH::AABB& outer, const DynamicBVH::AABB& inner) {
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+
+static DynamicBVH::AABB enlarge(const DynamicBVH::AABB& box) {
+    glm::vec3 margin = (box.max - box.min) * DynamicBVH::FAT_MARGIN;
+
+    return DynamicBVH::AABB{box.min - margin, box.max + margin};
+}
+
+static float getDistanceSquared(const glm::vec3& point, const DynamicBVH::AABB& box) {
+    glm::vec3 offset = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.f));
+
+    return glm::dot(offset, offset);
+}
+
+// slab test, returns the entry distance clamped to 0 or infinity when the ray misses
+static float intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const DynamicBVH::AABB& box) {
+    glm::vec3 t0 = (box.min - origin) * inverseDirection;
+    glm::vec3 t1 = (box.max - origin) * inverseDirection;
+
+    glm::vec3 tMin = glm::min(t0, t1);
+    glm::vec3 tMax = glm::max(t0, t1);
+
+    float entry = std::max({tMin.x, tMin.y, tMin.z, 0.f});
+    float exit = std::min({tMax.x, tMax.y, tMax.z, maxDistance});
+
+    return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+}
+
+DynamicBVH::DynamicBVH() {}
+
+int32_t DynamicBVH::allocateNode() {
+    int32_t index;
+
+    if (mFreeList != NULL_NODE) {
+        index = mFreeList;
+        mFreeList = mNodes[index].parent;
+    } else {
+        index = mNodes.size();
+        mNodes.emplace_back();
+    }
+
+    Node& node = mNodes[index];
+    node.parent = NULL_NODE;
+    node.child1 = NULL_NODE;
+    node.child2 = NULL_NODE;
+    node.height = 0;
+    node.userData = 0;
+
+    return index;
+}
+
+void DynamicBVH::freeNode(int32_t node) {
+    mNodes[node].parent = mFreeList;
+    mNodes[node].height = -1;
+    mFreeList = node;
+}
+
+int32_t DynamicBVH::insert(const AABB& bounds, uint32_t userData) {
+    int32_t leaf = allocateNode();
+
+    mNodes[leaf].bounds = enlarge(bounds);
+    mNodes[leaf].leafBounds = bounds;
+    mNodes[leaf].userData = userData;
+
+    insertLeaf(leaf);
+    mProxyCount++;
+
+    return leaf;
+}
+
+void DynamicBVH::remove(int32_t proxy) {
+    removeLeaf(proxy);
+    freeNode(proxy);
+    mProxyCount--;
+}
+
+bool DynamicBVH::update(int32_t proxy, const AABB& bounds) {
+    mNodes[proxy].leafBounds = bounds;
+
+    if (contains(mNodes[proxy].bounds, bounds)) {
+        return false;
+    }
+
+    removeLeaf(proxy);
+    mNodes[proxy].bounds = enlarge(bounds);
+    insertLeaf(proxy);
+
+    return true;
+}
+
+void DynamicBVH::clear() {
+    mNodes.clear();
+    mRoot = NULL_NODE;
+    mFreeList = NULL_NODE;
+    mProxyCount = 0;
+}
+
+int32_t DynamicBVH::findBestSibling(const AABB& bounds) const {
+    // the cost of a sibling is the area of the new parent plus the growth of every ancestor,
+    // descends towards the child with the lower bound on its subtree's cost and stops once
+    // neither child can beat the best sibling found so far
+    float leafArea = getArea(bounds);
+    glm::vec3 leafCenter = (bounds.min + bounds.max) * 0.5f;
+
+    int32_t index = mRoot;
+    float areaBase = getArea(mNodes[index].bounds);
+    float directCost = getArea(combine(mNodes[index].bounds, bounds));
+    float inheritedCost = 0.f;
+
+    int32_t bestSibling = index;
+    float bestCost = directCost;
+
+    while (!mNodes[index].isLeaf()) {
+        const Node& node = mNodes[index];
+        float cost = directCost + inheritedCost;
+
+        if (cost < bestCost) {
+            bestSibling = index;
+            bestCost = cost;
+        }
+
+        inheritedCost += directCost - areaBase;
+
+        int32_t children[2] = {node.child1, node.child2};
+        float childAreas[2] = {0.f, 0.f};
+        float childDirectCosts[2];
+        float lowerCosts[2] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+
+        for (int i = 0; i < 2; i++) {
+            const Node& child = mNodes[children[i]];
+            childDirectCosts[i] = getArea(combine(child.bounds, bounds));
+
+            if (child.isLeaf()) {
+                float childCost = childDirectCosts[i] + inheritedCost;
+
+                if (childCost < bestCost) {
+                    bestSibling = children[i];
+                    bestCost = childCost;
+                }
+            } else {
+                // a descendant costs at least the leaf's area on top of the child's growth
+                childAreas[i] = getArea(child.bounds);
+                lowerCosts[i] = inheritedCost + childDirectCosts[i] + std::min(leafArea - childAreas[i], 0.f);
+            }
+        }
+
+        if (bestCost <= lowerCosts[0] && bestCost <= lowerCosts[1]) {
+            break;
+        }
+
+        int next = lowerCosts[1] < lowerCosts[0] ? 1 : 0;
+
+        // flat or point like boxes often tie, prefer the closer child then
+        if (lowerCosts[0] == lowerCosts[1]) {
+            const AABB& box1 = mNodes[children[0]].bounds;
+            const AABB& box2 = mNodes[children[1]].bounds;
+            glm::vec3 offset1 = (box1.min + box1.max) * 0.5f - leafCenter;
+            glm::vec3 offset2 = (box2.min + box2.max) * 0.5f - leafCenter;
+
+            next = glm::dot(offset2, offset2) < glm::dot(offset1, offset1) ? 1 : 0;
+        }
+
+        index = children[next];
+        areaBase = childAreas[next];
+        directCost = childDirectCosts[next];
+    }
+
+    return bestSibling;
+}
+
+void DynamicBVH::insertLeaf(int32_t leaf) {
+    if (mRoot == NULL_NODE) {
+        mRoot = leaf;
+        mNodes[leaf].parent = NULL_NODE;
+
+        return;
+    }
+
+    int32_t sibling = findBestSibling(mNodes[leaf].bounds);
+    int32_t oldParent = mNodes[sibling].parent;
+    int32_t newParent = allocateNode();
+
+    Node& parent = mNodes[newParent];
+    parent.parent = oldParent;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+    parent.bounds = combine(mNodes[sibling].bounds, mNodes[leaf].bounds);
+    parent.height = mNodes[sibling].height + 1;
+
+    if (oldParent == NULL_NODE) {
+        mRoot = newParent;
+    } else if (mNodes[oldParent].child1 == sibling) {
+        mNodes[oldParent].child1 = newParent;
+    } else {
+        mNodes[oldParent].child2 = newParent;
+    }
+
+    mNodes[sibling].parent = newParent;
+    mNodes[leaf].parent = newParent;
+
+    refit(oldParent);
+}
+
+void DynamicBVH::removeLeaf(int32_t leaf) {
+    if (leaf == mRoot) {
+        mRoot = NULL_NODE;
+
+        return;
+    }
+
+    int32_t parent = mNodes[leaf].parent;
+    int32_t grandParent = mNodes[parent].parent;
+    int32_t sibling = mNodes[parent].child1 == leaf ? mNodes[parent].child2 : mNodes[parent].child1;
+
+    // the sibling takes the parent's place
+    mNodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    if (grandParent == NULL_NODE) {
+        mRoot = sibling;
+
+        return;
+    }
+
+    if (mNodes[grandParent].child1 == parent) {
+        mNodes[grandParent].child1 = sibling;
+    } else {
+        mNodes[grandParent].child2 = sibling;
+    }
+
+    refit(grandParent);
+}
+
+void DynamicBVH::refit(int32_t node) {
+    while (node != NULL_NODE) {
+        Node& current = mNodes[node];
+        const Node& child1 = mNodes[current.child1];
+        const Node& child2 = mNodes[current.child2];
+
+        current.bounds = combine(child1.bounds, child2.bounds);
+        current.height = std::max(child1.height, child2.height) + 1;
+
+        rotate(node);
+
+        node = mNodes[node].parent;
+    }
+}
+
+void DynamicBVH::rotate(int32_t nodeA) {
+    // swaps a child with a grandchild on the other side when that shrinks the other child,
+    // the node's own bounds stay the same
+    Node& a = mNodes[nodeA];
+
+    if (a.height < 2) {
+        return;
+    }
+
+    int32_t nodeB = a.child1;
+    int32_t nodeC = a.child2;
+    Node& b = mNodes[nodeB];
+    Node& c = mNodes[nodeC];
+
+    enum class Rotation {
+        NONE,
+        B_F,
+        B_G,
+        C_D,
+        C_E
+    };
+
+    Rotation bestRotation = Rotation::NONE;
+    float bestCost = 0.f;
+
+    if (!c.isLeaf()) {
+        float areaC = getArea(c.bounds);
+        const AABB& f = mNodes[c.child1].bounds;
+        const AABB& g = mNodes[c.child2].bounds;
+
+        float costBF = getArea(combine(b.bounds, g)) - areaC;
+        float costBG = getArea(combine(b.bounds, f)) - areaC;
+
+        if (costBF < bestCost) {
+            bestRotation = Rotation::B_F;
+            bestCost = costBF;
+        }
+
+        if (costBG < bestCost) {
+            bestRotation = Rotation::B_G;
+            bestCost = costBG;
+        }
+    }
+
+    if (!b.isLeaf()) {
+        float areaB = getArea(b.bounds);
+        const AABB& d = mNodes[b.child1].bounds;
+        const AABB& e = mNodes[b.child2].bounds;
+
+        float costCD = getArea(combine(c.bounds, e)) - areaB;
+        float costCE = getArea(combine(c.bounds, d)) - areaB;
+
+        if (costCD < bestCost) {
+            bestRotation = Rotation::C_D;
+            bestCost = costCD;
+        }
+
+        if (costCE < bestCost) {
+            bestRotation = Rotation::C_E;
+            bestCost = costCE;
+        }
+    }
+
+    // the grandchild moves up into the child's slot, the child moves down into the grandchild's
+    auto swap = [&](int32_t child, int32_t other, bool firstChild, bool firstGrandChild) {
+        Node& otherNode = mNodes[other];
+        int32_t grandChild = firstGrandChild ? otherNode.child1 : otherNode.child2;
+        int32_t remaining = firstGrandChild ? otherNode.child2 : otherNode.child1;
+
+        (firstChild ? a.child1 : a.child2) = grandChild;
+        (firstGrandChild ? otherNode.child1 : otherNode.child2) = child;
+
+        mNodes[grandChild].parent = nodeA;
+        mNodes[child].parent = other;
+
+        otherNode.bounds = combine(mNodes[child].bounds, mNodes[remaining].bounds);
+        otherNode.height = std::max(mNodes[child].height, mNodes[remaining].height) + 1;
+        a.height = std::max(mNodes[grandChild].height, otherNode.height) + 1;
+    };
+
+    switch (bestRotation) {
+        case Rotation::NONE:
+            break;
+        case Rotation::B_F:
+            swap(nodeB, nodeC, true, true);
+            break;
+        case Rotation::B_G:
+            swap(nodeB, nodeC, true, false);
+            break;
+        case Rotation::C_D:
+            swap(nodeC, nodeB, false, true);
+            break;
+        case Rotation::C_E:
+            swap(nodeC, nodeB, false, false);
+            break;
+    }
+}
+
+void DynamicBVH::queryFrustum(const FrustumCuller::Frustum& frustum, std::vector<uint32_t>& outUserData) const {
+    if (mRoot == NULL_NODE) {
+        return;
+    }
+
+    enum class Containment {
+        OUTSIDE,
+        INTERSECTING,
+        INSIDE
+    };
+
+    auto classify = [&](const AABB& box) {
+        glm::vec3 center = (box.min + box.max) * 0.5f;
+        glm::vec3 extents = (box.max - box.min) * 0.5f;
+        Containment containment = Containment::INSIDE;
+
+        for (const glm::vec4& plane : frustum.planes) {
+            float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+
+            if (distance < -radius) {
+                return Containment::OUTSIDE;
+            }
+
+            if (distance < radius) {
+                containment = Containment::INTERSECTING;
+            }
+        }
+
+        return containment;
+    };
+
+    // subtrees fully inside the frustum are collected without further tests
+    std::vector<std::pair<int32_t, bool>> stack;
+    stack.emplace_back(mRoot, false);
+
+    while (!stack.empty()) {
+        auto [index, inside] = stack.back();
+        stack.pop_back();
+
+        const Node& node = mNodes[index];
+
+        if (!inside) {
+            Containment containment = classify(node.isLeaf() ? node.leafBounds : node.bounds);
+
+            if (containment == Containment::OUTSIDE) {
+                continue;
+            }
+
+            inside = containment == Containment::INSIDE;
+        }
+
+        if (node.isLeaf()) {
+            outUserData.push_back(node.userData);
+        } else {
+            stack.emplace_back(node.child1, inside);
+            stack.emplace_back(node.child2, inside);
+        }
+    }
+}
+
+void DynamicBVH::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& outUserData) const {
+    if (mRoot == NULL_NODE) {
+        return;
+    }
+
+    float radiusSquared = radius * radius;
+
+    std::vector<int32_t> stack;
+    stack.push_back(mRoot);
+
+    while (!stack.empty()) {
+        const Node& node = mNodes[stack.back()];
+        stack.pop_back();
+
+        if (getDistanceSquared(center, node.isLeaf() ? node.leafBounds : node.bounds) > radiusSquared) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            outUserData.push_back(node.userData);
+        } else {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+std::optional<DynamicBVH::Hit> DynamicBVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+    if (mRoot == NULL_NODE) {
+        return std::nullopt;
+    }
+
+    // zero components divide into infinities, which the slab test handles
+    glm::vec3 inverseDirection = 1.f / direction;
+
+    std::optional<Hit> closest;
+    float closestDistance = maxDistance;
+
+    std::vector<std::pair<int32_t, float>> stack;
+    float rootDistance = intersectRay(origin, inverseDirection, closestDistance, mNodes[mRoot].bounds);
+
+    if (rootDistance <= closestDistance) {
+        stack.emplace_back(mRoot, rootDistance);
+    }
+
+    while (!stack.empty()) {
+        auto [index, distance] = stack.back();
+        stack.pop_back();
+
+        // a closer hit was found after the node was pushed
+        if (distance > closestDistance) {
+            continue;
+        }
+
+        const Node& node = mNodes[index];
+
+        if (node.isLeaf()) {
+            float hitDistance = intersectRay(origin, inverseDirection, closestDistance, node.leafBounds);
+
+            if (hitDistance <= closestDistance) {
+                closestDistance = hitDistance;
+                closest = Hit{node.userData, hitDistance};
+            }
+
+            continue;
+        }
+
+        // visit the nearer child first, it is pushed last
+        float distance1 = intersectRay(origin, inverseDirection, closestDistance, mNodes[node.child1].bounds);
+        float distance2 = intersectRay(origin, inverseDirection, closestDistance, mNodes[node.child2].bounds);
+
+        std::pair<int32_t, float> near{node.child1, distance1};
+        std::pair<int32_t, float> far{node.child2, distance2};
+
+        if (distance2 < distance1) {
+            std::swap(near, far);
+        }
+
+        if (far.second <= closestDistance) {
+            stack.push_back(far);
+        }
+
+        if (near.second <= closestDistance) {
+            stack.push_back(near);
+        }
+    }
+
+    return closest;
+}
+
+std::optional<DynamicBVH::Hit> DynamicBVH::findNearest(const glm::vec3& point, float maxDistance) const {
+    if (mRoot == NULL_NODE) {
+        return std::nullopt;
+    }
+
+    // best first search, enlarged boxes are never further away than the exact ones
+    using Entry = std::pair<float, int32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    std::optional<Hit> nearest;
+    float nearestDistanceSquared = maxDistance * maxDistance;
+
+    queue.emplace(getDistanceSquared(point, mNodes[mRoot].bounds), mRoot);
+
+    while (!queue.empty()) {
+        auto [distanceSquared, index] = queue.top();
+        queue.pop();
+
+        if (distanceSquared > nearestDistanceSquared) {
+            break;
+        }
+
+        const Node& node = mNodes[index];
+
+        if (node.isLeaf()) {
+            float leafDistanceSquared = getDistanceSquared(point, node.leafBounds);
+
+            if (leafDistanceSquared <= nearestDistanceSquared) {
+                nearestDistanceSquared = leafDistanceSquared;
+                nearest = Hit{node.userData, std::sqrt(leafDistanceSquared)};
+            }
+
+            continue;
+        }
+
+        for (int32_t child : {node.child1, node.child2}) {
+            float childDistanceSquared = getDistanceSquared(point, mNodes[child].bounds);
+
+            if (childDistanceSquared <= nearestDistanceSquared) {
+                queue.emplace(childDistanceSquared, child);
+            }
+        }
+    }
+
+    return nearest;
+}
+
+int32_t DynamicBVH::getHeight() const {
+    return mRoot == NULL_NODE ? 0 : mNodes[mRoot].height;
+}
+
+float DynamicBVH::getAreaRatio() const {
+    if (mRoot == NULL_NODE) {
+        return 0.f;
+    }
+
+    float totalArea = 0.f;
+
+    for (const Node& node : mNodes) {
+        if (node.height > 0) {
+            totalArea += getArea(node.bounds);
+        }
+    }
+
+    return totalArea / getArea(mNodes[mRoot].bounds);
+}
+
+bool DynamicBVH::validate() const {
+    uint32_t leafCount = 0;
+    uint32_t freeCount = 0;
+
+    for (int32_t index = mFreeList; index != NULL_NODE; index = mNodes[index].parent) {
+        freeCount++;
+    }
+
+    if (mRoot == NULL_NODE) {
+        return mProxyCount == 0 && freeCount == mNodes.size();
+    }
+
+    if (mNodes[mRoot].parent != NULL_NODE) {
+        return false;
+    }
+
+    std::vector<int32_t> stack;
+    stack.push_back(mRoot);
+    uint32_t nodeCount = 0;
+
+    while (!stack.empty()) {
+        int32_t index = stack.back();
+        stack.pop_back();
+        nodeCount++;
+
+        const Node& node = mNodes[index];
+
+        if (node.isLeaf()) {
+            leafCount++;
+
+            if (node.height != 0 || node.child2 != NULL_NODE || !contains(node.bounds, node.leafBounds)) {
+                return false;
+            }
+
+            continue;
+        }
+
+        const Node& child1 = mNodes[node.child1];
+        const Node& child2 = mNodes[node.child2];
+
+        if (child1.parent != index || child2.parent != index) {
+            return false;
+        }
+
+        if (node.height != std::max(child1.height, child2.height) + 1) {
+            return false;
+        }
+
+        if (!contains(node.bounds, child1.bounds) || !contains(node.bounds, child2.bounds)) {
+            return false;
+        }
+
+        stack.push_back(node.child1);
+        stack.push_back(node.child2);
+    }
+
+    return leafCount == mProxyCount && nodeCount + freeCount == mNodes.size();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "frustum_culler.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// incrementally maintained aabb tree, leaves keep enlarged boxes so small moves don't touch
+// the tree, inserts descend towards the sibling with the lowest surface area heuristic cost
+// and every refit rotates nodes when that lowers the area of the tree
+class DynamicBVH {
+public:
+    static constexpr int32_t NULL_NODE = -1;
+    // leaf boxes are enlarged by this fraction of their size on every side
+    static constexpr float FAT_MARGIN = 0.1f;
+
+    struct AABB {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    struct Hit {
+        uint32_t userData;
+        // along the ray or from the query point, 0 when it starts inside the box
+        float distance;
+    };
+
+    DynamicBVH();
+
+    // returns a proxy id, stable until the proxy is removed
+    int32_t insert(const AABB& bounds, uint32_t userData);
+    void remove(int32_t proxy);
+    // returns false when the bounds still fit the leaf's enlarged box and the tree didn't change
+    bool update(int32_t proxy, const AABB& bounds);
+    void clear();
+
+    uint32_t getUserData(int32_t proxy) const {
+        return mNodes[proxy].userData;
+    }
+
+    const AABB& getBounds(int32_t proxy) const {
+        return mNodes[proxy].leafBounds;
+    }
+
+    uint32_t getProxyCount() const {
+        return mProxyCount;
+    }
+
+    // queries test the exact bounds of the proxies and append their user data
+    void queryFrustum(const FrustumCuller::Frustum& frustum, std::vector<uint32_t>& outUserData) const;
+    void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& outUserData) const;
+
+    // closest box hit by the ray, direction doesn't have to be normalized, distances are in its units
+    std::optional<Hit> raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+    // proxy with the closest box to point, within maxDistance
+    std::optional<Hit> findNearest(const glm::vec3& point, float maxDistance) const;
+
+    // levels below the root, 0 for a single leaf
+    int32_t getHeight() const;
+
+    // summed area of the internal nodes over the root's area, lower is better
+    float getAreaRatio() const;
+
+    // checks links, heights, containment and the proxy count, for benchmarks and debugging
+    bool validate() const;
+
+private:
+    struct Node {
+        // enlarged for leaves
+        AABB bounds;
+        AABB leafBounds;
+
+        // next free node while the node is free
+        int32_t parent;
+
+        int32_t child1;
+        int32_t child2;
+        // 0 for leaves, -1 for free nodes
+        int32_t height;
+        uint32_t userData;
+
+        bool isLeaf() const {
+            return child1 == NULL_NODE;
+        }
+    };
+
+    int32_t allocateNode();
+    void freeNode(int32_t node);
+
+    void insertLeaf(int32_t leaf);
+    void removeLeaf(int32_t leaf);
+    int32_t findBestSibling(const AABB& bounds) const;
+
+    // recomputes bounds and heights from node up to the root, rotating along the way
+    void refit(int32_t node);
+    void rotate(int32_t node);
+
+    std::vector<Node> mNodes;
+    int32_t mRoot = NULL_NODE;
+    int32_t mFreeList = NULL_NODE;
+    uint32_t mProxyCount = 0;
+};
@@ -28,18 +28,13 @@ void Entity::deferredDestroy() {
     addComponent<Destroy>();
 }
 
-void Entity::propagateTransform(const glm::mat4& parentMatrix) {
-    glm::mat4 globalMatrix = parentMatrix;
-
+void Entity::addToHierarchy(TransformHierarchy& hierarchy, uint32_t parent) {
     if (hasComponent<Transform>()) {
-        Transform& transform = getComponent<Transform>();
-
-        transform.update(parentMatrix);
-        globalMatrix = transform.globalMatrix;
+        parent = hierarchy.addNode(getComponent<Transform>(), parent, this);
     }
 
     for (auto child : mChildren) {
-        child->propagateTransform(globalMatrix);
+        child->addToHierarchy(hierarchy, parent);
     }
 }
 
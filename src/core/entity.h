@@ -3,6 +3,7 @@
 #include "entt.hpp"
 #include <nlohmann/json.hpp>
 #include "components/components.h"
+#include "transform_hierarchy.h"
 
 class Entity {
 
@@ -45,7 +46,8 @@ public:
     void deferredDestroy();
 
     void drawGUI();
-    void propagateTransform(const glm::mat4& parentMatrix);
+    // adds the transforms of the subtree in depth first order, entities without one pass parent on to their children
+    void addToHierarchy(TransformHierarchy& hierarchy, uint32_t parent);
 
     const std::string& getUUID() {
         return mRegistry.get<Metadata>(mHandle).uuid;
@@ -0,0 +1,167 @@
+#include "flythrough_benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// nearest rank percentile of sorted values
+static float percentile(const std::vector<float>& sorted, float p) {
+    if (sorted.empty()) {
+        return 0.f;
+    }
+
+    size_t rank = (size_t)std::ceil(p * sorted.size());
+
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static nlohmann::json summarize(std::vector<float> values) {
+    std::sort(values.begin(), values.end());
+
+    double sum = std::accumulate(values.begin(), values.end(), 0.0);
+
+    return {
+        {"avg", values.empty() ? 0.0 : sum / values.size()},
+        {"min", values.empty() ? 0.f : values.front()},
+        {"p50", percentile(values, 0.50f)},
+        {"p95", percentile(values, 0.95f)},
+        {"p99", percentile(values, 0.99f)},
+        {"max", values.empty() ? 0.f : values.back()}
+    };
+}
+
+template<typename F>
+static std::vector<float> collect(const std::vector<FlythroughBenchmark::FrameSample>& samples, F&& field) {
+    std::vector<float> values;
+    values.reserve(samples.size());
+
+    for (auto& sample : samples) {
+        values.push_back((float)field(sample));
+    }
+
+    return values;
+}
+
+// peak resident set size of the process, 0 where it can't be queried
+static uint64_t getPeakProcessMemory() {
+#if defined(__linux__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (uint64_t)usage.ru_maxrss * 1024;
+#elif defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+FlythroughBenchmark::FlythroughBenchmark(CameraPath path, uint32_t frameCount) : mPath(std::move(path)), mFrameCount(frameCount) {
+    if (mFrameCount == 0) {
+        mFrameCount = mPath.hasKeyframes()
+            ? (uint32_t)std::ceil(mPath.getDuration() / mPath.getTimeStep()) + 1
+            : mPath.getInputFrameCount();
+    }
+
+    for (int16_t i = GLFW_KEY_UNKNOWN; i <= GLFW_KEY_LAST; i++) {
+        mInput.keyStates[i] = InputState::IDLE;
+    }
+
+    for (uint8_t i = GLFW_MOUSE_BUTTON_1; i <= GLFW_MOUSE_BUTTON_LAST; i++) {
+        mInput.mouse.buttonStates[i] = InputState::IDLE;
+    }
+
+    // warmup frames see no input so scripts don't run ahead of the path
+    mPath.applyInput(UINT32_MAX, mInput);
+    mSamples.reserve(mFrameCount);
+
+    fmt::println("Running flythrough benchmark for {} frames at {:.4f} s per frame after {} warmup frames", mFrameCount, mPath.getTimeStep(), WARMUP_FRAMES);
+}
+
+std::optional<glm::mat4> FlythroughBenchmark::getCameraMatrix() const {
+    if (!mPath.hasKeyframes()) {
+        return std::nullopt;
+    }
+
+    return mPath.sample(getPathFrame() * mPath.getTimeStep());
+}
+
+void FlythroughBenchmark::addFrame(const FrameSample& sample, const std::vector<GPUProfiler::ScopeResult>& gpuScopes) {
+    if (!isWarmingUp()) {
+        mSamples.push_back(sample);
+        mPeakGPUMemory = std::max(mPeakGPUMemory, sample.gpuMemoryUsage);
+
+        // gpu results lag a few frames behind, the last warmup frames are counted in their place
+        for (auto& scope : gpuScopes) {
+            GPUScopeTotal& total = mGPUScopes[scope.name];
+            total.time += scope.time;
+            total.count++;
+        }
+    }
+
+    mFrameIndex++;
+
+    if (!isWarmingUp()) {
+        mPath.applyInput(getPathFrame(), mInput);
+    }
+}
+
+bool FlythroughBenchmark::writeReport(const std::filesystem::path& path, const nlohmann::json& config) const {
+    std::ofstream outFile(path);
+
+    if (!outFile.is_open()) {
+        fmt::println("Failed to open {} for writing", path.string());
+        return false;
+    }
+
+    nlohmann::json report;
+    report["config"] = config;
+    report["frames"] = mSamples.size();
+    report["warmupFrames"] = WARMUP_FRAMES;
+    report["timeStep"] = mPath.getTimeStep();
+
+    report["frameTime"] = summarize(collect(mSamples, [](const FrameSample& s) { return s.frameTime; }));
+
+    report["stages"] = {
+        {"update", summarize(collect(mSamples, [](const FrameSample& s) { return s.updateTime; }))},
+        {"draw", summarize(collect(mSamples, [](const FrameSample& s) { return s.drawTime; }))},
+        {"drawGeometry", summarize(collect(mSamples, [](const FrameSample& s) { return s.drawGeometryTime; }))},
+        {"postEffects", summarize(collect(mSamples, [](const FrameSample& s) { return s.postEffectsTime; }))},
+        {"cull", summarize(collect(mSamples, [](const FrameSample& s) { return s.cullTime; }))},
+        {"sort", summarize(collect(mSamples, [](const FrameSample& s) { return s.sortTime; }))},
+        {"cpuWait", summarize(collect(mSamples, [](const FrameSample& s) { return s.cpuWaitTime; }))}
+    };
+
+    report["drawCalls"] = summarize(collect(mSamples, [](const FrameSample& s) { return s.drawCallCount; }));
+    report["triangles"] = summarize(collect(mSamples, [](const FrameSample& s) { return s.triangleCount; }));
+
+    report["memory"] = {
+        {"peakGPUBytes", mPeakGPUMemory},
+        {"peakProcessBytes", getPeakProcessMemory()}
+    };
+
+    nlohmann::json gpuScopes = nlohmann::json::object();
+
+    for (auto& [name, total] : mGPUScopes) {
+        gpuScopes[name] = total.time / total.count;
+    }
+
+    report["gpuScopes"] = gpuScopes;
+
+    outFile << report.dump(4);
+
+    float averageFrameTime = report["frameTime"]["avg"];
+    float p99FrameTime = report["frameTime"]["p99"];
+
+    fmt::println("Benchmark finished, avg {:.3f} ms, p99 {:.3f} ms over {} frames, report written to {}", averageFrameTime, p99FrameTime, mSamples.size(), path.string());
+
+    return true;
+}
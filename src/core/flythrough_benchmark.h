@@ -0,0 +1,85 @@
+#pragma once
+
+#include "camera_path.h"
+#include "gpu_profiler.h"
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <map>
+
+// replays a camera path at its fixed time step for a fixed number of frames and reports
+// frame time percentiles, per stage cpu times, draw counts and peak memory as json
+class FlythroughBenchmark {
+public:
+    // frames rendered at the start of the path before sampling, pipelines and uploads settle
+    static constexpr uint32_t WARMUP_FRAMES = 30;
+
+    // times in ms
+    struct FrameSample {
+        float frameTime;
+        float updateTime;
+        float drawTime;
+        float drawGeometryTime;
+        float postEffectsTime;
+        float cullTime;
+        float sortTime;
+        float cpuWaitTime;
+        int drawCallCount;
+        int triangleCount;
+        // device memory used across all heaps
+        uint64_t gpuMemoryUsage;
+    };
+
+    // frameCount 0 runs the whole path
+    FlythroughBenchmark(CameraPath path, uint32_t frameCount);
+
+    float getTimeStep() const {
+        return mPath.getTimeStep();
+    }
+
+    bool isFinished() const {
+        return mFrameIndex >= WARMUP_FRAMES + mFrameCount;
+    }
+
+    bool isWarmingUp() const {
+        return mFrameIndex < WARMUP_FRAMES;
+    }
+
+    // camera pose for the current frame, empty when the path only replays input
+    std::optional<glm::mat4> getCameraMatrix() const;
+
+    // recorded input for the current frame, null when the path has none
+    const Input* getInput() const {
+        return mPath.getInputFrameCount() > 0 ? &mInput : nullptr;
+    }
+
+    // stores the finished frame's sample and moves on to the next frame
+    void addFrame(const FrameSample& sample, const std::vector<GPUProfiler::ScopeResult>& gpuScopes);
+
+    // config is stored as is, so runs can be told apart
+    bool writeReport(const std::filesystem::path& path, const nlohmann::json& config) const;
+
+private:
+    // index of the frame along the path, warmup frames hold the first pose
+    uint32_t getPathFrame() const {
+        return mFrameIndex < WARMUP_FRAMES ? 0 : mFrameIndex - WARMUP_FRAMES;
+    }
+
+    CameraPath mPath;
+    uint32_t mFrameCount;
+    uint32_t mFrameIndex = 0;
+
+    Input mInput;
+
+    std::vector<FrameSample> mSamples;
+    uint64_t mPeakGPUMemory = 0;
+
+    struct GPUScopeTotal {
+        double time = 0.0;
+        uint32_t count = 0;
+    };
+
+    // averaged by name, ordered for a stable report
+    std::map<std::string, GPUScopeTotal> mGPUScopes;
+};
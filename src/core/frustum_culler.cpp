@@ -0,0 +1,350 @@
+#include "frustum_culler.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_X86
+#endif
+
+FrustumCuller::Frustum FrustumCuller::extractFrustum(const glm::mat4& viewProjection, const glm::vec3& viewPosition, float projectionScale) {
+    // get matrix rows (glm matrices are column major)
+    auto row = [&](int i) {
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    };
+
+    glm::vec4 r0 = row(0);
+    glm::vec4 r1 = row(1);
+    glm::vec4 r2 = row(2);
+    glm::vec4 r3 = row(3);
+
+    Frustum frustum{};
+
+    // depth range is zero to one, so the depth planes are z >= 0 and z <= w,
+    // this holds for reversed depth as well (near and far are just swapped)
+    frustum.planes[0] = r3 + r0; // left
+    frustum.planes[1] = r3 - r0; // right
+    frustum.planes[2] = r3 + r1; // bottom
+    frustum.planes[3] = r3 - r1; // top
+    frustum.planes[4] = r2;      // z >= 0
+    frustum.planes[5] = r3 - r2; // z <= w
+
+    // normalize planes so distances are in world units
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    frustum.viewPosition = viewPosition;
+    frustum.projectionScale = projectionScale;
+
+    return frustum;
+}
+
+bool FrustumCuller::isVisibleProjected(const glm::vec3& origin, const glm::vec3& extents, const glm::mat4& transform, const glm::mat4& viewProjection) {
+    std::array<glm::vec3, 8> corners {
+        glm::vec3 { 1, 1, 1 },
+        glm::vec3 { 1, 1, -1 },
+        glm::vec3 { 1, -1, 1 },
+        glm::vec3 { 1, -1, -1 },
+        glm::vec3 { -1, 1, 1 },
+        glm::vec3 { -1, 1, -1 },
+        glm::vec3 { -1, -1, 1 },
+        glm::vec3 { -1, -1, -1 },
+    };
+
+    glm::mat4 matrix = viewProjection * transform;
+
+    glm::vec3 min = { 1.5, 1.5, 1.5 };
+    glm::vec3 max = { -1.5, -1.5, -1.5 };
+
+    for (int c = 0; c < 8; c++) {
+        // project each corner into clip space
+        glm::vec4 v = matrix * glm::vec4(origin + (corners[c] * extents), 1.f);
+
+        // perspective correction
+        v.x = v.x / v.w;
+        v.y = v.y / v.w;
+        v.z = v.z / v.w;
+
+        min = glm::min(glm::vec3 { v.x, v.y, v.z }, min);
+        max = glm::max(glm::vec3 { v.x, v.y, v.z }, max);
+    }
+
+    // check the clip space box is within the view
+    if (min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f) {
+        return false;
+    } else {
+        return true;
+    }
+}
+
+void FrustumCuller::resize(uint32_t count) {
+    mCount = count;
+
+    mCenterX.resize(count);
+    mCenterY.resize(count);
+    mCenterZ.resize(count);
+    mExtentX.resize(count);
+    mExtentY.resize(count);
+    mExtentZ.resize(count);
+    mRadius.resize(count);
+}
+
+void FrustumCuller::clear() {
+    resize(0);
+}
+
+void FrustumCuller::setBounds(uint32_t index, const glm::vec3& origin, const glm::vec3& extents, float sphereRadius, const glm::mat4& transform) {
+    glm::vec3 center = transform * glm::vec4(origin, 1.f);
+
+    // extents of the world space box enclosing the transformed local box
+    glm::vec3 worldExtents{};
+    for (int i = 0; i < 3; i++) {
+        worldExtents[i] = std::abs(transform[0][i]) * extents.x +
+                          std::abs(transform[1][i]) * extents.y +
+                          std::abs(transform[2][i]) * extents.z;
+    }
+
+    // scale radius by the largest axis scale
+    float maxScale = std::max({
+        glm::length(glm::vec3(transform[0])),
+        glm::length(glm::vec3(transform[1])),
+        glm::length(glm::vec3(transform[2]))
+    });
+
+    mCenterX[index] = center.x;
+    mCenterY[index] = center.y;
+    mCenterZ[index] = center.z;
+    mExtentX[index] = worldExtents.x;
+    mExtentY[index] = worldExtents.y;
+    mExtentZ[index] = worldExtents.z;
+    mRadius[index] = sphereRadius * maxScale;
+}
+
+bool FrustumCuller::isAVXSupported() {
+#if defined(FRUSTUM_CULLER_X86) && (defined(__GNUC__) || defined(__clang__))
+    static const bool supported = __builtin_cpu_supports("avx");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void FrustumCuller::cull(const Frustum& frustum, float minScreenSize, std::vector<uint32_t>& outVisible, Path path) const {
+    outVisible.clear();
+    outVisible.reserve(mCount);
+
+    if (path == Path::AUTO) {
+        path = isAVXSupported() ? Path::AVX : Path::SSE;
+    }
+
+    uint32_t processed = 0;
+
+#ifdef FRUSTUM_CULLER_X86
+    if (path == Path::AVX && isAVXSupported()) {
+        processed = cullAVX(frustum, minScreenSize, outVisible);
+    } else if (path != Path::SCALAR) {
+        processed = cullSSE(frustum, minScreenSize, outVisible);
+    }
+#endif
+
+    // handle remaining objects that don't fill a full register
+    cullScalar(frustum, minScreenSize, processed, outVisible);
+}
+
+void FrustumCuller::cullScalar(const Frustum& frustum, float minScreenSize, uint32_t begin, std::vector<uint32_t>& outVisible) const {
+    float minScreenSizeSq = minScreenSize * minScreenSize;
+    float projectionScaleSq = frustum.projectionScale * frustum.projectionScale;
+
+    for (uint32_t i = begin; i < mCount; i++) {
+        bool visible = true;
+
+        for (const auto& plane : frustum.planes) {
+            float distance = (plane.x * mCenterX[i] + plane.y * mCenterY[i]) + (plane.z * mCenterZ[i] + plane.w);
+
+            // projected radius of the box on the plane normal
+            float boxRadius = std::abs(plane.x) * mExtentX[i] + std::abs(plane.y) * mExtentY[i] + std::abs(plane.z) * mExtentZ[i];
+
+            // object is outside if either the sphere or the box is fully behind the plane
+            if (distance < -std::min(mRadius[i], boxRadius)) {
+                visible = false;
+                break;
+            }
+        }
+
+        if (visible && minScreenSize > 0.f) {
+            float dx = mCenterX[i] - frustum.viewPosition.x;
+            float dy = mCenterY[i] - frustum.viewPosition.y;
+            float dz = mCenterZ[i] - frustum.viewPosition.z;
+
+            float distanceSq = dx * dx + dy * dy + dz * dz;
+
+            visible = mRadius[i] * mRadius[i] * projectionScaleSq >= minScreenSizeSq * distanceSq;
+        }
+
+        if (visible) {
+            outVisible.push_back(i);
+        }
+    }
+}
+
+#ifdef FRUSTUM_CULLER_X86
+
+uint32_t FrustumCuller::cullSSE(const Frustum& frustum, float minScreenSize, std::vector<uint32_t>& outVisible) const {
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m128 absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+
+    for (int p = 0; p < 6; p++) {
+        const glm::vec4& plane = frustum.planes[p];
+
+        planeX[p] = _mm_set1_ps(plane.x);
+        planeY[p] = _mm_set1_ps(plane.y);
+        planeZ[p] = _mm_set1_ps(plane.z);
+        planeW[p] = _mm_set1_ps(plane.w);
+        absPlaneX[p] = _mm_set1_ps(std::abs(plane.x));
+        absPlaneY[p] = _mm_set1_ps(std::abs(plane.y));
+        absPlaneZ[p] = _mm_set1_ps(std::abs(plane.z));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 viewX = _mm_set1_ps(frustum.viewPosition.x);
+    const __m128 viewY = _mm_set1_ps(frustum.viewPosition.y);
+    const __m128 viewZ = _mm_set1_ps(frustum.viewPosition.z);
+    const __m128 minScreenSizeSq = _mm_set1_ps(minScreenSize * minScreenSize);
+    const __m128 projectionScaleSq = _mm_set1_ps(frustum.projectionScale * frustum.projectionScale);
+
+    uint32_t count = mCount & ~3u;
+
+    for (uint32_t i = 0; i < count; i += 4) {
+        __m128 centerX = _mm_loadu_ps(&mCenterX[i]);
+        __m128 centerY = _mm_loadu_ps(&mCenterY[i]);
+        __m128 centerZ = _mm_loadu_ps(&mCenterZ[i]);
+        __m128 extentX = _mm_loadu_ps(&mExtentX[i]);
+        __m128 extentY = _mm_loadu_ps(&mExtentY[i]);
+        __m128 extentZ = _mm_loadu_ps(&mExtentZ[i]);
+        __m128 radius = _mm_loadu_ps(&mRadius[i]);
+
+        __m128 visible = _mm_cmpeq_ps(zero, zero);
+
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planeX[p], centerX), _mm_mul_ps(planeY[p], centerY)),
+                _mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), planeW[p]));
+
+            __m128 boxRadius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(absPlaneX[p], extentX), _mm_mul_ps(absPlaneY[p], extentY)),
+                _mm_mul_ps(absPlaneZ[p], extentZ));
+
+            // distance + min(sphere radius, box radius) >= 0
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(distance, _mm_min_ps(radius, boxRadius)), zero);
+            visible = _mm_and_ps(visible, inside);
+        }
+
+        if (minScreenSize > 0.f) {
+            __m128 dx = _mm_sub_ps(centerX, viewX);
+            __m128 dy = _mm_sub_ps(centerY, viewY);
+            __m128 dz = _mm_sub_ps(centerZ, viewZ);
+
+            __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 projectedSq = _mm_mul_ps(_mm_mul_ps(radius, radius), projectionScaleSq);
+
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(projectedSq, _mm_mul_ps(minScreenSizeSq, distanceSq)));
+        }
+
+        // compact visible lanes into the output list
+        unsigned int mask = _mm_movemask_ps(visible);
+        while (mask) {
+            outVisible.push_back(i + std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return count;
+}
+
+__attribute__((target("avx")))
+uint32_t FrustumCuller::cullAVX(const Frustum& frustum, float minScreenSize, std::vector<uint32_t>& outVisible) const {
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m256 absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+
+    for (int p = 0; p < 6; p++) {
+        const glm::vec4& plane = frustum.planes[p];
+
+        planeX[p] = _mm256_set1_ps(plane.x);
+        planeY[p] = _mm256_set1_ps(plane.y);
+        planeZ[p] = _mm256_set1_ps(plane.z);
+        planeW[p] = _mm256_set1_ps(plane.w);
+        absPlaneX[p] = _mm256_set1_ps(std::abs(plane.x));
+        absPlaneY[p] = _mm256_set1_ps(std::abs(plane.y));
+        absPlaneZ[p] = _mm256_set1_ps(std::abs(plane.z));
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 viewX = _mm256_set1_ps(frustum.viewPosition.x);
+    const __m256 viewY = _mm256_set1_ps(frustum.viewPosition.y);
+    const __m256 viewZ = _mm256_set1_ps(frustum.viewPosition.z);
+    const __m256 minScreenSizeSq = _mm256_set1_ps(minScreenSize * minScreenSize);
+    const __m256 projectionScaleSq = _mm256_set1_ps(frustum.projectionScale * frustum.projectionScale);
+
+    uint32_t count = mCount & ~7u;
+
+    for (uint32_t i = 0; i < count; i += 8) {
+        __m256 centerX = _mm256_loadu_ps(&mCenterX[i]);
+        __m256 centerY = _mm256_loadu_ps(&mCenterY[i]);
+        __m256 centerZ = _mm256_loadu_ps(&mCenterZ[i]);
+        __m256 extentX = _mm256_loadu_ps(&mExtentX[i]);
+        __m256 extentY = _mm256_loadu_ps(&mExtentY[i]);
+        __m256 extentZ = _mm256_loadu_ps(&mExtentZ[i]);
+        __m256 radius = _mm256_loadu_ps(&mRadius[i]);
+
+        __m256 visible = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(planeX[p], centerX), _mm256_mul_ps(planeY[p], centerY)),
+                _mm256_add_ps(_mm256_mul_ps(planeZ[p], centerZ), planeW[p]));
+
+            __m256 boxRadius = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(absPlaneX[p], extentX), _mm256_mul_ps(absPlaneY[p], extentY)),
+                _mm256_mul_ps(absPlaneZ[p], extentZ));
+
+            // distance + min(sphere radius, box radius) >= 0
+            __m256 inside = _mm256_cmp_ps(_mm256_add_ps(distance, _mm256_min_ps(radius, boxRadius)), zero, _CMP_GE_OQ);
+            visible = _mm256_and_ps(visible, inside);
+        }
+
+        if (minScreenSize > 0.f) {
+            __m256 dx = _mm256_sub_ps(centerX, viewX);
+            __m256 dy = _mm256_sub_ps(centerY, viewY);
+            __m256 dz = _mm256_sub_ps(centerZ, viewZ);
+
+            __m256 distanceSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+            __m256 projectedSq = _mm256_mul_ps(_mm256_mul_ps(radius, radius), projectionScaleSq);
+
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(projectedSq, _mm256_mul_ps(minScreenSizeSq, distanceSq), _CMP_GE_OQ));
+        }
+
+        // compact visible lanes into the output list
+        unsigned int mask = _mm256_movemask_ps(visible);
+        while (mask) {
+            outVisible.push_back(i + std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return count;
+}
+
+#else
+
+uint32_t FrustumCuller::cullSSE(const Frustum& frustum, float minScreenSize, std::vector<uint32_t>& outVisible) const {
+    return 0;
+}
+
+uint32_t FrustumCuller::cullAVX(const Frustum& frustum, float minScreenSize, std::vector<uint32_t>& outVisible) const {
+    return 0;
+}
+
+#endif
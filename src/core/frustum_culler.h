@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// frustum culler keeping world space bounds in structure of arrays form,
+// testing 4 (SSE) or 8 (AVX) objects at a time
+class FrustumCuller {
+public:
+    struct Frustum {
+        // plane normals point inside the frustum, w holds the distance
+        std::array<glm::vec4, 6> planes;
+
+        glm::vec3 viewPosition;
+
+        // vertical projection scale, projection[1][1]
+        float projectionScale;
+    };
+
+    enum class Path {
+        AUTO,
+        SCALAR,
+        SSE,
+        AVX
+    };
+
+    static Frustum extractFrustum(const glm::mat4& viewProjection, const glm::vec3& viewPosition, float projectionScale);
+
+    // reference test, projects all 8 corners of the local bounding box into clip space
+    static bool isVisibleProjected(const glm::vec3& origin, const glm::vec3& extents, const glm::mat4& transform, const glm::mat4& viewProjection);
+
+    void resize(uint32_t count);
+    void clear();
+
+    uint32_t size() const {
+        return mCount;
+    }
+
+    // transforms local bounds into world space and stores them at index
+    void setBounds(uint32_t index, const glm::vec3& origin, const glm::vec3& extents, float sphereRadius, const glm::mat4& transform);
+
+    // writes indices of visible objects to outVisible, objects whose projected
+    // diameter is below minScreenSize (fraction of screen height) are rejected
+    void cull(const Frustum& frustum, float minScreenSize, std::vector<uint32_t>& outVisible, Path path = Path::AUTO) const;
+
+    static bool isAVXSupported();
+
+private:
+    void cullScalar(const Frustum& frustum, float minScreenSize, uint32_t begin, std::vector<uint32_t>& outVisible) const;
+    uint32_t cullSSE(const Frustum& frustum, float minScreenSize, std::vector<uint32_t>& outVisible) const;
+    uint32_t cullAVX(const Frustum& frustum, float minScreenSize, std::vector<uint32_t>& outVisible) const;
+
+    uint32_t mCount = 0;
+
+    // world space bounds
+    std::vector<float> mCenterX;
+    std::vector<float> mCenterY;
+    std::vector<float> mCenterZ;
+    std::vector<float> mExtentX;
+    std::vector<float> mExtentY;
+    std::vector<float> mExtentZ;
+    std::vector<float> mRadius;
+};
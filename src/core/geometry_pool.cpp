@@ -0,0 +1,194 @@
+#include "geometry_pool.h"
+
+#include "vk_engine.h"
+
+#include <algorithm>
+
+RangeAllocator::RangeAllocator(uint32_t size) : mFreeCount(size) {
+    mFreeRanges[0] = size;
+}
+
+bool RangeAllocator::allocate(uint32_t count, uint32_t& outOffset) {
+    // empty ranges take no space
+    if (count == 0) {
+        outOffset = 0;
+        return true;
+    }
+
+    auto best = mFreeRanges.end();
+
+    for (auto it = mFreeRanges.begin(); it != mFreeRanges.end(); it++) {
+        if (it->second >= count && (best == mFreeRanges.end() || it->second < best->second)) {
+            best = it;
+
+            if (it->second == count) {
+                break;
+            }
+        }
+    }
+
+    if (best == mFreeRanges.end()) {
+        return false;
+    }
+
+    auto [offset, size] = *best;
+    mFreeRanges.erase(best);
+
+    if (size > count) {
+        mFreeRanges[offset + count] = size - count;
+    }
+
+    mFreeCount -= count;
+    outOffset = offset;
+
+    return true;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    mFreeCount += count;
+
+    auto next = mFreeRanges.lower_bound(offset);
+
+    // merge with the following range
+    if (next != mFreeRanges.end() && offset + count == next->first) {
+        count += next->second;
+        next = mFreeRanges.erase(next);
+    }
+
+    // merge with the preceding range
+    if (next != mFreeRanges.begin()) {
+        auto prev = std::prev(next);
+
+        if (prev->first + prev->second == offset) {
+            prev->second += count;
+            return;
+        }
+    }
+
+    mFreeRanges[offset] = count;
+}
+
+GeometryPool::GeometryPool(VulkanEngine& vkEngine) : mVkEngine(vkEngine) {}
+
+GeometryPool::~GeometryPool() {
+    for (auto* arenas : {&mVertexArenas, &mCompactVertexArenas, &mIndexArenas, &mShortIndexArenas}) {
+        for (auto& arena : *arenas) {
+            mVkEngine.destroyBuffer(arena->buffer);
+        }
+    }
+}
+
+size_t GeometryPool::getVertexSize(VertexFormat vertexFormat) {
+    return vertexFormat == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+size_t GeometryPool::getIndexSize(VkIndexType indexType) {
+    return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+std::vector<std::unique_ptr<GeometryPool::Arena>>& GeometryPool::getVertexArenas(VertexFormat vertexFormat) {
+    return vertexFormat == VertexFormat::Compact ? mCompactVertexArenas : mVertexArenas;
+}
+
+std::vector<std::unique_ptr<GeometryPool::Arena>>& GeometryPool::getIndexArenas(VkIndexType indexType) {
+    return indexType == VK_INDEX_TYPE_UINT16 ? mShortIndexArenas : mIndexArenas;
+}
+
+uint32_t GeometryPool::allocateRange(std::vector<std::unique_ptr<Arena>>& arenas, uint32_t count, uint32_t capacity, size_t elementSize, VkBufferUsageFlags usage, uint32_t& outOffset) {
+    for (uint32_t i = 0; i < arenas.size(); i++) {
+        if (arenas[i]->allocator.allocate(count, outOffset)) {
+            return i;
+        }
+    }
+
+    // meshes larger than an arena get an arena of their own size
+    capacity = std::max(capacity, count);
+
+    auto arena = std::make_unique<Arena>(Arena{
+        .buffer = mVkEngine.createBuffer((size_t)capacity * elementSize, usage, VMA_MEMORY_USAGE_GPU_ONLY),
+        .allocator = RangeAllocator(capacity),
+        .capacity = capacity,
+        .elementSize = elementSize
+    });
+
+    arena->allocator.allocate(count, outOffset);
+    arenas.push_back(std::move(arena));
+
+    return arenas.size() - 1;
+}
+
+GPUMeshBuffers GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount, VertexFormat vertexFormat, VkIndexType indexType) {
+    std::scoped_lock lock(mMutex);
+
+    GPUMeshBuffers meshBuffers{};
+    meshBuffers.vertexCount = vertexCount;
+    meshBuffers.indexCount = indexCount;
+    meshBuffers.vertexFormat = vertexFormat;
+    meshBuffers.indexType = indexType;
+    meshBuffers.positionScale = glm::vec3(1.f);
+
+    auto& vertexArenas = getVertexArenas(vertexFormat);
+    auto& indexArenas = getIndexArenas(indexType);
+
+    uint32_t vertexOffset;
+    meshBuffers.vertexArena = allocateRange(
+        vertexArenas,
+        vertexCount,
+        VERTEX_ARENA_CAPACITY,
+        getVertexSize(vertexFormat),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        vertexOffset
+    );
+
+    meshBuffers.indexArena = allocateRange(
+        indexArenas,
+        indexCount,
+        INDEX_ARENA_CAPACITY,
+        getIndexSize(indexType),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        meshBuffers.firstIndex
+    );
+
+    const AllocatedBuffer& vertexBuffer = vertexArenas[meshBuffers.vertexArena]->buffer;
+
+    meshBuffers.vertexBuffer = vertexBuffer.buffer;
+    meshBuffers.vertexBufferAddress = vertexBuffer.deviceAddress;
+    meshBuffers.vertexOffset = (int32_t)vertexOffset;
+    meshBuffers.indexBuffer = indexArenas[meshBuffers.indexArena]->buffer.buffer;
+    meshBuffers.indexBufferAddress = indexArenas[meshBuffers.indexArena]->buffer.deviceAddress;
+
+    mMeshCount++;
+
+    return meshBuffers;
+}
+
+void GeometryPool::free(const GPUMeshBuffers& meshBuffers) {
+    std::scoped_lock lock(mMutex);
+
+    getVertexArenas(meshBuffers.vertexFormat)[meshBuffers.vertexArena]->allocator.free(meshBuffers.vertexOffset, meshBuffers.vertexCount);
+    getIndexArenas(meshBuffers.indexType)[meshBuffers.indexArena]->allocator.free(meshBuffers.firstIndex, meshBuffers.indexCount);
+
+    mMeshCount--;
+}
+
+GeometryPool::Stats GeometryPool::getStats() {
+    std::scoped_lock lock(mMutex);
+
+    Stats stats{};
+    stats.vertexArenaCount = mVertexArenas.size() + mCompactVertexArenas.size();
+    stats.indexArenaCount = mIndexArenas.size() + mShortIndexArenas.size();
+    stats.meshCount = mMeshCount;
+
+    for (auto* arenas : {&mVertexArenas, &mCompactVertexArenas, &mIndexArenas, &mShortIndexArenas}) {
+        for (auto& arena : *arenas) {
+            stats.capacity += (VkDeviceSize)arena->capacity * arena->elementSize;
+            stats.usedSize += (VkDeviceSize)(arena->capacity - arena->allocator.getFreeCount()) * arena->elementSize;
+        }
+    }
+
+    return stats;
+}
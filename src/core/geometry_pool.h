@@ -0,0 +1,86 @@
+#pragma once
+
+#include "vk_types.h"
+#include "volk.h"
+
+#include <map>
+#include <mutex>
+
+// forward reference
+class VulkanEngine;
+
+// offset allocator over a range of elements, free ranges are coalesced on free
+class RangeAllocator {
+public:
+    RangeAllocator(uint32_t size);
+
+    // best fit, returns false when no free range is large enough
+    bool allocate(uint32_t count, uint32_t& outOffset);
+    void free(uint32_t offset, uint32_t count);
+
+    uint32_t getFreeCount() const {
+        return mFreeCount;
+    }
+
+private:
+    // offset -> element count
+    std::map<uint32_t, uint32_t> mFreeRanges;
+    uint32_t mFreeCount;
+};
+
+// large device local vertex and index arenas shared by every mesh, so draws of
+// different meshes keep the same index buffer binding and vertex buffer address,
+// each vertex format and index type gets arenas of its own
+class GeometryPool {
+public:
+    static constexpr uint32_t VERTEX_ARENA_CAPACITY = 1 << 21;
+    static constexpr uint32_t INDEX_ARENA_CAPACITY = 1 << 23;
+
+    struct Stats {
+        uint32_t vertexArenaCount;
+        uint32_t indexArenaCount;
+        uint32_t meshCount;
+        VkDeviceSize usedSize;
+        VkDeviceSize capacity;
+    };
+
+    GeometryPool(VulkanEngine& vkEngine);
+    ~GeometryPool();
+
+    // reserves vertex and index ranges, everything but the mesh id and position range is filled in
+    GPUMeshBuffers allocate(uint32_t vertexCount, uint32_t indexCount, VertexFormat vertexFormat = VertexFormat::Full, VkIndexType indexType = VK_INDEX_TYPE_UINT32);
+
+    // the caller makes sure no frame in flight still draws the mesh
+    void free(const GPUMeshBuffers& meshBuffers);
+
+    Stats getStats();
+
+    static size_t getVertexSize(VertexFormat vertexFormat);
+    static size_t getIndexSize(VkIndexType indexType);
+
+private:
+    struct Arena {
+        AllocatedBuffer buffer;
+        RangeAllocator allocator;
+        uint32_t capacity;
+        size_t elementSize;
+    };
+
+    std::vector<std::unique_ptr<Arena>>& getVertexArenas(VertexFormat vertexFormat);
+    std::vector<std::unique_ptr<Arena>>& getIndexArenas(VkIndexType indexType);
+
+    // finds space in an existing arena or creates a new one, returns the arena index
+    uint32_t allocateRange(std::vector<std::unique_ptr<Arena>>& arenas, uint32_t count, uint32_t capacity, size_t elementSize, VkBufferUsageFlags usage, uint32_t& outOffset);
+
+    VulkanEngine& mVkEngine;
+
+    // meshes are uploaded from the scene loading thread
+    std::mutex mMutex;
+
+    std::vector<std::unique_ptr<Arena>> mVertexArenas;
+    std::vector<std::unique_ptr<Arena>> mCompactVertexArenas;
+    std::vector<std::unique_ptr<Arena>> mIndexArenas;
+    std::vector<std::unique_ptr<Arena>> mShortIndexArenas;
+
+    uint32_t mMeshCount = 0;
+};
@@ -0,0 +1,255 @@
+#include "gpu_profiler.h"
+
+#include "vk_engine.h"
+
+#include <fstream>
+#include <functional>
+
+GPUProfiler::GPUProfiler(VulkanEngine& vkEngine, uint32_t frameCount, float timestampPeriod, uint32_t timestampValidBits, bool supportsStatistics)
+    : mVkEngine(vkEngine),
+      mTimestampPeriod(timestampPeriod),
+      mTimestampMask(timestampValidBits >= 64 ? UINT64_MAX : (1ull << timestampValidBits) - 1),
+      mSupportsStatistics(supportsStatistics),
+      mFrames(frameCount) {
+    VkDevice device = mVkEngine.getDevice();
+
+    for (auto& frame : mFrames) {
+        // two timestamps per scope
+        if (supportsTimestamps()) {
+            VkQueryPoolCreateInfo timestampPoolInfo{};
+            timestampPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            timestampPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            timestampPoolInfo.queryCount = MAX_SCOPES * 2;
+
+            VK_CHECK(vkCreateQueryPool(device, &timestampPoolInfo, nullptr, &frame.timestampPool));
+        }
+
+        if (mSupportsStatistics) {
+            VkQueryPoolCreateInfo statisticsPoolInfo{};
+            statisticsPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            statisticsPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            statisticsPoolInfo.queryCount = MAX_STATISTICS_SCOPES;
+            statisticsPoolInfo.pipelineStatistics = STATISTIC_FLAGS;
+
+            VK_CHECK(vkCreateQueryPool(device, &statisticsPoolInfo, nullptr, &frame.statisticsPool));
+        }
+
+        frame.scopes.reserve(MAX_SCOPES);
+    }
+
+    if (!supportsTimestamps()) {
+        fmt::println("graphics queue does not support timestamps, gpu profiling disabled");
+    }
+}
+
+GPUProfiler::~GPUProfiler() {
+    VkDevice device = mVkEngine.getDevice();
+
+    for (auto& frame : mFrames) {
+        if (frame.timestampPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, frame.timestampPool, nullptr);
+        }
+
+        if (frame.statisticsPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, frame.statisticsPool, nullptr);
+        }
+    }
+}
+
+void GPUProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    mFrameIndex = frameIndex;
+    FrameQueries& frame = mFrames[frameIndex];
+
+    // the frame's previous submission has finished, so its queries are ready
+    readResults(frame);
+
+    frame.scopes.clear();
+    frame.statisticsCount = 0;
+
+    if (!enabled || !supportsTimestamps()) {
+        return;
+    }
+
+    vkCmdResetQueryPool(commandBuffer, frame.timestampPool, 0, MAX_SCOPES * 2);
+
+    if (mSupportsStatistics) {
+        vkCmdResetQueryPool(commandBuffer, frame.statisticsPool, 0, MAX_STATISTICS_SCOPES);
+    }
+}
+
+uint32_t GPUProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name, uint32_t parent, bool collectStatistics) {
+    if (!enabled || !supportsTimestamps()) {
+        return NO_SCOPE;
+    }
+
+    FrameQueries& frame = mFrames[mFrameIndex];
+    Scope* scope;
+    uint32_t index;
+
+    {
+        std::scoped_lock lock(mMutex);
+
+        if (frame.scopes.size() >= MAX_SCOPES) {
+            return NO_SCOPE;
+        }
+
+        index = frame.scopes.size();
+        scope = &frame.scopes.emplace_back(Scope{name, parent});
+
+        if (collectStatistics && mSupportsStatistics && frame.statisticsCount < MAX_STATISTICS_SCOPES) {
+            scope->statisticsQuery = frame.statisticsCount++;
+        }
+    }
+
+    vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.timestampPool, index * 2);
+
+    if (scope->statisticsQuery != NO_SCOPE) {
+        vkCmdBeginQuery(commandBuffer, frame.statisticsPool, scope->statisticsQuery, 0);
+    }
+
+    return index;
+}
+
+void GPUProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+    if (scope == NO_SCOPE) {
+        return;
+    }
+
+    FrameQueries& frame = mFrames[mFrameIndex];
+    uint32_t statisticsQuery;
+
+    {
+        std::scoped_lock lock(mMutex);
+        statisticsQuery = frame.scopes[scope].statisticsQuery;
+    }
+
+    if (statisticsQuery != NO_SCOPE) {
+        vkCmdEndQuery(commandBuffer, frame.statisticsPool, statisticsQuery);
+    }
+
+    vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.timestampPool, scope * 2 + 1);
+}
+
+void GPUProfiler::readResults(FrameQueries& frame) {
+    if (frame.scopes.empty()) {
+        mFrameTime = 0.f;
+        return;
+    }
+
+    VkDevice device = mVkEngine.getDevice();
+    uint32_t scopeCount = frame.scopes.size();
+
+    // value and availability per query, no wait flag so a missing query never stalls
+    std::vector<uint64_t> timestamps(scopeCount * 4);
+
+    vkGetQueryPoolResults(
+        device,
+        frame.timestampPool,
+        0,
+        scopeCount * 2,
+        timestamps.size() * sizeof(uint64_t),
+        timestamps.data(),
+        2 * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+    );
+
+    // one value per statistic flag, then availability
+    std::vector<uint64_t> statistics(frame.statisticsCount * 3);
+
+    if (frame.statisticsCount > 0) {
+        vkGetQueryPoolResults(
+            device,
+            frame.statisticsPool,
+            0,
+            frame.statisticsCount,
+            statistics.size() * sizeof(uint64_t),
+            statistics.data(),
+            3 * sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+        );
+    }
+
+    // scopes are opened in recording order, which differs from tree order across threads
+    std::vector<std::vector<uint32_t>> children(scopeCount);
+    std::vector<uint32_t> roots;
+
+    for (uint32_t i = 0; i < scopeCount; i++) {
+        uint32_t parent = frame.scopes[i].parent;
+
+        if (parent < scopeCount) {
+            children[parent].push_back(i);
+        } else {
+            roots.push_back(i);
+        }
+    }
+
+    mResults.clear();
+
+    uint64_t frameStart = UINT64_MAX;
+    uint64_t frameEnd = 0;
+
+    std::function<void(uint32_t, uint32_t)> addScope = [&](uint32_t index, uint32_t depth) {
+        const Scope& scope = frame.scopes[index];
+
+        uint64_t* begin = &timestamps[index * 4];
+        uint64_t* end = begin + 2;
+
+        // skip scopes whose queries were never written
+        if (begin[1] == 0 || end[1] == 0) {
+            return;
+        }
+
+        ScopeResult result{};
+        result.name = scope.name;
+        result.depth = depth;
+        result.time = ((end[0] - begin[0]) & mTimestampMask) * mTimestampPeriod / 1000000.f;
+
+        if (scope.statisticsQuery != NO_SCOPE && statistics[scope.statisticsQuery * 3 + 2] != 0) {
+            result.hasStatistics = true;
+            result.vertexInvocations = statistics[scope.statisticsQuery * 3];
+            result.fragmentInvocations = statistics[scope.statisticsQuery * 3 + 1];
+        }
+
+        mResults.push_back(result);
+
+        frameStart = std::min(frameStart, begin[0]);
+        frameEnd = std::max(frameEnd, end[0]);
+
+        for (auto child : children[index]) {
+            addScope(child, depth + 1);
+        }
+    };
+
+    for (auto root : roots) {
+        addScope(root, 0);
+    }
+
+    mFrameTime = frameEnd > frameStart ? ((frameEnd - frameStart) & mTimestampMask) * mTimestampPeriod / 1000000.f : 0.f;
+}
+
+bool GPUProfiler::exportCSV(const std::filesystem::path& path) const {
+    std::ofstream outFile(path);
+
+    if (!outFile.is_open()) {
+        fmt::println("Failed to open {} for writing", path.string());
+        return false;
+    }
+
+    outFile << "scope,depth,gpu_ms,vertex_invocations,fragment_invocations\n";
+
+    for (auto& result : mResults) {
+        outFile << result.name << ',' << result.depth << ',' << result.time << ',';
+
+        if (result.hasStatistics) {
+            outFile << result.vertexInvocations << ',' << result.fragmentInvocations;
+        } else {
+            outFile << ',';
+        }
+
+        outFile << '\n';
+    }
+
+    fmt::println("Exported gpu profile to {}", path.string());
+
+    return true;
+}
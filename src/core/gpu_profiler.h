@@ -0,0 +1,102 @@
+#pragma once
+
+#include "vk_types.h"
+#include "volk.h"
+
+#include <filesystem>
+#include <mutex>
+
+// forward reference
+class VulkanEngine;
+
+// timestamp and pipeline statistics queries around render passes, every frame in flight
+// owns its query pools, so results are read back when the frame's resources are reused
+// and the gpu is known to be done with them, without waiting on the queries
+class GPUProfiler {
+public:
+    static constexpr uint32_t MAX_SCOPES = 128;
+    static constexpr uint32_t MAX_STATISTICS_SCOPES = 16;
+    static constexpr uint32_t NO_SCOPE = UINT32_MAX;
+
+    // result order matches the bit order of the flags
+    static constexpr VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    struct ScopeResult {
+        std::string name;
+        // depth in the scope tree, results are stored depth first
+        uint32_t depth;
+        float time;
+        bool hasStatistics;
+        uint64_t vertexInvocations;
+        uint64_t fragmentInvocations;
+    };
+
+    // timestamps are disabled when the queue family reports no valid timestamp bits
+    GPUProfiler(VulkanEngine& vkEngine, uint32_t frameCount, float timestampPeriod, uint32_t timestampValidBits, bool supportsStatistics);
+    ~GPUProfiler();
+
+    // reads back the queries last written with this frame's pools and resets them,
+    // must be recorded at the start of the frame's primary command buffer
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    // thread safe so scopes can be opened while recording secondary command buffers, statistics
+    // scopes must stay in one command buffer and run secondaries inheriting STATISTIC_FLAGS
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string& name, uint32_t parent = NO_SCOPE, bool collectStatistics = false);
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    const std::vector<ScopeResult>& getResults() const {
+        return mResults;
+    }
+
+    // ms from the first scope's start to the last scope's end in the frame read back last,
+    // 0 when no scopes were recorded
+    float getFrameTime() const {
+        return mFrameTime;
+    }
+
+    bool supportsTimestamps() const {
+        return mTimestampMask != 0;
+    }
+
+    bool supportsStatistics() const {
+        return mSupportsStatistics;
+    }
+
+    bool exportCSV(const std::filesystem::path& path) const;
+
+    bool enabled = true;
+
+private:
+    struct Scope {
+        std::string name;
+        uint32_t parent;
+        uint32_t statisticsQuery = NO_SCOPE;
+    };
+
+    struct FrameQueries {
+        VkQueryPool timestampPool = VK_NULL_HANDLE;
+        VkQueryPool statisticsPool = VK_NULL_HANDLE;
+
+        std::vector<Scope> scopes;
+        uint32_t statisticsCount = 0;
+    };
+
+    void readResults(FrameQueries& frame);
+
+    VulkanEngine& mVkEngine;
+
+    // nanoseconds per timestamp tick
+    float mTimestampPeriod;
+    uint64_t mTimestampMask;
+    bool mSupportsStatistics;
+
+    std::mutex mMutex;
+
+    std::vector<FrameQueries> mFrames;
+    uint32_t mFrameIndex = 0;
+
+    std::vector<ScopeResult> mResults;
+    float mFrameTime = 0.f;
+};
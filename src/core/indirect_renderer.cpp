@@ -0,0 +1,469 @@
+#include "indirect_renderer.h"
+
+#include "frustum_culler.h"
+#include "vk_engine.h"
+#include "vk_scene.h"
+
+IndirectRenderer::IndirectRenderer(VulkanEngine& vkEngine) : mVkEngine(vkEngine) {
+    mFrames.resize(MAX_FRAMES_IN_FLIGHT);
+}
+
+IndirectRenderer::~IndirectRenderer() {
+    for (auto& frame : mFrames) {
+        freeFrameResources(frame);
+    }
+}
+
+void IndirectRenderer::freeFrameResources(FrameResources& frame) {
+    if (frame.objectCapacity > 0) {
+        mVkEngine.destroyBuffer(frame.objectBuffer);
+        mVkEngine.destroyBuffer(frame.drawCommandBuffer);
+    }
+
+    if (frame.bucketCapacity > 0) {
+        mVkEngine.destroyBuffer(frame.drawCountBuffer);
+    }
+
+    if (frame.meshletObjectCapacity > 0) {
+        mVkEngine.destroyBuffer(frame.meshletObjectBuffer);
+        mVkEngine.destroyBuffer(frame.clusterCommandBuffer);
+        mVkEngine.destroyBuffer(frame.clusterCullDataBuffer);
+    }
+
+    if (frame.clusterJobCapacity > 0) {
+        mVkEngine.destroyBuffer(frame.clusterJobBuffer);
+    }
+
+    if (frame.clusterIndexCapacity > 0) {
+        mVkEngine.destroyBuffer(frame.clusterIndexBuffer);
+    }
+
+    frame.objectCapacity = 0;
+    frame.bucketCapacity = 0;
+    frame.meshletObjectCapacity = 0;
+    frame.clusterJobCapacity = 0;
+    frame.clusterIndexCapacity = 0;
+}
+
+void IndirectRenderer::reserveBuffer(AllocatedBuffer& buffer, uint32_t& capacity, uint32_t count, size_t elementSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) {
+    if (count <= capacity) {
+        return;
+    }
+
+    if (capacity > 0) {
+        mVkEngine.destroyBuffer(buffer);
+    }
+
+    capacity = std::max(count, capacity * 2);
+    buffer = mVkEngine.createBuffer(capacity * elementSize, usage, memoryUsage);
+}
+
+void IndirectRenderer::reserveClusters(FrameResources& frame, uint32_t meshletObjectCount, uint32_t jobCount, uint32_t indexCount) {
+    if (frame.meshletObjectCapacity == 0) {
+        frame.clusterCullDataBuffer = mVkEngine.createBuffer(
+            sizeof(GPUClusterCullData),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_CPU_TO_GPU
+        );
+    }
+
+    // the command buffer shares the meshlet object capacity, one command per object
+    uint32_t commandCapacity = frame.meshletObjectCapacity;
+
+    reserveBuffer(
+        frame.meshletObjectBuffer,
+        frame.meshletObjectCapacity,
+        meshletObjectCount,
+        sizeof(GPUMeshletObject),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+
+    // index counts are reset by the host every frame and incremented by the culling pass
+    reserveBuffer(
+        frame.clusterCommandBuffer,
+        commandCapacity,
+        meshletObjectCount,
+        sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+
+    reserveBuffer(
+        frame.clusterJobBuffer,
+        frame.clusterJobCapacity,
+        jobCount,
+        sizeof(GPUClusterJob),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+
+    reserveBuffer(
+        frame.clusterIndexBuffer,
+        frame.clusterIndexCapacity,
+        indexCount,
+        sizeof(uint32_t),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY
+    );
+}
+
+void IndirectRenderer::reserve(FrameResources& frame, uint32_t objectCount, uint32_t bucketCount) {
+    // frame resources are only used by this frame, which already finished on the gpu,
+    // so buffers can be recreated right away
+    if (objectCount > frame.objectCapacity) {
+        if (frame.objectCapacity > 0) {
+            mVkEngine.destroyBuffer(frame.objectBuffer);
+            mVkEngine.destroyBuffer(frame.drawCommandBuffer);
+        }
+
+        frame.objectCapacity = std::max(objectCount, frame.objectCapacity * 2);
+
+        frame.objectBuffer = mVkEngine.createBuffer(
+            frame.objectCapacity * sizeof(GPUObjectData),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_CPU_TO_GPU
+        );
+
+        frame.drawCommandBuffer = mVkEngine.createBuffer(
+            frame.objectCapacity * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY
+        );
+    }
+
+    if (bucketCount > frame.bucketCapacity) {
+        if (frame.bucketCapacity > 0) {
+            mVkEngine.destroyBuffer(frame.drawCountBuffer);
+        }
+
+        frame.bucketCapacity = std::max(bucketCount, frame.bucketCapacity * 2);
+
+        frame.drawCountBuffer = mVkEngine.createBuffer(
+            frame.bucketCapacity * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY
+        );
+    }
+}
+
+void IndirectRenderer::prepare(VkCommandBuffer commandBuffer, const std::vector<GLTFRenderObject>& objects, const glm::mat4& viewProjection, const meshlod::View& lodView, bool enableCulling, bool enableMeshlets, uint32_t frameIndex) {
+    FrameResources& frame = mFrames[frameIndex];
+
+    mBuckets.clear();
+    mBucketLookup.clear();
+    mClusterBuckets.clear();
+    mClusterBucketLookup.clear();
+    mGPUObjects.clear();
+    mGPUObjectLods.clear();
+    mMeshletObjects.clear();
+    mHostObjects.clear();
+
+    // the cull shader emits one instance per object, asset authored instances are left to the host,
+    // lods are picked on the host and only full detail surfaces are culled per meshlet
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        const GLTFRenderObject& object = objects[i];
+
+        if (object.instanceCount > 1) {
+            mHostObjects.push_back(i);
+            continue;
+        }
+
+        uint32_t lod = meshlod::selectLod({object.lods, object.lodCount}, object.bounds, object.transform, lodView);
+
+        if (enableMeshlets && object.meshletCount > 0 && lod == 0) {
+            mMeshletObjects.push_back(i);
+        } else {
+            mGPUObjects.push_back(i);
+            mGPUObjectLods.push_back(lod);
+        }
+    }
+
+    mObjectBuckets.resize(mGPUObjects.size());
+    mMeshletObjectBuckets.resize(mMeshletObjects.size());
+
+    // group objects by material and index buffer
+    for (uint32_t i = 0; i < mGPUObjects.size(); i++) {
+        const GLTFRenderObject& object = objects[mGPUObjects[i]];
+        BucketKey key{object.material, object.indexBuffer};
+
+        auto [it, inserted] = mBucketLookup.try_emplace(key, (uint32_t)mBuckets.size());
+
+        if (inserted) {
+            mBuckets.push_back(DrawBucket{key.material, key.indexBuffer, object.indexType, 0, 0});
+        }
+
+        mBuckets[it->second].commandCount++;
+        mObjectBuckets[i] = it->second;
+    }
+
+    // compacted cluster indices all live in one buffer, so only the material splits them
+    for (uint32_t i = 0; i < mMeshletObjects.size(); i++) {
+        const GLTFRenderObject& object = objects[mMeshletObjects[i]];
+
+        auto [it, inserted] = mClusterBucketLookup.try_emplace(object.material, (uint32_t)mClusterBuckets.size());
+
+        if (inserted) {
+            mClusterBuckets.push_back(DrawBucket{object.material, VK_NULL_HANDLE, VK_INDEX_TYPE_UINT32, 0, 0});
+        }
+
+        mClusterBuckets[it->second].commandCount++;
+        mMeshletObjectBuckets[i] = it->second;
+    }
+
+    uint32_t objectCount = mGPUObjects.size() + mMeshletObjects.size();
+
+    if (objectCount == 0) {
+        return;
+    }
+
+    // each bucket gets a contiguous range of draw command slots
+    uint32_t commandOffset = 0;
+
+    for (auto& bucket : mBuckets) {
+        bucket.firstCommand = commandOffset;
+        commandOffset += bucket.commandCount;
+    }
+
+    commandOffset = 0;
+
+    for (auto& bucket : mClusterBuckets) {
+        bucket.firstCommand = commandOffset;
+        commandOffset += bucket.commandCount;
+    }
+
+    reserve(frame, objectCount, mBuckets.size());
+
+    // write object data, meshlet objects follow the ones culled per object
+    GPUObjectData* objectData = (GPUObjectData*)frame.objectBuffer.allocInfo.pMappedData;
+
+    auto writeObject = [&](GPUObjectData& data, const GLTFRenderObject& object) {
+        data.worldMatrix = object.transform;
+        data.boundsOrigin = glm::vec4(object.bounds.origin, object.bounds.sphereRadius);
+        data.boundsExtents = glm::vec4(object.bounds.extents, 0.f);
+        data.vertexBuffer = object.vertexBufferAddress;
+        data.vertexFormat = object.vertexFormat;
+        data.positionOffset = glm::vec4(object.positionOffset, 0.f);
+        data.positionScale = glm::vec4(object.positionScale, 0.f);
+        data.firstIndex = object.firstIndex;
+        data.vertexOffset = object.vertexOffset;
+        data.indexCount = object.indexCount;
+    };
+
+    for (uint32_t i = 0; i < mGPUObjects.size(); i++) {
+        const GLTFRenderObject& object = objects[mGPUObjects[i]];
+        GPUObjectData& data = objectData[i];
+
+        writeObject(data, object);
+
+        // the culling pass only sees the chosen lod's index range
+        uint32_t lod = mGPUObjectLods[i];
+
+        if (lod > 0) {
+            data.firstIndex += object.lods[lod - 1].indexOffset;
+            data.indexCount = object.lods[lod - 1].indexCount;
+        }
+        data.drawBucket = mObjectBuckets[i];
+        data.bucketOffset = mBuckets[mObjectBuckets[i]].firstCommand;
+    }
+
+    for (uint32_t i = 0; i < mMeshletObjects.size(); i++) {
+        writeObject(objectData[mGPUObjects.size() + i], objects[mMeshletObjects[i]]);
+    }
+
+    FrustumCuller::Frustum frustum = FrustumCuller::extractFrustum(viewProjection, glm::vec3(0.f), 0.f);
+
+    if (!mGPUObjects.empty()) {
+        // reset draw counts
+        vkCmdFillBuffer(commandBuffer, frame.drawCountBuffer.buffer, 0, mBuckets.size() * sizeof(uint32_t), 0);
+
+        VkMemoryBarrier2 clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+        clearBarrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+        clearBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        clearBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+        VkDependencyInfo clearDependency{};
+        clearDependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        clearDependency.memoryBarrierCount = 1;
+        clearDependency.pMemoryBarriers = &clearBarrier;
+
+        vkCmdPipelineBarrier2(commandBuffer, &clearDependency);
+
+        // cull objects and write draw commands
+        Pipeline* cullPipeline = mVkEngine.getPipelineResourceManager().getPipeline(PipelineResourceManager::PipelineType::GPU_CULL);
+
+        GPUCullPushConstants pushConstants{};
+        for (int i = 0; i < 6; i++) {
+            pushConstants.frustumPlanes[i] = frustum.planes[i];
+        }
+        pushConstants.objectBuffer = frame.objectBuffer.deviceAddress;
+        pushConstants.drawCommandBuffer = frame.drawCommandBuffer.deviceAddress;
+        pushConstants.drawCountBuffer = frame.drawCountBuffer.deviceAddress;
+        pushConstants.objectCount = mGPUObjects.size();
+        pushConstants.enableCulling = enableCulling;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline->pipeline);
+        vkCmdPushConstants(commandBuffer, cullPipeline->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullPushConstants), &pushConstants);
+        vkCmdDispatch(commandBuffer, (mGPUObjects.size() + 63) / 64, 1, 1);
+    }
+
+    if (!mMeshletObjects.empty()) {
+        recordClusterCulling(commandBuffer, frame, objects, frustum, lodView.position, enableCulling);
+    }
+
+    // make draw commands, counts and compacted indices visible to the draws
+    VkMemoryBarrier2 cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    cullBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    cullBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    cullBarrier.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT;
+
+    VkDependencyInfo cullDependency{};
+    cullDependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    cullDependency.memoryBarrierCount = 1;
+    cullDependency.pMemoryBarriers = &cullBarrier;
+
+    vkCmdPipelineBarrier2(commandBuffer, &cullDependency);
+}
+
+void IndirectRenderer::recordClusterCulling(VkCommandBuffer commandBuffer, FrameResources& frame, const std::vector<GLTFRenderObject>& objects, const FrustumCuller::Frustum& frustum, const glm::vec3& cameraPosition, bool enableCulling) {
+    // every object reserves room for all of its triangles, the culling pass fills a prefix of it
+    uint32_t jobCount = 0;
+    uint32_t indexCount = 0;
+
+    for (uint32_t objectIndex : mMeshletObjects) {
+        jobCount += objects[objectIndex].meshletCount;
+        indexCount += objects[objectIndex].indexCount;
+    }
+
+    reserveClusters(frame, mMeshletObjects.size(), jobCount, indexCount);
+
+    GPUMeshletObject* meshletObjects = (GPUMeshletObject*)frame.meshletObjectBuffer.allocInfo.pMappedData;
+    VkDrawIndexedIndirectCommand* commands = (VkDrawIndexedIndirectCommand*)frame.clusterCommandBuffer.allocInfo.pMappedData;
+    GPUClusterJob* jobs = (GPUClusterJob*)frame.clusterJobBuffer.allocInfo.pMappedData;
+
+    std::vector<uint32_t> bucketCommands(mClusterBuckets.size(), 0);
+    uint32_t jobOffset = 0;
+    uint32_t indexOffset = 0;
+
+    for (uint32_t i = 0; i < mMeshletObjects.size(); i++) {
+        const GLTFRenderObject& object = objects[mMeshletObjects[i]];
+        const DrawBucket& bucket = mClusterBuckets[mMeshletObjectBuckets[i]];
+        uint32_t commandIndex = bucket.firstCommand + bucketCommands[mMeshletObjectBuckets[i]]++;
+
+        GPUMeshletObject& meshletObject = meshletObjects[i];
+        meshletObject.meshletBuffer = object.meshletBufferAddress;
+        meshletObject.indexBuffer = object.indexBufferAddress;
+        meshletObject.firstIndex = object.firstIndex;
+        meshletObject.shortIndices = object.indexType == VK_INDEX_TYPE_UINT16;
+        meshletObject.objectIndex = mGPUObjects.size() + i;
+        meshletObject.commandIndex = commandIndex;
+
+        VkDrawIndexedIndirectCommand& command = commands[commandIndex];
+        command.indexCount = 0;
+        command.instanceCount = 1;
+        command.firstIndex = indexOffset;
+        command.vertexOffset = object.vertexOffset;
+        command.firstInstance = meshletObject.objectIndex;
+
+        for (uint32_t j = 0; j < object.meshletCount; j++) {
+            jobs[jobOffset++] = GPUClusterJob{i, j};
+        }
+
+        indexOffset += object.indexCount;
+    }
+
+    GPUClusterCullData* cullData = (GPUClusterCullData*)frame.clusterCullDataBuffer.allocInfo.pMappedData;
+
+    for (int i = 0; i < 6; i++) {
+        cullData->frustumPlanes[i] = frustum.planes[i];
+    }
+    cullData->cameraPosition = glm::vec4(cameraPosition, 0.f);
+    cullData->objectBuffer = frame.objectBuffer.deviceAddress;
+    cullData->meshletObjectBuffer = frame.meshletObjectBuffer.deviceAddress;
+    cullData->jobBuffer = frame.clusterJobBuffer.deviceAddress;
+    cullData->drawCommandBuffer = frame.clusterCommandBuffer.deviceAddress;
+    cullData->outputIndexBuffer = frame.clusterIndexBuffer.deviceAddress;
+    cullData->jobCount = jobCount;
+    cullData->enableCulling = enableCulling;
+
+    // one workgroup per meshlet, large scenes spill into a second dimension
+    Pipeline* clusterPipeline = mVkEngine.getPipelineResourceManager().getPipeline(PipelineResourceManager::PipelineType::GPU_CLUSTER_CULL);
+
+    GPUClusterCullPushConstants pushConstants{};
+    pushConstants.cullData = frame.clusterCullDataBuffer.deviceAddress;
+
+    uint32_t groupCountX = std::min(jobCount, MAX_DISPATCH_GROUPS);
+    uint32_t groupCountY = (jobCount + groupCountX - 1) / groupCountX;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterPipeline->pipeline);
+    vkCmdPushConstants(commandBuffer, clusterPipeline->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUClusterCullPushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+}
+
+uint32_t IndirectRenderer::draw(VkCommandBuffer commandBuffer, Scene3D& scene, uint32_t frameIndex) {
+    if (mBuckets.empty() && mClusterBuckets.empty()) {
+        return 0;
+    }
+
+    FrameResources& frame = mFrames[frameIndex];
+
+    Pipeline* pipeline = mVkEngine.getPipelineResourceManager().getPipeline(PipelineResourceManager::PipelineType::PBR_OPAQUE_INDIRECT);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+    scene.setGlobalDescriptorOffset(commandBuffer, pipeline->layout, frameIndex);
+
+    PBRIndirectPushConstants pushConstants;
+    pushConstants.objectBuffer = frame.objectBuffer.deviceAddress;
+
+    vkCmdPushConstants(commandBuffer, pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PBRIndirectPushConstants), &pushConstants);
+
+    VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+
+    for (uint32_t i = 0; i < mBuckets.size(); i++) {
+        const DrawBucket& bucket = mBuckets[i];
+        const DescriptorAllocation& descriptor = bucket.material->descriptor;
+
+        vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 1, 1, &descriptor.bufferIndex, &descriptor.offset);
+
+        if (bucket.indexBuffer != lastIndexBuffer) {
+            lastIndexBuffer = bucket.indexBuffer;
+
+            vkCmdBindIndexBuffer(commandBuffer, bucket.indexBuffer, 0, bucket.indexType);
+        }
+
+        vkCmdDrawIndexedIndirectCount(
+            commandBuffer,
+            frame.drawCommandBuffer.buffer,
+            bucket.firstCommand * sizeof(VkDrawIndexedIndirectCommand),
+            frame.drawCountBuffer.buffer,
+            i * sizeof(uint32_t),
+            bucket.commandCount,
+            sizeof(VkDrawIndexedIndirectCommand)
+        );
+    }
+
+    if (!mClusterBuckets.empty()) {
+        vkCmdBindIndexBuffer(commandBuffer, frame.clusterIndexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    // cluster draws always run, commands whose meshlets were all culled draw nothing
+    for (const DrawBucket& bucket : mClusterBuckets) {
+        const DescriptorAllocation& descriptor = bucket.material->descriptor;
+
+        vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 1, 1, &descriptor.bufferIndex, &descriptor.offset);
+
+        vkCmdDrawIndexedIndirect(
+            commandBuffer,
+            frame.clusterCommandBuffer.buffer,
+            bucket.firstCommand * sizeof(VkDrawIndexedIndirectCommand),
+            bucket.commandCount,
+            sizeof(VkDrawIndexedIndirectCommand)
+        );
+    }
+
+    return mBuckets.size() + mClusterBuckets.size();
+}
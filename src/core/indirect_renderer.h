@@ -0,0 +1,112 @@
+#pragma once
+
+#include "vk_types.h"
+#include "frustum_culler.h"
+#include "mesh_lod.h"
+#include "volk.h"
+
+#include <unordered_map>
+
+// forward reference
+class VulkanEngine;
+class Scene3D;
+
+// gpu driven path for opaque geometry, objects are culled in a compute pass
+// which writes indirect draw commands, one indirect draw per material/mesh bucket,
+// objects with meshlets are culled per cluster by a second pass which compacts the
+// surviving triangles into an index buffer of its own
+class IndirectRenderer {
+public:
+    // dispatches are split into rows of at most this many workgroups
+    static constexpr uint32_t MAX_DISPATCH_GROUPS = 65535;
+
+    IndirectRenderer(VulkanEngine& vkEngine);
+    ~IndirectRenderer();
+
+    // uploads object data with their selected lods and records the culling passes, must be recorded outside of rendering,
+    // objects with meshlets drawn at full detail are culled per cluster when enableMeshlets is set
+    void prepare(VkCommandBuffer commandBuffer, const std::vector<GLTFRenderObject>& objects, const glm::mat4& viewProjection, const meshlod::View& lodView, bool enableCulling, bool enableMeshlets, uint32_t frameIndex);
+
+    // records the indirect draws, returns the number of draw calls
+    uint32_t draw(VkCommandBuffer commandBuffer, Scene3D& scene, uint32_t frameIndex);
+
+    // indices of objects from the last prepare call that have to be culled and drawn on the host
+    const std::vector<uint32_t>& getHostObjects() const {
+        return mHostObjects;
+    }
+
+private:
+    struct DrawBucket {
+        MaterialInstance* material;
+        VkBuffer indexBuffer;
+        // every index arena holds a single index type
+        VkIndexType indexType;
+        uint32_t firstCommand;
+        uint32_t commandCount;
+    };
+
+    struct BucketKey {
+        MaterialInstance* material;
+        VkBuffer indexBuffer;
+
+        bool operator==(const BucketKey& other) const {
+            return material == other.material && indexBuffer == other.indexBuffer;
+        }
+    };
+
+    struct BucketKeyHash {
+        size_t operator()(const BucketKey& key) const {
+            return std::hash<void*>()(key.material) ^ (std::hash<void*>()(key.indexBuffer) << 1);
+        }
+    };
+
+    struct FrameResources {
+        AllocatedBuffer objectBuffer{};
+        AllocatedBuffer drawCommandBuffer{};
+        AllocatedBuffer drawCountBuffer{};
+
+        uint32_t objectCapacity = 0;
+        uint32_t bucketCapacity = 0;
+
+        // per cluster culling, commands are written by the host and completed by the culling pass
+        AllocatedBuffer meshletObjectBuffer{};
+        AllocatedBuffer clusterCommandBuffer{};
+        AllocatedBuffer clusterJobBuffer{};
+        AllocatedBuffer clusterIndexBuffer{};
+        AllocatedBuffer clusterCullDataBuffer{};
+
+        uint32_t meshletObjectCapacity = 0;
+        uint32_t clusterJobCapacity = 0;
+        uint32_t clusterIndexCapacity = 0;
+    };
+
+    void reserve(FrameResources& frame, uint32_t objectCount, uint32_t bucketCount);
+    void reserveClusters(FrameResources& frame, uint32_t meshletObjectCount, uint32_t jobCount, uint32_t indexCount);
+    void freeFrameResources(FrameResources& frame);
+
+    // recreates the buffer when count elements don't fit, capacity is 0 while it doesn't exist
+    void reserveBuffer(AllocatedBuffer& buffer, uint32_t& capacity, uint32_t count, size_t elementSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+
+    void recordClusterCulling(VkCommandBuffer commandBuffer, FrameResources& frame, const std::vector<GLTFRenderObject>& objects, const FrustumCuller::Frustum& frustum, const glm::vec3& cameraPosition, bool enableCulling);
+
+    VulkanEngine& mVkEngine;
+
+    std::vector<FrameResources> mFrames;
+
+    std::vector<DrawBucket> mBuckets;
+    std::unordered_map<BucketKey, uint32_t, BucketKeyHash> mBucketLookup;
+    std::vector<uint32_t> mObjectBuckets;
+
+    // one bucket per material, all of them draw from the frame's cluster index buffer
+    std::vector<DrawBucket> mClusterBuckets;
+    std::unordered_map<MaterialInstance*, uint32_t> mClusterBucketLookup;
+    std::vector<uint32_t> mMeshletObjectBuckets;
+
+    // indices into the prepared object list
+    std::vector<uint32_t> mGPUObjects;
+    std::vector<uint32_t> mMeshletObjects;
+    std::vector<uint32_t> mHostObjects;
+
+    // selected lod of every gpu object
+    std::vector<uint32_t> mGPUObjectLods;
+};
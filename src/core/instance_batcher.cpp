@@ -0,0 +1,115 @@
+#include "instance_batcher.h"
+
+#include "vk_engine.h"
+
+InstanceBatcher::InstanceBatcher(VulkanEngine& vkEngine) : mVkEngine(vkEngine) {
+    mFrames.resize(MAX_FRAMES_IN_FLIGHT);
+}
+
+InstanceBatcher::~InstanceBatcher() {
+    for (auto& frame : mFrames) {
+        if (frame.capacity > 0) {
+            mVkEngine.destroyBuffer(frame.instanceBuffer);
+        }
+    }
+}
+
+void InstanceBatcher::reserve(FrameResources& frame, uint32_t instanceCount) {
+    // the frame already finished on the gpu, so the buffer can be recreated right away
+    if (instanceCount <= frame.capacity) {
+        return;
+    }
+
+    if (frame.capacity > 0) {
+        mVkEngine.destroyBuffer(frame.instanceBuffer);
+    }
+
+    frame.capacity = std::max(instanceCount, frame.capacity * 2);
+
+    frame.instanceBuffer = mVkEngine.createBuffer(
+        frame.capacity * sizeof(glm::mat4),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+}
+
+void InstanceBatcher::build(std::span<const GLTFRenderObject* const> opaqueObjects, std::span<const GLTFRenderObject* const> transparentObjects, bool merge, uint32_t frameIndex) {
+    FrameResources& frame = mFrames[frameIndex];
+
+    mBatches.clear();
+    mBatchLookup.clear();
+    mObjectBatches.resize(opaqueObjects.size() + transparentObjects.size());
+
+    // count instances per batch, batches keep the order of their first object
+    uint32_t objectIndex = 0;
+
+    for (const GLTFRenderObject* object : opaqueObjects) {
+        uint32_t batchIndex = mBatches.size();
+
+        if (merge) {
+            auto [it, inserted] = mBatchLookup.try_emplace(makeKey(*object), batchIndex);
+            batchIndex = it->second;
+        }
+
+        if (batchIndex == mBatches.size()) {
+            mBatches.push_back(Batch{object, 0, 0});
+        }
+
+        mBatches[batchIndex].instanceCount += object->instanceCount;
+        mObjectBatches[objectIndex++] = batchIndex;
+    }
+
+    for (const GLTFRenderObject* object : transparentObjects) {
+        bool mergeWithLast = merge && !mBatches.empty() && objectIndex > opaqueObjects.size()
+            && makeKey(*mBatches.back().object) == makeKey(*object);
+
+        if (!mergeWithLast) {
+            mBatches.push_back(Batch{object, 0, 0});
+        }
+
+        mBatches.back().instanceCount += object->instanceCount;
+        mObjectBatches[objectIndex++] = mBatches.size() - 1;
+    }
+
+    // assign instance ranges
+    uint32_t instanceCount = 0;
+    mBatchCursors.resize(mBatches.size());
+
+    for (uint32_t i = 0; i < mBatches.size(); i++) {
+        mBatches[i].firstInstance = instanceCount;
+        mBatchCursors[i] = instanceCount;
+        instanceCount += mBatches[i].instanceCount;
+    }
+
+    if (instanceCount == 0) {
+        return;
+    }
+
+    reserve(frame, instanceCount);
+
+    // write transforms, asset authored instances are expanded here straight into the buffer
+    glm::mat4* transforms = (glm::mat4*)frame.instanceBuffer.allocInfo.pMappedData;
+
+    auto writeObject = [&](const GLTFRenderObject& object, uint32_t batchIndex) {
+        uint32_t& cursor = mBatchCursors[batchIndex];
+
+        if (object.instanceTransforms == nullptr) {
+            transforms[cursor++] = object.transform;
+            return;
+        }
+
+        for (uint32_t i = 0; i < object.instanceCount; i++) {
+            transforms[cursor++] = object.transform * object.instanceTransforms[i];
+        }
+    };
+
+    objectIndex = 0;
+
+    for (const GLTFRenderObject* object : opaqueObjects) {
+        writeObject(*object, mObjectBatches[objectIndex++]);
+    }
+
+    for (const GLTFRenderObject* object : transparentObjects) {
+        writeObject(*object, mObjectBatches[objectIndex++]);
+    }
+}
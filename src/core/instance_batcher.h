@@ -0,0 +1,80 @@
+#pragma once
+
+#include "vk_types.h"
+#include "volk.h"
+
+#include <span>
+#include <unordered_map>
+
+// forward reference
+class VulkanEngine;
+
+// merges draws sharing mesh surface and material into instanced draws, instance transforms
+// are written to a per frame storage buffer read through gl_InstanceIndex
+class InstanceBatcher {
+public:
+    struct Batch {
+        const GLTFRenderObject* object;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    InstanceBatcher(VulkanEngine& vkEngine);
+    ~InstanceBatcher();
+
+    // opaque objects are merged over the whole list, transparent ones only with their
+    // neighbours so the back to front order is kept, without merging every object gets its own batch
+    void build(std::span<const GLTFRenderObject* const> opaqueObjects, std::span<const GLTFRenderObject* const> transparentObjects, bool merge, uint32_t frameIndex);
+
+    const std::vector<Batch>& getBatches() const {
+        return mBatches;
+    }
+
+    VkDeviceAddress getInstanceBufferAddress(uint32_t frameIndex) const {
+        return mFrames[frameIndex].instanceBuffer.deviceAddress;
+    }
+
+private:
+    struct BatchKey {
+        VkBuffer indexBuffer;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        MaterialInstance* material;
+
+        bool operator==(const BatchKey& other) const {
+            return indexBuffer == other.indexBuffer && firstIndex == other.firstIndex && indexCount == other.indexCount && material == other.material;
+        }
+    };
+
+    struct BatchKeyHash {
+        size_t operator()(const BatchKey& key) const {
+            size_t hash = std::hash<void*>()(key.indexBuffer);
+            hash ^= std::hash<void*>()(key.material) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            hash ^= std::hash<uint64_t>()((uint64_t)key.firstIndex << 32 | key.indexCount) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+            return hash;
+        }
+    };
+
+    struct FrameResources {
+        AllocatedBuffer instanceBuffer{};
+        uint32_t capacity = 0;
+    };
+
+    static BatchKey makeKey(const GLTFRenderObject& object) {
+        return BatchKey{object.indexBuffer, object.firstIndex, object.indexCount, object.material};
+    }
+
+    void reserve(FrameResources& frame, uint32_t instanceCount);
+
+    VulkanEngine& mVkEngine;
+
+    std::vector<FrameResources> mFrames;
+
+    std::vector<Batch> mBatches;
+    std::unordered_map<BatchKey, uint32_t, BatchKeyHash> mBatchLookup;
+
+    // batch of every input object, written in a second pass once batch offsets are known
+    std::vector<uint32_t> mObjectBatches;
+    std::vector<uint32_t> mBatchCursors;
+};
@@ -0,0 +1,936 @@
+#include "mesh_lod.h"
+
+#include "mesh_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// border edges keep the outline of open surfaces and attribute seams in place
+constexpr double BORDER_WEIGHT = 10.0;
+
+// minimum cosine between a triangle's normal before and after a collapse
+constexpr double MIN_NORMAL_DOT = 0.2;
+
+// subdivisions of the barycentric grid sampled on every changed triangle when measuring the error
+constexpr uint32_t ERROR_SAMPLE_STEPS = 4;
+// patches of the grid with a sample within this fraction of the largest distance are split,
+// at most ERROR_SPLIT_DEPTH times
+constexpr double ERROR_SPLIT_RATIO = 0.9;
+constexpr uint32_t ERROR_SPLIT_DEPTH = 4;
+
+namespace {
+    // sum of squared distances to weighted planes, stored as the upper half of a symmetric 4x4 matrix
+    struct Quadric {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+        double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        double a22 = 0.0, a23 = 0.0;
+        double a33 = 0.0;
+        double weight = 0.0;
+
+        void addPlane(const glm::dvec3& normal, double d, double w) {
+            a00 += normal.x * normal.x * w;
+            a01 += normal.x * normal.y * w;
+            a02 += normal.x * normal.z * w;
+            a03 += normal.x * d * w;
+            a11 += normal.y * normal.y * w;
+            a12 += normal.y * normal.z * w;
+            a13 += normal.y * d * w;
+            a22 += normal.z * normal.z * w;
+            a23 += normal.z * d * w;
+            a33 += d * d * w;
+            weight += w;
+        }
+
+        void add(const Quadric& other) {
+            a00 += other.a00;
+            a01 += other.a01;
+            a02 += other.a02;
+            a03 += other.a03;
+            a11 += other.a11;
+            a12 += other.a12;
+            a13 += other.a13;
+            a22 += other.a22;
+            a23 += other.a23;
+            a33 += other.a33;
+            weight += other.weight;
+        }
+
+        // weighted mean squared distance of p to the planes
+        double evaluate(const glm::dvec3& p) const {
+            double r = a00 * p.x * p.x + 2.0 * a01 * p.x * p.y + 2.0 * a02 * p.x * p.z + 2.0 * a03 * p.x
+                     + a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + 2.0 * a13 * p.y
+                     + a22 * p.z * p.z + 2.0 * a23 * p.z
+                     + a33;
+
+            return std::abs(r) / std::max(weight, 1e-12);
+        }
+    };
+
+    struct Collapse {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+    };
+
+    struct EdgeEntry {
+        uint64_t key;
+        uint32_t triangle;
+    };
+}
+
+static uint64_t makeEdgeKey(uint32_t a, uint32_t b) {
+    return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+// distance from p to the closest point of triangle abc, from Real-Time Collision Detection 5.1.5
+static double getTriangleDistance(const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c) {
+    glm::dvec3 ab = b - a;
+    glm::dvec3 ac = c - a;
+    glm::dvec3 ap = p - a;
+
+    double d1 = glm::dot(ab, ap);
+    double d2 = glm::dot(ac, ap);
+
+    if (d1 <= 0.0 && d2 <= 0.0) {
+        return glm::length(ap);
+    }
+
+    glm::dvec3 bp = p - b;
+    double d3 = glm::dot(ab, bp);
+    double d4 = glm::dot(ac, bp);
+
+    if (d3 >= 0.0 && d4 <= d3) {
+        return glm::length(bp);
+    }
+
+    double vc = d1 * d4 - d3 * d2;
+
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+        return glm::length(ap - ab * (d1 / (d1 - d3)));
+    }
+
+    glm::dvec3 cp = p - c;
+    double d5 = glm::dot(ab, cp);
+    double d6 = glm::dot(ac, cp);
+
+    if (d6 >= 0.0 && d5 <= d6) {
+        return glm::length(cp);
+    }
+
+    double vb = d5 * d2 - d1 * d6;
+
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+        return glm::length(ap - ac * (d2 / (d2 - d6)));
+    }
+
+    double va = d3 * d6 - d5 * d4;
+
+    if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0) {
+        return glm::length(bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+    }
+
+    double denominator = 1.0 / (va + vb + vc);
+
+    return glm::length(ap - ab * (vb * denominator) - ac * (vc * denominator));
+}
+
+namespace {
+    // triangles bucketed into a uniform grid of cells about the size of a triangle,
+    // for the distance from a point to the closest triangle of a surface
+    class TriangleGrid {
+    public:
+        TriangleGrid(const std::vector<glm::dvec3>& positions, std::span<const uint32_t> corners) : mPositions(positions), mCorners(corners) {
+            uint32_t triangleCount = corners.size() / 3;
+
+            if (triangleCount == 0) {
+                return;
+            }
+
+            glm::dvec3 min(std::numeric_limits<double>::max());
+            glm::dvec3 max(std::numeric_limits<double>::lowest());
+            double edgeLengths = 0.0;
+
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                for (uint32_t k = 0; k < 3; k++) {
+                    const glm::dvec3& p = positions[corners[t * 3 + k]];
+
+                    min = glm::min(min, p);
+                    max = glm::max(max, p);
+                    edgeLengths += glm::distance(p, positions[corners[t * 3 + (k + 1) % 3]]);
+                }
+            }
+
+            // cells as large as the average edge, grown until there are at most 16 per triangle, a surface
+            // only fills a thin shell of its box so most cells stay empty
+            glm::dvec3 extent = max - min;
+            mCellSize = std::max(edgeLengths / (triangleCount * 3), std::max({extent.x, extent.y, extent.z}) * 1e-6 + 1e-12);
+
+            while ((extent.x / mCellSize + 1.0) * (extent.y / mCellSize + 1.0) * (extent.z / mCellSize + 1.0) > triangleCount * 16.0) {
+                mCellSize *= 2.0;
+            }
+
+            mOrigin = min;
+            mSize = glm::ivec3(extent / mCellSize) + 1;
+
+            std::vector<uint32_t> counts(mSize.x * mSize.y * mSize.z + 1, 0);
+
+            auto forEachCell = [&](uint32_t t, auto&& function) {
+                const glm::dvec3& a = positions[corners[t * 3]];
+                const glm::dvec3& b = positions[corners[t * 3 + 1]];
+                const glm::dvec3& c = positions[corners[t * 3 + 2]];
+
+                glm::ivec3 first = getCell(glm::min(a, glm::min(b, c)));
+                glm::ivec3 last = getCell(glm::max(a, glm::max(b, c)));
+
+                for (int z = first.z; z <= last.z; z++) {
+                    for (int y = first.y; y <= last.y; y++) {
+                        for (int x = first.x; x <= last.x; x++) {
+                            function(getCellIndex(glm::ivec3(x, y, z)));
+                        }
+                    }
+                }
+            };
+
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                forEachCell(t, [&](uint32_t cell) {
+                    counts[cell + 1]++;
+                });
+            }
+
+            for (uint32_t i = 1; i < counts.size(); i++) {
+                counts[i] += counts[i - 1];
+            }
+
+            mCellStarts = counts;
+            mCellTriangles.resize(counts.back());
+
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                forEachCell(t, [&](uint32_t cell) {
+                    mCellTriangles[counts[cell]++] = t;
+                });
+            }
+        }
+
+        bool isEmpty() const {
+            return mCellTriangles.empty();
+        }
+
+        // closest triangle to p, or the first one found closer than bound, starting with hint
+        uint32_t findClosest(const glm::dvec3& p, double bound, uint32_t hint) const {
+            if (hint != UINT32_MAX && getDistance(p, hint) < bound) {
+                return hint;
+            }
+
+            glm::ivec3 center = getCell(p);
+            int maxRadius = std::max({mSize.x, mSize.y, mSize.z});
+            double distance = std::numeric_limits<double>::max();
+            uint32_t closest = UINT32_MAX;
+
+            // p lies in the center cell, so cells from ring r on are at least r - 1 cells away
+            for (int r = 0; r <= maxRadius && distance > (r - 1) * mCellSize && distance > bound; r++) {
+                glm::ivec3 first = glm::max(center - r, glm::ivec3(0));
+                glm::ivec3 last = glm::min(center + r, mSize - 1);
+
+                for (int z = first.z; z <= last.z; z++) {
+                    for (int y = first.y; y <= last.y; y++) {
+                        for (int x = first.x; x <= last.x; x++) {
+                            glm::ivec3 offset = glm::abs(glm::ivec3(x, y, z) - center);
+
+                            if (std::max({offset.x, offset.y, offset.z}) != r) {
+                                continue;
+                            }
+
+                            uint32_t cell = getCellIndex(glm::ivec3(x, y, z));
+
+                            for (uint32_t i = mCellStarts[cell]; i < mCellStarts[cell + 1]; i++) {
+                                double triangleDistance = getDistance(p, mCellTriangles[i]);
+
+                                if (triangleDistance < distance) {
+                                    distance = triangleDistance;
+                                    closest = mCellTriangles[i];
+
+                                    if (distance < bound) {
+                                        return closest;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            return closest;
+        }
+
+        double getDistance(const glm::dvec3& p, uint32_t triangle) const {
+            const uint32_t* c = &mCorners[triangle * 3];
+            return getTriangleDistance(p, mPositions[c[0]], mPositions[c[1]], mPositions[c[2]]);
+        }
+
+    private:
+        glm::ivec3 getCell(const glm::dvec3& p) const {
+            return glm::clamp(glm::ivec3((p - mOrigin) / mCellSize), glm::ivec3(0), mSize - 1);
+        }
+
+        uint32_t getCellIndex(const glm::ivec3& cell) const {
+            return (cell.z * mSize.y + cell.y) * mSize.x + cell.x;
+        }
+
+        const std::vector<glm::dvec3>& mPositions;
+        std::span<const uint32_t> mCorners;
+
+        glm::dvec3 mOrigin{};
+        double mCellSize = 1.0;
+        glm::ivec3 mSize{0};
+        std::vector<uint32_t> mCellStarts;
+        std::vector<uint32_t> mCellTriangles;
+    };
+
+    // raises maxDistance to the largest distance from triangles to the closest triangle of another
+    // surface, sampled on a barycentric grid, patches of the grid around samples close to the maximum
+    // are split further so the peaks between samples are found as well
+    class SurfaceDistance {
+    public:
+        SurfaceDistance(const TriangleGrid& other, double& maxDistance) : mOther(other), mMaxDistance(maxDistance) {}
+
+        // raises the maximum with the distance at the triangle's center, a cheap first estimate
+        // that lets most triangles and patches stop early
+        void addCenter(const glm::dvec3* corners) {
+            if (!mOther.isEmpty()) {
+                makeSample((corners[0] + corners[1] + corners[2]) / 3.0);
+            }
+        }
+
+        // counterpart is a nearby triangle of the other surface, or null
+        void addTriangle(const glm::dvec3* corners, const glm::dvec3* counterpart) {
+            if (mOther.isEmpty()) {
+                return;
+            }
+
+            // the distance to a single triangle is convex, so the corners bound it over the whole triangle
+            if (counterpart != nullptr) {
+                double bound = 0.0;
+
+                for (uint32_t k = 0; k < 3; k++) {
+                    bound = std::max(bound, getTriangleDistance(corners[k], counterpart[0], counterpart[1], counterpart[2]));
+                }
+
+                if (bound <= mMaxDistance) {
+                    return;
+                }
+            }
+
+            // row i holds ERROR_SAMPLE_STEPS + 1 - i samples
+            mSamples.clear();
+
+            for (uint32_t i = 0; i <= ERROR_SAMPLE_STEPS; i++) {
+                for (uint32_t j = 0; i + j <= ERROR_SAMPLE_STEPS; j++) {
+                    uint32_t k = ERROR_SAMPLE_STEPS - i - j;
+                    mSamples.push_back(makeSample((corners[0] * (double)i + corners[1] * (double)j + corners[2] * (double)k) / (double)ERROR_SAMPLE_STEPS));
+                }
+            }
+
+            auto getSample = [&](uint32_t i, uint32_t j) {
+                return mSamples[i * (ERROR_SAMPLE_STEPS + 1) - i * (i - 1) / 2 + j];
+            };
+
+            for (uint32_t i = 0; i < ERROR_SAMPLE_STEPS; i++) {
+                for (uint32_t j = 0; i + j < ERROR_SAMPLE_STEPS; j++) {
+                    addPatch(getSample(i, j), getSample(i + 1, j), getSample(i, j + 1), 0);
+
+                    if (i + j + 1 < ERROR_SAMPLE_STEPS) {
+                        addPatch(getSample(i + 1, j), getSample(i + 1, j + 1), getSample(i, j + 1), 0);
+                    }
+                }
+            }
+        }
+
+    private:
+        struct Sample {
+            glm::dvec3 position;
+            double distance;
+        };
+
+        Sample makeSample(const glm::dvec3& p) {
+            // samples below the split ratio neither raise the maximum nor get split, so any triangle under
+            // it settles them, consecutive samples are close and usually share their closest triangle
+            mClosest = mOther.findClosest(p, mMaxDistance * ERROR_SPLIT_RATIO, mClosest);
+
+            double distance = mOther.getDistance(p, mClosest);
+            mMaxDistance = std::max(mMaxDistance, distance);
+
+            return Sample{p, distance};
+        }
+
+        void addPatch(const Sample& a, const Sample& b, const Sample& c, uint32_t depth) {
+            if (depth == ERROR_SPLIT_DEPTH || std::max({a.distance, b.distance, c.distance}) < mMaxDistance * ERROR_SPLIT_RATIO) {
+                return;
+            }
+
+            Sample ab = makeSample((a.position + b.position) * 0.5);
+            Sample bc = makeSample((b.position + c.position) * 0.5);
+            Sample ca = makeSample((c.position + a.position) * 0.5);
+
+            addPatch(a, ab, ca, depth + 1);
+            addPatch(ab, b, bc, depth + 1);
+            addPatch(ca, bc, c, depth + 1);
+            addPatch(ab, bc, ca, depth + 1);
+        }
+
+        const TriangleGrid& mOther;
+        double& mMaxDistance;
+        std::vector<Sample> mSamples;
+        uint32_t mClosest = UINT32_MAX;
+    };
+}
+
+std::vector<uint32_t> meshlod::simplify(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float& outError) {
+    outError = 0.f;
+
+    if (indices.size() <= targetIndexCount || indices.size() < 3) {
+        return std::vector<uint32_t>(indices.begin(), indices.end());
+    }
+
+    // local ids for the vertices the surface uses, surfaces reference a contiguous vertex range
+    auto [minIt, maxIt] = std::minmax_element(indices.begin(), indices.end());
+    uint32_t firstVertex = *minIt;
+
+    std::vector<uint32_t> localIds(*maxIt - firstVertex + 1, UINT32_MAX);
+    std::vector<uint32_t> usedVertices;
+
+    for (uint32_t index : indices) {
+        uint32_t& localId = localIds[index - firstVertex];
+
+        if (localId == UINT32_MAX) {
+            localId = usedVertices.size();
+            usedVertices.push_back(index);
+        }
+    }
+
+    uint32_t vertexCount = usedVertices.size();
+
+    // weld vertices at equal positions, attribute seams split vertices that have to move together
+    std::vector<uint32_t> sorted(vertexCount);
+
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        sorted[i] = i;
+    }
+
+    auto positionLess = [&](uint32_t a, uint32_t b) {
+        const glm::vec3& pa = vertices[usedVertices[a]].position;
+        const glm::vec3& pb = vertices[usedVertices[b]].position;
+
+        if (pa.x != pb.x) {
+            return pa.x < pb.x;
+        }
+
+        if (pa.y != pb.y) {
+            return pa.y < pb.y;
+        }
+
+        return pa.z < pb.z;
+    };
+
+    std::sort(sorted.begin(), sorted.end(), positionLess);
+
+    // vertices of a group are contiguous in sorted
+    std::vector<uint32_t> groupOf(vertexCount);
+    std::vector<uint32_t> groupStart;
+    std::vector<glm::dvec3> positions;
+
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        if (i == 0 || positionLess(sorted[i - 1], sorted[i])) {
+            groupStart.push_back(i);
+            positions.push_back(glm::dvec3(vertices[usedVertices[sorted[i]]].position));
+        }
+
+        groupOf[sorted[i]] = groupStart.size() - 1;
+    }
+
+    uint32_t groupCount = groupStart.size();
+    groupStart.push_back(vertexCount);
+
+    // corners hold the current group, the local vertex of each corner is kept for the output
+    uint32_t triangleCount = indices.size() / 3;
+
+    std::vector<uint32_t> corners(triangleCount * 3);
+    std::vector<uint32_t> cornerVertices(triangleCount * 3);
+    std::vector<bool> deadTriangles(triangleCount, false);
+    uint32_t liveTriangleCount = 0;
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        for (uint32_t k = 0; k < 3; k++) {
+            cornerVertices[t * 3 + k] = localIds[indices[t * 3 + k] - firstVertex];
+            corners[t * 3 + k] = groupOf[cornerVertices[t * 3 + k]];
+        }
+
+        const uint32_t* c = &corners[t * 3];
+
+        if (c[0] == c[1] || c[1] == c[2] || c[0] == c[2]) {
+            deadTriangles[t] = true;
+        } else {
+            liveTriangleCount++;
+        }
+    }
+
+    auto triangleNormal = [&](uint32_t t) {
+        const uint32_t* c = &corners[t * 3];
+        return glm::cross(positions[c[1]] - positions[c[0]], positions[c[2]] - positions[c[0]]);
+    };
+
+    // area weighted face planes
+    std::vector<Quadric> quadrics(groupCount);
+    std::vector<std::vector<uint32_t>> groupTriangles(groupCount);
+    std::vector<EdgeEntry> edges;
+    edges.reserve(liveTriangleCount * 3);
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (deadTriangles[t]) {
+            continue;
+        }
+
+        const uint32_t* c = &corners[t * 3];
+        glm::dvec3 normal = triangleNormal(t);
+        double length = glm::length(normal);
+
+        if (length > 0.0) {
+            normal /= length;
+            double d = -glm::dot(normal, positions[c[0]]);
+
+            for (uint32_t k = 0; k < 3; k++) {
+                quadrics[c[k]].addPlane(normal, d, length * 0.5);
+            }
+        }
+
+        for (uint32_t k = 0; k < 3; k++) {
+            groupTriangles[c[k]].push_back(t);
+            edges.push_back(EdgeEntry{makeEdgeKey(c[k], c[(k + 1) % 3]), t});
+        }
+    }
+
+    // edges used by a single triangle are borders, a plane through the edge perpendicular
+    // to the triangle holds them in place
+    std::sort(edges.begin(), edges.end(), [](const EdgeEntry& a, const EdgeEntry& b) {
+        return a.key < b.key;
+    });
+
+    std::vector<bool> border(groupCount, false);
+
+    for (size_t i = 0; i < edges.size();) {
+        size_t end = i + 1;
+
+        while (end < edges.size() && edges[end].key == edges[i].key) {
+            end++;
+        }
+
+        if (end - i == 1) {
+            uint32_t a = edges[i].key >> 32;
+            uint32_t b = edges[i].key & UINT32_MAX;
+
+            glm::dvec3 edge = positions[b] - positions[a];
+            glm::dvec3 normal = glm::cross(edge, triangleNormal(edges[i].triangle));
+            double length = glm::length(normal);
+
+            if (length > 0.0) {
+                normal /= length;
+                double d = -glm::dot(normal, positions[a]);
+                double weight = glm::dot(edge, edge) * BORDER_WEIGHT;
+
+                quadrics[a].addPlane(normal, d, weight);
+                quadrics[b].addPlane(normal, d, weight);
+            }
+
+            border[a] = true;
+            border[b] = true;
+        }
+
+        i = end;
+    }
+
+    std::vector<bool> locked(groupCount, false);
+    std::vector<Collapse> collapses;
+    std::vector<uint64_t> edgeKeys;
+
+    std::vector<uint32_t> fromNeighbors;
+    std::vector<uint32_t> toNeighbors;
+
+    auto gatherNeighbors = [&](uint32_t group, std::vector<uint32_t>& outNeighbors) {
+        outNeighbors.clear();
+
+        for (uint32_t t : groupTriangles[group]) {
+            if (deadTriangles[t]) {
+                continue;
+            }
+
+            for (uint32_t k = 0; k < 3; k++) {
+                if (corners[t * 3 + k] != group) {
+                    outNeighbors.push_back(corners[t * 3 + k]);
+                }
+            }
+        }
+
+        std::sort(outNeighbors.begin(), outNeighbors.end());
+        outNeighbors.erase(std::unique(outNeighbors.begin(), outNeighbors.end()), outNeighbors.end());
+    };
+
+    size_t targetTriangleCount = targetIndexCount / 3;
+
+    // collapses run in passes over the cheapest edges, a vertex takes part in at most one collapse
+    // per pass, so costs stay current and no vertex grows into a fan of long thin triangles
+    while (liveTriangleCount > targetTriangleCount) {
+        edgeKeys.clear();
+
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            if (deadTriangles[t]) {
+                continue;
+            }
+
+            for (uint32_t k = 0; k < 3; k++) {
+                edgeKeys.push_back(makeEdgeKey(corners[t * 3 + k], corners[t * 3 + (k + 1) % 3]));
+            }
+        }
+
+        std::sort(edgeKeys.begin(), edgeKeys.end());
+        edgeKeys.erase(std::unique(edgeKeys.begin(), edgeKeys.end()), edgeKeys.end());
+
+        // half edge collapses keep the surviving vertex's position, so the output only uses input vertices
+        collapses.clear();
+
+        for (uint64_t key : edgeKeys) {
+            uint32_t a = key >> 32;
+            uint32_t b = key & UINT32_MAX;
+
+            Quadric quadric = quadrics[a];
+            quadric.add(quadrics[b]);
+
+            constexpr double LOCKED = std::numeric_limits<double>::infinity();
+
+            // border vertices only slide along the border
+            double costAB = border[a] && !border[b] ? LOCKED : quadric.evaluate(positions[b]);
+            double costBA = border[b] && !border[a] ? LOCKED : quadric.evaluate(positions[a]);
+
+            if (costAB == LOCKED && costBA == LOCKED) {
+                continue;
+            }
+
+            collapses.push_back(costAB <= costBA ? Collapse{costAB, a, b} : Collapse{costBA, b, a});
+        }
+
+        if (collapses.empty()) {
+            break;
+        }
+
+        // a collapse removes about two triangles, the rest of the gap is left to passes with updated costs
+        size_t collapseGoal = std::max<size_t>((liveTriangleCount - targetTriangleCount) / 2, 1);
+        size_t collapseCount = 0;
+
+        // only the cheapest candidates get a chance this pass, locks and failed checks skip some of them
+        auto cheaper = [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        };
+
+        size_t candidateCount = std::min(collapses.size(), collapseGoal * 3);
+
+        std::nth_element(collapses.begin(), collapses.begin() + candidateCount - 1, collapses.end(), cheaper);
+        std::sort(collapses.begin(), collapses.begin() + candidateCount, cheaper);
+        collapses.resize(candidateCount);
+
+        std::fill(locked.begin(), locked.end(), false);
+
+        for (const Collapse& collapse : collapses) {
+            if (collapseCount >= collapseGoal || liveTriangleCount <= targetTriangleCount) {
+                break;
+            }
+
+            uint32_t from = collapse.from;
+            uint32_t to = collapse.to;
+
+            if (locked[from] || locked[to]) {
+                continue;
+            }
+
+            // triangles on the edge disappear with the collapse
+            uint32_t sharedCount = 0;
+
+            for (uint32_t t : groupTriangles[from]) {
+                if (!deadTriangles[t] && (corners[t * 3] == to || corners[t * 3 + 1] == to || corners[t * 3 + 2] == to)) {
+                    sharedCount++;
+                }
+            }
+
+            if (border[from] && sharedCount != 1) {
+                continue;
+            }
+
+            // the vertices may only share the neighbours across their common triangles,
+            // anything else would fold the surface into a non manifold fin
+            gatherNeighbors(from, fromNeighbors);
+            gatherNeighbors(to, toNeighbors);
+
+            uint32_t commonCount = 0;
+
+            for (size_t i = 0, j = 0; i < fromNeighbors.size() && j < toNeighbors.size();) {
+                if (fromNeighbors[i] < toNeighbors[j]) {
+                    i++;
+                } else if (fromNeighbors[i] > toNeighbors[j]) {
+                    j++;
+                } else {
+                    commonCount++;
+                    i++;
+                    j++;
+                }
+            }
+
+            if (commonCount != sharedCount) {
+                continue;
+            }
+
+            // moving from onto to must not flip the remaining triangles around it
+            bool flips = false;
+
+            for (uint32_t t : groupTriangles[from]) {
+                const uint32_t* c = &corners[t * 3];
+
+                if (deadTriangles[t] || c[0] == to || c[1] == to || c[2] == to) {
+                    continue;
+                }
+
+                glm::dvec3 p[3];
+
+                for (uint32_t k = 0; k < 3; k++) {
+                    p[k] = c[k] == from ? positions[to] : positions[c[k]];
+                }
+
+                glm::dvec3 before = triangleNormal(t);
+                glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+                double lengths = glm::length(before) * glm::length(after);
+
+                if (lengths <= 0.0 || glm::dot(before, after) < MIN_NORMAL_DOT * lengths) {
+                    flips = true;
+                    break;
+                }
+            }
+
+            if (flips) {
+                continue;
+            }
+
+            for (uint32_t t : groupTriangles[from]) {
+                if (deadTriangles[t]) {
+                    continue;
+                }
+
+                uint32_t* c = &corners[t * 3];
+
+                if (c[0] == to || c[1] == to || c[2] == to) {
+                    deadTriangles[t] = true;
+                    liveTriangleCount--;
+                    continue;
+                }
+
+                for (uint32_t k = 0; k < 3; k++) {
+                    if (c[k] == from) {
+                        c[k] = to;
+                    }
+                }
+
+                groupTriangles[to].push_back(t);
+            }
+
+            std::erase_if(groupTriangles[to], [&](uint32_t t) {
+                return deadTriangles[t];
+            });
+
+            groupTriangles[from].clear();
+            quadrics[to].add(quadrics[from]);
+
+            // costs of edges around to are stale until the next pass, from is gone
+            locked[from] = true;
+            locked[to] = true;
+
+            collapseCount++;
+        }
+
+        // every remaining edge would break the surface
+        if (collapseCount == 0) {
+            break;
+        }
+    }
+
+    // corners whose group collapsed take the vertex of the new group with the closest attributes
+    std::vector<uint32_t> result;
+    result.reserve(liveTriangleCount * 3);
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (deadTriangles[t]) {
+            continue;
+        }
+
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t vertex = cornerVertices[t * 3 + k];
+            uint32_t group = corners[t * 3 + k];
+
+            if (groupOf[vertex] != group) {
+                const Vertex& original = vertices[usedVertices[vertex]];
+                float bestDistance = std::numeric_limits<float>::max();
+
+                for (uint32_t i = groupStart[group]; i < groupStart[group + 1]; i++) {
+                    const Vertex& candidate = vertices[usedVertices[sorted[i]]];
+
+                    glm::vec2 uvDelta(candidate.uvX - original.uvX, candidate.uvY - original.uvY);
+                    float distance = glm::dot(uvDelta, uvDelta) + 1.f - glm::dot(candidate.normal, original.normal);
+
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        vertex = sorted[i];
+                    }
+                }
+            }
+
+            result.push_back(usedVertices[vertex]);
+        }
+    }
+
+    // quadrics only rank collapses, the error is the largest distance between input and result,
+    // measured both ways from sample points on every triangle the collapses touched
+    std::vector<uint32_t> inputCorners;
+    std::vector<uint32_t> resultCorners;
+    std::vector<uint32_t> touchedTriangles;
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        uint32_t c[3] = {groupOf[cornerVertices[t * 3]], groupOf[cornerVertices[t * 3 + 1]], groupOf[cornerVertices[t * 3 + 2]]};
+
+        // degenerate input triangles cover nothing
+        if (c[0] == c[1] || c[1] == c[2] || c[0] == c[2]) {
+            continue;
+        }
+
+        bool touched = deadTriangles[t];
+
+        for (uint32_t k = 0; k < 3; k++) {
+            touched |= corners[t * 3 + k] != c[k];
+            inputCorners.push_back(c[k]);
+
+            if (!deadTriangles[t]) {
+                resultCorners.push_back(corners[t * 3 + k]);
+            }
+        }
+
+        if (touched) {
+            touchedTriangles.push_back(t);
+        }
+    }
+
+    TriangleGrid inputGrid(positions, inputCorners);
+    TriangleGrid resultGrid(positions, resultCorners);
+
+    double maxDistance = 0.0;
+
+    SurfaceDistance toResult(resultGrid, maxDistance);
+    SurfaceDistance toInput(inputGrid, maxDistance);
+
+    auto getTriangles = [&](uint32_t t, glm::dvec3* input, glm::dvec3* output) {
+        for (uint32_t k = 0; k < 3; k++) {
+            input[k] = positions[groupOf[cornerVertices[t * 3 + k]]];
+            output[k] = positions[corners[t * 3 + k]];
+        }
+    };
+
+    for (uint32_t t : touchedTriangles) {
+        glm::dvec3 input[3];
+        glm::dvec3 output[3];
+        getTriangles(t, input, output);
+
+        toResult.addCenter(input);
+
+        if (!deadTriangles[t]) {
+            toInput.addCenter(output);
+        }
+    }
+
+    // a triangle's counterpart on the other side is usually close enough to settle it without a search
+    for (uint32_t t : touchedTriangles) {
+        glm::dvec3 input[3];
+        glm::dvec3 output[3];
+        getTriangles(t, input, output);
+
+        toResult.addTriangle(input, deadTriangles[t] ? nullptr : output);
+
+        if (!deadTriangles[t]) {
+            toInput.addTriangle(output, input);
+        }
+    }
+
+    outError = (float)maxDistance;
+
+    return result;
+}
+
+void meshlod::buildLods(std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::vector<MeshLod>& outLods, std::vector<uint32_t>& outIndices) {
+    if (indices.size() / 3 < MIN_TRIANGLE_COUNT) {
+        return;
+    }
+
+    std::vector<uint32_t> previous(indices.begin(), indices.end());
+    float error = 0.f;
+
+    for (uint32_t i = 0; i < MAX_LOD_COUNT; i++) {
+        size_t targetIndexCount = (size_t)(previous.size() / 3 * REDUCTION) * 3;
+
+        float lodError;
+        std::vector<uint32_t> lod = simplify(vertices, previous, targetIndexCount, lodError);
+
+        // borders and seams can stall the reduction, a level barely smaller than the last isn't worth keeping
+        if (lod.empty() || lod.size() > previous.size() * 0.8f) {
+            break;
+        }
+
+        // levels are simplified from the previous one, so their errors add up
+        error += lodError;
+
+        outLods.push_back(MeshLod{(uint32_t)outIndices.size(), (uint32_t)lod.size(), error});
+        outIndices.insert(outIndices.end(), lod.begin(), lod.end());
+
+        if (lod.size() / 3 < MIN_TRIANGLE_COUNT) {
+            break;
+        }
+
+        previous = std::move(lod);
+    }
+}
+
+meshlod::View meshlod::makeView(const glm::vec3& position, float projectionScale, float viewportHeight, float maxError) {
+    // projection[1][1] maps a unit length at unit distance to a unit in ndc, which spans half the viewport
+    return View{position, projectionScale * viewportHeight * 0.5f, maxError};
+}
+
+uint32_t meshlod::selectLod(std::span<const MeshLod> lods, const Bounds& bounds, const glm::mat4& transform, const View& view) {
+    if (lods.empty() || view.maxError <= 0.f) {
+        return 0;
+    }
+
+    glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.origin, 1.f));
+    float scale = std::max({
+        glm::length(glm::vec3(transform[0])),
+        glm::length(glm::vec3(transform[1])),
+        glm::length(glm::vec3(transform[2]))
+    });
+
+    float distance = glm::length(center - view.position) - bounds.sphereRadius * scale;
+
+    if (distance <= 0.f) {
+        return 0;
+    }
+
+    // pixels covered by one mesh unit at the closest point of the bounds
+    float pixelsPerUnit = view.pixelScale * scale / distance;
+    uint32_t lod = 0;
+
+    while (lod < lods.size() && lods[lod].error * pixelsPerUnit <= view.maxError) {
+        lod++;
+    }
+
+    return lod;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// forward references
+struct Vertex;
+struct MeshLod;
+struct Bounds;
+
+// quadric error edge collapse simplification of surfaces into lower detail index lists,
+// and the per frame choice between them from the projected bounds of an object
+namespace meshlod {
+    // levels below the full detail surface
+    constexpr uint32_t MAX_LOD_COUNT = 4;
+    // surfaces with fewer triangles are only drawn at full detail
+    constexpr uint32_t MIN_TRIANGLE_COUNT = 256;
+    // every level aims for this fraction of the previous level's triangles
+    constexpr float REDUCTION = 0.5f;
+
+    struct View {
+        glm::vec3 position;
+        // pixels covered by a unit length at unit distance
+        float pixelScale;
+        // largest projected error in pixels, 0 keeps every object at full detail
+        float maxError;
+    };
+
+    // collapses edges of the indexed triangles until at most targetIndexCount indices are left or
+    // no collapse keeps the surface valid, the result only references vertices of the input,
+    // outError bounds the distance between input and result in mesh units, taken both ways
+    // at sample points of every triangle the collapses touched
+    std::vector<uint32_t> simplify(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float& outError);
+
+    // simplifies a surface into up to MAX_LOD_COUNT levels appended to outIndices,
+    // level index offsets are positions in outIndices
+    void buildLods(std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::vector<MeshLod>& outLods, std::vector<uint32_t>& outIndices);
+
+    View makeView(const glm::vec3& position, float projectionScale, float viewportHeight, float maxError);
+
+    // coarsest level whose error projected at the closest point of the bounding sphere stays
+    // within the view's limit, 0 is the full detail surface and i > 0 is lods[i - 1]
+    uint32_t selectLod(std::span<const MeshLod> lods, const Bounds& bounds, const glm::mat4& transform, const View& view);
+}
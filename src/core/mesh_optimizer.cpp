@@ -0,0 +1,484 @@
+#include "mesh_optimizer.h"
+
+#include "mesh_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+// forsyth's scoring constants, the cache is larger than the analysis cache on purpose
+constexpr uint32_t CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+// resolution of every overdraw view
+constexpr uint32_t OVERDRAW_VIEW_SIZE = 256;
+
+// fifo cache simulation, returns the misses of every triangle when outMisses is set
+static uint32_t simulateCache(std::span<const uint32_t> indices, uint32_t cacheSize, std::vector<uint32_t>* outMisses = nullptr) {
+    uint32_t vertexCount = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end()) + 1;
+
+    // a vertex is cached while it was added in the last cacheSize misses
+    std::vector<uint32_t> cachedAt(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    uint32_t misses = 0;
+
+    if (outMisses) {
+        outMisses->assign(indices.size() / 3, 0);
+    }
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        uint32_t index = indices[i];
+
+        if (time - cachedAt[index] > cacheSize) {
+            cachedAt[index] = time++;
+            misses++;
+
+            if (outMisses) {
+                (*outMisses)[i / 3]++;
+            }
+        }
+    }
+
+    return misses;
+}
+
+float meshopt::computeACMR(std::span<const uint32_t> indices, uint32_t cacheSize) {
+    if (indices.size() < 3) {
+        return 0.f;
+    }
+
+    return (float)simulateCache(indices, cacheSize) / (indices.size() / 3);
+}
+
+float meshopt::computeATVR(std::span<const uint32_t> indices, uint32_t cacheSize) {
+    if (indices.empty()) {
+        return 0.f;
+    }
+
+    std::vector<uint32_t> unique(indices.begin(), indices.end());
+    std::sort(unique.begin(), unique.end());
+    size_t uniqueCount = std::unique(unique.begin(), unique.end()) - unique.begin();
+
+    return (float)simulateCache(indices, cacheSize) / uniqueCount;
+}
+
+float meshopt::computeOverdraw(std::span<const uint32_t> indices, std::span<const Vertex> vertices) {
+    if (indices.size() < 3) {
+        return 0.f;
+    }
+
+    glm::vec3 minPos(std::numeric_limits<float>::max());
+    glm::vec3 maxPos(std::numeric_limits<float>::lowest());
+
+    for (uint32_t index : indices) {
+        minPos = glm::min(minPos, vertices[index].position);
+        maxPos = glm::max(maxPos, vertices[index].position);
+    }
+
+    float extent = std::max(glm::max(maxPos.x - minPos.x, maxPos.y - minPos.y), std::max(maxPos.z - minPos.z, 1e-6f));
+
+    std::vector<float> depth(OVERDRAW_VIEW_SIZE * OVERDRAW_VIEW_SIZE);
+    uint64_t shadedCount = 0;
+    uint64_t coveredCount = 0;
+
+    for (uint32_t view = 0; view < 6; view++) {
+        // view direction along an axis, x and y are the two other axes
+        uint32_t axis = view / 2;
+        float direction = view % 2 == 0 ? 1.f : -1.f;
+        uint32_t axisX = (axis + 1) % 3;
+        uint32_t axisY = (axis + 2) % 3;
+
+        std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            glm::vec3 p[3];
+
+            for (uint32_t k = 0; k < 3; k++) {
+                glm::vec3 local = (vertices[indices[i + k]].position - minPos) / extent;
+                p[k] = glm::vec3(local[axisX] * (OVERDRAW_VIEW_SIZE - 1), local[axisY] * (OVERDRAW_VIEW_SIZE - 1), local[axis] * direction);
+            }
+
+            // area is the normal's component along the view axis, front faces point against the view
+            float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+
+            if (area * direction >= 0.f) {
+                continue;
+            }
+
+            int minX = std::max((int)std::ceil(std::min({p[0].x, p[1].x, p[2].x})), 0);
+            int maxX = std::min((int)std::floor(std::max({p[0].x, p[1].x, p[2].x})), (int)OVERDRAW_VIEW_SIZE - 1);
+            int minY = std::max((int)std::ceil(std::min({p[0].y, p[1].y, p[2].y})), 0);
+            int maxY = std::min((int)std::floor(std::max({p[0].y, p[1].y, p[2].y})), (int)OVERDRAW_VIEW_SIZE - 1);
+
+            for (int y = minY; y <= maxY; y++) {
+                for (int x = minX; x <= maxX; x++) {
+                    // barycentrics, negative outside the triangle
+                    float w0 = ((p[2].x - p[1].x) * (y - p[1].y) - (p[2].y - p[1].y) * (x - p[1].x)) / area;
+                    float w1 = ((p[0].x - p[2].x) * (y - p[2].y) - (p[0].y - p[2].y) * (x - p[2].x)) / area;
+                    float w2 = 1.f - w0 - w1;
+
+                    if (w0 < 0.f || w1 < 0.f || w2 < 0.f) {
+                        continue;
+                    }
+
+                    float z = w0 * p[0].z + w1 * p[1].z + w2 * p[2].z;
+                    float& stored = depth[y * OVERDRAW_VIEW_SIZE + x];
+
+                    if (z < stored) {
+                        coveredCount += stored == std::numeric_limits<float>::max();
+                        stored = z;
+                        shadedCount++;
+                    }
+                }
+            }
+        }
+    }
+
+    return coveredCount == 0 ? 0.f : (float)shadedCount / coveredCount;
+}
+
+void meshopt::deduplicateVertices(std::span<uint32_t> indices, std::span<const Vertex> vertices) {
+    std::vector<uint32_t> order(vertices.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    // vertices hold no padding, so bytes compare equal exactly when every attribute does
+    auto less = [&](uint32_t a, uint32_t b) {
+        int compare = std::memcmp(&vertices[a], &vertices[b], sizeof(Vertex));
+        return compare < 0 || (compare == 0 && a < b);
+    };
+
+    std::sort(order.begin(), order.end(), less);
+
+    std::vector<uint32_t> remap(vertices.size());
+
+    for (size_t i = 0; i < order.size(); i++) {
+        bool duplicate = i > 0 && std::memcmp(&vertices[order[i - 1]], &vertices[order[i]], sizeof(Vertex)) == 0;
+        remap[order[i]] = duplicate ? remap[order[i - 1]] : order[i];
+    }
+
+    for (uint32_t& index : indices) {
+        index = remap[index];
+    }
+}
+
+void meshopt::optimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount) {
+    uint32_t triangleCount = indices.size() / 3;
+
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // triangles of every vertex, emitted triangles are swapped past the live count
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    std::vector<uint32_t> liveCounts(vertexCount, 0);
+
+    for (uint32_t index : indices) {
+        liveCounts[index]++;
+    }
+
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveCounts[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+    for (uint32_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    // score of a vertex from its cache position, -1 when it has no triangles left
+    auto vertexScore = [](int32_t cachePosition, uint32_t liveCount) {
+        if (liveCount == 0) {
+            return -1.f;
+        }
+
+        float score = 0.f;
+
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // the last triangle's vertices, a fixed score so it isn't simply repeated
+                score = LAST_TRIANGLE_SCORE;
+            } else {
+                float scaled = 1.f - (float)(cachePosition - 3) / (CACHE_SIZE - 3);
+                score = std::pow(scaled, CACHE_DECAY_POWER);
+            }
+        }
+
+        // vertices with few triangles left are finished early so they don't linger
+        return score + VALENCE_BOOST_SCALE * std::pow((float)liveCount, -VALENCE_BOOST_POWER);
+    };
+
+    std::vector<float> vertexScores(vertexCount);
+
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        vertexScores[v] = vertexScore(-1, liveCounts[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    // the extra slots hold the vertices pushed out by the newest triangle while scores update
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(CACHE_SIZE + 3);
+    nextCache.reserve(CACHE_SIZE + 3);
+
+    uint32_t bestTriangle = 0;
+    uint32_t scanCursor = 0;
+
+    for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        if (bestTriangle == UINT32_MAX) {
+            // nothing in the cache has triangles left, continue with the next unused triangle
+            while (emitted[scanCursor]) {
+                scanCursor++;
+            }
+
+            bestTriangle = scanCursor;
+        }
+
+        const uint32_t* triangle = &indices[bestTriangle * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[bestTriangle] = true;
+
+        // remove the triangle from its vertices' live lists
+        nextCache.clear();
+
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+            uint32_t* end = begin + liveCounts[v];
+
+            std::swap(*std::find(begin, end, bestTriangle), *(end - 1));
+            liveCounts[v]--;
+
+            nextCache.push_back(v);
+        }
+
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                nextCache.push_back(v);
+            }
+        }
+
+        std::swap(cache, nextCache);
+
+        // rescore every vertex that was or still is cached and the triangles that use them
+        bestTriangle = UINT32_MAX;
+        float bestScore = -1.f;
+
+        for (uint32_t i = 0; i < cache.size(); i++) {
+            uint32_t v = cache[i];
+            int32_t position = i < CACHE_SIZE ? (int32_t)i : -1;
+
+            float score = vertexScore(position, liveCounts[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+
+            for (uint32_t j = 0; j < liveCounts[v]; j++) {
+                uint32_t t = adjacency[adjacencyOffsets[v] + j];
+                triangleScores[t] += delta;
+
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        if (cache.size() > CACHE_SIZE) {
+            cache.resize(CACHE_SIZE);
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void meshopt::optimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold) {
+    uint32_t triangleCount = indices.size() / 3;
+
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // hard boundaries where the cache order starts over, no triangle vertex was cached
+    std::vector<uint32_t> misses;
+    simulateCache(indices, ANALYSIS_CACHE_SIZE, &misses);
+
+    std::vector<uint32_t> clusters;
+
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (t == 0 || misses[t] == 3) {
+            clusters.push_back(t);
+        }
+    }
+
+    clusters.push_back(triangleCount);
+
+    // soft boundaries split hard clusters wherever the acmr since the last split is within the threshold
+    std::vector<uint32_t> softClusters;
+
+    std::vector<uint32_t> cachedAt(vertices.size(), 0);
+    uint32_t time = ANALYSIS_CACHE_SIZE + 1;
+
+    for (size_t c = 0; c + 1 < clusters.size(); c++) {
+        uint32_t begin = clusters[c];
+        uint32_t end = clusters[c + 1];
+
+        uint32_t clusterMisses = 0;
+
+        for (uint32_t t = begin; t < end; t++) {
+            clusterMisses += misses[t];
+        }
+
+        float clusterThreshold = threshold * clusterMisses / (end - begin);
+
+        softClusters.push_back(begin);
+
+        // every run starts with an empty cache, since any cluster may be drawn after any other,
+        // moving the clock past the cache size empties it
+        uint32_t start = begin;
+        uint32_t runMisses = 0;
+
+        for (uint32_t t = begin; t < end; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t index = indices[t * 3 + k];
+
+                if (time - cachedAt[index] > ANALYSIS_CACHE_SIZE) {
+                    cachedAt[index] = time++;
+                    runMisses++;
+                }
+            }
+
+            uint32_t runLength = t + 1 - start;
+
+            if (t + 1 < end && (float)runMisses / runLength <= clusterThreshold) {
+                softClusters.push_back(t + 1);
+                start = t + 1;
+                runMisses = 0;
+                time += ANALYSIS_CACHE_SIZE + 1;
+            }
+        }
+
+        // the last run never got below the threshold, it stays with the run before it
+        if (start > begin && (float)runMisses / (end - start) > clusterThreshold) {
+            softClusters.pop_back();
+        }
+
+        time += ANALYSIS_CACHE_SIZE + 1;
+    }
+
+    softClusters.push_back(triangleCount);
+
+    // mesh centroid over the triangle areas
+    glm::vec3 meshCentroid(0.f);
+    float meshArea = 0.f;
+
+    std::vector<glm::vec3> clusterCentroids(softClusters.size() - 1, glm::vec3(0.f));
+    std::vector<glm::vec3> clusterNormals(softClusters.size() - 1, glm::vec3(0.f));
+
+    for (size_t c = 0; c + 1 < softClusters.size(); c++) {
+        float clusterArea = 0.f;
+
+        for (uint32_t t = softClusters[c]; t < softClusters[c + 1]; t++) {
+            const glm::vec3& p0 = vertices[indices[t * 3]].position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+
+            clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.f);
+            clusterNormals[c] += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += clusterCentroids[c];
+        meshArea += clusterArea;
+
+        clusterCentroids[c] /= std::max(clusterArea, 1e-12f);
+    }
+
+    meshCentroid /= std::max(meshArea, 1e-12f);
+
+    // clusters far out and facing away from the center are likely to occlude the others
+    std::vector<float> sortKeys(softClusters.size() - 1);
+
+    for (size_t c = 0; c < sortKeys.size(); c++) {
+        float length = glm::length(clusterNormals[c]);
+        glm::vec3 normal = length > 0.f ? clusterNormals[c] / length : glm::vec3(0.f);
+
+        sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, normal);
+    }
+
+    std::vector<uint32_t> order(sortKeys.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    for (uint32_t c : order) {
+        result.insert(result.end(), indices.begin() + softClusters[c] * 3, indices.begin() + softClusters[c + 1] * 3);
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+uint32_t meshopt::optimizeVertexFetch(std::span<Vertex> vertices, std::span<uint32_t> indices) {
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    std::copy(reordered.begin(), reordered.end(), vertices.begin());
+
+    return reordered.size();
+}
+
+meshopt::Stats meshopt::optimize(std::vector<Vertex>& vertices, std::span<uint32_t> indices, bool reduceOverdraw) {
+    Stats stats{};
+    stats.acmrBefore = computeACMR(indices);
+    stats.atvrBefore = computeATVR(indices);
+    stats.vertexCountBefore = vertices.size();
+
+    deduplicateVertices(indices, vertices);
+    optimizeVertexCache(indices, vertices.size());
+
+    if (reduceOverdraw) {
+        optimizeOverdraw(indices, vertices);
+    }
+
+    vertices.resize(optimizeVertexFetch(vertices, indices));
+
+    stats.acmrAfter = computeACMR(indices);
+    stats.atvrAfter = computeATVR(indices);
+    stats.vertexCountAfter = vertices.size();
+
+    return stats;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// forward reference
+struct Vertex;
+
+// load time reordering of indexed triangle lists for the post transform vertex cache,
+// overdraw and vertex fetch locality, plus the measures used to report the results
+namespace meshopt {
+    // fifo cache size used to measure acmr and atvr, close to what current gpus reuse
+    constexpr uint32_t ANALYSIS_CACHE_SIZE = 16;
+    // clusters may be split while their acmr stays within this factor of the vertex cache order
+    constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+    struct Stats {
+        // transformed vertices per triangle
+        float acmrBefore;
+        float acmrAfter;
+        // transformed vertices per unique vertex, 1 is ideal
+        float atvrBefore;
+        float atvrAfter;
+        uint32_t vertexCountBefore;
+        uint32_t vertexCountAfter;
+    };
+
+    float computeACMR(std::span<const uint32_t> indices, uint32_t cacheSize = ANALYSIS_CACHE_SIZE);
+    float computeATVR(std::span<const uint32_t> indices, uint32_t cacheSize = ANALYSIS_CACHE_SIZE);
+
+    // shaded over covered pixels of orthographic views along the six axis directions,
+    // back faces are culled like the opaque pipelines do
+    float computeOverdraw(std::span<const uint32_t> indices, std::span<const Vertex> vertices);
+
+    // points the indices of bitwise identical vertices at the first one
+    void deduplicateVertices(std::span<uint32_t> indices, std::span<const Vertex> vertices);
+
+    // tom forsyth's linear speed vertex cache optimisation
+    void optimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount);
+
+    // splits cache ordered triangles into clusters and draws outward facing clusters on the
+    // outside of the mesh first, so they occlude the rest, keeps most of the cache order
+    void optimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold = OVERDRAW_THRESHOLD);
+
+    // reorders vertices by first use and drops unreferenced ones, returns the new vertex count
+    uint32_t optimizeVertexFetch(std::span<Vertex> vertices, std::span<uint32_t> indices);
+
+    // runs every step above on a surface with indices relative to its vertices,
+    // overdraw ordering is only worth it for opaque surfaces
+    Stats optimize(std::vector<Vertex>& vertices, std::span<uint32_t> indices, bool reduceOverdraw);
+}
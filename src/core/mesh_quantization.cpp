@@ -0,0 +1,105 @@
+#include "mesh_quantization.h"
+
+#include "mesh_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glm/gtc/packing.hpp>
+
+meshquant::PositionRange meshquant::getPositionRange(std::span<const Vertex> vertices) {
+    if (vertices.empty()) {
+        return PositionRange{glm::vec3(0.f), glm::vec3(0.f)};
+    }
+
+    glm::vec3 minPos(std::numeric_limits<float>::max());
+    glm::vec3 maxPos(std::numeric_limits<float>::lowest());
+
+    for (const Vertex& vertex : vertices) {
+        minPos = glm::min(minPos, vertex.position);
+        maxPos = glm::max(maxPos, vertex.position);
+    }
+
+    return PositionRange{minPos, maxPos - minPos};
+}
+
+glm::vec2 meshquant::encodeOctahedral(const glm::vec3& normal) {
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+
+    if (length == 0.f) {
+        return glm::vec2(0.f);
+    }
+
+    glm::vec2 encoded = glm::vec2(normal) / length;
+
+    // the lower hemisphere is folded over the diagonals
+    if (normal.z < 0.f) {
+        glm::vec2 sign(encoded.x >= 0.f ? 1.f : -1.f, encoded.y >= 0.f ? 1.f : -1.f);
+        encoded = (1.f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+    }
+
+    return encoded;
+}
+
+glm::vec3 meshquant::decodeOctahedral(const glm::vec2& encoded) {
+    glm::vec3 normal(encoded, 1.f - std::abs(encoded.x) - std::abs(encoded.y));
+    float fold = std::max(-normal.z, 0.f);
+
+    normal.x += normal.x >= 0.f ? -fold : fold;
+    normal.y += normal.y >= 0.f ? -fold : fold;
+
+    return glm::normalize(normal);
+}
+
+CompactVertex meshquant::compress(const Vertex& vertex, const PositionRange& range) {
+    // flat axes have no extent, every vertex sits at the offset
+    glm::vec3 position = glm::vec3(
+        range.scale.x > 0.f ? (vertex.position.x - range.offset.x) / range.scale.x : 0.f,
+        range.scale.y > 0.f ? (vertex.position.y - range.offset.y) / range.scale.y : 0.f,
+        range.scale.z > 0.f ? (vertex.position.z - range.offset.z) / range.scale.z : 0.f
+    );
+
+    glm::vec2 normal = encodeOctahedral(vertex.normal);
+
+    CompactVertex compact;
+    compact.position[0] = glm::packUnorm1x16(position.x);
+    compact.position[1] = glm::packUnorm1x16(position.y);
+    compact.position[2] = glm::packUnorm1x16(position.z);
+    compact.padding = 0;
+    compact.normal[0] = (int16_t)glm::packSnorm1x16(normal.x);
+    compact.normal[1] = (int16_t)glm::packSnorm1x16(normal.y);
+    compact.uv[0] = glm::packHalf1x16(vertex.uvX);
+    compact.uv[1] = glm::packHalf1x16(vertex.uvY);
+
+    return compact;
+}
+
+Vertex meshquant::decompress(const CompactVertex& vertex, const PositionRange& range) {
+    glm::vec3 position(
+        glm::unpackUnorm1x16(vertex.position[0]),
+        glm::unpackUnorm1x16(vertex.position[1]),
+        glm::unpackUnorm1x16(vertex.position[2])
+    );
+
+    glm::vec2 normal(glm::unpackSnorm1x16((uint16_t)vertex.normal[0]), glm::unpackSnorm1x16((uint16_t)vertex.normal[1]));
+
+    Vertex full;
+    full.position = range.offset + position * range.scale;
+    full.normal = decodeOctahedral(normal);
+    full.uvX = glm::unpackHalf1x16(vertex.uv[0]);
+    full.uvY = glm::unpackHalf1x16(vertex.uv[1]);
+
+    return full;
+}
+
+std::vector<CompactVertex> meshquant::compressVertices(std::span<const Vertex> vertices, const PositionRange& range) {
+    std::vector<CompactVertex> compact;
+    compact.reserve(vertices.size());
+
+    for (const Vertex& vertex : vertices) {
+        compact.push_back(compress(vertex, range));
+    }
+
+    return compact;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// forward references
+struct Vertex;
+struct CompactVertex;
+
+// conversion between full float vertices and the compact vertex format, decoding mirrors
+// the vertex shaders and is only used on the cpu to measure the error
+namespace meshquant {
+    // meshes with more vertices keep 32 bit indices
+    constexpr size_t MAX_SHORT_INDEX_VERTEX_COUNT = 1 << 16;
+
+    struct PositionRange {
+        glm::vec3 offset;
+        // size of the box, a unorm of 1 decodes to offset + scale
+        glm::vec3 scale;
+    };
+
+    // bounding box of every vertex, every surface of a mesh shares it so seams between them stay closed
+    PositionRange getPositionRange(std::span<const Vertex> vertices);
+
+    // unit vector to a point of the [-1, 1] square
+    glm::vec2 encodeOctahedral(const glm::vec3& normal);
+    glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+
+    CompactVertex compress(const Vertex& vertex, const PositionRange& range);
+    Vertex decompress(const CompactVertex& vertex, const PositionRange& range);
+
+    std::vector<CompactVertex> compressVertices(std::span<const Vertex> vertices, const PositionRange& range);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// mesh data shared by the loader and the cpu side mesh processing, free of vulkan types
+// so the processing builds without the renderer
+
+struct alignas(16) Vertex {
+    glm::vec3 position;
+    float uvX;
+    glm::vec3 normal;
+    float uvY;
+};
+
+// half size vertex, position is unorm16 over the mesh bounds, normal is an octahedral
+// snorm16 pair and uv are half floats, read by the shaders as a uvec4
+struct CompactVertex {
+    uint16_t position[3];
+    uint16_t padding;
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+
+struct Bounds {
+    glm::vec3 origin;
+    float sphereRadius;
+    glm::vec3 extents;
+};
+
+// simplified index range of a surface, stored after the full detail indices of its mesh
+struct MeshLod {
+    // from the surface's first index
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    // bound on the distance from the full detail surface, in mesh units
+    float error;
+};
+
+// cluster of up to 64 vertices and 124 triangles of a surface, its triangles are a contiguous
+// index range, layout matches the shaders (std430)
+struct Meshlet {
+    // mesh space bounding sphere, w holds the radius
+    glm::vec4 sphere;
+    // normal cone axis, w holds the cutoff, meshlets with a cutoff of 1 are never backface culled
+    glm::vec4 cone;
+    // from the surface's first index
+    uint32_t firstIndex;
+    uint32_t triangleCount;
+    uint32_t padding[2];
+};
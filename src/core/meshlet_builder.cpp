@@ -0,0 +1,135 @@
+#include "meshlet_builder.h"
+
+#include "mesh_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// cones wider than this, about 84 degrees from the axis, can't be culled from anywhere useful
+constexpr float MIN_CONE_DOT = 0.1f;
+
+static Meshlet computeBounds(std::span<const Vertex> vertices, std::span<const uint32_t> indices, uint32_t firstIndex, uint32_t triangleCount) {
+    glm::vec3 minPos(std::numeric_limits<float>::max());
+    glm::vec3 maxPos(std::numeric_limits<float>::lowest());
+
+    for (uint32_t i = firstIndex; i < firstIndex + triangleCount * 3; i++) {
+        minPos = glm::min(minPos, vertices[indices[i]].position);
+        maxPos = glm::max(maxPos, vertices[indices[i]].position);
+    }
+
+    glm::vec3 center = (minPos + maxPos) * 0.5f;
+    float radius = 0.f;
+
+    for (uint32_t i = firstIndex; i < firstIndex + triangleCount * 3; i++) {
+        radius = std::max(radius, glm::distance(center, vertices[indices[i]].position));
+    }
+
+    // the axis averages the unit normals, the cutoff comes from the normal furthest from it
+    std::vector<glm::vec3> normals;
+    normals.reserve(triangleCount);
+
+    glm::vec3 axis(0.f);
+
+    for (uint32_t i = firstIndex; i < firstIndex + triangleCount * 3; i += 3) {
+        const glm::vec3& p0 = vertices[indices[i]].position;
+        const glm::vec3& p1 = vertices[indices[i + 1]].position;
+        const glm::vec3& p2 = vertices[indices[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+
+        // degenerate triangles are never rasterized
+        if (length == 0.f) {
+            continue;
+        }
+
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+
+    Meshlet meshlet{};
+    meshlet.sphere = glm::vec4(center, radius);
+    meshlet.cone = glm::vec4(0.f, 0.f, 1.f, 1.f);
+    meshlet.firstIndex = firstIndex;
+    meshlet.triangleCount = triangleCount;
+
+    float axisLength = glm::length(axis);
+
+    if (normals.empty() || axisLength == 0.f) {
+        return meshlet;
+    }
+
+    axis /= axisLength;
+
+    float minDot = 1.f;
+
+    for (const glm::vec3& normal : normals) {
+        minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+
+    if (minDot > MIN_CONE_DOT) {
+        // sine of the cone's half angle
+        meshlet.cone = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+    }
+
+    return meshlet;
+}
+
+void meshlets::build(std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::vector<Meshlet>& outMeshlets) {
+    // meshlet each vertex was last added to
+    std::vector<uint32_t> vertexMeshlet(vertices.size(), std::numeric_limits<uint32_t>::max());
+
+    uint32_t meshletId = 0;
+    uint32_t firstIndex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t triangleCount = 0;
+
+    // vertices of the triangle at i the current meshlet doesn't have yet
+    auto countNewVertices = [&](uint32_t i) {
+        uint32_t newVertices = 0;
+
+        for (uint32_t k = 0; k < 3; k++) {
+            // repeated corners of degenerate triangles count once
+            bool repeated = (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+
+            if (vertexMeshlet[indices[i + k]] != meshletId && !repeated) {
+                newVertices++;
+            }
+        }
+
+        return newVertices;
+    };
+
+    for (uint32_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t newVertices = countNewVertices(i);
+
+        if (vertexCount + newVertices > MAX_VERTICES || triangleCount == MAX_TRIANGLES) {
+            outMeshlets.push_back(computeBounds(vertices, indices, firstIndex, triangleCount));
+
+            meshletId++;
+            firstIndex = i;
+            vertexCount = 0;
+            triangleCount = 0;
+            newVertices = countNewVertices(i);
+        }
+
+        for (uint32_t k = 0; k < 3; k++) {
+            vertexMeshlet[indices[i + k]] = meshletId;
+        }
+
+        vertexCount += newVertices;
+        triangleCount++;
+    }
+
+    if (triangleCount > 0) {
+        outMeshlets.push_back(computeBounds(vertices, indices, firstIndex, triangleCount));
+    }
+}
+
+bool meshlets::isBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition) {
+    glm::vec3 toCenter = glm::vec3(meshlet.sphere) - cameraPosition;
+
+    // every point of the sphere sees every normal of the cone from behind
+    return glm::dot(toCenter, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(toCenter) + meshlet.sphere.w;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// forward references
+struct Vertex;
+struct Meshlet;
+
+// splits surfaces into small clusters with bounds and normal cones, so large surfaces can be
+// culled piece by piece on the gpu
+namespace meshlets {
+    constexpr uint32_t MAX_VERTICES = 64;
+    constexpr uint32_t MAX_TRIANGLES = 124;
+    // smaller surfaces are culled as a whole
+    constexpr uint32_t MIN_TRIANGLE_COUNT = 1024;
+
+    // cuts the triangles in their current order, which is expected to be vertex cache optimized,
+    // into meshlets appended to outMeshlets, meshlet index ranges start at the first index
+    void build(std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::vector<Meshlet>& outMeshlets);
+
+    // conservative test in mesh space, true when every triangle of the meshlet faces away from the camera
+    bool isBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition);
+}
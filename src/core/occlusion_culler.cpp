@@ -0,0 +1,389 @@
+#include "occlusion_culler.h"
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OCCLUSION_CULLER_X86
+#endif
+
+// clip space point inside the depth range, 0 <= z <= w holds for regular and reversed depth
+static bool isInDepthRange(const glm::vec4& clip) {
+    return clip.w > 0.f && clip.z >= 0.f && clip.z <= clip.w;
+}
+
+static glm::vec2 toScreen(const glm::vec4& clip) {
+    return glm::vec2(
+        (clip.x / clip.w * 0.5f + 0.5f) * OcclusionCuller::WIDTH,
+        (clip.y / clip.w * 0.5f + 0.5f) * OcclusionCuller::HEIGHT
+    );
+}
+
+// edge function through a and b as a * x + b * y + c
+static glm::vec3 edgeFunction(const glm::vec2& a, const glm::vec2& b) {
+    return glm::vec3(a.y - b.y, b.x - a.x, (b.y - a.y) * a.x - (b.x - a.x) * a.y);
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewProjection) {
+    mViewProjection = viewProjection;
+    mPolygons.clear();
+
+    std::fill(mDepth.begin(), mDepth.end(), 0.f);
+    std::fill(mTileMin.begin(), mTileMin.end(), 0.f);
+    std::fill(mTileMax.begin(), mTileMax.end(), 0.f);
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3* positions, const uint32_t* indices, uint32_t indexCount, const glm::mat4& transform) {
+    glm::mat4 matrix = mViewProjection * transform;
+
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+        glm::vec4 clip[3];
+
+        for (uint32_t v = 0; v < 3; v++) {
+            clip[v] = matrix * glm::vec4(positions[indices[i + v]], 1.f);
+        }
+
+        // only whole pixels get covered, so the two halves of a quad go in as one polygon,
+        // otherwise the pixels along their shared edge would never be written
+        if (i + 5 < indexCount && addQuad(clip, &indices[i], positions, matrix)) {
+            i += 3;
+            continue;
+        }
+
+        addPolygon(clip, 3);
+    }
+}
+
+bool OcclusionCuller::addQuad(const glm::vec4* clip, const uint32_t* indices, const glm::vec3* positions, const glm::mat4& matrix) {
+    const uint32_t* next = indices + 3;
+
+    for (uint32_t e = 0; e < 3; e++) {
+        uint32_t p = indices[e];
+        uint32_t q = indices[(e + 1) % 3];
+
+        if (std::count(next, next + 3, p) != 1 || std::count(next, next + 3, q) != 1) {
+            continue;
+        }
+
+        // the other triangle's last vertex lies across the shared edge, between p and q
+        uint32_t other = next[0] + next[1] + next[2] - p - q;
+        glm::vec4 quad[4] = {clip[e], matrix * glm::vec4(positions[other], 1.f), clip[(e + 1) % 3], clip[(e + 2) % 3]};
+
+        return addPolygon(quad, 4);
+    }
+
+    return false;
+}
+
+bool OcclusionCuller::addPolygon(const glm::vec4* clip, uint32_t vertexCount) {
+    glm::vec2 s[MAX_POLYGON_EDGES];
+    float depth[MAX_POLYGON_EDGES];
+
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        // clipping would add coverage the real polygon doesn't have in front of the near plane
+        if (!isInDepthRange(clip[v])) {
+            return false;
+        }
+
+        s[v] = toScreen(clip[v]);
+        depth[v] = 1.f / clip[v].w;
+    }
+
+    float area = 0.f;
+
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        const glm::vec2& a = s[v];
+        const glm::vec2& b = s[(v + 1) % vertexCount];
+
+        area += a.x * b.y - a.y * b.x;
+    }
+
+    if (std::abs(area) < 1e-6f) {
+        return false;
+    }
+
+    // occluders are double sided, flip back facing polygons so the inside is positive
+    if (area < 0.f) {
+        std::reverse(s, s + vertexCount);
+        std::reverse(depth, depth + vertexCount);
+    }
+
+    Polygon polygon;
+
+    // unused edges are always positive
+    for (uint32_t e = 0; e < MAX_POLYGON_EDGES; e++) {
+        polygon.edges[e] = e < vertexCount ? edgeFunction(s[e], s[(e + 1) % vertexCount]) : glm::vec3(0.f, 0.f, 1.f);
+    }
+
+    // convex only, every vertex has to be strictly inside the edges it doesn't touch
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        for (uint32_t e = 0; e < vertexCount; e++) {
+            if (e == v || (e + 1) % vertexCount == v) {
+                continue;
+            }
+
+            if (glm::dot(polygon.edges[e], glm::vec3(s[v], 1.f)) <= 0.f) {
+                return false;
+            }
+        }
+    }
+
+    // depth is linear over the screen for planar polygons, fitted through the first three vertices
+    glm::vec2 u = s[1] - s[0];
+    glm::vec2 w = s[2] - s[0];
+    float du = depth[1] - depth[0];
+    float dw = depth[2] - depth[0];
+    float determinant = u.x * w.y - u.y * w.x;
+
+    polygon.depthPlane.x = (du * w.y - dw * u.y) / determinant;
+    polygon.depthPlane.y = (u.x * dw - w.x * du) / determinant;
+    polygon.depthPlane.z = depth[0] - polygon.depthPlane.x * s[0].x - polygon.depthPlane.y * s[0].y;
+
+    // a fourth vertex off the plane bends the surface, small bends are absorbed by moving
+    // the plane back, anything else is rasterized as separate triangles
+    if (vertexCount == 4) {
+        float offset = glm::dot(polygon.depthPlane, glm::vec3(s[3], 1.f)) - depth[3];
+
+        if (std::abs(offset) > depth[3] * 1e-3f) {
+            return false;
+        }
+
+        polygon.depthPlane.z -= std::abs(offset);
+    }
+
+    // occluders have to under cover, so the functions are evaluated at pixel centers but
+    // give the worst value over the pixel: only whole pixels pass and they get their farthest depth
+    for (auto& edge : polygon.edges) {
+        edge.z -= 0.5f * (std::abs(edge.x) + std::abs(edge.y));
+    }
+
+    polygon.depthPlane.z -= 0.5f * (std::abs(polygon.depthPlane.x) + std::abs(polygon.depthPlane.y));
+
+    // pixels that may lie entirely inside the polygon
+    glm::vec2 min = s[0];
+    glm::vec2 max = s[0];
+
+    for (uint32_t v = 1; v < vertexCount; v++) {
+        min = glm::min(min, s[v]);
+        max = glm::max(max, s[v]);
+    }
+
+    polygon.minX = std::max((int)std::ceil(min.x), 0);
+    polygon.maxX = std::min((int)std::floor(max.x) - 1, (int)WIDTH - 1);
+    polygon.minY = std::max((int)std::ceil(min.y), 0);
+    polygon.maxY = std::min((int)std::floor(max.y) - 1, (int)HEIGHT - 1);
+
+    // too small or off screen, still handled
+    if (polygon.minX <= polygon.maxX && polygon.minY <= polygon.maxY) {
+        mPolygons.push_back(polygon);
+    }
+
+    return true;
+}
+
+void OcclusionCuller::rasterize(ThreadPool* threadPool, Path path) {
+    if (path == Path::AUTO) {
+#ifdef OCCLUSION_CULLER_X86
+        path = Path::SSE;
+#else
+        path = Path::SCALAR;
+#endif
+    }
+
+    // bands cover disjoint rows and tiles, so workers never write the same memory
+    if (threadPool != nullptr) {
+        threadPool->parallelFor(BAND_COUNT, [&](uint32_t band, uint32_t) {
+            rasterizeBand(band, path);
+            updateTiles(band);
+        });
+    } else {
+        for (uint32_t band = 0; band < BAND_COUNT; band++) {
+            rasterizeBand(band, path);
+            updateTiles(band);
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeBand(uint32_t band, Path path) {
+    int bandStart = band * BAND_HEIGHT;
+    int bandEnd = bandStart + BAND_HEIGHT - 1;
+
+    for (const Polygon& polygon : mPolygons) {
+        int minY = std::max(polygon.minY, bandStart);
+        int maxY = std::min(polygon.maxY, bandEnd);
+
+        const glm::vec3* edges = polygon.edges;
+        const glm::vec3& depthPlane = polygon.depthPlane;
+
+        for (int y = minY; y <= maxY; y++) {
+            float py = y + 0.5f;
+            float* row = &mDepth[y * WIDTH];
+
+            // row constant parts of the edge functions and depth
+            float r0 = edges[0].y * py + edges[0].z;
+            float r1 = edges[1].y * py + edges[1].z;
+            float r2 = edges[2].y * py + edges[2].z;
+            float r3 = edges[3].y * py + edges[3].z;
+            float rowDepth = depthPlane.y * py + depthPlane.z;
+
+#ifdef OCCLUSION_CULLER_X86
+            if (path == Path::SSE) {
+                __m128 a0 = _mm_set1_ps(edges[0].x);
+                __m128 a1 = _mm_set1_ps(edges[1].x);
+                __m128 a2 = _mm_set1_ps(edges[2].x);
+                __m128 a3 = _mm_set1_ps(edges[3].x);
+                __m128 depthA = _mm_set1_ps(depthPlane.x);
+
+                __m128 row0 = _mm_set1_ps(r0);
+                __m128 row1 = _mm_set1_ps(r1);
+                __m128 row2 = _mm_set1_ps(r2);
+                __m128 row3 = _mm_set1_ps(r3);
+                __m128 rowDepth4 = _mm_set1_ps(rowDepth);
+
+                __m128 zero = _mm_setzero_ps();
+
+                // lanes outside the pixel bounds stay untouched, matching the scalar loop
+                __m128 firstCenter = _mm_set1_ps(polygon.minX + 0.5f);
+                __m128 lastCenter = _mm_set1_ps(polygon.maxX + 0.5f);
+
+                // WIDTH is a multiple of 4, so aligned groups never leave the row
+                for (int x = polygon.minX & ~3; x <= polygon.maxX; x += 4) {
+                    float fx = (float)x;
+                    __m128 px = _mm_setr_ps(fx + 0.5f, fx + 1.5f, fx + 2.5f, fx + 3.5f);
+
+                    __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+                    __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+                    __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+                    __m128 e3 = _mm_add_ps(_mm_mul_ps(a3, px), row3);
+
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_and_ps(_mm_cmpge_ps(e2, zero), _mm_cmpge_ps(e3, zero)));
+                    inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(px, firstCenter), _mm_cmple_ps(px, lastCenter)));
+
+                    if (_mm_movemask_ps(inside) == 0) {
+                        continue;
+                    }
+
+                    __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, px), rowDepth4);
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 closest = _mm_max_ps(current, depth);
+
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, current)));
+                }
+
+                continue;
+            }
+#endif
+
+            for (int x = polygon.minX; x <= polygon.maxX; x++) {
+                float px = x + 0.5f;
+
+                float e0 = edges[0].x * px + r0;
+                float e1 = edges[1].x * px + r1;
+                float e2 = edges[2].x * px + r2;
+                float e3 = edges[3].x * px + r3;
+
+                if (e0 >= 0.f && e1 >= 0.f && e2 >= 0.f && e3 >= 0.f) {
+                    float depth = depthPlane.x * px + rowDepth;
+                    row[x] = std::max(row[x], depth);
+                }
+            }
+        }
+    }
+}
+
+void OcclusionCuller::updateTiles(uint32_t band) {
+    uint32_t firstTileY = band * BAND_HEIGHT / TILE_SIZE;
+    uint32_t lastTileY = firstTileY + BAND_HEIGHT / TILE_SIZE;
+
+    for (uint32_t tileY = firstTileY; tileY < lastTileY; tileY++) {
+        for (uint32_t tileX = 0; tileX < TILES_X; tileX++) {
+            float minDepth = INFINITY;
+            float maxDepth = 0.f;
+
+            for (uint32_t y = tileY * TILE_SIZE; y < (tileY + 1) * TILE_SIZE; y++) {
+                const float* row = &mDepth[y * WIDTH + tileX * TILE_SIZE];
+
+                for (uint32_t x = 0; x < TILE_SIZE; x++) {
+                    minDepth = std::min(minDepth, row[x]);
+                    maxDepth = std::max(maxDepth, row[x]);
+                }
+            }
+
+            mTileMin[tileY * TILES_X + tileX] = minDepth;
+            mTileMax[tileY * TILES_X + tileX] = maxDepth;
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const glm::vec3& origin, const glm::vec3& extents, const glm::mat4& transform) const {
+    glm::mat4 matrix = mViewProjection * transform;
+
+    glm::vec2 min(INFINITY);
+    glm::vec2 max(-INFINITY);
+
+    // depth of the closest corner, the whole box is at most this close
+    float boxDepth = 0.f;
+
+    // corners are the center plus or minus the clip space box axes
+    glm::vec4 center = matrix * glm::vec4(origin, 1.f);
+    glm::vec4 axisX = matrix[0] * extents.x;
+    glm::vec4 axisY = matrix[1] * extents.y;
+    glm::vec4 axisZ = matrix[2] * extents.z;
+
+    for (uint32_t c = 0; c < 8; c++) {
+        glm::vec4 clip = center + (c & 1 ? axisX : -axisX) + (c & 2 ? axisY : -axisY) + (c & 4 ? axisZ : -axisZ);
+
+        if (!isInDepthRange(clip)) {
+            return true;
+        }
+
+        glm::vec2 screen = toScreen(clip);
+        min = glm::min(min, screen);
+        max = glm::max(max, screen);
+        boxDepth = std::max(boxDepth, 1.f / clip.w);
+    }
+
+    if (max.x < 0.f || max.y < 0.f || min.x > WIDTH || min.y > HEIGHT) {
+        return true;
+    }
+
+    // every pixel the box overlaps, not just the ones whose centers it covers
+    int minX = std::clamp((int)std::floor(min.x), 0, (int)WIDTH - 1);
+    int maxX = std::clamp((int)std::ceil(max.x) - 1, 0, (int)WIDTH - 1);
+    int minY = std::clamp((int)std::floor(min.y), 0, (int)HEIGHT - 1);
+    int maxY = std::clamp((int)std::ceil(max.y) - 1, 0, (int)HEIGHT - 1);
+
+    for (int tileY = minY / TILE_SIZE; tileY <= maxY / (int)TILE_SIZE; tileY++) {
+        for (int tileX = minX / TILE_SIZE; tileX <= maxX / (int)TILE_SIZE; tileX++) {
+            uint32_t tile = tileY * TILES_X + tileX;
+
+            // every occluder in the tile is behind the box
+            if (mTileMax[tile] <= boxDepth) {
+                return true;
+            }
+
+            // every pixel in the tile is covered by something closer
+            if (mTileMin[tile] > boxDepth) {
+                continue;
+            }
+
+            int x0 = std::max(minX, tileX * (int)TILE_SIZE);
+            int x1 = std::min(maxX, (tileX + 1) * (int)TILE_SIZE - 1);
+            int y0 = std::max(minY, tileY * (int)TILE_SIZE);
+            int y1 = std::min(maxY, (tileY + 1) * (int)TILE_SIZE - 1);
+
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    if (mDepth[y * WIDTH + x] <= boxDepth) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
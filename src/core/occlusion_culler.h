@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+// software occlusion culling, occluder triangles are rasterized on the cpu into a small
+// depth buffer holding 1/w, larger is closer regardless of the depth range or reversed depth,
+// the min and max depth of every tile let most object tests finish without reading pixels
+//
+// the buffer is conservative, a pixel is only written when one occluder polygon covers all of it and
+// holds the farthest occluder depth inside it, so objects are never culled while in view
+//
+// no gpu is involved, so it can be driven and checked from plain cpu code
+class OcclusionCuller {
+public:
+    static constexpr uint32_t WIDTH = 256;
+    static constexpr uint32_t HEIGHT = 128;
+    static constexpr uint32_t TILE_SIZE = 8;
+    static constexpr uint32_t TILES_X = WIDTH / TILE_SIZE;
+    static constexpr uint32_t TILES_Y = HEIGHT / TILE_SIZE;
+    // rows rasterized by one task, a multiple of the tile size
+    static constexpr uint32_t BAND_HEIGHT = 16;
+    static constexpr uint32_t BAND_COUNT = HEIGHT / BAND_HEIGHT;
+
+    enum class Path {
+        AUTO,
+        SCALAR,
+        SSE
+    };
+
+    // clears the depth buffer and drops the last frame's occluders
+    void beginFrame(const glm::mat4& viewProjection);
+
+    // queues indexCount / 3 triangles, triangles crossing the near plane are dropped
+    // so the depth buffer never claims more coverage than the occluders have, consecutive
+    // triangles forming a flat convex quad are merged so their shared edge gets covered
+    void addOccluder(const glm::vec3* positions, const uint32_t* indices, uint32_t indexCount, const glm::mat4& transform);
+
+    // rasterizes the queued triangles and builds the tile bounds, bands are split
+    // across the pool's workers or run on the calling thread without a pool
+    void rasterize(ThreadPool* threadPool = nullptr, Path path = Path::AUTO);
+
+    // tests a local bounding box, false only if occluders hide all of it,
+    // boxes crossing the near plane or leaving the screen are always visible
+    bool isVisible(const glm::vec3& origin, const glm::vec3& extents, const glm::mat4& transform) const;
+
+    // queued triangles and merged quads
+    uint32_t getPolygonCount() const {
+        return mPolygons.size();
+    }
+
+    // WIDTH * HEIGHT values, 0 where no occluder was drawn
+    const std::vector<float>& getDepth() const {
+        return mDepth;
+    }
+
+private:
+    static constexpr uint32_t MAX_POLYGON_EDGES = 4;
+
+    // convex screen space polygon, depth is a plane over the screen
+    struct Polygon {
+        // edge functions a * x + b * y + c, non negative when the pixel around the point is inside
+        glm::vec3 edges[MAX_POLYGON_EDGES];
+        // farthest depth inside the pixel around the point
+        glm::vec3 depthPlane;
+
+        // pixel bounds, inclusive
+        int minX;
+        int maxX;
+        int minY;
+        int maxY;
+    };
+
+    // false when the quad isn't two triangles sharing an edge, or isn't flat and convex
+    bool addQuad(const glm::vec4* clip, const uint32_t* indices, const glm::vec3* positions, const glm::mat4& matrix);
+    // false when the polygon was rejected as a whole, without being rasterized
+    bool addPolygon(const glm::vec4* clip, uint32_t vertexCount);
+
+    void rasterizeBand(uint32_t band, Path path);
+    void updateTiles(uint32_t band);
+
+    glm::mat4 mViewProjection{1.f};
+
+    std::vector<Polygon> mPolygons;
+
+    std::vector<float> mDepth = std::vector<float>(WIDTH * HEIGHT, 0.f);
+    // farthest and closest depth per tile
+    std::vector<float> mTileMin = std::vector<float>(TILES_X * TILES_Y, 0.f);
+    std::vector<float> mTileMax = std::vector<float>(TILES_X * TILES_Y, 0.f);
+};
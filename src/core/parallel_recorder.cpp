@@ -0,0 +1,101 @@
+#include "parallel_recorder.h"
+
+#include "vk_engine.h"
+#include "vk_initializers.h"
+
+#include <chrono>
+
+ParallelRecorder::ParallelRecorder(VulkanEngine& vkEngine, uint32_t frameCount, uint32_t workerCount) : mVkEngine(vkEngine), mThreadPool(workerCount) {
+    VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(mVkEngine.getGraphicsQueueFamily());
+
+    mPools.resize(frameCount);
+
+    for (auto& framePools : mPools) {
+        framePools.resize(mThreadPool.getWorkerCount());
+
+        for (auto& workerPool : framePools) {
+            VK_CHECK(vkCreateCommandPool(mVkEngine.getDevice(), &poolInfo, nullptr, &workerPool.pool));
+        }
+    }
+
+    mWorkerRecordTimes.resize(mThreadPool.getWorkerCount(), 0.f);
+}
+
+ParallelRecorder::~ParallelRecorder() {
+    // destroying a pool frees its command buffers
+    for (auto& framePools : mPools) {
+        for (auto& workerPool : framePools) {
+            vkDestroyCommandPool(mVkEngine.getDevice(), workerPool.pool, nullptr);
+        }
+    }
+}
+
+void ParallelRecorder::beginFrame(uint32_t frameIndex) {
+    mFrameIndex = frameIndex;
+
+    for (auto& workerPool : mPools[frameIndex]) {
+        if (workerPool.usedCount == 0) {
+            continue;
+        }
+
+        VK_CHECK(vkResetCommandPool(mVkEngine.getDevice(), workerPool.pool, 0));
+        workerPool.usedCount = 0;
+    }
+}
+
+VkCommandBuffer ParallelRecorder::acquireBuffer(WorkerPool& workerPool) {
+    // buffers are kept after a pool reset, allocate only when running out
+    if (workerPool.usedCount == workerPool.buffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(workerPool.pool);
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+        VkCommandBuffer commandBuffer;
+        VK_CHECK(vkAllocateCommandBuffers(mVkEngine.getDevice(), &allocInfo, &commandBuffer));
+
+        workerPool.buffers.push_back(commandBuffer);
+    }
+
+    return workerPool.buffers[workerPool.usedCount++];
+}
+
+const std::vector<VkCommandBuffer>& ParallelRecorder::record(
+    uint32_t taskCount,
+    const VkCommandBufferInheritanceRenderingInfo& renderingInfo,
+    VkQueryPipelineStatisticFlags pipelineStatistics,
+    const std::function<void(VkCommandBuffer commandBuffer, uint32_t taskIndex, uint32_t workerIndex)>& function
+) {
+    mRecordedBuffers.assign(taskCount, VK_NULL_HANDLE);
+    std::fill(mWorkerRecordTimes.begin(), mWorkerRecordTimes.end(), 0.f);
+
+    std::vector<WorkerPool>& framePools = mPools[mFrameIndex];
+
+    mThreadPool.parallelFor(taskCount, [&](uint32_t taskIndex, uint32_t workerIndex) {
+        auto start = std::chrono::system_clock::now();
+
+        VkCommandBuffer commandBuffer = acquireBuffer(framePools[workerIndex]);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.pNext = &renderingInfo;
+        inheritanceInfo.pipelineStatistics = pipelineStatistics;
+
+        VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT
+        );
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+        function(commandBuffer, taskIndex, workerIndex);
+
+        VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+        mRecordedBuffers[taskIndex] = commandBuffer;
+
+        // only this worker writes its entry
+        auto end = std::chrono::system_clock::now();
+        mWorkerRecordTimes[workerIndex] += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.f;
+    });
+
+    return mRecordedBuffers;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "vk_types.h"
+#include "volk.h"
+#include "thread_pool.h"
+
+#include <functional>
+
+// forward reference
+class VulkanEngine;
+
+// records secondary command buffers for a dynamic rendering pass on worker threads,
+// every worker owns one command pool per frame in flight so no pool is shared between threads
+class ParallelRecorder {
+public:
+    ParallelRecorder(VulkanEngine& vkEngine, uint32_t frameCount, uint32_t workerCount = 0);
+    ~ParallelRecorder();
+
+    uint32_t getWorkerCount() const {
+        return mThreadPool.getWorkerCount();
+    }
+
+    // resets the command pools of the frame, the frame must have finished on the gpu
+    void beginFrame(uint32_t frameIndex);
+
+    // records taskCount secondary command buffers in parallel, buffers are returned in task order
+    // and can be executed inside a rendering pass begun with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+    // pipelineStatistics must cover the statistics queries active when they are executed
+    const std::vector<VkCommandBuffer>& record(
+        uint32_t taskCount,
+        const VkCommandBufferInheritanceRenderingInfo& renderingInfo,
+        VkQueryPipelineStatisticFlags pipelineStatistics,
+        const std::function<void(VkCommandBuffer commandBuffer, uint32_t taskIndex, uint32_t workerIndex)>& function
+    );
+
+    // time in ms each worker spent recording during the last record call
+    const std::vector<float>& getWorkerRecordTimes() const {
+        return mWorkerRecordTimes;
+    }
+
+    ThreadPool& getThreadPool() {
+        return mThreadPool;
+    }
+
+private:
+    struct WorkerPool {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> buffers;
+        uint32_t usedCount = 0;
+    };
+
+    VkCommandBuffer acquireBuffer(WorkerPool& workerPool);
+
+    VulkanEngine& mVkEngine;
+
+    ThreadPool mThreadPool;
+
+    // indexed by frame, then worker
+    std::vector<std::vector<WorkerPool>> mPools;
+    uint32_t mFrameIndex = 0;
+
+    std::vector<VkCommandBuffer> mRecordedBuffers;
+    std::vector<float> mWorkerRecordTimes;
+};
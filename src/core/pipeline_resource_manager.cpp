@@ -5,6 +5,9 @@
 #include "vk_types.h"
 #include "volk.h"
 #include "vk_engine.h"
+#include "vk_initializers.h"
+
+#include <algorithm>
 
 PipelineResourceManager::PipelineResourceManager(VulkanEngine& vkEngine) : mVkEngine(vkEngine) {
     init(mVkEngine.getDevice(), mVkEngine.getDrawImageFormat(), mVkEngine.getDepthImageFormat());
@@ -82,6 +85,136 @@ void PipelineResourceManager::createDescriptorSetLayouts(VkDevice device) {
 
         mDescriptorSetLayouts[DescriptorSetLayoutType::SKYBOX] = info;
     }
+
+    {
+        DescriptorLayoutBuilder layoutBuilder{};
+        DescriptorSetLayoutInfo info{};
+
+        // texture slots of materials that were never written are left empty
+        VkDescriptorBindingFlags bindingFlags[] = {
+            0,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+        };
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = 2;
+        bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+        info.layout = layoutBuilder
+                        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+                        .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, MAX_BINDLESS_TEXTURES)
+                        .build(device, &bindingFlagsInfo, VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+        vkGetDescriptorSetLayoutSizeEXT(device, info.layout, &info.size);
+        info.alignedSize = alignedSize(info.size, mDescriptorBufferProperties.descriptorBufferOffsetAlignment);
+        info.bindingOffsets.resize(2);
+
+        for (int i = 0; i < 2; i++) {
+            vkGetDescriptorSetLayoutBindingOffsetEXT(device, info.layout, i, &info.bindingOffsets[i]);
+        }
+
+        mDescriptorSetLayouts[DescriptorSetLayoutType::BINDLESS] = info;
+    }
+}
+
+void PipelineResourceManager::createBindlessResources(VkDevice device) {
+    auto descriptorSetInfo = mDescriptorSetLayouts[DescriptorSetLayoutType::BINDLESS];
+
+    mBindlessMaterialBuffer = mVkEngine.createBuffer(
+        sizeof(GPUMaterial) * MAX_BINDLESS_MATERIALS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+
+    // the bindless set is allocated once and shared by every material
+    mBindlessDescriptor = mDescriptorAllocator->allocate(descriptorSetInfo.alignedSize);
+
+    // create material buffer descriptor
+    VkDescriptorAddressInfoEXT addressInfo{};
+    addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+    addressInfo.address = mBindlessMaterialBuffer.deviceAddress;
+    addressInfo.range = sizeof(GPUMaterial) * MAX_BINDLESS_MATERIALS;
+    addressInfo.format = VK_FORMAT_UNDEFINED;
+
+    VkDescriptorGetInfoEXT descriptorInfo{};
+    descriptorInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+    descriptorInfo.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorInfo.data.pStorageBuffer = &addressInfo;
+
+    vkGetDescriptorEXT(
+        device,
+        &descriptorInfo,
+        mDescriptorBufferProperties.storageBufferDescriptorSize,
+        mDescriptorAllocator->getData(mBindlessDescriptor) + descriptorSetInfo.bindingOffsets[0]
+    );
+}
+
+void PipelineResourceManager::writeBindlessTexture(uint32_t slot, VkImageView imageView, VkSampler sampler) {
+    auto& descriptorSetInfo = mDescriptorSetLayouts[DescriptorSetLayoutType::BINDLESS];
+
+    VkDescriptorImageInfo imageDescriptor{};
+    imageDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageDescriptor.imageView = imageView;
+    imageDescriptor.sampler = sampler;
+
+    VkDescriptorGetInfoEXT imageDescriptorInfo{};
+    imageDescriptorInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+    imageDescriptorInfo.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    imageDescriptorInfo.data.pCombinedImageSampler = &imageDescriptor;
+
+    // array elements are tightly packed after the binding offset
+    VkDeviceSize offset = descriptorSetInfo.bindingOffsets[1] + slot * mDescriptorBufferProperties.combinedImageSamplerDescriptorSize;
+
+    vkGetDescriptorEXT(
+        mVkEngine.getDevice(),
+        &imageDescriptorInfo,
+        mDescriptorBufferProperties.combinedImageSamplerDescriptorSize,
+        mDescriptorAllocator->getData(mBindlessDescriptor) + offset
+    );
+}
+
+uint32_t PipelineResourceManager::writeBindlessMaterial(const MaterialResources& resources, const MaterialConstants& constants) {
+    uint32_t materialIndex;
+
+    {
+        std::scoped_lock lock(mBindlessMutex);
+
+        if (!mFreeBindlessMaterials.empty()) {
+            materialIndex = mFreeBindlessMaterials.back();
+            mFreeBindlessMaterials.pop_back();
+        } else if (mNextBindlessMaterial < MAX_BINDLESS_MATERIALS) {
+            materialIndex = mNextBindlessMaterial++;
+        } else {
+            // every material owns its slot until it is freed, a shared fallback would be freed twice
+            fmt::println("bindless material limit of {} reached", MAX_BINDLESS_MATERIALS);
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint32_t firstSlot = materialIndex * TEXTURES_PER_MATERIAL;
+
+    writeBindlessTexture(firstSlot + 0, resources.colorImage.imageView, resources.colorSampler);
+    writeBindlessTexture(firstSlot + 1, resources.metalRoughImage.imageView, resources.metalRoughSampler);
+    writeBindlessTexture(firstSlot + 2, resources.normalImage.imageView, resources.normalSampler);
+    writeBindlessTexture(firstSlot + 3, resources.emissiveImage.imageView, resources.emissiveSampler);
+    writeBindlessTexture(firstSlot + 4, resources.occlusionImage.imageView, resources.occlusionSampler);
+
+    GPUMaterial material{};
+    material.colorFactors = constants.colorFactors;
+    material.metalRoughFactors = constants.metalRoughFactors;
+    material.emissiveFactors = constants.emissiveFactors;
+    material.emissiveStrength = constants.emissiveStrength;
+    material.normalScale = constants.normalScale;
+    material.occlusionStrength = constants.occlusionStrength;
+    material.colorTexture = firstSlot + 0;
+    material.metalRoughTexture = firstSlot + 1;
+    material.normalTexture = firstSlot + 2;
+    material.emissiveTexture = firstSlot + 3;
+    material.occlusionTexture = firstSlot + 4;
+
+    ((GPUMaterial*)mBindlessMaterialBuffer.allocInfo.pMappedData)[materialIndex] = material;
+
+    return materialIndex;
 }
 
 void PipelineResourceManager::buildPBRPipelines(VkDevice device, VkFormat colorFormat, VkFormat depthFormat) {
@@ -143,6 +276,67 @@ void PipelineResourceManager::buildPBRPipelines(VkDevice device, VkFormat colorF
     vkDestroyShaderModule(device, fragShader, nullptr);
 }
 
+void PipelineResourceManager::buildBindlessPBRPipelines(VkDevice device, VkFormat colorFormat, VkFormat depthFormat) {
+    // load shaders
+    VkShaderModule fragShader;
+
+    if (!vkutil::loadShaderModule("shaders/mesh_pbr_bindless.frag.spv", device, &fragShader)) {
+        fmt::println("error while building mesh_pbr_bindless.frag shader");
+    }
+
+    VkShaderModule vertShader;
+
+    if (!vkutil::loadShaderModule("shaders/mesh_pbr.vert.spv", device, &vertShader)) {
+        fmt::println("error while building mesh.vert shader");
+    }
+
+    // the fragment shader reads the material index
+    std::vector<VkPushConstantRange> pushConstants(1);
+    pushConstants[0].offset = 0;
+    pushConstants[0].size = sizeof(PBRBindlessPushConstants);
+    pushConstants[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayout layouts[] = {
+        mDescriptorSetLayouts[DescriptorSetLayoutType::PBR_SCENE_DATA].layout,
+        mDescriptorSetLayouts[DescriptorSetLayoutType::BINDLESS].layout
+    };
+
+    VkPipelineLayout newLayout = vkutil::createPipelineLayout(layouts, pushConstants, device);
+
+    mPipelines[PipelineType::PBR_OPAQUE_BINDLESS].layout = newLayout;
+    mPipelines[PipelineType::PBR_TRANSPARENT_BINDLESS].layout = newLayout;
+    mPipelines[PipelineType::PBR_OPAQUE_DOUBLE_SIDED_BINDLESS].layout = newLayout;
+    mPipelines[PipelineType::PBR_TRANSPARENT_DOUBLE_SIDED_BINDLESS].layout = newLayout;
+
+    // same states as the regular pbr pipelines
+    PipelineBuilder pipelineBuilder;
+
+    mPipelines[PipelineType::PBR_OPAQUE_DOUBLE_SIDED_BINDLESS].pipeline = pipelineBuilder.clear().setShaders(vertShader, fragShader)
+                                              .setInputTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+                                              .setPolygonMode(VK_POLYGON_MODE_FILL)
+                                              .setCullMode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+                                              .setMultisampling()
+                                              .disableBlending()
+                                              .enableDepthTesting(true, VK_COMPARE_OP_GREATER)
+                                              .setColorAttachmentFormat(colorFormat)
+                                              .setDepthFormat(depthFormat)
+                                              .setLayout(newLayout)
+                                              .buildPipeline(device, VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+    mPipelines[PipelineType::PBR_OPAQUE_BINDLESS].pipeline = pipelineBuilder.setCullMode(VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+                                              .buildPipeline(device, VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+    mPipelines[PipelineType::PBR_TRANSPARENT_BINDLESS].pipeline = pipelineBuilder.enableBlendingAdditive()
+                                                   .enableDepthTesting(false, VK_COMPARE_OP_GREATER)
+                                                   .buildPipeline(device, VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+    mPipelines[PipelineType::PBR_TRANSPARENT_DOUBLE_SIDED_BINDLESS].pipeline = pipelineBuilder.setCullMode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+                                                         .buildPipeline(device, VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+    vkDestroyShaderModule(device, vertShader, nullptr);
+    vkDestroyShaderModule(device, fragShader, nullptr);
+}
+
 void PipelineResourceManager::buildPhongPipeline(VkDevice device, VkFormat colorFormat, VkFormat depthFormat) {
 
 }
@@ -196,13 +390,17 @@ void PipelineResourceManager::createDescriptorBuffers(VkDevice device) {
     // get descriptor buffer properties
     mDescriptorBufferProperties = mVkEngine.getDescriptorBufferProperties();
 
-    static constexpr size_t bufferSize = 256 * 1e5;
-
-    // create descriptor buffer
-    mDescriptorBuffer = mVkEngine.createBuffer(
-        bufferSize,
-        VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-        VMA_MEMORY_USAGE_CPU_TO_GPU
+    // every block holds both resource and sampler descriptors, so it counts against both binding limits
+    uint32_t maxBlockCount = std::min({
+        mDescriptorBufferProperties.maxDescriptorBufferBindings,
+        mDescriptorBufferProperties.maxResourceDescriptorBufferBindings,
+        mDescriptorBufferProperties.maxSamplerDescriptorBufferBindings
+    });
+
+    mDescriptorAllocator = std::make_unique<DescriptorBufferAllocator>(
+        mVkEngine,
+        mDescriptorBufferProperties.descriptorBufferOffsetAlignment,
+        maxBlockCount
     );
 }
 
@@ -288,24 +486,114 @@ void PipelineResourceManager::buildSkyboxPipelines(VkDevice device, VkFormat col
     vkDestroyShaderModule(device, fragShader, nullptr);
 }
 
+void PipelineResourceManager::buildGPUDrivenPipelines(VkDevice device, VkFormat colorFormat, VkFormat depthFormat) {
+    // indirect pbr pipeline, object data is fetched from a storage buffer
+    VkShaderModule fragShader;
+
+    if (!vkutil::loadShaderModule("shaders/mesh_pbr.frag.spv", device, &fragShader)) {
+        fmt::println("error while building mesh_pbr.frag shader");
+    }
+
+    VkShaderModule vertShader;
+
+    if (!vkutil::loadShaderModule("shaders/mesh_pbr_indirect.vert.spv", device, &vertShader)) {
+        fmt::println("error while building mesh_pbr_indirect.vert shader");
+    }
+
+    std::vector<VkPushConstantRange> pushConstants(1);
+    pushConstants[0].offset = 0;
+    pushConstants[0].size = sizeof(PBRIndirectPushConstants);
+    pushConstants[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayout layouts[] = {
+        mDescriptorSetLayouts[DescriptorSetLayoutType::PBR_SCENE_DATA].layout,
+        mDescriptorSetLayouts[DescriptorSetLayoutType::PBR].layout
+    };
+
+    mPipelines[PipelineType::PBR_OPAQUE_INDIRECT].layout = vkutil::createPipelineLayout(layouts, pushConstants, device);
+
+    // same state as the regular opaque pipeline
+    PipelineBuilder pipelineBuilder;
+
+    mPipelines[PipelineType::PBR_OPAQUE_INDIRECT].pipeline = pipelineBuilder.clear().setShaders(vertShader, fragShader)
+                                              .setInputTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+                                              .setPolygonMode(VK_POLYGON_MODE_FILL)
+                                              .setCullMode(VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+                                              .setMultisampling()
+                                              .disableBlending()
+                                              .enableDepthTesting(true, VK_COMPARE_OP_GREATER)
+                                              .setColorAttachmentFormat(colorFormat)
+                                              .setDepthFormat(depthFormat)
+                                              .setLayout(mPipelines[PipelineType::PBR_OPAQUE_INDIRECT].layout)
+                                              .buildPipeline(device, VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+
+    vkDestroyShaderModule(device, vertShader, nullptr);
+    vkDestroyShaderModule(device, fragShader, nullptr);
+
+    // culling compute pipeline, all buffers are accessed through device addresses
+    pushConstants[0].size = sizeof(GPUCullPushConstants);
+    pushConstants[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    mPipelines[PipelineType::GPU_CULL].layout = vkutil::createPipelineLayout({}, pushConstants, device);
+
+    VkShaderModule computeShader;
+
+    if (!vkutil::loadShaderModule("shaders/cull.comp.spv", device, &computeShader)) {
+        fmt::println("error while building cull.comp shader");
+    }
+
+    VkComputePipelineCreateInfo createInfo = vkinit::computePipelineCreateInfo(computeShader, mPipelines[PipelineType::GPU_CULL].layout);
+
+    VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &mPipelines[PipelineType::GPU_CULL].pipeline));
+
+    vkDestroyShaderModule(device, computeShader, nullptr);
+
+    // cluster culling pipeline, reads its inputs from a buffer
+    pushConstants[0].size = sizeof(GPUClusterCullPushConstants);
+
+    mPipelines[PipelineType::GPU_CLUSTER_CULL].layout = vkutil::createPipelineLayout({}, pushConstants, device);
+
+    if (!vkutil::loadShaderModule("shaders/cluster_cull.comp.spv", device, &computeShader)) {
+        fmt::println("error while building cluster_cull.comp shader");
+    }
+
+    createInfo = vkinit::computePipelineCreateInfo(computeShader, mPipelines[PipelineType::GPU_CLUSTER_CULL].layout);
+
+    VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &mPipelines[PipelineType::GPU_CLUSTER_CULL].pipeline));
+
+    vkDestroyShaderModule(device, computeShader, nullptr);
+}
+
 void PipelineResourceManager::bindDescriptorBuffers(VkCommandBuffer commandBuffer) {
-    VkDescriptorBufferBindingInfoEXT bindingInfo;
+    mDescriptorAllocator->bind(commandBuffer);
+}
 
-    bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
-    bindingInfo.address = mDescriptorBuffer.deviceAddress;
-    bindingInfo.usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
-    bindingInfo.pNext = nullptr;
+void PipelineResourceManager::freeDescriptor(const DescriptorAllocation& allocation) {
+    mDescriptorAllocator->free(allocation);
+}
+
+void PipelineResourceManager::freeMaterial(const MaterialInstance& materialInstance) {
+    mDescriptorAllocator->free(materialInstance.descriptor);
 
-    vkCmdBindDescriptorBuffersEXT(commandBuffer, 1, &bindingInfo);
+    std::scoped_lock lock(mBindlessMutex);
+    mFreeBindlessMaterials.push_back(materialInstance.materialIndex);
 }
 
 void PipelineResourceManager::init(VkDevice device, VkFormat colorFormat, VkFormat depthFormat) {
     createDescriptorBuffers(device);
     createDescriptorSetLayouts(device);
+    createBindlessResources(device);
 
     buildPBRPipelines(device, colorFormat, depthFormat);
+    buildBindlessPBRPipelines(device, colorFormat, depthFormat);
     buildSpritePipeline(device, colorFormat, depthFormat);
     buildSkyboxPipelines(device, colorFormat, depthFormat);
+    buildGPUDrivenPipelines(device, colorFormat, depthFormat);
+
+    // pipeline types double as sort ids
+    for (auto& [type, pipeline] : mPipelines) {
+        pipeline.id = (uint32_t)type;
+    }
 }
 
 void PipelineResourceManager::freeResources() {
@@ -317,37 +605,50 @@ void PipelineResourceManager::freeResources() {
 
     // some of these might be shared, so manual deletion is necessary
     vkDestroyPipelineLayout(device, mPipelines[PipelineType::PBR_OPAQUE].layout, nullptr);
+    vkDestroyPipelineLayout(device, mPipelines[PipelineType::PBR_OPAQUE_BINDLESS].layout, nullptr);
     vkDestroyPipelineLayout(device, mPipelines[PipelineType::SPRITE].layout, nullptr);
     vkDestroyPipelineLayout(device, mPipelines[PipelineType::SKYBOX].layout, nullptr);
     vkDestroyPipelineLayout(device, mPipelines[PipelineType::EQUI_TO_CUBE].layout, nullptr);
+    vkDestroyPipelineLayout(device, mPipelines[PipelineType::PBR_OPAQUE_INDIRECT].layout, nullptr);
+    vkDestroyPipelineLayout(device, mPipelines[PipelineType::GPU_CULL].layout, nullptr);
+    vkDestroyPipelineLayout(device, mPipelines[PipelineType::GPU_CLUSTER_CULL].layout, nullptr);
 
     for (auto& [k, v] : mPipelines) {
         vkDestroyPipeline(device, v.pipeline, nullptr);
     }
 
-    mVkEngine.destroyBuffer(mDescriptorBuffer);
+    mVkEngine.destroyBuffer(mBindlessMaterialBuffer);
+
+    mDescriptorAllocator = nullptr;
 }
 
-MaterialInstance PipelineResourceManager::writeMaterial(VkDevice device, MaterialPass pass, const MaterialResources& resources) {
+MaterialInstance PipelineResourceManager::writeMaterial(VkDevice device, MaterialPass pass, const MaterialResources& resources, const MaterialConstants& constants) {
     MaterialInstance materialInstance;
     materialInstance.passType = pass;
+    materialInstance.id = mNextMaterialId++;
 
     if (pass == MaterialPass::Transparent) {
         materialInstance.pipeline = &mPipelines[PipelineType::PBR_TRANSPARENT];
+        materialInstance.bindlessPipeline = &mPipelines[PipelineType::PBR_TRANSPARENT_BINDLESS];
     } else if (pass == MaterialPass::Opaque) {
         materialInstance.pipeline = &mPipelines[PipelineType::PBR_OPAQUE];
+        materialInstance.bindlessPipeline = &mPipelines[PipelineType::PBR_OPAQUE_BINDLESS];
     } else if (pass == MaterialPass::TransparentDoubleSided) {
         materialInstance.pipeline = &mPipelines[PipelineType::PBR_TRANSPARENT_DOUBLE_SIDED];
+        materialInstance.bindlessPipeline = &mPipelines[PipelineType::PBR_TRANSPARENT_DOUBLE_SIDED_BINDLESS];
     } else if (pass == MaterialPass::OpaqueDoubleSided) {
         materialInstance.pipeline = &mPipelines[PipelineType::PBR_OPAQUE_DOUBLE_SIDED];
+        materialInstance.bindlessPipeline = &mPipelines[PipelineType::PBR_OPAQUE_DOUBLE_SIDED_BINDLESS];
     }
 
-    materialInstance.descriptorOffset = createMaterialDescriptor(resources);
+    // both paths are written so bindless mode can be toggled at runtime
+    materialInstance.descriptor = createMaterialDescriptor(resources);
+    materialInstance.materialIndex = writeBindlessMaterial(resources, constants);
 
     return materialInstance;
 }
 
-VkDeviceSize PipelineResourceManager::createSceneDescriptor(
+DescriptorAllocation PipelineResourceManager::createSceneDescriptor(
     VkDeviceAddress bufferAddress,
     VkDeviceSize size,
     VkImageView irradianceMapView,
@@ -357,6 +658,14 @@ VkDeviceSize PipelineResourceManager::createSceneDescriptor(
 ) {
     auto descriptorSetInfo = mDescriptorSetLayouts[DescriptorSetLayoutType::PBR_SCENE_DATA];
 
+    DescriptorAllocation allocation = mDescriptorAllocator->allocate(descriptorSetInfo.alignedSize);
+
+    if (allocation.size == 0) {
+        return allocation;
+    }
+
+    char* descriptorData = mDescriptorAllocator->getData(allocation);
+
     // create scene data buffer descriptor
     VkDescriptorAddressInfoEXT addressInfo{};
     addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
@@ -373,7 +682,7 @@ VkDeviceSize PipelineResourceManager::createSceneDescriptor(
         mVkEngine.getDevice(),
         &descriptorInfo,
         mDescriptorBufferProperties.uniformBufferDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[0]
+        descriptorData + descriptorSetInfo.bindingOffsets[0]
     );
 
     // create irradiance map descriptor
@@ -392,7 +701,7 @@ VkDeviceSize PipelineResourceManager::createSceneDescriptor(
         mVkEngine.getDevice(),
         &imageDescriptorInfo,
         mDescriptorBufferProperties.combinedImageSamplerDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[1]
+        descriptorData + descriptorSetInfo.bindingOffsets[1]
     );
 
     // create prefiltered env map descriptor
@@ -411,7 +720,7 @@ VkDeviceSize PipelineResourceManager::createSceneDescriptor(
         mVkEngine.getDevice(),
         &prefilteredDescriptorInfo,
         mDescriptorBufferProperties.combinedImageSamplerDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[2]
+        descriptorData + descriptorSetInfo.bindingOffsets[2]
     );
 
     // create brdf lut descriptor
@@ -430,18 +739,23 @@ VkDeviceSize PipelineResourceManager::createSceneDescriptor(
         mVkEngine.getDevice(),
         &brdflutDescriptorInfo,
         mDescriptorBufferProperties.combinedImageSamplerDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[3]
+        descriptorData + descriptorSetInfo.bindingOffsets[3]
     );
 
-    VkDeviceSize retOffset = mCurrentOffset;
-    mCurrentOffset += descriptorSetInfo.alignedSize;
-
-    return retOffset;
+    return allocation;
 }
 
-VkDeviceSize PipelineResourceManager::createMaterialDescriptor(const MaterialResources& resources) {
+DescriptorAllocation PipelineResourceManager::createMaterialDescriptor(const MaterialResources& resources) {
     auto descriptorSetInfo = mDescriptorSetLayouts[DescriptorSetLayoutType::PBR];
 
+    DescriptorAllocation allocation = mDescriptorAllocator->allocate(descriptorSetInfo.alignedSize);
+
+    if (allocation.size == 0) {
+        return allocation;
+    }
+
+    char* descriptorData = mDescriptorAllocator->getData(allocation);
+
     // create material constants descriptor
     VkDescriptorAddressInfoEXT addressInfo{};
     addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
@@ -458,7 +772,7 @@ VkDeviceSize PipelineResourceManager::createMaterialDescriptor(const MaterialRes
         mVkEngine.getDevice(),
         &descriptorInfo,
         mDescriptorBufferProperties.uniformBufferDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[0]
+        descriptorData + descriptorSetInfo.bindingOffsets[0]
     );
 
     // create color texture descriptor
@@ -477,7 +791,7 @@ VkDeviceSize PipelineResourceManager::createMaterialDescriptor(const MaterialRes
         mVkEngine.getDevice(),
         &imageDescriptorInfo,
         mDescriptorBufferProperties.combinedImageSamplerDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[1]
+        descriptorData + descriptorSetInfo.bindingOffsets[1]
     );
 
     // create metal rough texture descriptor
@@ -496,7 +810,7 @@ VkDeviceSize PipelineResourceManager::createMaterialDescriptor(const MaterialRes
         mVkEngine.getDevice(),
         &metalDescriptorInfo,
         mDescriptorBufferProperties.combinedImageSamplerDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[2]
+        descriptorData + descriptorSetInfo.bindingOffsets[2]
     );
 
     // create normal texture descriptor
@@ -515,7 +829,7 @@ VkDeviceSize PipelineResourceManager::createMaterialDescriptor(const MaterialRes
         mVkEngine.getDevice(),
         &normalDescriptorInfo,
         mDescriptorBufferProperties.combinedImageSamplerDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[3]
+        descriptorData + descriptorSetInfo.bindingOffsets[3]
     );
 
     // create emissive texture descriptor
@@ -533,7 +847,7 @@ VkDeviceSize PipelineResourceManager::createMaterialDescriptor(const MaterialRes
         mVkEngine.getDevice(),
         &emissiveDescriptorInfo,
         mDescriptorBufferProperties.combinedImageSamplerDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[4]
+        descriptorData + descriptorSetInfo.bindingOffsets[4]
     );
 
     // create occlusion texture descriptor
@@ -552,11 +866,8 @@ VkDeviceSize PipelineResourceManager::createMaterialDescriptor(const MaterialRes
         mVkEngine.getDevice(),
         &occlusionDescriptorInfo,
         mDescriptorBufferProperties.combinedImageSamplerDescriptorSize,
-        (char*)mDescriptorBuffer.allocInfo.pMappedData + mCurrentOffset + descriptorSetInfo.bindingOffsets[5]
+        descriptorData + descriptorSetInfo.bindingOffsets[5]
     );
 
-    VkDeviceSize retOffset = mCurrentOffset;
-    mCurrentOffset += descriptorSetInfo.alignedSize;
-
-    return retOffset;
+    return allocation;
 }
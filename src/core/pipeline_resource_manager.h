@@ -1,9 +1,12 @@
 #pragma once
 
+#include "descriptor_buffer_allocator.h"
 #include "vk_descriptors.h"
 #include "vk_types.h"
 #include "volk.h"
 
+#include <mutex>
+
 // forward reference
 class VulkanEngine;
 
@@ -14,6 +17,13 @@ public:
         PBR_TRANSPARENT,
         PBR_OPAQUE_DOUBLE_SIDED,
         PBR_TRANSPARENT_DOUBLE_SIDED,
+        PBR_OPAQUE_BINDLESS,
+        PBR_TRANSPARENT_BINDLESS,
+        PBR_OPAQUE_DOUBLE_SIDED_BINDLESS,
+        PBR_TRANSPARENT_DOUBLE_SIDED_BINDLESS,
+        PBR_OPAQUE_INDIRECT,
+        GPU_CULL,
+        GPU_CLUSTER_CULL,
         SPRITE,
         PHONG,
         SKYBOX,
@@ -27,9 +37,15 @@ public:
         PHONG,
         SPRITE,
         PBR_SCENE_DATA,
-        SKYBOX
+        SKYBOX,
+        BINDLESS
     };
 
+    // every material owns a fixed range of texture slots in the bindless array
+    static constexpr uint32_t MAX_BINDLESS_MATERIALS = 2048;
+    static constexpr uint32_t TEXTURES_PER_MATERIAL = 5;
+    static constexpr uint32_t MAX_BINDLESS_TEXTURES = MAX_BINDLESS_MATERIALS * TEXTURES_PER_MATERIAL;
+
     PipelineResourceManager(VulkanEngine& vkEngine);
     ~PipelineResourceManager();
 
@@ -42,9 +58,22 @@ public:
     }
 
     void bindDescriptorBuffers(VkCommandBuffer commandBuffer);
-    VkDeviceSize createMaterialDescriptor(const MaterialResources& resources);
-    VkDeviceSize createSceneDescriptor(VkDeviceAddress bufferAddress, VkDeviceSize size, VkImageView irradianceMapView, VkImageView prefilteredEnvMapView, VkImageView brdflutView, VkSampler sampler);
-    MaterialInstance writeMaterial(VkDevice device, MaterialPass pass, const MaterialResources& resources);
+    DescriptorAllocation createMaterialDescriptor(const MaterialResources& resources);
+    DescriptorAllocation createSceneDescriptor(VkDeviceAddress bufferAddress, VkDeviceSize size, VkImageView irradianceMapView, VkImageView prefilteredEnvMapView, VkImageView brdflutView, VkSampler sampler);
+    MaterialInstance writeMaterial(VkDevice device, MaterialPass pass, const MaterialResources& resources, const MaterialConstants& constants);
+
+    // the caller makes sure no frame in flight still uses the descriptors
+    void freeDescriptor(const DescriptorAllocation& allocation);
+    void freeMaterial(const MaterialInstance& materialInstance);
+
+    // set holding the material buffer and all material textures
+    const DescriptorAllocation& getBindlessDescriptor() const {
+        return mBindlessDescriptor;
+    }
+
+    DescriptorBufferAllocator::Stats getDescriptorStats() {
+        return mDescriptorAllocator->getStats();
+    }
 
 private:
     struct DescriptorSetLayoutInfo {
@@ -58,11 +87,16 @@ private:
 
     void createDescriptorBuffers(VkDevice device);
     void createDescriptorSetLayouts(VkDevice device);
+    void createBindlessResources(VkDevice device);
+    uint32_t writeBindlessMaterial(const MaterialResources& resources, const MaterialConstants& constants);
+    void writeBindlessTexture(uint32_t slot, VkImageView imageView, VkSampler sampler);
 
     void buildPBRPipelines(VkDevice device, VkFormat colorFormat, VkFormat depthFormat);
+    void buildBindlessPBRPipelines(VkDevice device, VkFormat colorFormat, VkFormat depthFormat);
     void buildPhongPipeline(VkDevice device, VkFormat colorFormat, VkFormat depthFormat);
     void buildSpritePipeline(VkDevice device, VkFormat colorFormat, VkFormat depthFormat);
     void buildSkyboxPipelines(VkDevice device, VkFormat colorFormat, VkFormat depthFormat);
+    void buildGPUDrivenPipelines(VkDevice device, VkFormat colorFormat, VkFormat depthFormat);
 
     void freeResources();
 
@@ -73,8 +107,18 @@ private:
     std::unordered_map<PipelineType, Pipeline> mPipelines;
     std::unordered_map<DescriptorSetLayoutType, DescriptorSetLayoutInfo> mDescriptorSetLayouts;
 
-    AllocatedBuffer mDescriptorBuffer;
-    VkDeviceSize mCurrentOffset = 0;
+    std::unique_ptr<DescriptorBufferAllocator> mDescriptorAllocator;
+
+    uint32_t mNextMaterialId = 0;
+
+    // bindless materials
+    AllocatedBuffer mBindlessMaterialBuffer;
+    DescriptorAllocation mBindlessDescriptor;
+
+    // materials are written from the scene loading thread
+    std::mutex mBindlessMutex;
+    uint32_t mNextBindlessMaterial = 0;
+    std::vector<uint32_t> mFreeBindlessMaterials;
 
     VkPhysicalDeviceDescriptorBufferPropertiesEXT mDescriptorBufferProperties;
 };
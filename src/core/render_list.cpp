@@ -0,0 +1,163 @@
+#include "render_list.h"
+
+#include "vk_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+RenderList::RenderList() {
+    mOpaque.version = nextVersion();
+    mTransparent.version = nextVersion();
+}
+
+uint64_t RenderList::nextVersion() {
+    static std::atomic<uint64_t> version = 1;
+
+    return version++;
+}
+
+void RenderList::addEntity(entt::entity entity, LoadedGLTF& gltf, const glm::mat4& transform) {
+    if (hasEntity(entity)) {
+        removeEntity(entity);
+    }
+
+    // gather surfaces relative to the entity
+    mGatherOpaque.clear();
+    mGatherTransparent.clear();
+
+    gltf.draw(glm::mat4(1.f), mGatherOpaque, mGatherTransparent);
+
+    EntityRecord& record = mEntities[entity];
+
+    for (auto& object : mGatherOpaque) {
+        addObject(mOpaque, record.opaqueSlots, entity, object, transform);
+    }
+
+    for (auto& object : mGatherTransparent) {
+        addObject(mTransparent, record.transparentSlots, entity, object, transform);
+    }
+
+    mOpaque.version = nextVersion();
+    mTransparent.version = nextVersion();
+}
+
+void RenderList::addObject(ObjectList& list, std::vector<uint32_t>& slots, entt::entity entity, const GLTFRenderObject& object, const glm::mat4& transform) {
+    uint32_t slot = list.objects.size();
+
+    list.objects.push_back(object);
+    list.objects.back().transform = transform * object.transform;
+    list.nodeTransforms.push_back(object.transform);
+    list.owners.push_back(SlotOwner{entity, (uint32_t)slots.size()});
+
+    slots.push_back(slot);
+}
+
+void RenderList::removeEntity(entt::entity entity) {
+    auto it = mEntities.find(entity);
+
+    if (it == mEntities.end()) {
+        return;
+    }
+
+    // remove slots from the back, swapped in slots always come from the end of the list
+    // so the remaining slot indices of this entity stay valid
+    std::vector<uint32_t> opaqueSlots = std::move(it->second.opaqueSlots);
+    std::vector<uint32_t> transparentSlots = std::move(it->second.transparentSlots);
+
+    std::sort(opaqueSlots.begin(), opaqueSlots.end(), std::greater<uint32_t>());
+    std::sort(transparentSlots.begin(), transparentSlots.end(), std::greater<uint32_t>());
+
+    for (auto slot : opaqueSlots) {
+        removeSlot(mOpaque, slot, true);
+    }
+
+    for (auto slot : transparentSlots) {
+        removeSlot(mTransparent, slot, false);
+    }
+
+    mEntities.erase(entity);
+
+    mOpaque.version = nextVersion();
+    mTransparent.version = nextVersion();
+}
+
+void RenderList::removeSlot(ObjectList& list, uint32_t slot, bool opaque) {
+    uint32_t last = list.objects.size() - 1;
+
+    // swap erase, move the last slot into the removed one and fix its owner
+    if (slot != last) {
+        list.objects[slot] = list.objects[last];
+        list.nodeTransforms[slot] = list.nodeTransforms[last];
+        list.owners[slot] = list.owners[last];
+
+        const SlotOwner& owner = list.owners[slot];
+        auto ownerRecord = mEntities.find(owner.entity);
+
+        if (ownerRecord != mEntities.end()) {
+            auto& slots = opaque ? ownerRecord->second.opaqueSlots : ownerRecord->second.transparentSlots;
+
+            // the removed entity's slot list was moved out, nothing to fix for it
+            if (owner.recordIndex < slots.size()) {
+                slots[owner.recordIndex] = slot;
+            }
+        }
+    }
+
+    list.objects.pop_back();
+    list.nodeTransforms.pop_back();
+    list.owners.pop_back();
+}
+
+void RenderList::updateTransform(entt::entity entity, const glm::mat4& transform) {
+    auto it = mEntities.find(entity);
+
+    if (it == mEntities.end()) {
+        return;
+    }
+
+    if (!it->second.opaqueSlots.empty()) {
+        updateSlots(mOpaque, it->second.opaqueSlots, transform);
+        mOpaque.version = nextVersion();
+    }
+
+    if (!it->second.transparentSlots.empty()) {
+        updateSlots(mTransparent, it->second.transparentSlots, transform);
+        mTransparent.version = nextVersion();
+    }
+}
+
+void RenderList::updateSlots(ObjectList& list, const std::vector<uint32_t>& slots, const glm::mat4& transform) {
+    for (auto slot : slots) {
+        list.objects[slot].transform = transform * list.nodeTransforms[slot];
+    }
+}
+
+bool RenderList::getEntityBounds(entt::entity entity, glm::vec3& outMin, glm::vec3& outMax) const {
+    auto it = mEntities.find(entity);
+
+    if (it == mEntities.end()) {
+        return false;
+    }
+
+    bool hasBounds = false;
+
+    auto addSlots = [&](const ObjectList& list, const std::vector<uint32_t>& slots) {
+        for (auto slot : slots) {
+            const GLTFRenderObject& object = list.objects[slot];
+            glm::mat3 matrix(object.transform);
+
+            glm::vec3 center = object.transform * glm::vec4(object.bounds.origin, 1.f);
+            glm::vec3 extents = glm::abs(matrix[0]) * object.bounds.extents.x + glm::abs(matrix[1]) * object.bounds.extents.y + glm::abs(matrix[2]) * object.bounds.extents.z;
+
+            outMin = hasBounds ? glm::min(outMin, center - extents) : center - extents;
+            outMax = hasBounds ? glm::max(outMax, center + extents) : center + extents;
+            hasBounds = true;
+        }
+    };
+
+    addSlots(mOpaque, it->second.opaqueSlots);
+    addSlots(mTransparent, it->second.transparentSlots);
+
+    return hasBounds;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "vk_types.h"
+#include "entt.hpp"
+
+#include <unordered_map>
+
+class LoadedGLTF;
+
+// retained list of gltf surfaces, entities register their surfaces once and
+// only entities whose transform changed update their slots
+class RenderList {
+public:
+    RenderList();
+
+    void addEntity(entt::entity entity, LoadedGLTF& gltf, const glm::mat4& transform);
+    void removeEntity(entt::entity entity);
+    void updateTransform(entt::entity entity, const glm::mat4& transform);
+
+    bool hasEntity(entt::entity entity) const {
+        return mEntities.contains(entity);
+    }
+
+    // world space box around the entity's surfaces, false when it has none
+    bool getEntityBounds(entt::entity entity, glm::vec3& outMin, glm::vec3& outMax) const;
+
+    const std::vector<GLTFRenderObject>& getOpaqueObjects() const {
+        return mOpaque.objects;
+    }
+
+    const std::vector<GLTFRenderObject>& getTransparentObjects() const {
+        return mTransparent.objects;
+    }
+
+    // versions change whenever the matching list changes, unique across render lists
+    uint64_t getOpaqueVersion() const {
+        return mOpaque.version;
+    }
+
+    uint64_t getTransparentVersion() const {
+        return mTransparent.version;
+    }
+
+private:
+    struct SlotOwner {
+        entt::entity entity;
+        uint32_t recordIndex; // index in the entity's slot list
+    };
+
+    struct ObjectList {
+        std::vector<GLTFRenderObject> objects;
+        std::vector<glm::mat4> nodeTransforms; // surface transform relative to the entity
+        std::vector<SlotOwner> owners;
+
+        uint64_t version = 0;
+    };
+
+    struct EntityRecord {
+        std::vector<uint32_t> opaqueSlots;
+        std::vector<uint32_t> transparentSlots;
+    };
+
+    void addObject(ObjectList& list, std::vector<uint32_t>& slots, entt::entity entity, const GLTFRenderObject& object, const glm::mat4& transform);
+    void removeSlot(ObjectList& list, uint32_t slot, bool opaque);
+    void updateSlots(ObjectList& list, const std::vector<uint32_t>& slots, const glm::mat4& transform);
+
+    static uint64_t nextVersion();
+
+    ObjectList mOpaque;
+    ObjectList mTransparent;
+
+    std::unordered_map<entt::entity, EntityRecord> mEntities;
+
+    // scratch lists reused when gathering surfaces
+    std::vector<GLTFRenderObject> mGatherOpaque;
+    std::vector<GLTFRenderObject> mGatherTransparent;
+};
@@ -0,0 +1,63 @@
+#include "resolution_governor.h"
+
+#include "compute_effects_manager.h"
+
+#include <algorithm>
+#include <cmath>
+
+float ResolutionGovernor::update(float frameTime, float renderScale, const Settings& settings, ComputeEffectsManager& effects) {
+    renderScale = std::clamp(renderScale, settings.minScale, settings.maxScale);
+
+    if (frameTime <= 0.f) {
+        return renderScale;
+    }
+
+    // drop the samples in flight during a change and start averaging again after it
+    if (mCooldown > 0) {
+        mCooldown--;
+        mFilteredFrameTime = 0.f;
+
+        return renderScale;
+    }
+
+    mFilteredFrameTime = mFilteredFrameTime == 0.f ? frameTime : std::lerp(mFilteredFrameTime, frameTime, SMOOTHING);
+
+    float target = settings.targetFrameTime;
+    float lowerBound = target * (1.f - settings.hysteresis);
+
+    // aim for the middle of the band so the next measurement doesn't bounce out of it
+    float desiredTime = (target + lowerBound) * 0.5f;
+
+    // gpu time grows about linearly with the pixel count, so with the scale squared
+    float idealScale = renderScale * std::sqrt(desiredTime / mFilteredFrameTime);
+
+    if (mFilteredFrameTime > target) {
+        if (renderScale > settings.minScale) {
+            renderScale = std::max({idealScale, renderScale - settings.maxStep, settings.minScale});
+        } else if (!settings.stepDownEffects || !effects.stepDownEffect()) {
+            // nothing left to scale down
+            return renderScale;
+        }
+    } else if (mFilteredFrameTime < lowerBound) {
+        if (!effects.stepUpEffect()) {
+            if (renderScale >= settings.maxScale) {
+                return renderScale;
+            }
+
+            renderScale = std::min({idealScale, renderScale + settings.maxStep, settings.maxScale});
+        }
+    } else {
+        return renderScale;
+    }
+
+    mCooldown = settings.cooldownFrames;
+
+    return renderScale;
+}
+
+void ResolutionGovernor::reset(ComputeEffectsManager& effects) {
+    effects.restoreEffects();
+
+    mFilteredFrameTime = 0.f;
+    mCooldown = 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+class ComputeEffectsManager;
+
+// moves the render scale towards a target gpu frame time, once the scale reaches its minimum
+// compute effects are turned off by priority, recovery turns them back on before scaling up
+class ResolutionGovernor {
+public:
+    // frame times are smoothed so single slow frames don't trigger a change
+    static constexpr float SMOOTHING = 0.1f;
+
+    struct Settings {
+        // ms
+        float targetFrameTime = 1000.f / 60.f;
+        float minScale = 0.5f;
+        float maxScale = 1.f;
+        // nothing changes while the frame time is within this fraction below the target
+        float hysteresis = 0.15f;
+        // largest render scale change per adjustment
+        float maxStep = 0.1f;
+        // frames ignored after a change, results of frames recorded before it are still coming in
+        uint32_t cooldownFrames = 8;
+        bool stepDownEffects = true;
+    };
+
+    // returns the render scale for the next frame
+    float update(float frameTime, float renderScale, const Settings& settings, ComputeEffectsManager& effects);
+    // turns every stepped down effect back on
+    void reset(ComputeEffectsManager& effects);
+
+    float getFilteredFrameTime() const {
+        return mFilteredFrameTime;
+    }
+
+private:
+    float mFilteredFrameTime = 0.f;
+    uint32_t mCooldown = 0;
+};
@@ -1,6 +1,8 @@
 #include "script_manager.h"
 #include "components/components.h"
 #include "entity.h"
+#include "cpu_profiler.h"
+#include "vk_scene.h"
 #include "sol/sol.hpp"
 #include <GLFW/glfw3.h>
 #include <fmt/core.h>
@@ -93,21 +95,20 @@ void ScriptManager::initializeLuaState() {
 
     mLua.new_usertype<Transform>(
         "Transform", sol::constructors<Transform(), Transform(const Transform&)>(),
-        "position", &Transform::position,
-        "rotation", &Transform::rotation,
+        // the getters hand out references so transform.position.x = ... edits the transform in place,
+        // the transform is compared after the script call and marked dirty only if lua wrote through the reference
+        "position", sol::property([this](Transform& self) -> glm::vec3& { trackTransform(self); return self.position; }, &Transform::setPosition),
+        "rotation", sol::property([this](Transform& self) -> glm::quat& { trackTransform(self); return self.rotation; }, &Transform::setRotation),
+        "scale", sol::property([this](Transform& self) -> glm::vec3& { trackTransform(self); return self.scale; }, &Transform::setScale),
         "forward", &Transform::forward,
         "right", &Transform::right,
         "Translate", &Transform::translate,
         "Rotate", &Transform::rotate,
-        "SetPosition", [](Transform& self, glm::vec3 position) -> void {
-            self.position = position;
-        },
-        "SetRotation", [](Transform& self, glm::quat rotation) -> void {
-            self.rotation = rotation;
-        },
+        "SetPosition", &Transform::setPosition,
+        "SetRotation", &Transform::setRotation,
         "LookAt", [](Transform& self, glm::vec3 target) -> void {
             glm::vec3 direction = glm::normalize(target - self.position);
-            self.rotation = glm::rotation(glm::vec3(0.f, 0.f, -1.f), direction);
+            self.setRotation(glm::rotation(glm::vec3(0.f, 0.f, -1.f), direction));
         }
     );
 
@@ -141,11 +142,65 @@ void ScriptManager::initializeLuaState() {
         "deltaTime", 0.f
     );
 
+    // spatial queries return entity uuids
+    auto toUUIDs = [](const std::vector<Entity*>& entities) {
+        std::vector<std::string> uuids;
+        uuids.reserve(entities.size());
+
+        for (auto entity : entities) {
+            uuids.push_back(entity->getUUID());
+        }
+
+        return sol::as_table(std::move(uuids));
+    };
+
+    mLua["Scene"] = mLua.create_table_with(
+        "Raycast", [&](glm::vec3 origin, glm::vec3 direction, float maxDistance) -> sol::object {
+            auto hit = mScene.raycast(origin, direction, maxDistance);
+
+            if (!hit) {
+                return sol::lua_nil;
+            }
+
+            return mLua.create_table_with("uuid", hit->entity->getUUID(), "distance", hit->distance);
+        },
+        "OverlapSphere", [&, toUUIDs](glm::vec3 center, float radius) {
+            std::vector<Entity*> entities;
+            mScene.overlapSphere(center, radius, entities);
+
+            return toUUIDs(entities);
+        },
+        "QueryFrustum", [&, toUUIDs]() {
+            std::vector<Entity*> entities;
+            mScene.queryFrustum(mScene.getViewProj(), entities);
+
+            return toUUIDs(entities);
+        },
+        "FindNearest", [&](glm::vec3 point, float maxDistance) -> sol::object {
+            Entity* entity = mScene.findNearest(point, maxDistance);
+
+            if (entity == nullptr) {
+                return sol::lua_nil;
+            }
+
+            return sol::make_object(mLua, entity->getUUID());
+        },
+        "GetTransform", [&](const std::string& uuid) -> Transform* {
+            Entity* entity = mScene.getEntity(uuid);
+
+            if (entity == nullptr || !entity->hasComponent<Transform>()) {
+                return nullptr;
+            }
+
+            return &entity->getComponent<Transform>();
+        }
+    );
+
     // mIsInitialized = true;
     fmt::println("Initialized lua state");
 }
 
-ScriptManager::ScriptManager() {
+ScriptManager::ScriptManager(Scene3D& scene) : mScene(scene) {
     initializeLuaState();
 }
 
@@ -207,6 +262,27 @@ void ScriptManager::bindScript(const std::string& scriptName, Entity& entity) {
     env.set_function("getTransform", &Entity::getComponent<Transform>, &entity);
 }
 
+void ScriptManager::trackTransform(Transform& transform) {
+    // scripts often read the same transform several times in a row
+    if (!mTrackedTransforms.empty() && mTrackedTransforms.back().transform == &transform) {
+        return;
+    }
+
+    mTrackedTransforms.push_back({&transform, transform.position, transform.rotation, transform.scale});
+}
+
+void ScriptManager::markWrittenTransforms() {
+    for (const auto& snapshot : mTrackedTransforms) {
+        const Transform& transform = *snapshot.transform;
+
+        if (transform.position != snapshot.position || transform.rotation != snapshot.rotation || transform.scale != snapshot.scale) {
+            snapshot.transform->markDirty();
+        }
+    }
+
+    mTrackedTransforms.clear();
+}
+
 void ScriptManager::update(float deltaTime, const Input& input, Entity *camera) {
     mLua["Time"]["deltaTime"] = deltaTime;
     mInput = input;
@@ -214,6 +290,8 @@ void ScriptManager::update(float deltaTime, const Input& input, Entity *camera)
 }
 
 void ScriptManager::onUpdate(entt::registry& registry) {
+    PROFILE_SCOPE("script update");
+
     auto view = registry.view<Script, Metadata>();
 
     for (auto [entity, script, metadata] : view.each()) {
@@ -222,6 +300,7 @@ void ScriptManager::onUpdate(entt::registry& registry) {
         }
 
         sol::protected_function_result result = script.env["update"]();
+        markWrittenTransforms();
 
         if (!result.valid()) {
             sol::error err = result;
@@ -231,6 +310,8 @@ void ScriptManager::onUpdate(entt::registry& registry) {
 }
 
 void ScriptManager::onInit(entt::registry& registry) {
+    PROFILE_SCOPE("script init");
+
     auto view = registry.view<Script, Metadata>();
 
     for (auto [entity, script, metadata] : view.each()) {
@@ -239,6 +320,7 @@ void ScriptManager::onInit(entt::registry& registry) {
         }
 
         sol::protected_function_result result = script.env["init"]();
+        markWrittenTransforms();
 
         if (!result.valid()) {
             sol::error err = result;
@@ -250,6 +332,8 @@ void ScriptManager::onInit(entt::registry& registry) {
 }
 
 void ScriptManager::onLateUpdate(entt::registry& registry) {
+    PROFILE_SCOPE("script late update");
+
     auto view = registry.view<Script, Metadata>();
 
     for (auto [entity, script, metadata] : view.each()) {
@@ -258,6 +342,7 @@ void ScriptManager::onLateUpdate(entt::registry& registry) {
         }
 
         sol::protected_function_result result = script.env["late_update"]();
+        markWrittenTransforms();
 
         if (!result.valid()) {
             sol::error err = result;
@@ -4,16 +4,20 @@
 #include <sol/sol.hpp>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <entt.hpp>
 #include "entity.h"
 #include "vk_window.h"
 
 #include <components/components.h>
 
+// forward reference
+class Scene3D;
+
 class ScriptManager {
 
 public:
-    ScriptManager();
+    ScriptManager(Scene3D& scene);
     ~ScriptManager();
 
     void loadScript(const std::string& filePath);
@@ -33,14 +37,28 @@ private:
         std::unordered_map<std::string, sol::type> symbols;
     };
 
+    // a transform lua got a reference into, with the values it had at that point
+    struct TransformSnapshot {
+        Transform* transform;
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+
     void initializeLuaState();
     std::unordered_map<std::string, sol::type> getSymbols(const sol::bytecode& bytecode);
 
+    void trackTransform(Transform& transform);
+    // marks the tracked transforms that lua wrote to during the last script call
+    void markWrittenTransforms();
+
     sol::state mLua;
+    Scene3D& mScene;
     // inline static bool mIsInitialized = false;
 
     Input mInput;
     Entity *mCamera = nullptr;
 
     std::unordered_map<std::string, ScriptData> mLoadedScripts;
+    std::vector<TransformSnapshot> mTrackedTransforms;
 };
@@ -0,0 +1,149 @@
+#include "sprite_atlas.h"
+
+#include "vk_engine.h"
+
+#include <algorithm>
+#include <cstring>
+
+SpriteAtlas::SpriteAtlas(VulkanEngine& vkEngine, VkFormat format) : mVkEngine(vkEngine), mFormat(format) {}
+
+SpriteAtlas::~SpriteAtlas() {
+    for (auto& page : mPages) {
+        if (page->uploaded) {
+            mVkEngine.destroyImage(page->image);
+        }
+    }
+}
+
+SpriteAtlas::Page& SpriteAtlas::addPage(uint32_t width, uint32_t height) {
+    auto page = std::make_unique<Page>();
+    page->width = width;
+    page->height = height;
+    page->pixels.resize((size_t)width * height * 4, 0);
+
+    mPages.push_back(std::move(page));
+
+    return *mPages.back();
+}
+
+bool SpriteAtlas::tryPack(Page& page, uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY) {
+    // start a new shelf when the image does not fit in the current one
+    if (page.cursorX + width > page.width) {
+        page.shelfY += page.shelfHeight;
+        page.cursorX = 0;
+        page.shelfHeight = 0;
+    }
+
+    if (page.shelfY + height > page.height || width > page.width) {
+        return false;
+    }
+
+    outX = page.cursorX;
+    outY = page.shelfY;
+
+    page.cursorX += width;
+    page.shelfHeight = std::max(page.shelfHeight, height);
+
+    return true;
+}
+
+const SpriteRegion* SpriteAtlas::addImage(const std::string& name, const unsigned char* pixels, uint32_t width, uint32_t height) {
+    std::scoped_lock lock(mMutex);
+
+    if (mRegions.contains(name)) {
+        return &mRegions[name];
+    }
+
+    // padding keeps linear filtering from bleeding into neighbours
+    uint32_t paddedWidth = width + PADDING * 2;
+    uint32_t paddedHeight = height + PADDING * 2;
+
+    uint32_t x, y;
+    uint32_t pageIndex = mPages.size();
+
+    // only the last page is filled, older ones were closed when they ran out of space
+    if (!mPages.empty() && tryPack(*mPages.back(), paddedWidth, paddedHeight, x, y)) {
+        pageIndex = mPages.size() - 1;
+    } else {
+        Page& page = addPage(std::max(PAGE_SIZE, paddedWidth), std::max(PAGE_SIZE, paddedHeight));
+        tryPack(page, paddedWidth, paddedHeight, x, y);
+    }
+
+    Page& page = *mPages[pageIndex];
+
+    // copy pixels, border texels are clamped into the padding
+    for (uint32_t row = 0; row < paddedHeight; row++) {
+        uint32_t srcRow = std::clamp<int32_t>((int32_t)row - PADDING, 0, height - 1);
+
+        for (uint32_t column = 0; column < paddedWidth; column++) {
+            uint32_t srcColumn = std::clamp<int32_t>((int32_t)column - PADDING, 0, width - 1);
+
+            const unsigned char* src = pixels + ((size_t)srcRow * width + srcColumn) * 4;
+            unsigned char* dst = page.pixels.data() + ((size_t)(y + row) * page.width + x + column) * 4;
+
+            memcpy(dst, src, 4);
+        }
+    }
+
+    page.dirty = true;
+
+    SpriteRegion region;
+    region.page = pageIndex;
+    region.uvRect = glm::vec4(
+        (float)(x + PADDING) / page.width,
+        (float)(y + PADDING) / page.height,
+        (float)(x + PADDING + width) / page.width,
+        (float)(y + PADDING + height) / page.height
+    );
+
+    mRegions[name] = region;
+
+    return &mRegions[name];
+}
+
+const SpriteRegion* SpriteAtlas::getRegion(const std::string& name) {
+    std::scoped_lock lock(mMutex);
+
+    if (!mRegions.contains(name)) {
+        return nullptr;
+    }
+
+    return &mRegions[name];
+}
+
+void SpriteAtlas::update(DeletionQueue& deletionQueue) {
+    std::scoped_lock lock(mMutex);
+
+    mPageViews.resize(mPages.size(), VK_NULL_HANDLE);
+
+    for (uint32_t i = 0; i < mPages.size(); i++) {
+        Page& page = *mPages[i];
+
+        if (!page.dirty) {
+            continue;
+        }
+
+        // the old image can still be read by frames in flight
+        if (page.uploaded) {
+            AllocatedImage oldImage = page.image;
+            VulkanEngine& vkEngine = mVkEngine;
+
+            deletionQueue.push([&vkEngine, oldImage]() {
+                vkEngine.destroyImage(oldImage);
+            });
+        }
+
+        page.image = mVkEngine.createImage(
+            page.pixels.data(),
+            VkExtent3D{page.width, page.height, 1},
+            mFormat,
+            VK_IMAGE_USAGE_SAMPLED_BIT,
+            false
+        );
+
+        page.uploaded = true;
+        page.dirty = false;
+
+        mPageViews[i] = page.image.imageView;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "vk_types.h"
+#include "deletion_queue.h"
+
+#include <mutex>
+
+// forward reference
+class VulkanEngine;
+
+struct SpriteRegion {
+    uint32_t page;
+    // uv min in xy, uv max in zw
+    glm::vec4 uvRect;
+};
+
+// packs sprite images into atlas pages using shelf packing, pages keep a copy of
+// their pixels so new images can be added after a page was uploaded
+class SpriteAtlas {
+public:
+    static constexpr uint32_t PAGE_SIZE = 2048;
+    static constexpr uint32_t PADDING = 2;
+
+    SpriteAtlas(VulkanEngine& vkEngine, VkFormat format);
+    ~SpriteAtlas();
+
+    // packs rgba8 pixels, images larger than a page get a page of their own
+    const SpriteRegion* addImage(const std::string& name, const unsigned char* pixels, uint32_t width, uint32_t height);
+
+    const SpriteRegion* getRegion(const std::string& name);
+
+    // uploads pages changed since the last call, must be called from the render thread,
+    // replaced page images are destroyed through the given deletion queue
+    void update(DeletionQueue& deletionQueue);
+
+    // image views of uploaded pages, VK_NULL_HANDLE for pages waiting for their first upload
+    const std::vector<VkImageView>& getPageViews() const {
+        return mPageViews;
+    }
+
+private:
+    struct Page {
+        uint32_t width;
+        uint32_t height;
+        std::vector<unsigned char> pixels;
+
+        AllocatedImage image{};
+        bool uploaded = false;
+        bool dirty = false;
+
+        // shelf packing state
+        uint32_t cursorX = 0;
+        uint32_t shelfY = 0;
+        uint32_t shelfHeight = 0;
+    };
+
+    bool tryPack(Page& page, uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY);
+    Page& addPage(uint32_t width, uint32_t height);
+
+    VulkanEngine& mVkEngine;
+    VkFormat mFormat;
+
+    // images are packed from the scene loading thread
+    std::mutex mMutex;
+
+    std::vector<std::unique_ptr<Page>> mPages;
+    std::unordered_map<std::string, SpriteRegion> mRegions;
+
+    // only touched by the render thread
+    std::vector<VkImageView> mPageViews;
+};
@@ -0,0 +1,152 @@
+#include "sprite_batcher.h"
+
+#include "sprite_atlas.h"
+#include "vk_descriptors.h"
+#include "vk_engine.h"
+
+#include "glm/ext/matrix_clip_space.hpp"
+
+#include <algorithm>
+
+SpriteBatcher::SpriteBatcher(VulkanEngine& vkEngine) : mVkEngine(vkEngine) {}
+
+SpriteBatcher::~SpriteBatcher() {
+    if (mSegmentCapacity > 0) {
+        mVkEngine.destroyBuffer(mInstanceBuffer);
+    }
+}
+
+void SpriteBatcher::reserve(uint32_t instanceCount) {
+    if (instanceCount <= mSegmentCapacity) {
+        return;
+    }
+
+    // other segments can still be read by frames in flight
+    if (mSegmentCapacity > 0) {
+        AllocatedBuffer oldBuffer = mInstanceBuffer;
+        VulkanEngine& vkEngine = mVkEngine;
+
+        mVkEngine.getCurrentFrame().deletionQueue.push([&vkEngine, oldBuffer]() {
+            vkEngine.destroyBuffer(oldBuffer);
+        });
+    }
+
+    mSegmentCapacity = std::max(instanceCount, mSegmentCapacity * 2);
+
+    mInstanceBuffer = mVkEngine.createBuffer(
+        (size_t)mSegmentCapacity * MAX_FRAMES_IN_FLIGHT * sizeof(SpriteInstance),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_CPU_TO_GPU
+    );
+}
+
+void SpriteBatcher::prepare(const std::vector<SpriteRenderObject>& sprites, VkExtent2D viewportSize, uint32_t frameIndex) {
+    SpriteAtlas& atlas = mVkEngine.getAssetManager().getSpriteAtlas();
+    atlas.update(mVkEngine.getCurrentFrame().deletionQueue);
+    mPageViews = atlas.getPageViews();
+
+    mProjection = glm::ortho(0.0f, (float)viewportSize.width, 0.0f, (float)viewportSize.height, -100.f, 100.f);
+
+    mVisible.clear();
+    mBatches.clear();
+    mInstanceCount = 0;
+
+    // cull the transformed quad against the viewport
+    for (uint32_t i = 0; i < sprites.size(); i++) {
+        const SpriteRenderObject& sprite = sprites[i];
+
+        if (sprite.region->page >= mPageViews.size() || mPageViews[sprite.region->page] == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        const glm::mat4& transform = sprite.transform;
+
+        // quad corners span [-0.5, 0.5] and are drawn at z = 1
+        glm::vec2 center = glm::vec2(transform * glm::vec4(0.f, 0.f, 1.f, 1.f));
+        glm::vec2 extents = 0.5f * (glm::abs(glm::vec2(transform[0])) + glm::abs(glm::vec2(transform[1])));
+
+        if (center.x + extents.x < 0.f || center.x - extents.x > viewportSize.width ||
+            center.y + extents.y < 0.f || center.y - extents.y > viewportSize.height) {
+            continue;
+        }
+
+        mVisible.push_back(i);
+    }
+
+    if (mVisible.empty()) {
+        return;
+    }
+
+    // layers are drawn in order, sprites keep their submission order within a layer
+    std::stable_sort(mVisible.begin(), mVisible.end(), [&](uint32_t a, uint32_t b) {
+        const SpriteRenderObject& spriteA = sprites[a];
+        const SpriteRenderObject& spriteB = sprites[b];
+
+        if (spriteA.layer != spriteB.layer) {
+            return spriteA.layer < spriteB.layer;
+        }
+
+        return spriteA.region->page < spriteB.region->page;
+    });
+
+    reserve(mVisible.size());
+
+    SpriteInstance* instances = (SpriteInstance*)mInstanceBuffer.allocInfo.pMappedData + (size_t)frameIndex * mSegmentCapacity;
+
+    int lastLayer = 0;
+
+    for (auto index : mVisible) {
+        const SpriteRenderObject& sprite = sprites[index];
+
+        if (mBatches.empty() || sprite.layer != lastLayer || sprite.region->page != mBatches.back().page) {
+            mBatches.push_back(SpriteBatch{sprite.region->page, mInstanceCount, 0});
+            lastLayer = sprite.layer;
+        }
+
+        SpriteInstance& instance = instances[mInstanceCount++];
+        instance.transform = sprite.transform;
+        instance.uvRect = sprite.region->uvRect;
+        instance.tint = sprite.tint;
+
+        mBatches.back().instanceCount++;
+    }
+}
+
+uint32_t SpriteBatcher::draw(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    if (mBatches.empty()) {
+        return 0;
+    }
+
+    Pipeline* pipeline = mVkEngine.getPipelineResourceManager().getPipeline(PipelineResourceManager::PipelineType::SPRITE);
+    MeshAsset* quadMesh = mVkEngine.getAssetManager().getMesh("quad");
+    VkSampler linearSampler = *mVkEngine.getAssetManager().getSampler("linear");
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+    vkCmdBindIndexBuffer(commandBuffer, quadMesh->meshBuffers.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+    SpritePushConstants pushConstants;
+    pushConstants.projection = mProjection;
+    pushConstants.vertexBuffer = quadMesh->meshBuffers.vertexBufferAddress;
+    pushConstants.instanceBuffer = mInstanceBuffer.deviceAddress + (VkDeviceAddress)frameIndex * mSegmentCapacity * sizeof(SpriteInstance);
+
+    vkCmdPushConstants(commandBuffer, pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SpritePushConstants), &pushConstants);
+
+    uint32_t lastPage = UINT32_MAX;
+
+    for (auto& batch : mBatches) {
+        // atlas page only changes between batches of the same layer when a layer spans several pages
+        if (batch.page != lastPage) {
+            lastPage = batch.page;
+
+            DescriptorWriter writer;
+            std::vector<VkWriteDescriptorSet> writes = writer.writeImage(0, mPageViews[batch.page], linearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+                                                             .getWrites();
+
+            vkCmdPushDescriptorSetKHR(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, (uint32_t)writes.size(), writes.data());
+        }
+
+        vkCmdDrawIndexed(commandBuffer, quadMesh->surfaces[0].count, batch.instanceCount, quadMesh->meshBuffers.firstIndex + quadMesh->surfaces[0].startIndex, quadMesh->meshBuffers.vertexOffset, batch.firstInstance);
+    }
+
+    return mBatches.size();
+}
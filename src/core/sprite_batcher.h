@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vk_types.h"
+#include "volk.h"
+
+// forward reference
+class VulkanEngine;
+
+// draws sprites as instanced quads sampling the sprite atlas, visible sprites are
+// streamed into a ring buffer split into one segment per frame in flight
+class SpriteBatcher {
+public:
+    SpriteBatcher(VulkanEngine& vkEngine);
+    ~SpriteBatcher();
+
+    // uploads pending atlas pages, culls sprites against the viewport and writes instance data,
+    // must be called on the render thread before recording
+    void prepare(const std::vector<SpriteRenderObject>& sprites, VkExtent2D viewportSize, uint32_t frameIndex);
+
+    // one instanced draw per layer and atlas page, returns the number of draw calls
+    uint32_t draw(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    uint32_t getVisibleCount() const {
+        return mInstanceCount;
+    }
+
+private:
+    struct SpriteBatch {
+        uint32_t page;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    void reserve(uint32_t instanceCount);
+
+    VulkanEngine& mVkEngine;
+
+    // ring buffer holding a segment of mSegmentCapacity instances per frame
+    AllocatedBuffer mInstanceBuffer{};
+    uint32_t mSegmentCapacity = 0;
+
+    glm::mat4 mProjection{1.f};
+
+    std::vector<uint32_t> mVisible;
+    std::vector<SpriteBatch> mBatches;
+    uint32_t mInstanceCount = 0;
+
+    // atlas page views captured in prepare, the atlas may add pages while recording
+    std::vector<VkImageView> mPageViews;
+};
@@ -0,0 +1,108 @@
+#include "thread_pool.h"
+
+#include "cpu_profiler.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t workerCount) {
+    if (workerCount == 0) {
+        // hardware_concurrency may report 0, clamp before leaving a core to the main thread
+        workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    mWorkers.reserve(workerCount);
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        mWorkers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::scoped_lock lock(mMutex);
+        mStop = true;
+    }
+
+    mWorkCondition.notify_all();
+
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(uint32_t taskCount, const std::function<void(uint32_t taskIndex, uint32_t workerIndex)>& function) {
+    if (taskCount == 0) {
+        return;
+    }
+
+    std::unique_lock lock(mMutex);
+
+    mFunction = &function;
+    mTaskCount = taskCount;
+    mNextTask = 0;
+    mFinishedTasks = 0;
+    mGeneration++;
+
+    mWorkCondition.notify_all();
+
+    // also wait for workers to leave the task loop so none of them sees the next job's counter
+    mDoneCondition.wait(lock, [&]() {
+        return mFinishedTasks == mTaskCount && mActiveWorkers == 0;
+    });
+
+    mFunction = nullptr;
+    mTaskCount = 0;
+}
+
+void ThreadPool::workerLoop(uint32_t workerIndex) {
+    CPUProfiler::setThreadName("worker " + std::to_string(workerIndex));
+
+    uint64_t lastGeneration = 0;
+
+    while (true) {
+        const std::function<void(uint32_t, uint32_t)>* function;
+        uint32_t taskCount;
+
+        {
+            std::unique_lock lock(mMutex);
+
+            mWorkCondition.wait(lock, [&]() {
+                return mStop || mGeneration != lastGeneration;
+            });
+
+            if (mStop) {
+                return;
+            }
+
+            lastGeneration = mGeneration;
+
+            // woke up after the job already finished
+            if (mTaskCount == 0) {
+                continue;
+            }
+
+            function = mFunction;
+            taskCount = mTaskCount;
+            mActiveWorkers++;
+        }
+
+        // grab tasks until none are left
+        uint32_t finished = 0;
+
+        for (uint32_t task = mNextTask++; task < taskCount; task = mNextTask++) {
+            (*function)(task, workerIndex);
+            finished++;
+        }
+
+        {
+            std::scoped_lock lock(mMutex);
+
+            mFinishedTasks += finished;
+            mActiveWorkers--;
+
+            if (mFinishedTasks == mTaskCount && mActiveWorkers == 0) {
+                mDoneCondition.notify_one();
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads running index based jobs, each worker has a stable
+// index so callers can keep per worker resources (command pools, scratch memory)
+class ThreadPool {
+public:
+    // 0 picks one worker per hardware thread, leaving one for the main thread
+    ThreadPool(uint32_t workerCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t getWorkerCount() const {
+        return mWorkers.size();
+    }
+
+    // runs function(taskIndex, workerIndex) for every task and blocks until all of them finished
+    void parallelFor(uint32_t taskCount, const std::function<void(uint32_t taskIndex, uint32_t workerIndex)>& function);
+
+private:
+    void workerLoop(uint32_t workerIndex);
+
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mMutex;
+    std::condition_variable mWorkCondition;
+    std::condition_variable mDoneCondition;
+
+    // current job, only changed while no tasks are in flight
+    const std::function<void(uint32_t, uint32_t)>* mFunction = nullptr;
+    uint32_t mTaskCount = 0;
+    std::atomic<uint32_t> mNextTask = 0;
+    uint32_t mFinishedTasks = 0;
+    uint32_t mActiveWorkers = 0;
+
+    uint64_t mGeneration = 0;
+    bool mStop = false;
+};
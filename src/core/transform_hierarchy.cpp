@@ -0,0 +1,119 @@
+#include "transform_hierarchy.h"
+
+#include "components/transform.h"
+#include "cpu_profiler.h"
+
+#include <algorithm>
+
+void TransformHierarchy::clear() {
+    mTransforms.clear();
+    mEntities.clear();
+    mParents.clear();
+    mSubtreeSizes.clear();
+    mDirty.clear();
+    mDirtyNodes.clear();
+
+    mValid = true;
+    mSubtreeSizesValid = true;
+}
+
+uint32_t TransformHierarchy::addNode(Transform& transform, uint32_t parent, Entity* entity) {
+    uint32_t node = mTransforms.size();
+
+    transform.hierarchy = this;
+    transform.hierarchyIndex = node;
+
+    mTransforms.push_back(&transform);
+    mEntities.push_back(entity);
+    mParents.push_back(parent);
+    mSubtreeSizes.push_back(1);
+    mDirty.push_back(0);
+
+    mSubtreeSizesValid = false;
+    markNode(node);
+
+    return node;
+}
+
+void TransformHierarchy::markDirty(const Transform& transform) {
+    uint32_t node = transform.hierarchyIndex;
+
+    // copies and transforms left out of the last rebuild still point here
+    if (node >= mTransforms.size() || mTransforms[node] != &transform) {
+        return;
+    }
+
+    markNode(node);
+}
+
+void TransformHierarchy::markNode(uint32_t node) {
+    if (mDirty[node]) {
+        return;
+    }
+
+    mDirty[node] = 1;
+    mDirtyNodes.push_back(node);
+}
+
+void TransformHierarchy::updateSubtreeSizes() {
+    std::fill(mSubtreeSizes.begin(), mSubtreeSizes.end(), 1);
+
+    // children come after their parents, so walking backwards finishes every subtree before its root
+    for (uint32_t node = mTransforms.size(); node-- > 0;) {
+        if (mParents[node] != NO_PARENT) {
+            mSubtreeSizes[mParents[node]] += mSubtreeSizes[node];
+        }
+    }
+
+    mSubtreeSizesValid = true;
+}
+
+void TransformHierarchy::propagate(std::vector<Entity*>& changedEntities) {
+    PROFILE_SCOPE("transform hierarchy propagation");
+
+    mUpdatedCount = 0;
+
+    if (mDirtyNodes.empty()) {
+        return;
+    }
+
+    if (!mSubtreeSizesValid) {
+        updateSubtreeSizes();
+    }
+
+    // ranges of earlier nodes contain every later dirty node below them
+    std::sort(mDirtyNodes.begin(), mDirtyNodes.end());
+
+    uint32_t rangeEnd = 0;
+
+    for (auto first : mDirtyNodes) {
+        if (first < rangeEnd) {
+            continue;
+        }
+
+        rangeEnd = first + mSubtreeSizes[first];
+        mUpdatedCount += mSubtreeSizes[first];
+
+        for (uint32_t node = first; node < rangeEnd; node++) {
+            Transform& transform = *mTransforms[node];
+
+            if (mDirty[node]) {
+                transform.updateLocalMatrix();
+                mDirty[node] = 0;
+            }
+
+            uint32_t parent = mParents[node];
+            glm::mat4 globalMatrix = parent == NO_PARENT ? transform.localMatrix : mTransforms[parent]->globalMatrix * transform.localMatrix;
+
+            if (globalMatrix != transform.globalMatrix) {
+                transform.globalMatrix = globalMatrix;
+
+                if (mEntities[node] != nullptr) {
+                    changedEntities.push_back(mEntities[node]);
+                }
+            }
+        }
+    }
+
+    mDirtyNodes.clear();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// forward reference
+class Entity;
+struct Transform;
+
+// scene transforms in depth first order, parents come before their children so every subtree
+// is a contiguous range, writes mark transforms dirty and propagation walks only the ranges
+// below dirty nodes, static subtrees are never recomputed
+class TransformHierarchy {
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    void clear();
+
+    // nodes have to be added in depth first order, the node starts dirty
+    uint32_t addNode(Transform& transform, uint32_t parent, Entity* entity = nullptr);
+
+    // entities or parent links changed, the owner has to rebuild before the next propagation
+    void invalidate() {
+        mValid = false;
+    }
+
+    bool isValid() const {
+        return mValid;
+    }
+
+    void markDirty(const Transform& transform);
+
+    // recomputes local matrices of dirty nodes and global matrices below them,
+    // entities whose global matrix changed are appended to changedEntities
+    void propagate(std::vector<Entity*>& changedEntities);
+
+    Entity* getEntity(uint32_t node) const {
+        return mEntities[node];
+    }
+
+    uint32_t getNodeCount() const {
+        return mTransforms.size();
+    }
+
+    uint32_t getDirtyCount() const {
+        return mDirtyNodes.size();
+    }
+
+    // nodes whose global matrix was recomputed by the last propagation
+    uint32_t getUpdatedCount() const {
+        return mUpdatedCount;
+    }
+
+private:
+    void markNode(uint32_t node);
+    void updateSubtreeSizes();
+
+    std::vector<Transform*> mTransforms;
+    std::vector<Entity*> mEntities;
+    std::vector<uint32_t> mParents;
+    // nodes in the subtree, including the node
+    std::vector<uint32_t> mSubtreeSizes;
+    std::vector<uint8_t> mDirty;
+    std::vector<uint32_t> mDirtyNodes;
+
+    bool mValid = false;
+    bool mSubtreeSizesValid = true;
+    uint32_t mUpdatedCount = 0;
+};
@@ -0,0 +1,449 @@
+#include "upload_service.h"
+
+#include "vk_engine.h"
+#include "vk_images.h"
+#include "vk_initializers.h"
+
+#include <cstring>
+
+// staging offsets suit every texel size in use and the transfer queue's 4 byte requirement
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+// release on the transfer queue and matching acquire on the graphics queue, both sides
+// must describe the same layouts and queue families
+static void transferImageOwnership(
+    VkCommandBuffer transferCommandBuffer,
+    VkCommandBuffer graphicsCommandBuffer,
+    VkImage image,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout,
+    uint32_t transferQueueFamily,
+    uint32_t graphicsQueueFamily
+) {
+    VkImageMemoryBarrier2 imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    imageBarrier.pNext = nullptr;
+
+    imageBarrier.oldLayout = oldLayout;
+    imageBarrier.newLayout = newLayout;
+    imageBarrier.srcQueueFamilyIndex = transferQueueFamily;
+    imageBarrier.dstQueueFamilyIndex = graphicsQueueFamily;
+    imageBarrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    imageBarrier.image = image;
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.pNext = nullptr;
+    depInfo.imageMemoryBarrierCount = 1;
+    depInfo.pImageMemoryBarriers = &imageBarrier;
+
+    // release
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    imageBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    imageBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+
+    vkCmdPipelineBarrier2(transferCommandBuffer, &depInfo);
+
+    // acquire
+    imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+    imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+
+    vkCmdPipelineBarrier2(graphicsCommandBuffer, &depInfo);
+}
+
+static void transferBufferOwnership(
+    VkCommandBuffer transferCommandBuffer,
+    VkCommandBuffer graphicsCommandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    uint32_t transferQueueFamily,
+    uint32_t graphicsQueueFamily
+) {
+    VkBufferMemoryBarrier2 bufferBarrier{};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    bufferBarrier.pNext = nullptr;
+
+    bufferBarrier.srcQueueFamilyIndex = transferQueueFamily;
+    bufferBarrier.dstQueueFamilyIndex = graphicsQueueFamily;
+    bufferBarrier.buffer = buffer;
+    bufferBarrier.offset = offset;
+    bufferBarrier.size = size;
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.pNext = nullptr;
+    depInfo.bufferMemoryBarrierCount = 1;
+    depInfo.pBufferMemoryBarriers = &bufferBarrier;
+
+    // release
+    bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    bufferBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    bufferBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+
+    vkCmdPipelineBarrier2(transferCommandBuffer, &depInfo);
+
+    // acquire
+    bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    bufferBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+    bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+
+    vkCmdPipelineBarrier2(graphicsCommandBuffer, &depInfo);
+}
+
+UploadService::UploadService(
+    VulkanEngine& vkEngine,
+    VkQueue transferQueue,
+    uint32_t transferQueueFamily,
+    VkQueue graphicsQueue,
+    uint32_t graphicsQueueFamily,
+    std::mutex& queueMutex
+) : mVkEngine(vkEngine),
+    mTransferQueue(transferQueue),
+    mTransferQueueFamily(transferQueueFamily),
+    mGraphicsQueue(graphicsQueue),
+    mGraphicsQueueFamily(graphicsQueueFamily),
+    mQueueMutex(queueMutex) {
+    VkDevice device = mVkEngine.getDevice();
+
+    // create command pools and one command buffer per batch on each queue
+    VkCommandPoolCreateInfo transferPoolInfo = vkinit::command_pool_create_info(mTransferQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(device, &transferPoolInfo, nullptr, &mTransferCommandPool));
+
+    VkCommandPoolCreateInfo graphicsPoolInfo = vkinit::command_pool_create_info(mGraphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(device, &graphicsPoolInfo, nullptr, &mGraphicsCommandPool));
+
+    for (auto& batch : mBatches) {
+        VkCommandBufferAllocateInfo transferAllocInfo = vkinit::command_buffer_allocate_info(mTransferCommandPool);
+        VK_CHECK(vkAllocateCommandBuffers(device, &transferAllocInfo, &batch.transferCommandBuffer));
+
+        VkCommandBufferAllocateInfo graphicsAllocInfo = vkinit::command_buffer_allocate_info(mGraphicsCommandPool);
+        VK_CHECK(vkAllocateCommandBuffers(device, &graphicsAllocInfo, &batch.graphicsCommandBuffer));
+    }
+
+    // create timeline semaphores
+    VkSemaphoreTypeCreateInfo semaphoreTypeInfo{};
+    semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = vkinit::semaphore_create_info();
+    semaphoreInfo.pNext = &semaphoreTypeInfo;
+
+    VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &mCopySemaphore));
+    VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &mTimelineSemaphore));
+
+    // create staging ring, mapped for its whole lifetime
+    mStagingRing = mVkEngine.createBuffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+    fmt::println("upload service using {} transfer queue family {}", isDedicated() ? "dedicated" : "graphics", mTransferQueueFamily);
+}
+
+UploadService::~UploadService() {
+    wait(flush());
+
+    {
+        std::scoped_lock lock(mMutex);
+        retireBatches(false);
+    }
+
+    VkDevice device = mVkEngine.getDevice();
+
+    mVkEngine.destroyBuffer(mStagingRing);
+
+    vkDestroySemaphore(device, mCopySemaphore, nullptr);
+    vkDestroySemaphore(device, mTimelineSemaphore, nullptr);
+
+    vkDestroyCommandPool(device, mTransferCommandPool, nullptr);
+    vkDestroyCommandPool(device, mGraphicsCommandPool, nullptr);
+}
+
+UploadService::Batch& UploadService::beginBatch() {
+    Batch& batch = mBatches[mCurrentBatch];
+
+    if (mBatchOpen) {
+        return batch;
+    }
+
+    if (mBatchesInFlight == BATCH_COUNT) {
+        retireBatches(true);
+    }
+
+    batch.token = mNextToken++;
+    batch.empty = true;
+
+    VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    VK_CHECK(vkResetCommandBuffer(batch.transferCommandBuffer, 0));
+    VK_CHECK(vkBeginCommandBuffer(batch.transferCommandBuffer, &beginInfo));
+
+    if (isDedicated()) {
+        VK_CHECK(vkResetCommandBuffer(batch.graphicsCommandBuffer, 0));
+        VK_CHECK(vkBeginCommandBuffer(batch.graphicsCommandBuffer, &beginInfo));
+    }
+
+    mBatchOpen = true;
+
+    return batch;
+}
+
+void UploadService::submitBatch() {
+    Batch& batch = mBatches[mCurrentBatch];
+    batch.ringEnd = mRingHead;
+
+    VK_CHECK(vkEndCommandBuffer(batch.transferCommandBuffer));
+
+    VkCommandBufferSubmitInfo transferCommandInfo = vkinit::command_buffer_submit_info(batch.transferCommandBuffer);
+
+    {
+        std::scoped_lock lock(mQueueMutex);
+
+        if (isDedicated()) {
+            VK_CHECK(vkEndCommandBuffer(batch.graphicsCommandBuffer));
+
+            // copies signal the graphics side, which acquires ownership and generates mipmaps
+            VkSemaphoreSubmitInfo copySignal = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, mCopySemaphore);
+            copySignal.value = batch.token;
+
+            VkSubmitInfo2 transferSubmit = vkinit::submit_info(&transferCommandInfo, &copySignal, nullptr);
+            VK_CHECK(vkQueueSubmit2(mTransferQueue, 1, &transferSubmit, VK_NULL_HANDLE));
+
+            VkCommandBufferSubmitInfo graphicsCommandInfo = vkinit::command_buffer_submit_info(batch.graphicsCommandBuffer);
+            VkSemaphoreSubmitInfo copyWait = copySignal;
+            VkSemaphoreSubmitInfo uploadSignal = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, mTimelineSemaphore);
+            uploadSignal.value = batch.token;
+
+            VkSubmitInfo2 graphicsSubmit = vkinit::submit_info(&graphicsCommandInfo, &uploadSignal, &copyWait);
+            VK_CHECK(vkQueueSubmit2(mGraphicsQueue, 1, &graphicsSubmit, VK_NULL_HANDLE));
+        } else {
+            VkSemaphoreSubmitInfo uploadSignal = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, mTimelineSemaphore);
+            uploadSignal.value = batch.token;
+
+            VkSubmitInfo2 transferSubmit = vkinit::submit_info(&transferCommandInfo, &uploadSignal, nullptr);
+            VK_CHECK(vkQueueSubmit2(mTransferQueue, 1, &transferSubmit, VK_NULL_HANDLE));
+        }
+    }
+
+    mLastSubmitted = batch.token;
+    mBatchOpen = false;
+    mCurrentBatch = (mCurrentBatch + 1) % BATCH_COUNT;
+    mBatchesInFlight++;
+}
+
+void UploadService::retireBatches(bool waitOldest) {
+    if (mBatchesInFlight == 0) {
+        return;
+    }
+
+    if (waitOldest) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &mTimelineSemaphore;
+        waitInfo.pValues = &mBatches[mOldestBatch].token;
+
+        VK_CHECK(vkWaitSemaphores(mVkEngine.getDevice(), &waitInfo, UINT64_MAX));
+    }
+
+    uint64_t completed;
+    VK_CHECK(vkGetSemaphoreCounterValue(mVkEngine.getDevice(), mTimelineSemaphore, &completed));
+
+    // batches complete in submission order
+    while (mBatchesInFlight > 0 && mBatches[mOldestBatch].token <= completed) {
+        Batch& batch = mBatches[mOldestBatch];
+
+        mRingTail = batch.ringEnd;
+
+        for (auto& staging : batch.dedicatedStaging) {
+            mVkEngine.destroyBuffer(staging);
+        }
+
+        batch.dedicatedStaging.clear();
+
+        mOldestBatch = (mOldestBatch + 1) % BATCH_COUNT;
+        mBatchesInFlight--;
+    }
+}
+
+VkBuffer UploadService::allocateStaging(const void* data, VkDeviceSize size, VkDeviceSize& outOffset) {
+    VkDeviceSize alignedSize = (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+    if (alignedSize > STAGING_RING_SIZE) {
+        AllocatedBuffer staging = mVkEngine.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+        memcpy(staging.allocInfo.pMappedData, data, size);
+
+        beginBatch().dedicatedStaging.push_back(staging);
+
+        outOffset = 0;
+        return staging.buffer;
+    }
+
+    while (true) {
+        retireBatches(false);
+
+        // nothing in use, restart at the beginning of the ring
+        if (mRingHead == mRingTail && !mBatchOpen) {
+            mRingHead = mRingTail = 0;
+        }
+
+        // allocations never wrap around the end of the ring
+        VkDeviceSize offset = mRingHead % STAGING_RING_SIZE;
+        VkDeviceSize padding = offset + alignedSize > STAGING_RING_SIZE ? STAGING_RING_SIZE - offset : 0;
+
+        if (mRingHead + padding + alignedSize - mRingTail <= STAGING_RING_SIZE) {
+            mRingHead += padding;
+            break;
+        }
+
+        // the open batch holds part of the ring, so it has to go out before waiting
+        if (mBatchOpen) {
+            submitBatch();
+        }
+
+        retireBatches(true);
+    }
+
+    outOffset = mRingHead % STAGING_RING_SIZE;
+    mRingHead += alignedSize;
+
+    memcpy((char*)mStagingRing.allocInfo.pMappedData + outOffset, data, size);
+
+    return mStagingRing.buffer;
+}
+
+UploadService::Token UploadService::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    std::scoped_lock lock(mMutex);
+
+    VkDeviceSize stagingOffset;
+    VkBuffer staging = allocateStaging(data, size, stagingOffset);
+
+    Batch& batch = beginBatch();
+
+    VkBufferCopy copy{};
+    copy.srcOffset = stagingOffset;
+    copy.dstOffset = offset;
+    copy.size = size;
+
+    vkCmdCopyBuffer(batch.transferCommandBuffer, staging, buffer, 1, &copy);
+
+    if (isDedicated()) {
+        transferBufferOwnership(batch.transferCommandBuffer, batch.graphicsCommandBuffer, buffer, offset, size, mTransferQueueFamily, mGraphicsQueueFamily);
+    }
+
+    batch.empty = false;
+    mUploadedSize += size;
+
+    return batch.token;
+}
+
+UploadService::Token UploadService::uploadImage(const AllocatedImage& image, const void* data, VkDeviceSize size, uint32_t layerCount, bool mipMapped) {
+    std::scoped_lock lock(mMutex);
+
+    VkDeviceSize stagingOffset;
+    VkBuffer staging = allocateStaging(data, size, stagingOffset);
+
+    Batch& batch = beginBatch();
+    VkCommandBuffer commandBuffer = batch.transferCommandBuffer;
+
+    vkutil::transitionImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkBufferImageCopy copyRegion{};
+    copyRegion.bufferOffset = stagingOffset;
+    copyRegion.bufferRowLength = 0;
+    copyRegion.bufferImageHeight = 0;
+
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = layerCount;
+    copyRegion.imageExtent = {image.imageExtent.width, image.imageExtent.height, 1};
+
+    vkCmdCopyBufferToImage(commandBuffer, staging, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    VkExtent2D extent{image.imageExtent.width, image.imageExtent.height};
+
+    if (isDedicated()) {
+        // blits need a graphics queue, so mipmapped images move over before generating the chain
+        VkImageLayout layout = mipMapped ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        transferImageOwnership(commandBuffer, batch.graphicsCommandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout, mTransferQueueFamily, mGraphicsQueueFamily);
+
+        if (mipMapped) {
+            vkutil::generateMipmaps(batch.graphicsCommandBuffer, image.image, extent);
+        }
+    } else if (mipMapped) {
+        vkutil::generateMipmaps(commandBuffer, image.image, extent);
+    } else {
+        vkutil::transitionImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    batch.empty = false;
+    mUploadedSize += size;
+
+    return batch.token;
+}
+
+UploadService::Token UploadService::flush() {
+    std::scoped_lock lock(mMutex);
+
+    if (mBatchOpen) {
+        submitBatch();
+    }
+
+    retireBatches(false);
+
+    return mLastSubmitted;
+}
+
+bool UploadService::isComplete(Token token) {
+    uint64_t completed;
+    VK_CHECK(vkGetSemaphoreCounterValue(mVkEngine.getDevice(), mTimelineSemaphore, &completed));
+
+    return completed >= token;
+}
+
+void UploadService::wait(Token token) {
+    {
+        std::scoped_lock lock(mMutex);
+
+        // the token belongs to the open batch
+        if (mBatchOpen && token >= mBatches[mCurrentBatch].token) {
+            submitBatch();
+        }
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &mTimelineSemaphore;
+    waitInfo.pValues = &token;
+
+    VK_CHECK(vkWaitSemaphores(mVkEngine.getDevice(), &waitInfo, UINT64_MAX));
+}
+
+VkSemaphoreSubmitInfo UploadService::getWaitInfo(VkPipelineStageFlags2 stageMask) {
+    VkSemaphoreSubmitInfo waitInfo = vkinit::semaphore_submit_info(stageMask, mTimelineSemaphore);
+    waitInfo.value = flush();
+
+    return waitInfo;
+}
+
+UploadService::Stats UploadService::getStats() {
+    std::scoped_lock lock(mMutex);
+
+    Stats stats;
+    stats.uploadedSize = mUploadedSize;
+    stats.stagingInUse = mRingHead - mRingTail;
+    stats.batchesInFlight = mBatchesInFlight;
+    stats.dedicatedTransferQueue = isDedicated();
+
+    return stats;
+}
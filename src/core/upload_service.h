@@ -0,0 +1,120 @@
+#pragma once
+
+#include "vk_types.h"
+#include "volk.h"
+
+#include <mutex>
+
+// forward reference
+class VulkanEngine;
+
+// streams buffer and image data to the gpu on the transfer queue, copies go through a
+// persistently mapped staging ring and are batched into one submission per flush
+//
+// every batch signals a timeline semaphore value which is returned as the upload token,
+// graphics submissions wait on the last flushed value on the gpu, so the cpu only blocks
+// when it waits on a token or the staging ring runs out of space
+class UploadService {
+public:
+    static constexpr VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+    static constexpr uint32_t BATCH_COUNT = 8;
+
+    using Token = uint64_t;
+
+    struct Stats {
+        VkDeviceSize uploadedSize;
+        VkDeviceSize stagingInUse;
+        uint32_t batchesInFlight;
+        bool dedicatedTransferQueue;
+    };
+
+    // graphics submissions share the queue mutex with the engine
+    UploadService(
+        VulkanEngine& vkEngine,
+        VkQueue transferQueue,
+        uint32_t transferQueueFamily,
+        VkQueue graphicsQueue,
+        uint32_t graphicsQueueFamily,
+        std::mutex& queueMutex
+    );
+    ~UploadService();
+
+    Token uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+    // copies into mip 0 of every layer, the image ends up in shader read only layout
+    Token uploadImage(const AllocatedImage& image, const void* data, VkDeviceSize size, uint32_t layerCount = 1, bool mipMapped = false);
+
+    // submits the open batch, returns the token every upload so far completes with
+    Token flush();
+
+    bool isComplete(Token token);
+    void wait(Token token);
+
+    // flushes and returns a wait on every upload so far, for graphics queue submissions
+    VkSemaphoreSubmitInfo getWaitInfo(VkPipelineStageFlags2 stageMask);
+
+    Stats getStats();
+
+private:
+    struct Batch {
+        // copies and release barriers
+        VkCommandBuffer transferCommandBuffer;
+        // acquire barriers and mipmap generation, unused without a dedicated transfer queue
+        VkCommandBuffer graphicsCommandBuffer;
+
+        Token token = 0;
+        bool empty = true;
+
+        // staging ring position after the batch's copies, the ring is released up to it on completion
+        VkDeviceSize ringEnd = 0;
+        // uploads larger than the ring get their own staging buffer
+        std::vector<AllocatedBuffer> dedicatedStaging;
+    };
+
+    // the open batch, waiting for the slot to retire if every batch is in flight
+    Batch& beginBatch();
+    void submitBatch();
+    void retireBatches(bool waitOldest);
+
+    // reserves staging space, returns the buffer and offset to copy from
+    VkBuffer allocateStaging(const void* data, VkDeviceSize size, VkDeviceSize& outOffset);
+
+    bool isDedicated() const {
+        return mTransferQueueFamily != mGraphicsQueueFamily;
+    }
+
+    VulkanEngine& mVkEngine;
+
+    VkQueue mTransferQueue;
+    uint32_t mTransferQueueFamily;
+    VkQueue mGraphicsQueue;
+    uint32_t mGraphicsQueueFamily;
+    std::mutex& mQueueMutex;
+
+    // uploads come from the scene loading thread while the render thread flushes
+    std::mutex mMutex;
+
+    VkCommandPool mTransferCommandPool;
+    VkCommandPool mGraphicsCommandPool;
+
+    // signaled by the transfer queue once a batch's copies are done
+    VkSemaphore mCopySemaphore;
+    // signaled once a batch is usable on the graphics queue
+    VkSemaphore mTimelineSemaphore;
+
+    AllocatedBuffer mStagingRing;
+    // monotonic ring positions, the ring offset is the position modulo its size
+    VkDeviceSize mRingHead = 0;
+    VkDeviceSize mRingTail = 0;
+
+    Batch mBatches[BATCH_COUNT];
+    uint32_t mCurrentBatch = 0;
+    uint32_t mOldestBatch = 0;
+    uint32_t mBatchesInFlight = 0;
+    bool mBatchOpen = false;
+
+    Token mNextToken = 1;
+    Token mLastSubmitted = 0;
+
+    VkDeviceSize mUploadedSize = 0;
+};
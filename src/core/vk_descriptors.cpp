@@ -3,10 +3,10 @@
 #include "volk.h"
 #include "vk_engine.h"
 
-DescriptorLayoutBuilder& DescriptorLayoutBuilder::addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags shaderStages) {
+DescriptorLayoutBuilder& DescriptorLayoutBuilder::addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags shaderStages, uint32_t descriptorCount) {
     VkDescriptorSetLayoutBinding newBind{};
     newBind.binding = binding;
-    newBind.descriptorCount = 1;
+    newBind.descriptorCount = descriptorCount;
     newBind.descriptorType = type;
     newBind.stageFlags = shaderStages;
 
@@ -11,7 +11,7 @@ class VulkanEngine;
 class DescriptorLayoutBuilder {
 public:
 
-    DescriptorLayoutBuilder& addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags shaderStages);
+    DescriptorLayoutBuilder& addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags shaderStages, uint32_t descriptorCount = 1);
     DescriptorLayoutBuilder& clear();
     VkDescriptorSetLayout build(VkDevice device, void *pNext = nullptr, VkDescriptorSetLayoutCreateFlags flags = 0);
 
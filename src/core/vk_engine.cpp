@@ -1,5 +1,6 @@
 #define IMGUI_IMPL_VULKAN_USE_VOLK
 #include "vk_engine.h"
+#include "render_list.h"
 #include "glm/ext/matrix_clip_space.hpp"
 #include "glm/ext/matrix_transform.hpp"
 
@@ -17,6 +18,8 @@
 #define VMA_DEBUG_LOG
 #include "vk_mem_alloc.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstring>
 #include <memory>
@@ -34,10 +37,23 @@
 #include <imgui_impl_vulkan.h>
 
 #include "stb_image.h"
+#include "stb_image_write.h"
 #include <chrono>
+#include <filesystem>
 #include <thread>
 #include "vk_scene.h"
 
+// fixed time step of headless runs
+constexpr float HEADLESS_DELTA_TIME = 1.f / 60.f;
+constexpr uint32_t DEFAULT_HEADLESS_FRAME_COUNT = 300;
+
+// occluders are the largest objects on screen, designated occluders are always used
+constexpr uint32_t MAX_OCCLUDERS = 64;
+constexpr float MIN_OCCLUDER_SCREEN_SIZE = 0.1f;
+
+// projected lod error allowed at a lod bias of 0, in pixels
+constexpr float LOD_ERROR_PIXELS = 1.f;
+
 void VulkanEngine::parseCliArgs(const std::vector<std::string>& cliArgs) {
     mUseValidationLayers = false;
 
@@ -45,21 +61,111 @@ void VulkanEngine::parseCliArgs(const std::vector<std::string>& cliArgs) {
         if (arg == "--debug") {
             mUseValidationLayers = true;
             fmt::println("Enabled validation layers");
+        } else if (arg == "--gpu-driven") {
+            mEngineConfig.enableGPUDrivenRendering = true;
+            fmt::println("Enabled gpu driven rendering");
+        } else if (arg == "--no-meshlets") {
+            mEngineConfig.enableMeshletCulling = false;
+            fmt::println("Disabled meshlet culling");
+        } else if (arg == "--no-instancing") {
+            mEngineConfig.enableInstancing = false;
+            fmt::println("Disabled instancing");
+        } else if (arg == "--compact-vertices") {
+            mEngineConfig.enableCompactVertices = true;
+            fmt::println("Enabled compact vertices");
+        } else if (arg == "--no-lods") {
+            mEngineConfig.enableLods = false;
+            fmt::println("Disabled lods");
+        } else if (arg.starts_with("--lod-bias=")) {
+            mEngineConfig.lodBias = std::stof(arg.substr(arg.find('=') + 1));
+        } else if (arg == "--no-bindless") {
+            mEngineConfig.enableBindlessMaterials = false;
+            fmt::println("Disabled bindless materials");
+        } else if (arg == "--occlusion-culling") {
+            mEngineConfig.enableOcclusionCulling = true;
+            fmt::println("Enabled occlusion culling");
+        } else if (arg == "--compare-skybox-precompute") {
+            mEngineConfig.compareSkyboxPrecompute = true;
+            fmt::println("Comparing skybox precompute paths");
+        } else if (arg == "--serial-recording") {
+            mEngineConfig.enableParallelRecording = false;
+            fmt::println("Disabled parallel command recording");
+        } else if (arg.starts_with("--capture-trace=")) {
+            mTraceCaptureFrames = std::stoul(arg.substr(arg.find('=') + 1));
+
+            // startup is part of the capture
+            if (mTraceCaptureFrames > 0) {
+                CPUProfiler::startCapture();
+            }
+        } else if (arg == "--headless") {
+            mEngineConfig.headless = true;
+            fmt::println("Rendering headless");
+        } else if (arg.starts_with("--resolution=")) {
+            std::string value = arg.substr(arg.find('=') + 1);
+            size_t separator = value.find('x');
+
+            if (separator == std::string::npos) {
+                fmt::println("Invalid resolution {}, expected <width>x<height>", value);
+                continue;
+            }
+
+            // the draw image is allocated at the maximum size
+            mEngineConfig.headlessExtent.width = std::clamp<uint32_t>(std::stoul(value.substr(0, separator)), 1, MAX_IMAGE_WIDTH);
+            mEngineConfig.headlessExtent.height = std::clamp<uint32_t>(std::stoul(value.substr(separator + 1)), 1, MAX_IMAGE_HEIGHT);
+        } else if (arg.starts_with("--frames=")) {
+            mEngineConfig.frameCount = std::stoul(arg.substr(arg.find('=') + 1));
+        } else if (arg.starts_with("--output=")) {
+            mEngineConfig.headlessOutputPath = arg.substr(arg.find('=') + 1);
+        } else if (arg.starts_with("--scene=")) {
+            mEngineConfig.scenePath = arg.substr(arg.find('=') + 1);
+        } else if (arg.starts_with("--benchmark=")) {
+            mEngineConfig.benchmarkPath = arg.substr(arg.find('=') + 1);
+        } else if (arg.starts_with("--report=")) {
+            mEngineConfig.benchmarkReportPath = arg.substr(arg.find('=') + 1);
+        } else if (arg.starts_with("--target-fps=")) {
+            float targetFPS = std::stof(arg.substr(arg.find('=') + 1));
+
+            if (targetFPS > 0.f) {
+                mEngineConfig.enableDynamicResolution = true;
+                mEngineConfig.dynamicResolution.targetFrameTime = 1000.f / targetFPS;
+                fmt::println("Enabled dynamic resolution targeting {} fps", targetFPS);
+            }
+        } else if (arg.starts_with("--frames-in-flight=")) {
+            mEngineConfig.framesInFlight = std::clamp<uint32_t>(std::stoul(arg.substr(arg.find('=') + 1)), 1, MAX_FRAMES_IN_FLIGHT);
+            fmt::println("Using {} frames in flight", mEngineConfig.framesInFlight);
         }
     }
 }
 
 void VulkanEngine::init(const std::vector<std::string>& cliArgs)
 {
+    CPUProfiler::setThreadName("main");
+
     // parse cli args
     parseCliArgs(cliArgs);
 
-    // create window
-    mWindow = std::make_unique<Window>("Vulkan Engine", VkExtent2D{1600, 900}, *this);
+    if (!mEngineConfig.benchmarkPath.empty()) {
+        std::optional<CameraPath> path = CameraPath::load(mEngineConfig.benchmarkPath);
 
-    mMainDeletionQueue.push([&]() {
-        mWindow = nullptr;
-    });
+        if (path) {
+            mBenchmark = std::make_unique<FlythroughBenchmark>(std::move(*path), mEngineConfig.frameCount);
+        }
+    } else if (mEngineConfig.headless && mEngineConfig.frameCount == 0) {
+        mEngineConfig.frameCount = DEFAULT_HEADLESS_FRAME_COUNT;
+    }
+
+    // create window, headless runs only render offscreen
+    if (!mEngineConfig.headless) {
+        mWindow = std::make_unique<Window>("Vulkan Engine", VkExtent2D{1600, 900}, *this);
+
+        mMainDeletionQueue.push([&]() {
+            mWindow = nullptr;
+        });
+    } else {
+        for (int16_t i = GLFW_KEY_UNKNOWN; i <= GLFW_KEY_LAST; i++) {
+            mHeadlessInput.keyStates[i] = InputState::IDLE;
+        }
+    }
 
     // init vulkan
     initVulkan();
@@ -67,20 +173,56 @@ void VulkanEngine::init(const std::vector<std::string>& cliArgs)
     initSwapchain();
     initCommands();
     initSyncStructs();
-    initImGui();
+
+    if (!mEngineConfig.headless) {
+        initImGui();
+    }
+
     initECS();
     initImages();
 
+    mUploadService = std::make_unique<UploadService>(*this, mTransferQueue, mTransferQueueFamily, mImmediateCommandsQueue, mImmediateCommandsQueueFamily, mQueueMutex);
+    mGeometryPool = std::make_unique<GeometryPool>(*this);
     mAssetManager = std::make_unique<AssetManager>(*this);
     mPipelineResourceManager = std::make_unique<PipelineResourceManager>(*this);
     mComputeEffectsManager = std::make_unique<ComputeEffectsManager>(*this);
+    mIndirectRenderer = std::make_unique<IndirectRenderer>(*this);
+    mParallelRecorder = std::make_unique<ParallelRecorder>(*this, MAX_FRAMES_IN_FLIGHT);
+    mInstanceBatcher = std::make_unique<InstanceBatcher>(*this);
+    mSpriteBatcher = std::make_unique<SpriteBatcher>(*this);
+    mGPUProfiler = std::make_unique<GPUProfiler>(*this, MAX_FRAMES_IN_FLIGHT, mTimestampPeriod, mTimestampValidBits, mSupportsPipelineStatistics);
+
+    mStats.recordTime.resize(mParallelRecorder->getWorkerCount(), 0.f);
+    mStats.recordTimeBuffer.resize(mParallelRecorder->getWorkerCount(), 0.f);
 
     mMainDeletionQueue.push([&]() {
-        mPipelineResourceManager = nullptr;
+        mGPUProfiler = nullptr;
+        mSpriteBatcher = nullptr;
+        mInstanceBatcher = nullptr;
+        mParallelRecorder = nullptr;
+        mIndirectRenderer = nullptr;
+        // loaded gltfs free their material descriptors on destruction
         mAssetManager = nullptr;
+        mPipelineResourceManager = nullptr;
+        mGeometryPool = nullptr;
+        mUploadService = nullptr;
         mComputeEffectsManager = nullptr;
     });
 
+    if (mEngineConfig.headless) {
+        initHeadlessOutput();
+    }
+
+    // headless runs and benchmarks render the loaded scene from the first frame
+    if (mEngineConfig.headless || mBenchmark) {
+        mScene = std::make_shared<Scene3D>(mEngineConfig.scenePath, *this);
+        mMainDeletionQueue.push([&]() {
+            mScene = nullptr;
+        });
+
+        return;
+    }
+
     mScene = std::make_shared<Scene3D>("assets/scenes/loadingScene.json", *this);
     mMainDeletionQueue.push([&]() {
         mScene = nullptr;
@@ -88,7 +230,9 @@ void VulkanEngine::init(const std::vector<std::string>& cliArgs)
 
     // render loading screen
     std::thread([&](){
-        mLoadingScene = std::make_shared<Scene3D>("assets/scenes/testScene.json", *this);
+        CPUProfiler::setThreadName("scene loader");
+
+        mLoadingScene = std::make_shared<Scene3D>(mEngineConfig.scenePath, *this);
         mScene = mLoadingScene;
         mLoadingScene = nullptr;
 
@@ -151,66 +295,29 @@ void *VulkanEngine::getDataFromBuffer(const AllocatedBuffer& buffer) {
 }
 
 GPUMeshBuffers VulkanEngine::uploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices) {
-    const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
-    const size_t indexBufferSize = indices.size() * sizeof(uint32_t);
-
-    GPUMeshBuffers newMesh;
-
-    // create vertex buffer
-    newMesh.vertexBuffer = createBuffer(
-        vertexBufferSize,
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY
-    );
-
-    // get vertex buffer addess
-    VkBufferDeviceAddressInfo deviceAddressInfo{};
-    deviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
-    deviceAddressInfo.buffer = newMesh.vertexBuffer.buffer;
-
-    newMesh.vertexBufferAddress = vkGetBufferDeviceAddress(mDevice, &deviceAddressInfo);
-
-    // create index buffer
-    newMesh.indexBuffer = createBuffer(
-        indexBufferSize,
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY
-    );
-
-    // copy data to gpu using a staging buffer
-    AllocatedBuffer staging = createBuffer(vertexBufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-
-    void* data = staging.allocation->GetMappedData();
-
-    // copy vertex buffer
-    memcpy(data, vertices.data(), vertexBufferSize);
-
-    // copy index buffer
-    memcpy((char*)data + vertexBufferSize, indices.data(), indexBufferSize);
-
-    immediateSubmit([&](VkCommandBuffer commandBuffer) {
-        VkBufferCopy vertexCopy{};
-        vertexCopy.dstOffset = 0;
-        vertexCopy.srcOffset = 0;
-        vertexCopy.size = vertexBufferSize;
+    return uploadMesh(indices.data(), indices.size(), VK_INDEX_TYPE_UINT32, vertices.data(), vertices.size(), VertexFormat::Full);
+}
 
-        vkCmdCopyBuffer(commandBuffer, staging.buffer, newMesh.vertexBuffer.buffer, 1, &vertexCopy);
+GPUMeshBuffers VulkanEngine::uploadMesh(const void* indices, uint32_t indexCount, VkIndexType indexType, const void* vertices, uint32_t vertexCount, VertexFormat vertexFormat) {
+    PROFILE_SCOPE("upload mesh");
 
-        VkBufferCopy indexCopy{};
-        indexCopy.dstOffset = 0;
-        indexCopy.srcOffset = vertexBufferSize;
-        indexCopy.size = indexBufferSize;
+    const size_t vertexSize = GeometryPool::getVertexSize(vertexFormat);
+    const size_t indexSize = GeometryPool::getIndexSize(indexType);
 
-        vkCmdCopyBuffer(commandBuffer, staging.buffer, newMesh.indexBuffer.buffer, 1, &indexCopy);
-    });
+    // reserve ranges in the shared arenas
+    GPUMeshBuffers newMesh = mGeometryPool->allocate(vertexCount, indexCount, vertexFormat, indexType);
+    newMesh.id = mNextMeshId++;
 
-    // cleanup staging buffer
-    destroyBuffer(staging);
+    // copies go out with the next upload batch, draws wait on it on the gpu
+    mUploadService->uploadBuffer(newMesh.vertexBuffer, (VkDeviceSize)newMesh.vertexOffset * vertexSize, vertices, vertexCount * vertexSize);
+    mUploadService->uploadBuffer(newMesh.indexBuffer, (VkDeviceSize)newMesh.firstIndex * indexSize, indices, indexCount * indexSize);
 
     return newMesh;
 }
 
 void VulkanEngine::immediateSubmit(std::function<void(VkCommandBuffer commandBuffer)>&& function, bool waitResult) {
+    PROFILE_SCOPE("immediate submit");
+
     // reset imd cmd fence and command buffer
     VK_CHECK(vkResetFences(mDevice, 1, &mImmFence));
     VK_CHECK(vkResetCommandBuffer(mImmCommandBuffer, 0));
@@ -230,17 +337,85 @@ void VulkanEngine::immediateSubmit(std::function<void(VkCommandBuffer commandBuf
     VkCommandBufferSubmitInfo commandInfo = vkinit::command_buffer_submit_info(commandBuffer);
     VkSubmitInfo2 submitInfo = vkinit::submit_info(&commandInfo, nullptr, nullptr);
 
+    // commands may read resources whose uploads are still in flight
+    VkSemaphoreSubmitInfo uploadWaitInfo{};
+
+    if (mUploadService) {
+        uploadWaitInfo = mUploadService->getWaitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+
+        submitInfo.waitSemaphoreInfoCount = 1;
+        submitInfo.pWaitSemaphoreInfos = &uploadWaitInfo;
+    }
+
     // submit command buffer to queue
-    VK_CHECK(vkQueueSubmit2(mImmediateCommandsQueue, 1, &submitInfo, mImmFence));
+    {
+        std::scoped_lock lock(mQueueMutex);
+        VK_CHECK(vkQueueSubmit2(mImmediateCommandsQueue, 1, &submitInfo, mImmFence));
+    }
 
     VK_CHECK(vkWaitForFences(mDevice, 1, &mImmFence, true, UINT64_MAX));
 
     // TODO: maybe make this more efficient
     if (waitResult) {
+        std::scoped_lock lock(mQueueMutex);
         vkQueueWaitIdle(mImmediateCommandsQueue);
     }
 }
 
+void VulkanEngine::waitForFrame() {
+    PROFILE_SCOPE("wait for frame");
+
+    auto start = std::chrono::system_clock::now();
+
+    // frames in flight changes drain the gpu, so every frame's resources can be reused right away
+    if (mEngineConfig.framesInFlight != mFramesInFlight) {
+        mEngineConfig.framesInFlight = std::clamp(mEngineConfig.framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &mFrameTimeline;
+        waitInfo.pValues = &mFrameTimelineValue;
+
+        VK_CHECK(vkWaitSemaphores(mDevice, &waitInfo, UINT64_MAX));
+
+        for (auto& frame : mFrames) {
+            frame.deletionQueue.flush();
+        }
+
+        mFramesInFlight = mEngineConfig.framesInFlight;
+        mFrameNumber = 0;
+    }
+
+    // wait until the gpu is done with the last submission using this frame's resources
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &mFrameTimeline;
+    waitInfo.pValues = &getCurrentFrame().timelineValue;
+
+    VK_CHECK(vkWaitSemaphores(mDevice, &waitInfo, UINT64_MAX));
+
+    auto end = std::chrono::system_clock::now();
+    mStats.cpuWaitTimeBuffer += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.f;
+
+    // flush deletion queue of current frame
+    getCurrentFrame().deletionQueue.flush();
+}
+
+VkSemaphoreSubmitInfo VulkanEngine::getFrameSignalInfo() {
+    getCurrentFrame().timelineValue = ++mFrameTimelineValue;
+
+    VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, mFrameTimeline);
+    signalInfo.value = mFrameTimelineValue;
+
+    return signalInfo;
+}
+
+void VulkanEngine::advanceFrame() {
+    mFrameNumber = (mFrameNumber + 1) % mFramesInFlight;
+}
+
 void VulkanEngine::initVulkan() {
     // init volk
     VK_CHECK(volkInitialize());
@@ -248,17 +423,25 @@ void VulkanEngine::initVulkan() {
     // build vulkan instance using vkbootstrap
     vkb::InstanceBuilder builder{};
 
-    vkb::Instance vkbInstance = builder.set_app_name("VkEngine")
-        // .request_validation_layers(mUseValidationLayers)
-        .enable_validation_layers(true)
+    builder.set_app_name("VkEngine")
         .use_default_debug_messenger()
         .require_api_version(1, 3, 0)
-        .enable_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)
-        .enable_extension(VK_KHR_DISPLAY_EXTENSION_NAME) // enable display info
-        .enable_extension(VK_KHR_SURFACE_EXTENSION_NAME)
-        .enable_extensions(mWindow->getGLFWInstanceExtensions())
-        .build()
-        .value();
+        .enable_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+    if (mEngineConfig.headless) {
+        // no surface extensions, validation layers are optional on machines without an sdk
+        builder.set_headless()
+            .request_validation_layers(mUseValidationLayers);
+    } else {
+        builder
+            // .request_validation_layers(mUseValidationLayers)
+            .enable_validation_layers(true)
+            .enable_extension(VK_KHR_DISPLAY_EXTENSION_NAME) // enable display info
+            .enable_extension(VK_KHR_SURFACE_EXTENSION_NAME)
+            .enable_extensions(mWindow->getGLFWInstanceExtensions());
+    }
+
+    vkb::Instance vkbInstance = builder.build().value();
 
     // get instance and messenger from vkbInstance
     mInstance = vkbInstance.instance;
@@ -277,6 +460,10 @@ void VulkanEngine::initVulkan() {
     features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     features12.bufferDeviceAddress = true;
     features12.descriptorIndexing = true;
+    features12.runtimeDescriptorArray = true;
+    features12.descriptorBindingPartiallyBound = true;
+    features12.drawIndirectCount = true;
+    features12.timelineSemaphore = true;
 
     VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures{};
     descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
@@ -288,14 +475,20 @@ void VulkanEngine::initVulkan() {
 
     VkPhysicalDeviceFeatures physicalDeviceFeatures{};
     physicalDeviceFeatures.samplerAnisotropy = VK_TRUE;
+    physicalDeviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    physicalDeviceFeatures.multiDrawIndirect = VK_TRUE;
+    physicalDeviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
 
     vkb::PhysicalDeviceSelector vkbSelector{vkbInstance};
 
+    if (!mEngineConfig.headless) {
+        vkbSelector.set_surface(mWindow->getSurface());
+    }
+
     vkbSelector
         .set_minimum_version(1, 3)
         .set_required_features_13(features13)
         .set_required_features_12(features12)
-        .set_surface(mWindow->getSurface())
         .prefer_gpu_device_type(vkb::PreferredDeviceType::discrete)
         .add_required_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME)
         .add_required_extension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)
@@ -303,7 +496,9 @@ void VulkanEngine::initVulkan() {
         .set_required_features(physicalDeviceFeatures);
 
     auto devices = vkbSelector.select_devices(vkb::DeviceSelectionMode::only_fully_suitable).value();
-    vkb::PhysicalDevice vkbPhysicalDevice;
+
+    // prefer nvidia gpus, fall back to the first suitable device (e.g. lavapipe)
+    vkb::PhysicalDevice vkbPhysicalDevice = devices[0];
 
     for (auto dev : devices) {
         fmt::println("found device: {}", dev.name);
@@ -315,42 +510,58 @@ void VulkanEngine::initVulkan() {
 
     fmt::println("Physical Device name: {}", vkbPhysicalDevice.name);
 
+    // optional features used by the gpu profiler
+    VkPhysicalDeviceFeatures statisticsFeatures{};
+    statisticsFeatures.pipelineStatisticsQuery = VK_TRUE;
+    mSupportsPipelineStatistics = vkbPhysicalDevice.enable_features_if_present(statisticsFeatures);
+
+    VkPhysicalDeviceFeatures inheritedQueryFeatures{};
+    inheritedQueryFeatures.inheritedQueries = VK_TRUE;
+    mSupportsInheritedQueries = mSupportsPipelineStatistics && vkbPhysicalDevice.enable_features_if_present(inheritedQueryFeatures);
+
     // create logical device using vkbootstrap
     std::vector<vkb::CustomQueueDescription> queueDescriptions;
     auto queueFamilies = vkbPhysicalDevice.get_queue_families();
 
     for (uint32_t i = 0; i < queueFamilies.size(); i++) {
         if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            // use a second queue for immediate commands if the family has one
+            std::vector<float> priorities = {1.0f, 0.8f};
+            priorities.resize(std::min<uint32_t>(queueFamilies[i].queueCount, 2));
+
             queueDescriptions.push_back(vkb::CustomQueueDescription{
                 i,
-                std::vector<float> {
-                    1.0f,
-                    0.8f
-                }
+                priorities
             });
 
             mGraphicsQueueFamily = i;
             mImmediateCommandsQueueFamily = i;
+            mTimestampValidBits = queueFamilies[i].timestampValidBits;
 
             break;
         }
     }
 
-    // for (uint32_t i = 1; i < queueFamilies.size(); i++) {
-    //     if (queueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT) {
-    //         std::cout << "Transfer queue count: " << queueFamilies[i].queueCount << "\n";
-    //         queueDescriptions.push_back(vkb::CustomQueueDescription{
-    //             i,
-    //             std::vector<float> {
-    //                 1.0f
-    //             }
-    //         });
+    // prefer a transfer only family (dma engine), then any non graphics family with transfer support
+    mTransferQueueFamily = mGraphicsQueueFamily;
+
+    for (VkQueueFlags excluded : {VkQueueFlags(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT), VkQueueFlags(VK_QUEUE_GRAPHICS_BIT)}) {
+        for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+            if ((queueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilies[i].queueFlags & excluded)) {
+                mTransferQueueFamily = i;
+                break;
+            }
+        }
 
-    //         mImmediateCommandsQueueFamily = i;
+        if (mTransferQueueFamily != mGraphicsQueueFamily) {
+            queueDescriptions.push_back(vkb::CustomQueueDescription{
+                mTransferQueueFamily,
+                std::vector<float>{1.0f}
+            });
 
-    //         break;
-    //     }
-    // }
+            break;
+        }
+    }
 
     vkb::DeviceBuilder vkbDeviceBuilder{vkbPhysicalDevice};
     vkb::Device vkbDevice = vkbDeviceBuilder.custom_queue_setup(queueDescriptions).build().value();
@@ -363,7 +574,14 @@ void VulkanEngine::initVulkan() {
 
     // get queues
     vkGetDeviceQueue(mDevice, mGraphicsQueueFamily, 0, &mGraphicsQueue);
-    vkGetDeviceQueue(mDevice, mImmediateCommandsQueueFamily, 1, &mImmediateCommandsQueue);
+    vkGetDeviceQueue(mDevice, mImmediateCommandsQueueFamily, queueDescriptions[0].priorities.size() - 1, &mImmediateCommandsQueue);
+
+    // without a separate family uploads share the immediate commands queue
+    if (mTransferQueueFamily != mGraphicsQueueFamily) {
+        vkGetDeviceQueue(mDevice, mTransferQueueFamily, 0, &mTransferQueue);
+    } else {
+        mTransferQueue = mImmediateCommandsQueue;
+    }
 
     // get descriptor buffer properties
     mDescriptorBufferProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
@@ -375,6 +593,7 @@ void VulkanEngine::initVulkan() {
     vkGetPhysicalDeviceProperties2KHR(mPhysicalDevice, &deviceProperties);
 
     mMaxSamplerAnisotropy = deviceProperties.properties.limits.maxSamplerAnisotropy;
+    mTimestampPeriod = deviceProperties.properties.limits.timestampPeriod;
 }
 
 void VulkanEngine::initVMA() {
@@ -420,6 +639,10 @@ void VulkanEngine::initVMA() {
 }
 
 void VulkanEngine::initSwapchain() {
+    if (mEngineConfig.headless) {
+        return;
+    }
+
     mWindow->createSwapchain(VK_PRESENT_MODE_IMMEDIATE_KHR);
 }
 
@@ -505,12 +728,24 @@ void VulkanEngine::initSyncStructs() {
     VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphore_create_info();
 
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        VK_CHECK(vkCreateFence(mDevice, &fenceCreateInfo, nullptr, &mFrames[i].renderFence));
-
         VK_CHECK(vkCreateSemaphore(mDevice, &semaphoreCreateInfo, nullptr, &mFrames[i].swapchainSemaphore));
         VK_CHECK(vkCreateSemaphore(mDevice, &semaphoreCreateInfo, nullptr, &mFrames[i].renderSemaphore));
     }
 
+    // create frame timeline, frame submissions signal increasing values
+    VkSemaphoreTypeCreateInfo semaphoreTypeInfo{};
+    semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo timelineCreateInfo = vkinit::semaphore_create_info();
+    timelineCreateInfo.pNext = &semaphoreTypeInfo;
+
+    VK_CHECK(vkCreateSemaphore(mDevice, &timelineCreateInfo, nullptr, &mFrameTimeline));
+
+    mFramesInFlight = std::clamp(mEngineConfig.framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+    mEngineConfig.framesInFlight = mFramesInFlight;
+
     // create fence for imm commands
     VK_CHECK(vkCreateFence(mDevice, &fenceCreateInfo, nullptr, &mImmFence));
 
@@ -599,13 +834,14 @@ void VulkanEngine::cleanup() {
         vkDestroyCommandPool(mDevice, mFrames[i].commandPool, nullptr);
 
         // destroy sync objects
-        vkDestroyFence(mDevice, mFrames[i].renderFence, nullptr);
         vkDestroySemaphore(mDevice, mFrames[i].swapchainSemaphore, nullptr);
         vkDestroySemaphore(mDevice, mFrames[i].renderSemaphore, nullptr);
 
         mFrames[i].deletionQueue.flush();
     }
 
+    vkDestroySemaphore(mDevice, mFrameTimeline, nullptr);
+
     mMainDeletionQueue.flush();
 
     vkDestroyDevice(mDevice, nullptr);
@@ -616,7 +852,7 @@ void VulkanEngine::cleanup() {
 
 void VulkanEngine::drawImGui(VkCommandBuffer commandBuffer, VkImageView targetImageView) {
     VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(targetImageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-    VkRenderingInfo renderInfo = vkinit::rendering_info(mWindow->getExtent(), &colorAttachment, nullptr);
+    VkRenderingInfo renderInfo = vkinit::rendering_info(getOutputExtent(), &colorAttachment, nullptr);
 
     vkCmdBeginRendering(commandBuffer, &renderInfo);
 
@@ -627,36 +863,97 @@ void VulkanEngine::drawImGui(VkCommandBuffer commandBuffer, VkImageView targetIm
 
 void VulkanEngine::run() {
     auto currentTime = std::chrono::system_clock::now();
+    auto runStart = currentTime;
 
     // main loop
     while (true) {
         // get start time
         auto start = std::chrono::system_clock::now();
 
-        // poll GLFW events
-        mWindow->pollEvents();
-
-        // end loop if window is closed
-        if (mWindow->shouldClose()) {
+        if (mBenchmark && mBenchmark->isFinished()) {
             break;
         }
 
-        // throttle speed if window is minimized
-        if (mWindow->isMinimized()) {
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
-            continue;
+        if (mEngineConfig.headless) {
+            if (!mBenchmark && mHeadlessFrameNumber >= mEngineConfig.frameCount) {
+                break;
+            }
+        } else {
+            // poll GLFW events
+            mWindow->pollEvents();
+
+            if (isKeyPressed(GLFW_KEY_F9)) {
+                toggleTraceCapture();
+            }
+
+            if (isKeyPressed(GLFW_KEY_F10)) {
+                toggleCameraRecording();
+            }
+
+            // end loop if window is closed
+            if (mWindow->shouldClose()) {
+                break;
+            }
+
+            // throttle speed if window is minimized
+            if (mWindow->isMinimized()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+        }
+
+        // stage times of a benchmark frame are taken from the growth of the stats buffers
+        Stats frameStart;
+
+        if (mBenchmark) {
+            frameStart = mStats;
         }
 
-        drawGui();
+        {
+            PROFILE_SCOPE("frame");
+
+            if (!mEngineConfig.headless) {
+                PROFILE_SCOPE("gui");
+                drawGui();
+            }
+
+            // get delta time, headless runs and benchmarks step a fixed time so their frames are reproducible
+            auto newTime = std::chrono::system_clock::now();
+
+            if (mBenchmark) {
+                mDeltaTime = mBenchmark->getTimeStep();
+            } else if (mEngineConfig.headless) {
+                mDeltaTime = HEADLESS_DELTA_TIME;
+            } else {
+                mDeltaTime = std::chrono::duration_cast<std::chrono::microseconds>(newTime - currentTime).count() / 1000000.f;
+            }
+
+            currentTime = newTime;
+
+            if (mBenchmark) {
+                mScene->setCameraOverride(mBenchmark->getCameraMatrix());
+            }
+
+            {
+                PROFILE_SCOPE("update");
+                update();
+            }
 
-        // get delta time
-        auto newTime = std::chrono::system_clock::now();
-        mDeltaTime = std::chrono::duration_cast<std::chrono::microseconds>(newTime - currentTime).count() / 1000000.f;
-        currentTime = newTime;
+            if (mCameraRecording) {
+                mCameraRecording->addFrame(mDeltaTime, mScene->getCameraMatrix(), mWindow->getInput());
+            }
 
-        update();
+            {
+                PROFILE_SCOPE("draw");
+                draw();
+            }
+        }
 
-        draw();
+        updateTraceCapture();
+
+        if (mEngineConfig.headless) {
+            mHeadlessFrameNumber++;
+        }
 
         // get frame end time
         auto end = std::chrono::system_clock::now();
@@ -667,6 +964,12 @@ void VulkanEngine::run() {
         // update stats
         mStats.frameTimeBuffer += elapsed.count() / 1000.f; // convert to microseconds
 
+        if (mBenchmark) {
+            recordBenchmarkFrame(frameStart, elapsed.count() / 1000.f);
+        }
+
+        updateDynamicResolution(elapsed.count() / 1000.f);
+
         mStats.frameCount++;
         mStats.msElapsed += elapsed.count() / 1000.f;
 
@@ -676,12 +979,23 @@ void VulkanEngine::run() {
             mStats.drawGeometryTime = mStats.drawGeometryTimeBuffer / mStats.frameCount;
             mStats.drawTime = mStats.drawTimeBuffer / mStats.frameCount;
             mStats.postEffectsTime = mStats.postEffectsTimeBuffer / mStats.frameCount;
+            mStats.cullTime = mStats.cullTimeBuffer / mStats.frameCount;
+            mStats.sortTime = mStats.sortTimeBuffer / mStats.frameCount;
+            mStats.cpuWaitTime = mStats.cpuWaitTimeBuffer / mStats.frameCount;
 
             mStats.frameTimeBuffer = 0;
             mStats.updateTimeBuffer = 0;
             mStats.drawGeometryTimeBuffer = 0;
             mStats.drawTimeBuffer = 0;
             mStats.postEffectsTimeBuffer = 0;
+            mStats.cullTimeBuffer = 0;
+            mStats.sortTimeBuffer = 0;
+            mStats.cpuWaitTimeBuffer = 0;
+
+            for (uint32_t i = 0; i < mStats.recordTime.size(); i++) {
+                mStats.recordTime[i] = mStats.recordTimeBuffer[i] / mStats.frameCount;
+                mStats.recordTimeBuffer[i] = 0;
+            }
 
             mStats.fps = mStats.frameCount;
 
@@ -691,47 +1005,462 @@ void VulkanEngine::run() {
     }
 
     vkDeviceWaitIdle(mDevice);
+
+    if (mCameraRecording) {
+        toggleCameraRecording();
+    }
+
+    if (mBenchmark) {
+        VkExtent2D extent = getOutputExtent();
+
+        nlohmann::json config = {
+            {"scene", mEngineConfig.scenePath},
+            {"cameraPath", mEngineConfig.benchmarkPath},
+            {"resolution", {extent.width, extent.height}},
+            {"headless", mEngineConfig.headless},
+            {"renderScale", mEngineConfig.renderScale},
+            {"dynamicResolution", mEngineConfig.enableDynamicResolution},
+            {"framesInFlight", mFramesInFlight},
+            {"frustumCulling", mEngineConfig.enableFrustumCulling},
+            {"compactVertices", mEngineConfig.enableCompactVertices},
+            {"lods", mEngineConfig.enableLods},
+            {"lodBias", mEngineConfig.lodBias},
+            {"gpuDrivenRendering", mEngineConfig.enableGPUDrivenRendering},
+            {"meshletCulling", mEngineConfig.enableMeshletCulling},
+            {"drawSorting", mEngineConfig.enableDrawSorting},
+            {"parallelRecording", mEngineConfig.enableParallelRecording},
+            {"instancing", mEngineConfig.enableInstancing},
+            {"bindlessMaterials", mEngineConfig.enableBindlessMaterials}
+        };
+
+        mBenchmark->writeReport(mEngineConfig.benchmarkReportPath, config);
+    }
+
+    if (mEngineConfig.headless) {
+        // frames still in flight when the loop ended
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            writeFrameOutput(i);
+        }
+
+        auto runEnd = std::chrono::system_clock::now();
+        float runTime = std::chrono::duration_cast<std::chrono::microseconds>(runEnd - runStart).count() / 1000.f;
+
+        fmt::println("Rendered {} headless frames at {}x{} in {:.1f} ms, {:.3f} ms per frame",
+            mHeadlessFrameNumber, mEngineConfig.headlessExtent.width, mEngineConfig.headlessExtent.height,
+            runTime, mHeadlessFrameNumber > 0 ? runTime / mHeadlessFrameNumber : 0.f);
+    }
+}
+
+void VulkanEngine::initHeadlessOutput() {
+    for (auto& frame : mPendingOutputFrames) {
+        frame = UINT32_MAX;
+    }
+
+    if (mEngineConfig.headlessOutputPath.empty()) {
+        return;
+    }
+
+    std::filesystem::create_directories(mEngineConfig.headlessOutputPath);
+
+    VkExtent2D extent = mEngineConfig.headlessExtent;
+
+    // the blit converts the hdr draw image to 8 bit colors
+    mOutputImage = createImage(
+        VkExtent3D{extent.width, extent.height, 1},
+        VK_FORMAT_R8G8B8A8_UNORM,
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+    );
+
+    for (auto& buffer : mReadbackBuffers) {
+        buffer = createBuffer((size_t)extent.width * extent.height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+    }
+
+    mMainDeletionQueue.push([&]() {
+        destroyImage(mOutputImage);
+
+        for (auto& buffer : mReadbackBuffers) {
+            destroyBuffer(buffer);
+        }
+    });
+
+    fmt::println("Writing headless frames to {}", mEngineConfig.headlessOutputPath);
+}
+
+void VulkanEngine::recordFrameOutput(VkCommandBuffer commandBuffer) {
+    if (mEngineConfig.headlessOutputPath.empty()) {
+        return;
+    }
+
+    VkExtent2D extent = mEngineConfig.headlessExtent;
+
+    vkutil::transitionImage(commandBuffer, mDrawImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    vkutil::transitionImage(commandBuffer, mOutputImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    vkutil::copyImageToImage(commandBuffer, mDrawImage.image, mOutputImage.image, mDrawExtent, extent);
+
+    vkutil::transitionImage(commandBuffer, mOutputImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    VkBufferImageCopy copyRegion{};
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageExtent = {extent.width, extent.height, 1};
+
+    vkCmdCopyImageToBuffer(commandBuffer, mOutputImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mReadbackBuffers[mFrameNumber].buffer, 1, &copyRegion);
+
+    // make the copy visible to the host once the frame's timeline value is reached
+    VkMemoryBarrier2 hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    hostBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    hostBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    hostBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &hostBarrier;
+
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+
+    mPendingOutputFrames[mFrameNumber] = mHeadlessFrameNumber;
+}
+
+void VulkanEngine::writeFrameOutput(uint32_t frameIndex) {
+    uint32_t outputFrame = mPendingOutputFrames[frameIndex];
+
+    if (outputFrame == UINT32_MAX) {
+        return;
+    }
+
+    mPendingOutputFrames[frameIndex] = UINT32_MAX;
+
+    const AllocatedBuffer& buffer = mReadbackBuffers[frameIndex];
+    VK_CHECK(vmaInvalidateAllocation(mAllocator, buffer.allocation, 0, VK_WHOLE_SIZE));
+
+    VkExtent2D extent = mEngineConfig.headlessExtent;
+    std::filesystem::path path = std::filesystem::path(mEngineConfig.headlessOutputPath) / fmt::format("frame_{:05}.png", outputFrame);
+
+    if (!stbi_write_png(path.c_str(), extent.width, extent.height, 4, buffer.allocInfo.pMappedData, extent.width * 4)) {
+        fmt::println("Failed to write headless frame {}", path.string());
+    }
+}
+
+bool VulkanEngine::isKeyPressed(int key) {
+    // hotkeys only come from the window, never from replayed input
+    const Input& input = mWindow->getInput();
+    auto it = input.keyStates.find(glfwGetKeyScancode(key));
+
+    return it != input.keyStates.end() && it->second == InputState::PRESSED;
+}
+
+void VulkanEngine::toggleTraceCapture() {
+    if (CPUProfiler::isCapturing()) {
+        CPUProfiler::stopCapture(fmt::format("cpu_trace_{}.json", mTraceCaptureCount++));
+        mTraceCaptureFrames = 0;
+    } else {
+        CPUProfiler::startCapture();
+    }
+}
+
+void VulkanEngine::updateTraceCapture() {
+    // captures started from the cli stop on their own
+    if (mTraceCaptureFrames > 0 && --mTraceCaptureFrames == 0) {
+        toggleTraceCapture();
+    }
 }
 
-bool isVisible(const GLTFRenderObject& obj, const glm::mat4& viewProj) {
-    std::array<glm::vec3, 8> corners {
-        glm::vec3 { 1, 1, 1 },
-        glm::vec3 { 1, 1, -1 },
-        glm::vec3 { 1, -1, 1 },
-        glm::vec3 { 1, -1, -1 },
-        glm::vec3 { -1, 1, 1 },
-        glm::vec3 { -1, 1, -1 },
-        glm::vec3 { -1, -1, 1 },
-        glm::vec3 { -1, -1, -1 },
+void VulkanEngine::toggleCameraRecording() {
+    if (mCameraRecording) {
+        mCameraRecording->save(fmt::format("camera_path_{}.json", mCameraRecordingCount++));
+        mCameraRecording = nullptr;
+    } else {
+        mCameraRecording = std::make_unique<CameraPath>();
+        fmt::println("Started camera path recording");
+    }
+}
+
+void VulkanEngine::recordBenchmarkFrame(const Stats& frameStart, float frameTime) {
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(mAllocator, budgets);
+
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(mAllocator, &memoryProperties);
+
+    uint64_t gpuMemoryUsage = 0;
+
+    for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+        gpuMemoryUsage += budgets[i].usage;
+    }
+
+    FlythroughBenchmark::FrameSample sample{
+        .frameTime = frameTime,
+        .updateTime = mStats.updateTimeBuffer - frameStart.updateTimeBuffer,
+        .drawTime = mStats.drawTimeBuffer - frameStart.drawTimeBuffer,
+        .drawGeometryTime = mStats.drawGeometryTimeBuffer - frameStart.drawGeometryTimeBuffer,
+        .postEffectsTime = mStats.postEffectsTimeBuffer - frameStart.postEffectsTimeBuffer,
+        .cullTime = mStats.cullTimeBuffer - frameStart.cullTimeBuffer,
+        .sortTime = mStats.sortTimeBuffer - frameStart.sortTimeBuffer,
+        .cpuWaitTime = mStats.cpuWaitTimeBuffer - frameStart.cpuWaitTimeBuffer,
+        .drawCallCount = mStats.drawCallCount,
+        .triangleCount = mStats.triangleCount,
+        .gpuMemoryUsage = gpuMemoryUsage
     };
 
-    glm::mat4 matrix = viewProj * obj.transform;
+    mBenchmark->addFrame(sample, mGPUProfiler->getResults());
+}
+
+void VulkanEngine::updateDynamicResolution(float cpuFrameTime) {
+    if (!mEngineConfig.enableDynamicResolution) {
+        return;
+    }
+
+    // the cpu frame time stands in when the gpu can't be timed
+    float frameTime = mGPUProfiler->getFrameTime() > 0.f ? mGPUProfiler->getFrameTime() : cpuFrameTime;
+
+    mEngineConfig.renderScale = mResolutionGovernor.update(frameTime, mEngineConfig.renderScale, mEngineConfig.dynamicResolution, *mComputeEffectsManager);
+}
 
-    glm::vec3 min = { 1.5, 1.5, 1.5 };
-    glm::vec3 max = { -1.5, -1.5, -1.5 };
+void VulkanEngine::cullObjects(const std::vector<GLTFRenderObject>& objects, uint64_t version, FrustumCuller& culler, uint64_t& cullerVersion, std::vector<uint32_t>& outIndices) {
+    PROFILE_SCOPE("cull");
 
-    for (int c = 0; c < 8; c++) {
-        // project each corner into clip space
-        glm::vec4 v = matrix * glm::vec4(obj.bounds.origin + (corners[c] * obj.bounds.extents), 1.f);
+    if (!mEngineConfig.enableFrustumCulling) {
+        outIndices.resize(objects.size());
 
-        // perspective correction
-        v.x = v.x / v.w;
-        v.y = v.y / v.w;
-        v.z = v.z / v.w;
+        for (uint32_t i = 0; i < objects.size(); i++) {
+            outIndices[i] = i;
+        }
 
-        min = glm::min(glm::vec3 { v.x, v.y, v.z }, min);
-        max = glm::max(glm::vec3 { v.x, v.y, v.z }, max);
+        return;
     }
 
-    // check the clip space box is within the view
-    if (min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f) {
-        return false;
+    // update world space bounds, only needed when the render list changed
+    if (version != cullerVersion) {
+        culler.resize(objects.size());
+
+        for (uint32_t i = 0; i < objects.size(); i++) {
+            const GLTFRenderObject& object = objects[i];
+
+            culler.setBounds(i, object.bounds.origin, object.bounds.extents, object.bounds.sphereRadius, object.transform);
+        }
+
+        cullerVersion = version;
+    }
+
+    FrustumCuller::Frustum frustum = FrustumCuller::extractFrustum(
+        mRenderContext.sceneData.viewProjection,
+        mRenderContext.sceneData.viewPosition,
+        mRenderContext.sceneData.projection[1][1]
+    );
+
+    culler.cull(frustum, mEngineConfig.minScreenSize, outIndices);
+}
+
+void VulkanEngine::occlusionCull(const std::vector<GLTFRenderObject>& opaqueObjects, const std::vector<GLTFRenderObject>& transparentObjects, bool gpuDriven) {
+    PROFILE_SCOPE("occlusion cull");
+
+    const SceneData& sceneData = mRenderContext.sceneData;
+    glm::vec3 viewPosition = glm::vec3(sceneData.viewPosition);
+    float projectionScale = sceneData.projection[1][1];
+
+    // gpu driven opaque objects aren't culled on the cpu, but can still hide transparent ones
+    mOccluderCandidates.clear();
+
+    auto addCandidate = [&](uint32_t index) {
+        const GLTFRenderObject& object = opaqueObjects[index];
+
+        if (object.occluderIndices == nullptr) {
+            return;
+        }
+
+        glm::vec3 center = glm::vec3(object.transform * glm::vec4(object.bounds.origin, 1.f));
+        float maxScale = std::max({
+            glm::length(glm::vec3(object.transform[0])),
+            glm::length(glm::vec3(object.transform[1])),
+            glm::length(glm::vec3(object.transform[2]))
+        });
+
+        // projected diameter as a fraction of the screen height
+        float distance = std::max(glm::length(center - viewPosition), 0.001f);
+        float screenSize = object.bounds.sphereRadius * maxScale * projectionScale / distance;
+
+        if (object.designatedOccluder) {
+            screenSize = INFINITY;
+        } else if (screenSize < MIN_OCCLUDER_SCREEN_SIZE) {
+            return;
+        }
+
+        mOccluderCandidates.emplace_back(screenSize, index);
+    };
+
+    if (gpuDriven) {
+        for (uint32_t i = 0; i < opaqueObjects.size(); i++) {
+            addCandidate(i);
+        }
     } else {
-        return true;
+        for (auto index : mOpaqueObjectIndices) {
+            addCandidate(index);
+        }
+    }
+
+    uint32_t occluderCount = std::min<uint32_t>(mOccluderCandidates.size(), MAX_OCCLUDERS);
+
+    std::partial_sort(mOccluderCandidates.begin(), mOccluderCandidates.begin() + occluderCount, mOccluderCandidates.end(), [](const auto& a, const auto& b) {
+        return a.first > b.first;
+    });
+
+    mOcclusionCuller.beginFrame(sceneData.viewProjection);
+
+    for (uint32_t i = 0; i < occluderCount; i++) {
+        const GLTFRenderObject& object = opaqueObjects[mOccluderCandidates[i].second];
+        mOcclusionCuller.addOccluder(object.occluderPositions, object.occluderIndices, object.indexCount, object.transform);
+    }
+
+    // the recording workers are idle until drawGeometry
+    mOcclusionCuller.rasterize(&mParallelRecorder->getThreadPool());
+
+    auto removeOccluded = [&](const std::vector<GLTFRenderObject>& objects, std::vector<uint32_t>& indices) {
+        size_t count = indices.size();
+
+        std::erase_if(indices, [&](uint32_t index) {
+            const GLTFRenderObject& object = objects[index];
+            return !mOcclusionCuller.isVisible(object.bounds.origin, object.bounds.extents, object.transform);
+        });
+
+        mStats.occludedCount += count - indices.size();
+    };
+
+    if (!gpuDriven) {
+        removeOccluded(opaqueObjects, mOpaqueObjectIndices);
+    }
+
+    removeOccluded(transparentObjects, mTransparentObjectIndices);
+}
+
+meshlod::View VulkanEngine::getLodView() const {
+    const SceneData& sceneData = mRenderContext.sceneData;
+    float maxError = mEngineConfig.enableLods ? LOD_ERROR_PIXELS * std::exp2(mEngineConfig.lodBias) : 0.f;
+
+    return meshlod::makeView(glm::vec3(sceneData.viewPosition), sceneData.projection[1][1], (float)mDrawExtent.height, maxError);
+}
+
+const GLTFRenderObject* VulkanEngine::selectLod(const GLTFRenderObject& object, const meshlod::View& lodView) {
+    uint32_t lod = meshlod::selectLod({object.lods, object.lodCount}, object.bounds, object.transform, lodView);
+
+    if (lod == 0) {
+        return &object;
+    }
+
+    // copies keep the render list untouched and batch with other objects at the same lod
+    GLTFRenderObject& lodObject = mLodObjects.emplace_back(object);
+    lodObject.firstIndex += object.lods[lod - 1].indexOffset;
+    lodObject.indexCount = object.lods[lod - 1].indexCount;
+
+    return &lodObject;
+}
+
+void VulkanEngine::sortObjects(const std::vector<GLTFRenderObject>& objects, std::vector<uint32_t>& indices, bool transparent) {
+    PROFILE_SCOPE("sort");
+
+    const glm::mat4& view = mRenderContext.sceneData.view;
+
+    bool bindless = mEngineConfig.enableBindlessMaterials;
+
+    mSortEntries.resize(indices.size());
+
+    for (uint32_t i = 0; i < indices.size(); i++) {
+        const GLTFRenderObject& object = objects[indices[i]];
+
+        // view space depth of the bounds center
+        glm::vec4 center = object.transform * glm::vec4(object.bounds.origin, 1.f);
+        float viewDepth = -glm::dot(glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]), center);
+
+        // bindless materials cost no state change, so meshes are grouped instead
+        uint32_t pipelineId = bindless ? object.material->bindlessPipeline->id : object.material->pipeline->id;
+        uint32_t materialId = bindless ? 0 : object.material->id;
+
+        uint64_t key = transparent
+            ? drawsort::makeTransparentKey(pipelineId, materialId, object.meshId, viewDepth)
+            : drawsort::makeOpaqueKey(pipelineId, materialId, object.meshId, viewDepth);
+
+        mSortEntries[i] = drawsort::Entry{key, indices[i]};
+    }
+
+    drawsort::radixSort(mSortEntries, mSortScratch);
+
+    for (uint32_t i = 0; i < indices.size(); i++) {
+        indices[i] = mSortEntries[i].index;
+    }
+}
+
+void VulkanEngine::buildDrawLists() {
+    PROFILE_SCOPE("build draw lists");
+
+    // cull objects before sorting so only visible ones get sorted
+    auto cullStart = std::chrono::system_clock::now();
+
+    static const std::vector<GLTFRenderObject> noObjects;
+
+    const RenderList* renderList = mRenderContext.renderList.get();
+    const std::vector<GLTFRenderObject>& opaqueObjects = renderList ? renderList->getOpaqueObjects() : noObjects;
+    const std::vector<GLTFRenderObject>& transparentObjects = renderList ? renderList->getTransparentObjects() : noObjects;
+    uint64_t opaqueVersion = renderList ? renderList->getOpaqueVersion() : 0;
+    uint64_t transparentVersion = renderList ? renderList->getTransparentVersion() : 0;
+
+    // gpu driven opaque objects are culled in drawGeometry, once the frame's buffers are free
+    bool gpuDriven = mEngineConfig.enableGPUDrivenRendering;
+
+    if (!gpuDriven) {
+        cullObjects(opaqueObjects, opaqueVersion, mOpaqueCuller, mOpaqueCullerVersion, mOpaqueObjectIndices);
+    }
+
+    cullObjects(transparentObjects, transparentVersion, mTransparentCuller, mTransparentCullerVersion, mTransparentObjectIndices);
+
+    mStats.occludedCount = 0;
+
+    if (mEngineConfig.enableOcclusionCulling) {
+        occlusionCull(opaqueObjects, transparentObjects, gpuDriven);
+    }
+
+    auto cullEnd = std::chrono::system_clock::now();
+    mStats.cullTimeBuffer += std::chrono::duration_cast<std::chrono::microseconds>(cullEnd - cullStart).count() / 1000.f;
+
+    // sort objects by packed state and depth keys
+    if (mEngineConfig.enableDrawSorting) {
+        auto sortStart = std::chrono::system_clock::now();
+
+        if (!gpuDriven) {
+            sortObjects(opaqueObjects, mOpaqueObjectIndices, false);
+        }
+
+        sortObjects(transparentObjects, mTransparentObjectIndices, true);
+
+        auto sortEnd = std::chrono::system_clock::now();
+        mStats.sortTimeBuffer += std::chrono::duration_cast<std::chrono::microseconds>(sortEnd - sortStart).count() / 1000.f;
+    }
+
+    // merge visible objects into instanced batches, transparent batches are drawn after opaque ones
+    mOpaqueDrawList.clear();
+    mTransparentDrawList.clear();
+    mLodObjects.clear();
+
+    meshlod::View lodView = getLodView();
+
+    if (!gpuDriven) {
+        for (auto& index : mOpaqueObjectIndices) {
+            mOpaqueDrawList.push_back(selectLod(opaqueObjects[index], lodView));
+        }
+    }
+
+    for (auto& index : mTransparentObjectIndices) {
+        mTransparentDrawList.push_back(selectLod(transparentObjects[index], lodView));
     }
+
+    mDrawListsGPUDriven = gpuDriven;
 }
 
 void VulkanEngine::drawGeometry(VkCommandBuffer commandBuffer) {
+    PROFILE_SCOPE("draw geometry");
+
     // reset stat counters
     mStats.drawCallCount = 0;
     mStats.triangleCount = 0;
@@ -739,56 +1468,180 @@ void VulkanEngine::drawGeometry(VkCommandBuffer commandBuffer) {
     // get start time
     auto start = std::chrono::system_clock::now();
 
-    std::vector<uint32_t> opaqueObjectIndices;
-    opaqueObjectIndices.reserve(mRenderContext.opaqueObjects.size());
+    bool gpuDriven = mDrawListsGPUDriven;
 
-    for (uint32_t i = 0; i < mRenderContext.opaqueObjects.size(); i++) {
-        opaqueObjectIndices.push_back(i);
-    }
+    // secondary command buffers can only run inside a statistics query with inherited queries
+    bool collectStatistics = !mEngineConfig.enableParallelRecording || mSupportsInheritedQueries;
+    uint32_t geometryScope = mGPUProfiler->beginScope(commandBuffer, "geometry", GPUProfiler::NO_SCOPE, collectStatistics);
 
-    // sort opaque objects by material and mesh
-    if (mEngineConfig.enableDrawSorting) {
-        std::sort(opaqueObjectIndices.begin(), opaqueObjectIndices.end(), [&](const auto& iA, const auto& iB) {
-            const GLTFRenderObject& A = mRenderContext.opaqueObjects[iA];
-            const GLTFRenderObject& B = mRenderContext.opaqueObjects[iB];
+    if (gpuDriven) {
+        static const std::vector<GLTFRenderObject> noObjects;
 
-            if (A.material == B.material) {
-                return A.indexBuffer < B.indexBuffer;
-            } else {
-                return A.material < B.material;
+        const RenderList* renderList = mRenderContext.renderList.get();
+        const std::vector<GLTFRenderObject>& opaqueObjects = renderList ? renderList->getOpaqueObjects() : noObjects;
+
+        // opaque objects are culled on the gpu, record the culling pass before rendering starts
+        auto cullStart = std::chrono::system_clock::now();
+
+        PROFILE_SCOPE("gpu driven prepare");
+
+        mOpaqueObjectIndices.clear();
+
+        uint32_t cullScope = mGPUProfiler->beginScope(commandBuffer, "gpu culling", geometryScope);
+        meshlod::View lodView = getLodView();
+
+        mIndirectRenderer->prepare(commandBuffer, opaqueObjects, mRenderContext.sceneData.viewProjection, lodView, mEngineConfig.enableFrustumCulling, mEngineConfig.enableMeshletCulling, mFrameNumber);
+        mGPUProfiler->endScope(commandBuffer, cullScope);
+
+        // asset instanced objects are few, test them one by one
+        for (auto index : mIndirectRenderer->getHostObjects()) {
+            const GLTFRenderObject& object = opaqueObjects[index];
+
+            if (!mEngineConfig.enableFrustumCulling ||
+                FrustumCuller::isVisibleProjected(object.bounds.origin, object.bounds.extents, object.transform, mRenderContext.sceneData.viewProjection)) {
+                mOpaqueObjectIndices.push_back(index);
             }
-        });
-    }
+        }
+
+        auto cullEnd = std::chrono::system_clock::now();
+        mStats.cullTimeBuffer += std::chrono::duration_cast<std::chrono::microseconds>(cullEnd - cullStart).count() / 1000.f;
+
+        if (mEngineConfig.enableDrawSorting) {
+            auto sortStart = std::chrono::system_clock::now();
 
-    std::vector<uint32_t> transparentObjectIndices;
-    transparentObjectIndices.reserve(mRenderContext.transparentObjects.size());
+            sortObjects(opaqueObjects, mOpaqueObjectIndices, false);
 
-    for (uint32_t i = 0; i < mRenderContext.transparentObjects.size(); i++) {
-        transparentObjectIndices.push_back(i);
+            auto sortEnd = std::chrono::system_clock::now();
+            mStats.sortTimeBuffer += std::chrono::duration_cast<std::chrono::microseconds>(sortEnd - sortStart).count() / 1000.f;
+        }
+
+        for (auto& index : mOpaqueObjectIndices) {
+            mOpaqueDrawList.push_back(selectLod(opaqueObjects[index], lodView));
+        }
     }
 
-    // sort transparent objects by material and mesh
-    if (mEngineConfig.enableDrawSorting) {
-        std::sort(transparentObjectIndices.begin(), transparentObjectIndices.end(), [&](const auto& iA, const auto& iB) {
-            const GLTFRenderObject& A = mRenderContext.transparentObjects[iA];
-            const GLTFRenderObject& B = mRenderContext.transparentObjects[iB];
+    mInstanceBatcher->build(mOpaqueDrawList, mTransparentDrawList, mEngineConfig.enableInstancing, mFrameNumber);
 
-            if (A.material == B.material) {
-                return A.indexBuffer < B.indexBuffer;
-            } else {
-                return A.material < B.material;
-            }
-        });
+    mSpriteBatcher->prepare(mRenderContext.sprites, mDrawExtent, mFrameNumber);
+
+    if (mEngineConfig.enableParallelRecording) {
+        recordGeometryParallel(commandBuffer, gpuDriven, geometryScope);
+    } else {
+        VkClearValue clearValue{};
+        clearValue.color = {1.0, 1.0, 0.0, 1.0};
+        VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(mDrawImage.imageView, &clearValue, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        VkRenderingAttachmentInfo depthAttachment = vkinit::depth_attachment_info(mDepthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+
+        VkRenderingInfo renderInfo = vkinit::rendering_info(mDrawExtent, &colorAttachment, &depthAttachment);
+        vkCmdBeginRendering(commandBuffer, &renderInfo);
+
+        beginDrawState(commandBuffer);
+
+        DrawStats stats;
+
+        if (gpuDriven) {
+            // triangle counts are only known on the gpu, so only draw calls are counted
+            stats.drawCallCount += mIndirectRenderer->draw(commandBuffer, *mScene, mFrameNumber);
+        }
+
+        recordBatches(commandBuffer, mInstanceBatcher->getBatches(), stats);
+        recordSkyboxAndSprites(commandBuffer, stats, geometryScope);
+
+        vkCmdEndRendering(commandBuffer);
+
+        mStats.drawCallCount += stats.drawCallCount;
+        mStats.triangleCount += stats.triangleCount;
     }
 
+    mGPUProfiler->endScope(commandBuffer, geometryScope);
+
+    // get end time
+    auto end = std::chrono::system_clock::now();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    mStats.drawGeometryTimeBuffer += elapsed.count() / 1000.f;
+}
+
+void VulkanEngine::recordGeometryParallel(VkCommandBuffer commandBuffer, bool gpuDriven, uint32_t profilerScope) {
+    // small chunks cost more in command buffer overhead than they save
+    constexpr uint32_t MIN_DRAWS_PER_CHUNK = 128;
+    constexpr uint32_t CHUNKS_PER_WORKER = 2;
+
+    uint32_t workerCount = mParallelRecorder->getWorkerCount();
+    const std::vector<InstanceBatcher::Batch>& batches = mInstanceBatcher->getBatches();
+    uint32_t drawCount = batches.size();
+
+    uint32_t chunkCount = (drawCount + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK;
+    chunkCount = std::clamp(chunkCount, 1u, workerCount * CHUNKS_PER_WORKER);
+
+    uint32_t chunkSize = (drawCount + chunkCount - 1) / chunkCount;
+
+    // tasks keep submission order: indirect draws, object chunks, then skybox and sprites
+    uint32_t firstChunkTask = gpuDriven ? 1 : 0;
+    uint32_t lastTask = firstChunkTask + chunkCount;
+    uint32_t taskCount = lastTask + 1;
+
+    mChunkStats.assign(taskCount, DrawStats{});
+
+    mParallelRecorder->beginFrame(mFrameNumber);
+
+    VkFormat colorFormat = mDrawImage.imageFormat;
+
+    VkCommandBufferInheritanceRenderingInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritanceInfo.colorAttachmentCount = 1;
+    inheritanceInfo.pColorAttachmentFormats = &colorFormat;
+    inheritanceInfo.depthAttachmentFormat = mDepthImage.imageFormat;
+    inheritanceInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkQueryPipelineStatisticFlags pipelineStatistics = mSupportsInheritedQueries ? GPUProfiler::STATISTIC_FLAGS : 0;
+
+    const std::vector<VkCommandBuffer>& secondaryBuffers = mParallelRecorder->record(taskCount, inheritanceInfo, pipelineStatistics, [&](VkCommandBuffer secondary, uint32_t taskIndex, uint32_t workerIndex) {
+        PROFILE_SCOPE("record chunk");
+
+        // dynamic state and descriptor buffer bindings are not inherited
+        beginDrawState(secondary);
+
+        DrawStats& stats = mChunkStats[taskIndex];
+
+        if (taskIndex < firstChunkTask) {
+            stats.drawCallCount += mIndirectRenderer->draw(secondary, *mScene, mFrameNumber);
+        } else if (taskIndex < lastTask) {
+            uint32_t begin = std::min((taskIndex - firstChunkTask) * chunkSize, drawCount);
+            uint32_t end = std::min(begin + chunkSize, drawCount);
+
+            recordBatches(secondary, std::span(batches).subspan(begin, end - begin), stats);
+        } else {
+            recordSkyboxAndSprites(secondary, stats, profilerScope);
+        }
+    });
+
     VkClearValue clearValue{};
     clearValue.color = {1.0, 1.0, 0.0, 1.0};
     VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(mDrawImage.imageView, &clearValue, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
     VkRenderingAttachmentInfo depthAttachment = vkinit::depth_attachment_info(mDepthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 
     VkRenderingInfo renderInfo = vkinit::rendering_info(mDrawExtent, &colorAttachment, &depthAttachment);
+    renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+
     vkCmdBeginRendering(commandBuffer, &renderInfo);
+    vkCmdExecuteCommands(commandBuffer, secondaryBuffers.size(), secondaryBuffers.data());
+    vkCmdEndRendering(commandBuffer);
+
+    // update stats
+    for (auto& stats : mChunkStats) {
+        mStats.drawCallCount += stats.drawCallCount;
+        mStats.triangleCount += stats.triangleCount;
+    }
+
+    const std::vector<float>& recordTimes = mParallelRecorder->getWorkerRecordTimes();
+
+    for (uint32_t i = 0; i < recordTimes.size(); i++) {
+        mStats.recordTimeBuffer[i] += recordTimes[i];
+    }
+}
 
+void VulkanEngine::beginDrawState(VkCommandBuffer commandBuffer) {
     // set dynamic viewport and scissor
     VkViewport viewport{};
     viewport.x = 0;
@@ -809,67 +1662,115 @@ void VulkanEngine::drawGeometry(VkCommandBuffer commandBuffer) {
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
     mPipelineResourceManager->bindDescriptorBuffers(commandBuffer);
+}
+
+void VulkanEngine::recordBatches(VkCommandBuffer commandBuffer, std::span<const InstanceBatcher::Batch> batches, DrawStats& stats) {
+    if (mEngineConfig.enableBindlessMaterials) {
+        recordBatchesBindless(commandBuffer, batches, stats);
+        return;
+    }
 
     // track state
     Pipeline* lastPipeline = nullptr;
     MaterialInstance* lastMaterialInstance = nullptr;
     VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
 
-    uint32_t bufferIndex = 0;
-    VkDeviceSize bufferOffset = 0;
+    VkDeviceAddress instanceBuffer = mInstanceBatcher->getInstanceBufferAddress(mFrameNumber);
+
+    for (const InstanceBatcher::Batch& batch : batches) {
+        const GLTFRenderObject* object = batch.object;
 
-    auto draw = [&](const GLTFRenderObject& object) {
-        if (object.material != lastMaterialInstance) {
-            lastMaterialInstance = object.material;
+        if (object->material != lastMaterialInstance) {
+            lastMaterialInstance = object->material;
 
-            if (object.material->pipeline != lastPipeline) {
-                lastPipeline = object.material->pipeline;
+            if (object->material->pipeline != lastPipeline) {
+                lastPipeline = object->material->pipeline;
 
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline->pipeline);
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, object->material->pipeline->pipeline);
 
-                mScene->setGlobalDescriptorOffset(commandBuffer, object.material->pipeline->layout, mFrameNumber);
+                mScene->setGlobalDescriptorOffset(commandBuffer, object->material->pipeline->layout, mFrameNumber);
             }
 
-            vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline->layout, 1, 1, &bufferIndex, &object.material->descriptorOffset);
+            const DescriptorAllocation& descriptor = object->material->descriptor;
+            vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, object->material->pipeline->layout, 1, 1, &descriptor.bufferIndex, &descriptor.offset);
         }
 
-        if (object.indexBuffer != lastIndexBuffer) {
-            lastIndexBuffer = object.indexBuffer;
+        if (object->indexBuffer != lastIndexBuffer) {
+            lastIndexBuffer = object->indexBuffer;
 
-            vkCmdBindIndexBuffer(commandBuffer, object.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(commandBuffer, object->indexBuffer, 0, object->indexType);
         }
 
         PBRPushConstants pushConstants;
-        pushConstants.vertexBuffer = object.vertexBufferAddress;
-        pushConstants.worldMatrix = object.transform;
+        pushConstants.vertexBuffer = object->vertexBufferAddress;
+        pushConstants.instanceBuffer = instanceBuffer;
+        pushConstants.positionOffset = glm::vec4(object->positionOffset, 0.f);
+        pushConstants.positionScale = object->positionScale;
+        pushConstants.vertexFormat = object->vertexFormat;
 
-        vkCmdPushConstants(commandBuffer, object.material->pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PBRPushConstants), &pushConstants);
+        vkCmdPushConstants(commandBuffer, object->material->pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PBRPushConstants), &pushConstants);
 
-        vkCmdDrawIndexed(commandBuffer, object.indexCount, 1, object.firstIndex, 0, 0);
+        // world matrices are fetched with gl_InstanceIndex, which starts at the first instance
+        vkCmdDrawIndexed(commandBuffer, object->indexCount, batch.instanceCount, object->firstIndex, object->vertexOffset, batch.firstInstance);
 
         // update stats
-        mStats.drawCallCount++;
-        mStats.triangleCount += object.indexCount / 3;
-    };
+        stats.drawCallCount++;
+        stats.triangleCount += object->indexCount / 3 * batch.instanceCount;
+    }
+}
 
-    for (auto& index : opaqueObjectIndices) {
-        if (mEngineConfig.enableFrustumCulling && !isVisible(mRenderContext.opaqueObjects[index], mRenderContext.sceneData.viewProjection))
-            continue;
+void VulkanEngine::recordBatchesBindless(VkCommandBuffer commandBuffer, std::span<const InstanceBatcher::Batch> batches, DrawStats& stats) {
+    // track state, materials only change a push constant
+    Pipeline* lastPipeline = nullptr;
+    VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
 
-        draw(mRenderContext.opaqueObjects[index]);
-    }
+    const DescriptorAllocation& bindlessDescriptor = mPipelineResourceManager->getBindlessDescriptor();
+
+    VkDeviceAddress instanceBuffer = mInstanceBatcher->getInstanceBufferAddress(mFrameNumber);
 
-    // draw transparent objects after opaque ones
-    for (auto& index : transparentObjectIndices) {
-        if (mEngineConfig.enableFrustumCulling && !isVisible(mRenderContext.transparentObjects[index], mRenderContext.sceneData.viewProjection))
-            continue;
+    for (const InstanceBatcher::Batch& batch : batches) {
+        const GLTFRenderObject* object = batch.object;
+        Pipeline* pipeline = object->material->bindlessPipeline;
 
-        draw(mRenderContext.transparentObjects[index]);
+        if (pipeline != lastPipeline) {
+            lastPipeline = pipeline;
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+
+            mScene->setGlobalDescriptorOffset(commandBuffer, pipeline->layout, mFrameNumber);
+            vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 1, 1, &bindlessDescriptor.bufferIndex, &bindlessDescriptor.offset);
+        }
+
+        if (object->indexBuffer != lastIndexBuffer) {
+            lastIndexBuffer = object->indexBuffer;
+
+            vkCmdBindIndexBuffer(commandBuffer, object->indexBuffer, 0, object->indexType);
+        }
+
+        PBRBindlessPushConstants pushConstants;
+        pushConstants.vertexBuffer = object->vertexBufferAddress;
+        pushConstants.instanceBuffer = instanceBuffer;
+        pushConstants.positionOffset = glm::vec4(object->positionOffset, 0.f);
+        pushConstants.positionScale = object->positionScale;
+        pushConstants.vertexFormat = object->vertexFormat;
+        pushConstants.materialIndex = object->material->materialIndex;
+
+        vkCmdPushConstants(commandBuffer, pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PBRBindlessPushConstants), &pushConstants);
+
+        vkCmdDrawIndexed(commandBuffer, object->indexCount, batch.instanceCount, object->firstIndex, object->vertexOffset, batch.firstInstance);
+
+        // update stats
+        stats.drawCallCount++;
+        stats.triangleCount += object->indexCount / 3 * batch.instanceCount;
     }
+}
 
+void VulkanEngine::recordSkyboxAndSprites(VkCommandBuffer commandBuffer, DrawStats& stats, uint32_t profilerScope) {
     auto linearSampler = *mAssetManager->getSampler("linear");
 
     if (mRenderContext.skybox != nullptr) {
+        uint32_t skyboxScope = mGPUProfiler->beginScope(commandBuffer, "skybox", profilerScope);
+
         auto pipeline = mPipelineResourceManager->getPipeline(PipelineResourceManager::PipelineType::SKYBOX);
         auto cubeMesh = mAssetManager->getMesh("cube");
         SkyboxPushConstants pushConstants{};
@@ -877,7 +1778,7 @@ void VulkanEngine::drawGeometry(VkCommandBuffer commandBuffer) {
         pushConstants.vertexBuffer = cubeMesh->meshBuffers.vertexBufferAddress;
 
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
-        vkCmdBindIndexBuffer(commandBuffer, cubeMesh->meshBuffers.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(commandBuffer, cubeMesh->meshBuffers.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
         DescriptorWriter writer;
         std::vector<VkWriteDescriptorSet> descriptorWrites = writer.writeImage(0, mRenderContext.skybox->envMap.imageView, linearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
@@ -886,45 +1787,18 @@ void VulkanEngine::drawGeometry(VkCommandBuffer commandBuffer) {
         vkCmdPushDescriptorSetKHR(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, (uint32_t)descriptorWrites.size(), descriptorWrites.data());
 
         vkCmdPushConstants(commandBuffer, pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(SkyboxPushConstants), &pushConstants);
-        vkCmdDrawIndexed(commandBuffer, cubeMesh->surfaces[0].count, 1, cubeMesh->surfaces[0].startIndex, 0, 0);
-    }
+        vkCmdDrawIndexed(commandBuffer, cubeMesh->surfaces[0].count, 1, cubeMesh->meshBuffers.firstIndex + cubeMesh->surfaces[0].startIndex, cubeMesh->meshBuffers.vertexOffset, 0);
 
-    auto spritePipeline = mPipelineResourceManager->getPipeline(PipelineResourceManager::PipelineType::SPRITE);
-    auto quadMesh = mAssetManager->getMesh("quad");
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spritePipeline->pipeline);
-    vkCmdBindIndexBuffer(commandBuffer, quadMesh->meshBuffers.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-    glm::mat4 orthoProjection = glm::ortho(0.0f, (float)mDrawExtent.width, 0.0f, (float)mDrawExtent.height, -100.f, 100.f);
-
-    for (auto sprite : mRenderContext.sprites) {
-        // push constants
-        SpritePushConstants pushConstants;
-        pushConstants.vertexBuffer = quadMesh->meshBuffers.vertexBufferAddress;
-        pushConstants.worldMatrix = orthoProjection * sprite.transform;
-
-        vkCmdPushConstants(commandBuffer, spritePipeline->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SpritePushConstants), &pushConstants);
-
-        // push descriptors
-        DescriptorWriter writer;
-        std::vector<VkWriteDescriptorSet> writes = writer.writeImage(0, sprite.image->imageView, linearSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
-                                                         .getWrites();
-
-        vkCmdPushDescriptorSetKHR(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spritePipeline->layout, 0, (uint32_t)writes.size(), writes.data());
-
-        // draw quad
-        vkCmdDrawIndexed(commandBuffer, quadMesh->surfaces[0].count, 1, quadMesh->surfaces[0].startIndex, 0, 0);
-
-        // update stats
-        mStats.drawCallCount++;
-        mStats.triangleCount += quadMesh->surfaces[0].count / 3;
+        mGPUProfiler->endScope(commandBuffer, skyboxScope);
     }
 
-    vkCmdEndRendering(commandBuffer);
+    // sprites were culled and batched in prepare, one instanced draw per layer
+    uint32_t spriteScope = mGPUProfiler->beginScope(commandBuffer, "sprites", profilerScope);
 
-    // get end time
-    auto end = std::chrono::system_clock::now();
+    stats.drawCallCount += mSpriteBatcher->draw(commandBuffer, mFrameNumber);
+    stats.triangleCount += mSpriteBatcher->getVisibleCount() * 2;
 
-    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    mStats.drawGeometryTimeBuffer += elapsed.count() / 1000.f;
+    mGPUProfiler->endScope(commandBuffer, spriteScope);
 }
 
 AllocatedImage VulkanEngine::createImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipMapped, bool createMipViews) {
@@ -1028,6 +1902,23 @@ AllocatedImage VulkanEngine::createCubemap(
 
     VK_CHECK(vkCreateImageView(mDevice, &imageViewInfo, nullptr, &cubemap.imageView));
 
+    // render targets get a view per face and mip, kept for the lifetime of the cubemap
+    if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) {
+        cubemap.faceViews.resize(cubemapInfo.mipLevels * 6);
+
+        for (uint32_t mip = 0; mip < cubemapInfo.mipLevels; mip++) {
+            for (uint32_t face = 0; face < 6; face++) {
+                VkImageViewCreateInfo faceViewInfo = vkinit::imageview_create_info(format, cubemap.image, VK_IMAGE_ASPECT_COLOR_BIT);
+                faceViewInfo.subresourceRange.baseArrayLayer = face;
+                faceViewInfo.subresourceRange.layerCount = 1;
+                faceViewInfo.subresourceRange.baseMipLevel = mip;
+                faceViewInfo.subresourceRange.levelCount = 1;
+
+                VK_CHECK(vkCreateImageView(mDevice, &faceViewInfo, nullptr, &cubemap.faceViews[mip * 6 + face]));
+            }
+        }
+    }
+
     if (color == std::nullopt) {
         return cubemap;
     }
@@ -1040,37 +1931,10 @@ AllocatedImage VulkanEngine::createCubemap(
     }
 
     size_t dataSize = 6 * size.width * size.height * pixelSize;
-    AllocatedBuffer uploadBuffer = createBuffer(dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
     uint32_t colorInt = glm::packUnorm4x8(glm::vec4(color.value(), 1.f));
     std::vector<uint32_t> colorData(dataSize / sizeof(uint32_t), colorInt);
 
-    // copy data to staging buffer
-    memcpy(uploadBuffer.allocInfo.pMappedData, colorData.data(), dataSize);
-
-    immediateSubmit([&](VkCommandBuffer commandBuffer) {
-        vkutil::transitionImage(commandBuffer, cubemap.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-        VkBufferImageCopy copyRegion{};
-        copyRegion.bufferOffset = 0;
-        copyRegion.bufferRowLength = 0;
-        copyRegion.bufferImageHeight = 0;
-
-        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        copyRegion.imageSubresource.mipLevel = 0;
-        copyRegion.imageSubresource.baseArrayLayer = 0;
-        copyRegion.imageSubresource.layerCount = 6;
-        copyRegion.imageExtent = {size.width, size.height, 1};
-
-        vkCmdCopyBufferToImage(commandBuffer, uploadBuffer.buffer, cubemap.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-        if (mipMapped) {
-            vkutil::generateMipmaps(commandBuffer, cubemap.image, VkExtent2D{cubemap.imageExtent.width, cubemap.imageExtent.height});
-        } else {
-            vkutil::transitionImage(commandBuffer, cubemap.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        }
-    });
-
-    destroyBuffer(uploadBuffer);
+    mUploadService->uploadImage(cubemap, colorData.data(), dataSize, 6, mipMapped);
 
     return cubemap;
 }
@@ -1084,37 +1948,11 @@ AllocatedImage VulkanEngine::createImage(void* data, VkExtent3D size, VkFormat f
     }
 
     size_t dataSize = size.depth * size.width * size.height * pixelSize;
-    AllocatedBuffer uploadBuffer = createBuffer(dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-    // copy data to staging buffer
-    memcpy(uploadBuffer.allocInfo.pMappedData, data, dataSize);
 
     AllocatedImage newImage = createImage(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, mipMapped);
 
-    immediateSubmit([&](VkCommandBuffer commandBuffer) {
-        vkutil::transitionImage(commandBuffer, newImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-        VkBufferImageCopy copyRegion{};
-        copyRegion.bufferOffset = 0;
-        copyRegion.bufferRowLength = 0;
-        copyRegion.bufferImageHeight = 0;
-
-        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        copyRegion.imageSubresource.mipLevel = 0;
-        copyRegion.imageSubresource.baseArrayLayer = 0;
-        copyRegion.imageSubresource.layerCount = size.depth;
-        copyRegion.imageExtent = size;
-
-        vkCmdCopyBufferToImage(commandBuffer, uploadBuffer.buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-        if (mipMapped) {
-            vkutil::generateMipmaps(commandBuffer, newImage.image, VkExtent2D{newImage.imageExtent.width, newImage.imageExtent.height});
-        } else {
-            vkutil::transitionImage(commandBuffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        }
-    });
-
-    destroyBuffer(uploadBuffer);
+    // the image is usable once the upload batch completes, graphics submissions wait on it
+    mUploadService->uploadImage(newImage, data, dataSize, size.depth, mipMapped);
 
     return newImage;
 }
@@ -1126,4 +1964,8 @@ void VulkanEngine::destroyImage(const AllocatedImage& image) {
     for (int i = 0; i < image.mipViews.size(); i++) {
         vkDestroyImageView(mDevice, image.mipViews[i], nullptr);
     }
+
+    for (auto faceView : image.faceViews) {
+        vkDestroyImageView(mDevice, faceView, nullptr);
+    }
 }
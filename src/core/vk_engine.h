@@ -7,15 +7,33 @@
 #include "vk_descriptors.h"
 #include <memory>
 #include "asset_manager.h"
+#include "frustum_culler.h"
+#include "occlusion_culler.h"
+#include "mesh_lod.h"
+#include "indirect_renderer.h"
+#include "draw_sort.h"
+#include "parallel_recorder.h"
+#include "instance_batcher.h"
+#include "sprite_batcher.h"
+#include "geometry_pool.h"
+#include "upload_service.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "flythrough_benchmark.h"
+#include "resolution_governor.h"
 
 #include "volk.h"
 #include "entt.hpp"
 
 #include "vk_window.h"
 
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <thread>
 
-constexpr unsigned int MAX_FRAMES_IN_FLIGHT = 2;
+// upper bound for EngineConfig::framesInFlight, per frame resources are created for this many frames
+constexpr unsigned int MAX_FRAMES_IN_FLIGHT = 3;
 constexpr uint32_t MAX_IMAGE_WIDTH = 3840;
 constexpr uint32_t MAX_IMAGE_HEIGHT = 2160;
 
@@ -27,16 +45,29 @@ public:
 		float frameTime;
 		int triangleCount;
 		int drawCallCount;
+		// frustum visible objects hidden by occluders
+		int occludedCount;
 		float updateTime;
 		float drawGeometryTime;
 		float postEffectsTime;
 		float drawTime;
+		float cullTime;
+		float sortTime;
+		// time spent waiting for the gpu to free the frame's resources, high when gpu bound
+		float cpuWaitTime;
 
 		float frameTimeBuffer;
 		float updateTimeBuffer;
 		float drawGeometryTimeBuffer;
 		float postEffectsTimeBuffer;
 		float drawTimeBuffer;
+		float cullTimeBuffer;
+		float sortTimeBuffer;
+		float cpuWaitTimeBuffer;
+
+		// time each recording worker spent recording secondary command buffers
+		std::vector<float> recordTime;
+		std::vector<float> recordTimeBuffer;
 
 		float msElapsed;
 		int frameCount;
@@ -50,15 +81,58 @@ public:
 
 		VkSemaphore swapchainSemaphore;
 		VkSemaphore renderSemaphore;
-		VkFence renderFence;
+
+		// frame timeline value signaled by the last submission using this frame's resources
+		uint64_t timelineValue = 0;
 
 		DeletionQueue deletionQueue;
 	};
 
 	struct EngineConfig {
 		float renderScale = 1.0f;
+		// drive renderScale from the measured gpu frame time
+		bool enableDynamicResolution = false;
+		ResolutionGovernor::Settings dynamicResolution;
 		bool enableFrustumCulling = true;
+		// objects smaller than this fraction of the screen height are culled
+		float minScreenSize = 0.f;
+		// rasterize the largest visible objects on the cpu and cull what they hide
+		bool enableOcclusionCulling = false;
+		// upload gltf meshes as 16 byte quantized vertices, applies to scenes loaded afterwards
+		bool enableCompactVertices = false;
+		// draw simplified surfaces for objects whose lod error projects below a pixel
+		bool enableLods = true;
+		// every step doubles the allowed projected error, negative values prefer detail
+		float lodBias = 0.f;
+		// cull and draw opaque objects through compute generated indirect draws
+		bool enableGPUDrivenRendering = false;
+		// cull large surfaces per meshlet in the gpu driven path
+		bool enableMeshletCulling = true;
 		bool enableDrawSorting = true;
+		// record draws into secondary command buffers on worker threads
+		bool enableParallelRecording = true;
+		// merge draws of the same surface and material into instanced draws
+		bool enableInstancing = true;
+		// read materials from one global buffer and texture array instead of per material sets
+		bool enableBindlessMaterials = true;
+		// frames the cpu may record ahead of the gpu, 1 for low latency, 3 for throughput
+		uint32_t framesInFlight = 2;
+		// also time the skybox precompute with a blocking submit per face and log both paths
+		bool compareSkyboxPrecompute = false;
+
+		std::string scenePath = "assets/scenes/testScene.json";
+
+		// render offscreen without a window, swapchain or imgui, for ci and automated perf runs
+		bool headless = false;
+		VkExtent2D headlessExtent = {1280, 720};
+		// frames rendered by headless runs and benchmarks, 0 renders 300 headless frames or the whole camera path
+		uint32_t frameCount = 0;
+		// frames are written to this directory as png files when set
+		std::string headlessOutputPath;
+
+		// camera path replayed by a flythrough benchmark, empty for normal runs
+		std::string benchmarkPath;
+		std::string benchmarkReportPath = "benchmark_report.json";
 	};
 
 	// initializes everything in the engine
@@ -73,7 +147,7 @@ public:
 	void run();
 
 	FrameData& getCurrentFrame() {
-		return mFrames[mFrameNumber % MAX_FRAMES_IN_FLIGHT];
+		return mFrames[mFrameNumber];
 	}
 
 	const VkDevice& getDevice() {
@@ -88,14 +162,34 @@ public:
 		return mInstance;
 	}
 
+	uint32_t getGraphicsQueueFamily() {
+		return mGraphicsQueueFamily;
+	}
+
 	PipelineResourceManager& getPipelineResourceManager() {
 		return *mPipelineResourceManager;
 	}
 
+	const EngineConfig& getEngineConfig() {
+		return mEngineConfig;
+	}
+
+	GeometryPool& getGeometryPool() {
+		return *mGeometryPool;
+	}
+
+	UploadService& getUploadService() {
+		return *mUploadService;
+	}
+
 	AssetManager& getAssetManager() {
 		return *mAssetManager;
 	}
 
+	GPUProfiler& getGPUProfiler() {
+		return *mGPUProfiler;
+	}
+
 	VkPhysicalDeviceDescriptorBufferPropertiesEXT getDescriptorBufferProperties() {
 		return mDescriptorBufferProperties;
 	}
@@ -128,6 +222,8 @@ public:
 	void destroySampler(VkSampler sampler);
 
 	GPUMeshBuffers uploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices);
+	// indices and vertices in any format the geometry pool holds, counts are in elements
+	GPUMeshBuffers uploadMesh(const void* indices, uint32_t indexCount, VkIndexType indexType, const void* vertices, uint32_t vertexCount, VertexFormat vertexFormat);
 
 	float getDeltaTime() {
 	   return mDeltaTime;
@@ -137,13 +233,24 @@ public:
 	   return mDeltaTime;
 	}
 
+	// benchmarks replay recorded input in place of the window's
 	const Input& getInput() {
-	   return mWindow->getInput();
+	   if (mBenchmark && mBenchmark->getInput()) {
+	      return *mBenchmark->getInput();
+	   }
+
+	   return mEngineConfig.headless ? mHeadlessInput : mWindow->getInput();
+	}
+
+	// size of the presented image, the window's or the requested headless resolution
+	VkExtent2D getOutputExtent() {
+	   return mEngineConfig.headless ? mEngineConfig.headlessExtent : mWindow->getExtent();
 	}
 
 	// TODO: see about this later
 	float getWindowAspectRatio() {
-	   return mWindow->getAspectRatio();
+	   VkExtent2D extent = getOutputExtent();
+	   return (float)extent.width / (float)extent.height;
 	}
 
 protected:
@@ -158,11 +265,57 @@ protected:
 
 	// draw loop
 	virtual void draw() = 0;
+
+	// frame pacing on the frame timeline, draw waits as late as possible before touching per frame resources
+	void waitForFrame();
+	// reserves the next timeline value for the current frame's submission
+	VkSemaphoreSubmitInfo getFrameSignalInfo();
+	void advanceFrame();
+
+	// culling, sorting and draw list building, touches no per frame gpu resources
+	void buildDrawLists();
 	void drawImGui(VkCommandBuffer commandBuffer, VkImageView targetImageView);
 	void drawGeometry(VkCommandBuffer commandBuffer);
+	void cullObjects(const std::vector<GLTFRenderObject>& objects, uint64_t version, FrustumCuller& culler, uint64_t& cullerVersion, std::vector<uint32_t>& outIndices);
+	void sortObjects(const std::vector<GLTFRenderObject>& objects, std::vector<uint32_t>& indices, bool transparent);
+	// removes objects hidden by the selected occluders from the frustum culled lists
+	void occlusionCull(const std::vector<GLTFRenderObject>& opaqueObjects, const std::vector<GLTFRenderObject>& transparentObjects, bool gpuDriven);
+	meshlod::View getLodView() const;
+	// returns the object itself at full detail, otherwise a copy drawing the selected lod
+	const GLTFRenderObject* selectLod(const GLTFRenderObject& object, const meshlod::View& lodView);
+
+	struct DrawStats {
+		int drawCallCount = 0;
+		int triangleCount = 0;
+	};
+
+	// helpers recording into either the main command buffer or a secondary one,
+	// state tracking is local to each call so chunks can be recorded independently
+	void beginDrawState(VkCommandBuffer commandBuffer);
+	void recordBatches(VkCommandBuffer commandBuffer, std::span<const InstanceBatcher::Batch> batches, DrawStats& stats);
+	void recordBatchesBindless(VkCommandBuffer commandBuffer, std::span<const InstanceBatcher::Batch> batches, DrawStats& stats);
+	void recordSkyboxAndSprites(VkCommandBuffer commandBuffer, DrawStats& stats, uint32_t profilerScope);
+	void recordGeometryParallel(VkCommandBuffer commandBuffer, bool gpuDriven, uint32_t profilerScope);
 
 	void drawLoadingScreen();
 
+	// headless frames are blitted to an 8 bit image and read back without stalling,
+	// each frame's pixels are written once its resources are reused
+	void initHeadlessOutput();
+	void recordFrameOutput(VkCommandBuffer commandBuffer);
+	void writeFrameOutput(uint32_t frameIndex);
+
+	bool isKeyPressed(int key);
+	// starts a cpu trace capture or stops and writes the running one
+	void toggleTraceCapture();
+	void updateTraceCapture();
+
+	// starts recording the camera and input into a camera path or saves the running recording
+	void toggleCameraRecording();
+	// stage times are the growth of the stats buffers since frameStart
+	void recordBenchmarkFrame(const Stats& frameStart, float frameTime);
+	void updateDynamicResolution(float cpuFrameTime);
+
 	virtual void drawGui() = 0;
 	virtual void update() = 0;
 
@@ -186,18 +339,54 @@ protected:
 	bool mIsInitialized = false;
 	bool mUseValidationLayers = false;
 
+	// index of the current frame's resources, in [0, mFramesInFlight)
 	int mFrameNumber = 0;
 	float mDeltaTime = 0.f;
 
 	FrameData mFrames[MAX_FRAMES_IN_FLIGHT];
+	uint32_t mFramesInFlight;
+
+	VkSemaphore mFrameTimeline;
+	uint64_t mFrameTimelineValue = 0;
 	VkQueue mGraphicsQueue;
 	uint32_t mGraphicsQueueFamily;
 
 	VkQueue mImmediateCommandsQueue;
 	uint32_t mImmediateCommandsQueueFamily;
 
+	// falls back to the immediate commands queue without a separate transfer family
+	VkQueue mTransferQueue;
+	uint32_t mTransferQueueFamily;
+
+	// gpu profiler capabilities
+	float mTimestampPeriod;
+	uint32_t mTimestampValidBits;
+	bool mSupportsPipelineStatistics = false;
+	// pipeline statistics queries active while executing secondary command buffers
+	bool mSupportsInheritedQueries = false;
+
+	// guards queue access when the graphics family only exposes a single queue
+	std::mutex mQueueMutex;
+
 	EngineConfig mEngineConfig;
 
+	// no input reaches a headless run, every key stays idle
+	Input mHeadlessInput;
+	uint32_t mHeadlessFrameNumber = 0;
+
+	AllocatedImage mOutputImage;
+	AllocatedBuffer mReadbackBuffers[MAX_FRAMES_IN_FLIGHT];
+	// headless frame number read back into each frame's buffer, UINT32_MAX when none is pending
+	uint32_t mPendingOutputFrames[MAX_FRAMES_IN_FLIGHT];
+
+	// frames left in a capture started from the cli, 0 when captures are started by hand
+	uint32_t mTraceCaptureFrames = 0;
+	uint32_t mTraceCaptureCount = 0;
+
+	std::unique_ptr<FlythroughBenchmark> mBenchmark;
+	std::unique_ptr<CameraPath> mCameraRecording;
+	uint32_t mCameraRecordingCount = 0;
+
 	DeletionQueue mMainDeletionQueue;
 
 	// draw resources
@@ -212,16 +401,50 @@ protected:
 	VkCommandPool mImmCommandPool;
 
 	std::unique_ptr<PipelineResourceManager> mPipelineResourceManager;
+	std::unique_ptr<UploadService> mUploadService;
+	std::unique_ptr<GeometryPool> mGeometryPool;
 	std::unique_ptr<AssetManager> mAssetManager;
 	std::unique_ptr<ComputeEffectsManager> mComputeEffectsManager;
+	std::unique_ptr<IndirectRenderer> mIndirectRenderer;
+	std::unique_ptr<ParallelRecorder> mParallelRecorder;
+	std::unique_ptr<InstanceBatcher> mInstanceBatcher;
+	std::unique_ptr<SpriteBatcher> mSpriteBatcher;
+	std::unique_ptr<GPUProfiler> mGPUProfiler;
+
+	ResolutionGovernor mResolutionGovernor;
 
 	RenderContext mRenderContext;
 
+	// culling state, kept between frames to reuse allocations
+	FrustumCuller mOpaqueCuller;
+	FrustumCuller mTransparentCuller;
+	uint64_t mOpaqueCullerVersion = 0;
+	uint64_t mTransparentCullerVersion = 0;
+	std::vector<uint32_t> mOpaqueObjectIndices;
+	std::vector<uint32_t> mTransparentObjectIndices;
+	OcclusionCuller mOcclusionCuller;
+	// screen size and index of every occluder candidate
+	std::vector<std::pair<float, uint32_t>> mOccluderCandidates;
+	std::vector<drawsort::Entry> mSortEntries;
+	std::vector<drawsort::Entry> mSortScratch;
+
+	// sorted visible objects, batched into instanced draws which are split into chunks for parallel recording
+	std::vector<const GLTFRenderObject*> mOpaqueDrawList;
+	std::vector<const GLTFRenderObject*> mTransparentDrawList;
+	// this frame's lod copies of draw list objects, a deque so pointers stay valid while it grows
+	std::deque<GLTFRenderObject> mLodObjects;
+	// gpu driven opaque objects are added to the draw list by drawGeometry
+	bool mDrawListsGPUDriven = false;
+	std::vector<DrawStats> mChunkStats;
+
 	std::shared_ptr<Scene3D> mScene;
 	std::shared_ptr<Scene3D> mLoadingScene;
 
 	Stats mStats{};
 
+	// meshes can be uploaded from the scene loading thread
+	std::atomic<uint32_t> mNextMeshId = 0;
+
 	VkPhysicalDeviceDescriptorBufferPropertiesEXT mDescriptorBufferProperties{};
 	float mMaxSamplerAnisotropy;
 };
@@ -4,14 +4,27 @@
 #include "vk_engine.h"
 #include "pipeline_resource_manager.h"
 #include "vk_types.h"
+#include "mesh_lod.h"
+#include "mesh_optimizer.h"
+#include "mesh_quantization.h"
+#include "meshlet_builder.h"
+#include "geometry_pool.h"
+#include "thread_pool.h"
 #include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "volk.h"
 #include "stb_image.h"
 #include <fmt/core.h>
 #include <filesystem>
+#include <limits>
 #include <memory>
 #include <string_view>
+#include <algorithm>
+#include <cctype>
+
+// meshes up to this many triangles keep a cpu copy for occlusion culling
+constexpr size_t OCCLUDER_TRIANGLE_LIMIT = 2048;
 
 // convert fastgltf opengl filter to vulkan
 VkFilter extractFilter(fastgltf::Filter filter) {
@@ -131,7 +144,8 @@ void LoadedGLTF::load(std::filesystem::path filePath) {
                                  fastgltf::Options::LoadExternalBuffers;
 
     // create parser
-    fastgltf::Parser parser(fastgltf::Extensions::KHR_materials_emissive_strength);
+    // quantized attributes are converted by the accessor tools like any other component type
+    fastgltf::Parser parser(fastgltf::Extensions::KHR_materials_emissive_strength | fastgltf::Extensions::EXT_mesh_gpu_instancing | fastgltf::Extensions::KHR_mesh_quantization);
 
     // open gltf file
     auto gltfFile = fastgltf::MappedGltfFile::FromPath(filePath);
@@ -188,6 +202,7 @@ void LoadedGLTF::load(std::filesystem::path filePath) {
     for (auto& material : asset.materials) {
         std::shared_ptr<GLTFMaterial> newMaterial = std::make_shared<GLTFMaterial>();
         materials.push_back(newMaterial);
+        mMaterialList.push_back(newMaterial);
 
         mMaterials[material.name.c_str()] = newMaterial;
 
@@ -305,7 +320,7 @@ void LoadedGLTF::load(std::filesystem::path filePath) {
         // add material constants to buffer
         ((MaterialConstants*)mMaterialDataBuffer.allocInfo.pMappedData)[dataIndex] = constants;
 
-        newMaterial->materialInstance = mVkEngine.getPipelineResourceManager().writeMaterial(mVkEngine.getDevice(), passType, materialResources);
+        newMaterial->materialInstance = mVkEngine.getPipelineResourceManager().writeMaterial(mVkEngine.getDevice(), passType, materialResources, constants);
 
         dataIndex++;
     }
@@ -313,6 +328,28 @@ void LoadedGLTF::load(std::filesystem::path filePath) {
     // load meshes
     std::vector<uint32_t> indices;
     std::vector<Vertex> vertices;
+    std::vector<std::vector<uint32_t>> lodIndices;
+    std::vector<Vertex> surfaceVertices;
+    std::vector<Meshlet> meshletData;
+
+    // the engine's workers record frames while scenes load on the loader thread, so the lod builds get their own
+    ThreadPool lodPool;
+
+    // triangle weighted totals of the optimizer stats for the whole file
+    double acmrBefore = 0.0;
+    double acmrAfter = 0.0;
+    double atvrBefore = 0.0;
+    double atvrAfter = 0.0;
+    size_t optimizedTriangles = 0;
+    size_t vertexCountBefore = 0;
+    size_t vertexCountAfter = 0;
+
+    std::vector<uint16_t> shortIndices;
+    std::vector<CompactVertex> compactVertices;
+
+    bool useCompactVertices = mVkEngine.getEngineConfig().enableCompactVertices;
+    size_t geometrySize = 0;
+    size_t fullGeometrySize = 0;
 
     for (auto& mesh : asset.meshes) {
         if (mMeshes.contains(mesh.name.c_str())) {
@@ -328,6 +365,7 @@ void LoadedGLTF::load(std::filesystem::path filePath) {
 
         indices.clear();
         vertices.clear();
+        meshletData.clear();
 
         for (auto&& p : mesh.primitives) {
             GeoSurface newSurface;
@@ -388,6 +426,37 @@ void LoadedGLTF::load(std::filesystem::path filePath) {
                 newSurface.material = materials[0];
             }
 
+            // reorder the surface on its own vertices, then put them back after the previous surfaces
+            {
+                MaterialPass passType = newSurface.material->materialInstance.passType;
+                std::span<uint32_t> surfaceIndices(indices.data() + newSurface.startIndex, newSurface.count);
+
+                surfaceVertices.assign(vertices.begin() + initialVtx, vertices.end());
+
+                for (uint32_t& index : surfaceIndices) {
+                    index -= initialVtx;
+                }
+
+                meshopt::Stats stats = meshopt::optimize(surfaceVertices, surfaceIndices, passType == MaterialPass::Opaque || passType == MaterialPass::OpaqueDoubleSided);
+
+                vertices.resize(initialVtx);
+                vertices.insert(vertices.end(), surfaceVertices.begin(), surfaceVertices.end());
+
+                for (uint32_t& index : surfaceIndices) {
+                    index += initialVtx;
+                }
+
+                size_t triangleCount = newSurface.count / 3;
+
+                acmrBefore += stats.acmrBefore * triangleCount;
+                acmrAfter += stats.acmrAfter * triangleCount;
+                atvrBefore += stats.atvrBefore * triangleCount;
+                atvrAfter += stats.atvrAfter * triangleCount;
+                optimizedTriangles += triangleCount;
+                vertexCountBefore += stats.vertexCountBefore;
+                vertexCountAfter += stats.vertexCountAfter;
+            }
+
             glm::vec3 minPos = vertices[initialVtx].position;
             glm::vec3 maxPos = vertices[initialVtx].position;
 
@@ -400,10 +469,113 @@ void LoadedGLTF::load(std::filesystem::path filePath) {
             newSurface.bounds.extents = (maxPos - minPos) / 2.f;
             newSurface.bounds.sphereRadius = glm::length(newSurface.bounds.extents);
 
+            std::span<const uint32_t> surfaceIndices(indices.data() + newSurface.startIndex, newSurface.count);
+
+            // only opaque surfaces go through the gpu driven path, and only large ones gain from culling in pieces
+            if (newSurface.material->materialInstance.passType == MaterialPass::Opaque && newSurface.count / 3 >= meshlets::MIN_TRIANGLE_COUNT) {
+                newSurface.firstMeshlet = meshletData.size();
+                meshlets::build(vertices, surfaceIndices, meshletData);
+                newSurface.meshletCount = meshletData.size() - newSurface.firstMeshlet;
+            }
+
             newMesh->surfaces.push_back(newSurface);
         }
 
-        newMesh->meshBuffers = mVkEngine.uploadMesh(indices, vertices);
+        // surfaces simplify in parallel, each into its own index list so the output doesn't depend on timing
+        lodIndices.assign(newMesh->surfaces.size(), {});
+
+        lodPool.parallelFor(newMesh->surfaces.size(), [&](uint32_t surfaceIndex, uint32_t) {
+            GeoSurface& surface = newMesh->surfaces[surfaceIndex];
+            std::span<const uint32_t> surfaceIndices(indices.data() + surface.startIndex, surface.count);
+
+            meshlod::buildLods(vertices, surfaceIndices, surface.lods, lodIndices[surfaceIndex]);
+
+            // simplified levels keep the vertices but lose the triangle order
+            for (auto& lod : surface.lods) {
+                meshopt::optimizeVertexCache(std::span<uint32_t>(lodIndices[surfaceIndex]).subspan(lod.indexOffset, lod.indexCount), vertices.size());
+            }
+        });
+
+        // lods go after every surface's full detail indices, offsets become relative to their surface
+        uint32_t baseIndexCount = indices.size();
+
+        for (uint32_t i = 0; i < newMesh->surfaces.size(); i++) {
+            GeoSurface& surface = newMesh->surfaces[i];
+
+            for (auto& lod : surface.lods) {
+                lod.indexOffset += indices.size() - surface.startIndex;
+            }
+
+            indices.insert(indices.end(), lodIndices[i].begin(), lodIndices[i].end());
+        }
+
+        // indices are relative to the mesh, so any mesh with few enough vertices fits 16 bits
+        VkIndexType indexType = vertices.size() <= meshquant::MAX_SHORT_INDEX_VERTEX_COUNT ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        VertexFormat vertexFormat = useCompactVertices ? VertexFormat::Compact : VertexFormat::Full;
+
+        const void* indexData = indices.data();
+        const void* vertexData = vertices.data();
+
+        if (indexType == VK_INDEX_TYPE_UINT16) {
+            shortIndices.assign(indices.begin(), indices.end());
+            indexData = shortIndices.data();
+        }
+
+        meshquant::PositionRange positionRange{glm::vec3(0.f), glm::vec3(1.f)};
+
+        if (vertexFormat == VertexFormat::Compact) {
+            positionRange = meshquant::getPositionRange(vertices);
+            compactVertices = meshquant::compressVertices(vertices, positionRange);
+            vertexData = compactVertices.data();
+        }
+
+        newMesh->meshBuffers = mVkEngine.uploadMesh(indexData, indices.size(), indexType, vertexData, vertices.size(), vertexFormat);
+        newMesh->meshBuffers.positionOffset = positionRange.offset;
+        newMesh->meshBuffers.positionScale = positionRange.scale;
+
+        if (!meshletData.empty()) {
+            size_t meshletSize = meshletData.size() * sizeof(Meshlet);
+
+            newMesh->meshletBuffer = mVkEngine.createBuffer(
+                meshletSize,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY
+            );
+
+            mVkEngine.getUploadService().uploadBuffer(newMesh->meshletBuffer.buffer, 0, meshletData.data(), meshletSize);
+        }
+
+        geometrySize += indices.size() * GeometryPool::getIndexSize(indexType) + vertices.size() * GeometryPool::getVertexSize(vertexFormat);
+        fullGeometrySize += indices.size() * sizeof(uint32_t) + vertices.size() * sizeof(Vertex);
+
+        // meshes named *occluder* are always kept, other meshes only while cheap to rasterize
+        std::string lowerName = newMesh->name;
+        std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        newMesh->designatedOccluder = lowerName.find("occluder") != std::string::npos;
+
+        if (newMesh->designatedOccluder || baseIndexCount / 3 <= OCCLUDER_TRIANGLE_LIMIT) {
+            newMesh->occluderPositions.reserve(vertices.size());
+
+            for (auto& vertex : vertices) {
+                newMesh->occluderPositions.push_back(vertex.position);
+            }
+
+            newMesh->occluderIndices.assign(indices.begin(), indices.begin() + baseIndexCount);
+        }
+    }
+
+    if (optimizedTriangles > 0) {
+        fmt::println("Optimized {} triangles of {}: acmr {:.3f} -> {:.3f}, atvr {:.3f} -> {:.3f}, {} -> {} vertices",
+            optimizedTriangles, filePath.filename().string(),
+            acmrBefore / optimizedTriangles, acmrAfter / optimizedTriangles,
+            atvrBefore / optimizedTriangles, atvrAfter / optimizedTriangles,
+            vertexCountBefore, vertexCountAfter);
+    }
+
+    if (fullGeometrySize > 0) {
+        fmt::println("Uploaded {:.2f} MB of geometry for {}, {:.2f} MB with full vertices and 32 bit indices",
+            geometrySize / 1048576.f, filePath.filename().string(), fullGeometrySize / 1048576.f);
     }
 
     // load all nodes and their meshes
@@ -422,6 +594,10 @@ void LoadedGLTF::load(std::filesystem::path filePath) {
         auto transformMatrix = fastgltf::getTransformMatrix(node);
 
         memcpy(&newNode->getLocalTransform(), transformMatrix.data(), transformMatrix.size_bytes());
+
+        if (!node.instancingAttributes.empty()) {
+            newNode->setInstanceTransforms(loadInstanceTransforms(asset, node));
+        }
     }
 
     // run loop again to setup transform hierarchy
@@ -444,6 +620,48 @@ void LoadedGLTF::load(std::filesystem::path filePath) {
     }
 }
 
+std::vector<glm::mat4> LoadedGLTF::loadInstanceTransforms(fastgltf::Asset& asset, fastgltf::Node& node) {
+    auto translation = node.findInstancingAttribute("TRANSLATION");
+    auto rotation = node.findInstancingAttribute("ROTATION");
+    auto scale = node.findInstancingAttribute("SCALE");
+
+    // all attributes must have the same count
+    size_t instanceCount = asset.accessors[node.instancingAttributes[0].accessorIndex].count;
+
+    std::vector<glm::vec3> translations(instanceCount, glm::vec3(0.f));
+    std::vector<glm::quat> rotations(instanceCount, glm::quat(1.f, 0.f, 0.f, 0.f));
+    std::vector<glm::vec3> scales(instanceCount, glm::vec3(1.f));
+
+    if (translation != node.instancingAttributes.end()) {
+        fastgltf::iterateAccessorWithIndex<fastgltf::math::fvec3>(asset, asset.accessors[translation->accessorIndex],
+            [&](fastgltf::math::fvec3 v, size_t index) {
+                translations[index] = glm::vec3(v.x(), v.y(), v.z());
+            });
+    }
+
+    if (rotation != node.instancingAttributes.end()) {
+        fastgltf::iterateAccessorWithIndex<fastgltf::math::fvec4>(asset, asset.accessors[rotation->accessorIndex],
+            [&](fastgltf::math::fvec4 v, size_t index) {
+                rotations[index] = glm::quat(v.w(), v.x(), v.y(), v.z());
+            });
+    }
+
+    if (scale != node.instancingAttributes.end()) {
+        fastgltf::iterateAccessorWithIndex<fastgltf::math::fvec3>(asset, asset.accessors[scale->accessorIndex],
+            [&](fastgltf::math::fvec3 v, size_t index) {
+                scales[index] = glm::vec3(v.x(), v.y(), v.z());
+            });
+    }
+
+    std::vector<glm::mat4> transforms(instanceCount);
+
+    for (size_t i = 0; i < instanceCount; i++) {
+        transforms[i] = glm::translate(glm::mat4(1.f), translations[i]) * glm::toMat4(rotations[i]) * glm::scale(glm::mat4(1.f), scales[i]);
+    }
+
+    return transforms;
+}
+
 LoadedGLTF::LoadedGLTF(std::filesystem::path filePath, VulkanEngine& vkEngine) : mVkEngine(vkEngine) {
     load(filePath);
 }
@@ -452,9 +670,9 @@ LoadedGLTF::~LoadedGLTF() {
     freeResources();
 }
 
-void LoadedGLTF::draw(const glm::mat4& transform, RenderContext& context) {
+void LoadedGLTF::draw(const glm::mat4& transform, std::vector<GLTFRenderObject>& opaqueObjects, std::vector<GLTFRenderObject>& transparentObjects) {
     for (auto& node : mTopNodes) {
-        node->draw(transform, context);
+        node->draw(transform, opaqueObjects, transparentObjects);
     }
 }
 
@@ -471,9 +689,16 @@ void LoadedGLTF::freeResources() {
 
     mVkEngine.destroyBuffer(mMaterialDataBuffer);
 
+    for (auto& material : mMaterialList) {
+        mVkEngine.getPipelineResourceManager().freeMaterial(material->materialInstance);
+    }
+
     for (auto& [k, v] : mMeshes) {
-        mVkEngine.destroyBuffer(v->meshBuffers.indexBuffer);
-        mVkEngine.destroyBuffer(v->meshBuffers.vertexBuffer);
+        mVkEngine.getGeometryPool().free(v->meshBuffers);
+
+        if (v->meshletBuffer.buffer != VK_NULL_HANDLE) {
+            mVkEngine.destroyBuffer(v->meshletBuffer);
+        }
     }
 
     for (auto& [k, v] : mImages) {
@@ -493,30 +718,85 @@ GLTFNode::GLTFNode(std::shared_ptr<MeshAsset> mesh) {
     mMesh = mesh;
 }
 
-void GLTFNode::draw(const glm::mat4& transform, RenderContext& context) {
+// bounds in node space enclosing every instance of a surface
+static Bounds getInstancedBounds(const Bounds& bounds, const std::vector<glm::mat4>& instanceTransforms) {
+    glm::vec3 minPos(std::numeric_limits<float>::max());
+    glm::vec3 maxPos(std::numeric_limits<float>::lowest());
+
+    for (auto& transform : instanceTransforms) {
+        glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.origin, 1.f));
+
+        // extents of the transformed box along each axis
+        glm::mat3 absolute = glm::mat3(glm::abs(transform[0]), glm::abs(transform[1]), glm::abs(transform[2]));
+        glm::vec3 extents = absolute * bounds.extents;
+
+        minPos = glm::min(minPos, center - extents);
+        maxPos = glm::max(maxPos, center + extents);
+    }
+
+    Bounds instancedBounds;
+    instancedBounds.origin = (maxPos + minPos) / 2.f;
+    instancedBounds.extents = (maxPos - minPos) / 2.f;
+    instancedBounds.sphereRadius = glm::length(instancedBounds.extents);
+
+    return instancedBounds;
+}
+
+void GLTFNode::draw(const glm::mat4& transform, std::vector<GLTFRenderObject>& opaqueObjects, std::vector<GLTFRenderObject>& transparentObjects) {
     if (mMesh != nullptr) {
         glm::mat4 nodeTransform = transform * mGlobalTransform;
 
         for (auto& surface : mMesh->surfaces) {
             GLTFRenderObject object;
             object.indexCount = surface.count;
-            object.firstIndex = surface.startIndex;
-            object.indexBuffer = mMesh->meshBuffers.indexBuffer.buffer;
+            object.firstIndex = mMesh->meshBuffers.firstIndex + surface.startIndex;
+            object.vertexOffset = mMesh->meshBuffers.vertexOffset;
+            object.indexBuffer = mMesh->meshBuffers.indexBuffer;
+            object.indexType = mMesh->meshBuffers.indexType;
+            object.indexBufferAddress = mMesh->meshBuffers.indexBufferAddress;
+            object.meshId = mMesh->meshBuffers.id;
             object.material = &surface.material->materialInstance;
             object.bounds = surface.bounds;
             object.transform = nodeTransform;
             object.vertexBufferAddress = mMesh->meshBuffers.vertexBufferAddress;
+            object.vertexFormat = mMesh->meshBuffers.vertexFormat;
+            object.positionOffset = mMesh->meshBuffers.positionOffset;
+            object.positionScale = mMesh->meshBuffers.positionScale;
+            object.lods = surface.lods.data();
+            object.lodCount = surface.lods.size();
+
+            if (surface.meshletCount > 0) {
+                object.meshletBufferAddress = mMesh->meshletBuffer.deviceAddress + surface.firstMeshlet * sizeof(Meshlet);
+                object.meshletCount = surface.meshletCount;
+            }
+
+            if (!mMesh->occluderIndices.empty()) {
+                object.occluderPositions = mMesh->occluderPositions.data();
+                object.occluderIndices = mMesh->occluderIndices.data() + surface.startIndex;
+                object.designatedOccluder = mMesh->designatedOccluder;
+            }
+
+            // asset authored instances stay a single render object
+            if (!mInstanceTransforms.empty()) {
+                object.instanceTransforms = mInstanceTransforms.data();
+                object.instanceCount = mInstanceTransforms.size();
+                object.bounds = getInstancedBounds(surface.bounds, mInstanceTransforms);
+
+                // instances would need their triangles rasterized once per transform
+                object.occluderPositions = nullptr;
+                object.occluderIndices = nullptr;
+            }
 
             if (surface.material->materialInstance.passType == MaterialPass::Opaque) {
-                context.opaqueObjects.push_back(object);
+                opaqueObjects.push_back(object);
             } else {
-                context.transparentObjects.push_back(object);
+                transparentObjects.push_back(object);
             }
         }
     }
 
     for (auto& node : mChildren) {
-        node->draw(transform, context);
+        node->draw(transform, opaqueObjects, transparentObjects);
     }
 }
 
@@ -555,3 +835,7 @@ glm::mat4& GLTFNode::getLocalTransform() {
 glm::mat4& GLTFNode::getGlobalTransform() {
     return mGlobalTransform;
 }
+
+void GLTFNode::setInstanceTransforms(std::vector<glm::mat4> transforms) {
+    mInstanceTransforms = std::move(transforms);
+}
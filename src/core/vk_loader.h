@@ -10,7 +10,7 @@ class GLTFNode {
 public:
     GLTFNode(std::shared_ptr<MeshAsset> mesh = nullptr);
 
-    void draw(const glm::mat4& transform, RenderContext& context);
+    void draw(const glm::mat4& transform, std::vector<GLTFRenderObject>& opaqueObjects, std::vector<GLTFRenderObject>& transparentObjects);
 
     void addChild(std::shared_ptr<GLTFNode> child);
 
@@ -25,6 +25,9 @@ public:
     glm::mat4& getLocalTransform();
     glm::mat4& getGlobalTransform();
 
+    // EXT_mesh_gpu_instancing transforms, relative to the node
+    void setInstanceTransforms(std::vector<glm::mat4> transforms);
+
 private:
 
     std::weak_ptr<GLTFNode> mParent;
@@ -33,6 +36,8 @@ private:
 
     glm::mat4 mLocalTransform;
     glm::mat4 mGlobalTransform;
+
+    std::vector<glm::mat4> mInstanceTransforms;
 };
 
 class LoadedGLTF {
@@ -42,12 +47,13 @@ public:
 
     LoadedGLTF(const LoadedGLTF&) = default;
 
-    void draw(const glm::mat4& transform, RenderContext& context);
+    void draw(const glm::mat4& transform, std::vector<GLTFRenderObject>& opaqueObjects, std::vector<GLTFRenderObject>& transparentObjects);
     void freeResources();
 
 private:
     void load(std::filesystem::path filePath);
     AllocatedImage loadImage(fastgltf::Asset& asset, fastgltf::Image& image, VkFormat format, bool mipmapped);
+    std::vector<glm::mat4> loadInstanceTransforms(fastgltf::Asset& asset, fastgltf::Node& node);
 
     void initMaterialDataBuffer(size_t materialCount);
 
@@ -57,6 +63,8 @@ private:
     std::unordered_map<std::string, std::shared_ptr<GLTFNode>> mNodes;
     std::unordered_map<std::string, AllocatedImage> mImages;
     std::unordered_map<std::string, std::shared_ptr<GLTFMaterial>> mMaterials;
+    // every material in asset order, names are not unique
+    std::vector<std::shared_ptr<GLTFMaterial>> mMaterialList;
 
     std::vector<std::shared_ptr<GLTFNode>> mTopNodes;
 
@@ -5,6 +5,7 @@
 #include <imgui.h>
 
 #include <glm/gtx/matrix_decompose.hpp>
+#include <algorithm>
 #include <memory>
 
 Scene3D::Scene3D(const std::filesystem::path& path, VulkanEngine& vkEngine) : mVkEngine(vkEngine), mAssetManager(mVkEngine.getAssetManager()) {
@@ -41,7 +42,8 @@ void Scene3D::init() {
         }
     });
 
-    mScriptManager = std::make_unique<ScriptManager>();
+    mScriptManager = std::make_unique<ScriptManager>(*this);
+    mRenderList = std::make_shared<RenderList>();
 
     mDeletionQueue.push([&]() {
         mEntities.clear();
@@ -51,6 +53,8 @@ void Scene3D::init() {
 }
 
 void Scene3D::loadFromFile(const std::filesystem::path& filePath) {
+    PROFILE_SCOPE_DETAIL("scene load", filePath.string());
+
     mName = filePath.stem();
 
     // get json from file
@@ -65,7 +69,7 @@ void Scene3D::loadFromFile(const std::filesystem::path& filePath) {
 
     // create scene data descriptor
     for (unsigned int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        mSceneDataUBOs[i].globalDescriptorOffset = mVkEngine.getPipelineResourceManager().createSceneDescriptor(
+        mSceneDataUBOs[i].globalDescriptor = mVkEngine.getPipelineResourceManager().createSceneDescriptor(
             mSceneDataUBOs[i].buffer.deviceAddress,
             sizeof(SceneData),
             mSkybox ? mSkybox->irrMap.imageView : mAssetManager.getDefaultImage("black_cube")->imageView,
@@ -75,6 +79,12 @@ void Scene3D::loadFromFile(const std::filesystem::path& filePath) {
         );
     }
 
+    mDeletionQueue.push([&]() {
+        for (unsigned int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            mVkEngine.getPipelineResourceManager().freeDescriptor(mSceneDataUBOs[i].globalDescriptor);
+        }
+    });
+
     // load entities
     for (auto& entityJson : sceneJson["Entities"]) {
         auto componentJsons = entityJson["Components"];
@@ -102,6 +112,7 @@ void Scene3D::loadFromFile(const std::filesystem::path& filePath) {
         for (auto [entity, sprite] : view.each()) {
             mAssetManager.loadImage(sprite.name, VK_FORMAT_R8G8B8A8_SRGB);
             sprite.image = mAssetManager.getImage(std::filesystem::path(sprite.name).stem());
+            sprite.region = mAssetManager.getSpriteRegion(std::filesystem::path(sprite.name).stem());
         }
     }
 
@@ -154,6 +165,22 @@ void Scene3D::loadFromFile(const std::filesystem::path& filePath) {
         }
     }
 
+    // register gltf surfaces, transforms are updated once they get propagated
+    {
+        auto view = mRegistry.view<Transform, GLTF>();
+
+        for (auto [entity, transform, gltf] : view.each()) {
+            if (gltf.gltf != nullptr) {
+                mRenderList->addEntity(entity, *gltf.gltf, transform.globalMatrix);
+            }
+        }
+    }
+
+    // moved entities refit their proxies once transforms get propagated
+    for (auto& [uuid, entity] : mEntities) {
+        updateBVHProxy(*entity);
+    }
+
     fmt::println("Finished loading scene!");
 }
 
@@ -170,35 +197,157 @@ void Scene3D::cleanupEntities() {
 }
 
 void Scene3D::propagateTransform() {
-    for (auto& entity : mRootEntities) {
-        entity->propagateTransform(glm::mat4(1.f));
+    PROFILE_SCOPE("transform propagation");
+
+    if (!mTransformHierarchy.isValid()) {
+        rebuildTransformHierarchy();
     }
+
+    mTransformHierarchy.propagate(mChangedEntities);
 }
 
-void Scene3D::render(RenderContext& renderContext) {
-    renderContext = RenderContext{};
+void Scene3D::rebuildTransformHierarchy() {
+    PROFILE_SCOPE("transform hierarchy rebuild");
 
-    {
-        auto view = mRegistry.view<Transform, GLTF>();
+    // the components stay where entt put them, lua scripts keep pointers to them between frames
+    mTransformHierarchy.clear();
 
-        for (auto [entity, transform, gltf] : view.each()) {
-            if (gltf.gltf == nullptr) {
-                continue;
-            }
+    for (auto entity : mRootEntities) {
+        entity->addToHierarchy(mTransformHierarchy, TransformHierarchy::NO_PARENT);
+    }
+}
+
+void Scene3D::updateRenderList() {
+    PROFILE_SCOPE("render list update");
+
+    // only entities that moved update their surfaces
+    for (auto entity : mChangedEntities) {
+        if (entity->hasComponent<GLTF>()) {
+            mRenderList->updateTransform(entity->getHandle(), entity->getComponent<Transform>().globalMatrix);
+        }
+    }
+}
+
+void Scene3D::updateBVH() {
+    PROFILE_SCOPE("bvh update");
+
+    for (auto entity : mChangedEntities) {
+        updateBVHProxy(*entity);
+    }
+}
+
+bool Scene3D::getWorldBounds(Entity& entity, DynamicBVH::AABB& outBounds) {
+    bool hasBounds = entity.hasComponent<GLTF>() && mRenderList->getEntityBounds(entity.getHandle(), outBounds.min, outBounds.max);
 
-            gltf.gltf->draw(transform.globalMatrix, renderContext);
+    if (entity.hasComponent<SphereCollider>() && entity.hasComponent<Transform>()) {
+        const glm::mat4& matrix = entity.getComponent<Transform>().globalMatrix;
+
+        glm::vec3 center = matrix[3];
+        float maxScale = std::max({glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))});
+        float radius = entity.getComponent<SphereCollider>().radius * maxScale;
+
+        outBounds.min = hasBounds ? glm::min(outBounds.min, center - radius) : center - radius;
+        outBounds.max = hasBounds ? glm::max(outBounds.max, center + radius) : center + radius;
+        hasBounds = true;
+    }
+
+    return hasBounds;
+}
+
+void Scene3D::updateBVHProxy(Entity& entity) {
+    DynamicBVH::AABB bounds;
+    auto it = mBVHProxies.find(entity.getHandle());
+
+    if (!getWorldBounds(entity, bounds)) {
+        if (it != mBVHProxies.end()) {
+            mBVH.remove(it->second);
+            mBVHProxies.erase(it);
         }
+
+        return;
+    }
+
+    if (it == mBVHProxies.end()) {
+        mBVHProxies[entity.getHandle()] = mBVH.insert(bounds, entt::to_integral(entity.getHandle()));
+    } else {
+        mBVH.update(it->second, bounds);
+    }
+}
+
+Entity* Scene3D::getBVHEntity(uint32_t userData) {
+    return getEntity(mRegistry.get<Metadata>((entt::entity)userData).uuid);
+}
+
+std::optional<Scene3D::RaycastHit> Scene3D::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) {
+    auto hit = mBVH.raycast(origin, direction, maxDistance);
+
+    if (!hit) {
+        return std::nullopt;
+    }
+
+    return RaycastHit{getBVHEntity(hit->userData), hit->distance};
+}
+
+std::optional<Scene3D::RaycastHit> Scene3D::pick(const glm::vec2& ndcPosition) {
+    // reversed depth, the near plane is at 1
+    glm::mat4 inverseViewProjection = glm::inverse(mSceneData.viewProjection);
+
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcPosition, 1.f, 1.f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcPosition, 0.f, 1.f);
+
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+    float distance = glm::length(direction);
+
+    return raycast(origin, direction / distance, distance);
+}
+
+void Scene3D::queryFrustum(const glm::mat4& viewProjection, std::vector<Entity*>& outEntities) {
+    mQueryResults.clear();
+    mBVH.queryFrustum(FrustumCuller::extractFrustum(viewProjection, glm::vec3(0.f), 0.f), mQueryResults);
+
+    for (auto userData : mQueryResults) {
+        outEntities.push_back(getBVHEntity(userData));
+    }
+}
+
+void Scene3D::overlapSphere(const glm::vec3& center, float radius, std::vector<Entity*>& outEntities) {
+    mQueryResults.clear();
+    mBVH.querySphere(center, radius, mQueryResults);
+
+    for (auto userData : mQueryResults) {
+        outEntities.push_back(getBVHEntity(userData));
     }
+}
+
+Entity* Scene3D::findNearest(const glm::vec3& point, float maxDistance) {
+    auto nearest = mBVH.findNearest(point, maxDistance);
+
+    return nearest ? getBVHEntity(nearest->userData) : nullptr;
+}
+
+void Scene3D::render(RenderContext& renderContext) {
+    PROFILE_SCOPE("scene render");
+
+    renderContext.renderList = mRenderList;
+
+    // keep sprite capacity between frames
+    renderContext.sprites.clear();
 
     {
         auto view = mRegistry.view<Transform, Sprite>();
 
         for (auto [entity, transform, sprite] : view.each()) {
-            if (sprite.image == nullptr) {
+            if (sprite.region == nullptr) {
                 continue;
             }
 
-            renderContext.sprites.push_back(SpriteRenderObject{.image = sprite.image, .transform = transform.globalMatrix});
+            renderContext.sprites.push_back(SpriteRenderObject{
+                .region = sprite.region,
+                .transform = transform.globalMatrix,
+                .tint = sprite.tint,
+                .layer = sprite.layer
+            });
         }
     }
 
@@ -206,7 +355,9 @@ void Scene3D::render(RenderContext& renderContext) {
     renderContext.skybox = mSkybox;
 }
 
-void Scene3D::update(float deltaTime, const Input& input, int frameNumber) {
+void Scene3D::update(float deltaTime, const Input& input) {
+    PROFILE_SCOPE("scene update");
+
     // systems
     mScriptManager->update(deltaTime, input, mCameraEntity);
 
@@ -220,6 +371,11 @@ void Scene3D::update(float deltaTime, const Input& input, int frameNumber) {
     mScriptManager->onLateUpdate(mRegistry);
     propagateTransform();
 
+    updateRenderList();
+    updateBVH();
+
+    mChangedEntities.clear();
+
     mSceneData.view = glm::mat4(1.f);
     mSceneData.projection = glm::mat4(1.f);
 
@@ -227,6 +383,12 @@ void Scene3D::update(float deltaTime, const Input& input, int frameNumber) {
         Camera& camera = mCameraEntity->getComponent<Camera>();
         Transform& cameraTransform = mCameraEntity->getComponent<Transform>();
 
+        if (mCameraOverride) {
+            cameraTransform.globalMatrix = *mCameraOverride;
+            // restored by the next propagation once the override is reset
+            cameraTransform.markDirty();
+        }
+
         camera.aspectRatio = mVkEngine.getWindowAspectRatio();
         camera.updateMatrices(cameraTransform);
 
@@ -240,8 +402,9 @@ void Scene3D::update(float deltaTime, const Input& input, int frameNumber) {
     mSceneData.ambientColor = glm::vec4(.1f);
     mSceneData.sunlightDirection = glm::vec4(.2f, 1.0f, .5f, 1.f);
     mSceneData.sunlightColor = glm::vec4(0.f);
+}
 
-
+void Scene3D::writeSceneData(int frameNumber) {
     *(SceneData*)mSceneDataUBOs[frameNumber].buffer.allocInfo.pMappedData = mSceneData;
 }
 
@@ -251,6 +414,7 @@ Entity* Scene3D::createEntity(const nlohmann::json& metaJson) {
 
 Entity* Scene3D::createEntity(Metadata meta) {
     mEntities[meta.uuid] = std::make_unique<Entity>(meta, mRegistry);
+    mTransformHierarchy.invalidate();
 
     return mEntities[meta.uuid].get();
 }
@@ -271,7 +435,22 @@ Entity* Scene3D::getEntity(const std::string& name) {
 }
 
 void Scene3D::destroyEntity(const std::string& name) {
+    Entity* entity = getEntity(name);
+
+    if (entity != nullptr) {
+        mRenderList->removeEntity(entity->getHandle());
+        std::erase(mChangedEntities, entity);
+
+        auto it = mBVHProxies.find(entity->getHandle());
+
+        if (it != mBVHProxies.end()) {
+            mBVH.remove(it->second);
+            mBVHProxies.erase(it);
+        }
+    }
+
     mEntities.erase(name);
+    mTransformHierarchy.invalidate();
 }
 
 void Scene3D::drawGui() {
@@ -281,8 +460,14 @@ void Scene3D::drawGui() {
         // camera
         // mCamera.drawGui();
         if (ImGui::TreeNode("Camera")) {
-            ImGui::InputFloat3("position", (float*)&mCameraEntity->getComponent<Transform>().position);
-            ImGui::InputFloat3("rotation", (float*)&mCameraEntity->getComponent<Transform>().rotation);
+            Transform& cameraTransform = mCameraEntity->getComponent<Transform>();
+
+            bool edited = ImGui::InputFloat3("position", (float*)&cameraTransform.position);
+            edited |= ImGui::InputFloat3("rotation", (float*)&cameraTransform.rotation);
+
+            if (edited) {
+                cameraTransform.markDirty();
+            }
 
             ImGui::TreePop();
         }
@@ -320,9 +505,9 @@ void Scene3D::drawGui() {
 }
 
 void Scene3D::setGlobalDescriptorOffset(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, int frameNumber) {
-    uint32_t bufferIndexUbo = 0;
+    const DescriptorAllocation& descriptor = mSceneDataUBOs[frameNumber].globalDescriptor;
 
-    vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &bufferIndexUbo, &mSceneDataUBOs[frameNumber].globalDescriptorOffset);
+    vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptor.bufferIndex, &descriptor.offset);
 }
 
 nlohmann::json Scene3D::toJson() {
@@ -343,6 +528,18 @@ nlohmann::json Scene3D::toJson() {
     return sceneJson;
 }
 
+const glm::mat4 Scene3D::getViewProj() {
+    return mSceneData.viewProjection;
+}
+
+std::optional<glm::mat4> Scene3D::getCameraMatrix() {
+    if (!mCameraEntity) {
+        return std::nullopt;
+    }
+
+    return mCameraEntity->getComponent<Transform>().globalMatrix;
+}
+
 void Scene3D::saveToFile() {
     std::filesystem::path filePath = "assets/scenes/1" + mName + ".json";
 
@@ -10,6 +10,9 @@
 #include "script_manager.h"
 #include "asset_manager.h"
 #include "vk_engine.h"
+#include "render_list.h"
+#include "dynamic_bvh.h"
+#include "transform_hierarchy.h"
 
 // forward reference
 class VulkanEngine;
@@ -21,13 +24,24 @@ public:
     Scene3D(const std::filesystem::path& path, VulkanEngine& VkEngine);
     ~Scene3D();
 
-    void update(float deltaTime, const Input& input, int frameNumber);
+    void update(float deltaTime, const Input& input);
     void render(RenderContext& renderContext);
+
+    // copies the scene data into the frame's uniform buffer, once the gpu is done reading it
+    void writeSceneData(int frameNumber);
     void drawGui();
 
     void setGlobalDescriptorOffset(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, int frameNumber);
 
     const glm::mat4 getViewProj();
+
+    // replaces the camera's global transform until reset, used to replay camera paths
+    void setCameraOverride(std::optional<glm::mat4> cameraMatrix) {
+        mCameraOverride = cameraMatrix;
+    }
+
+    // global transform of the scene camera, empty when the scene has none
+    std::optional<glm::mat4> getCameraMatrix();
     void saveToFile();
 
     void loadFromFile(const std::filesystem::path& filePath);
@@ -40,14 +54,43 @@ public:
     Entity* getEntity(const std::string& name);
     void destroyEntity(const std::string& name);
 
+    struct RaycastHit {
+        Entity* entity;
+        float distance;
+    };
+
+    // spatial queries over the world bounds of entities with gltf models or sphere colliders
+    std::optional<RaycastHit> raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+    // casts a ray through a point of the last camera view, in vulkan ndc with y pointing down
+    std::optional<RaycastHit> pick(const glm::vec2& ndcPosition);
+    void queryFrustum(const glm::mat4& viewProjection, std::vector<Entity*>& outEntities);
+    void overlapSphere(const glm::vec3& center, float radius, std::vector<Entity*>& outEntities);
+    Entity* findNearest(const glm::vec3& point, float maxDistance);
+
+    const DynamicBVH& getBVH() const {
+        return mBVH;
+    }
+
+    const TransformHierarchy& getTransformHierarchy() const {
+        return mTransformHierarchy;
+    }
+
     // systems
     void propagateTransform();
+    void updateRenderList();
+    void updateBVH();
     void cleanupEntities();
 
 private:
     void init();
     void freeResources();
 
+    void rebuildTransformHierarchy();
+
+    bool getWorldBounds(Entity& entity, DynamicBVH::AABB& outBounds);
+    void updateBVHProxy(Entity& entity);
+    Entity* getBVHEntity(uint32_t userData);
+
     VulkanEngine& mVkEngine;
     AssetManager& mAssetManager;
 
@@ -55,7 +98,7 @@ private:
 
     struct SceneDataUBO {
         AllocatedBuffer buffer;
-        VkDeviceSize globalDescriptorOffset;
+        DescriptorAllocation globalDescriptor;
     };
 
     std::array<SceneDataUBO, MAX_FRAMES_IN_FLIGHT> mSceneDataUBOs;
@@ -69,8 +112,21 @@ private:
     entt::registry mRegistry;
 
     std::vector<Entity*> mRootEntities; // has to be declared before entity map
+    std::vector<Entity*> mChangedEntities;
+
+    // rebuilt on the next propagation whenever entities are created or destroyed
+    TransformHierarchy mTransformHierarchy;
+
+    // shared with the render context so it outlives the scene while in flight
+    std::shared_ptr<RenderList> mRenderList;
     std::unordered_map<std::string, std::unique_ptr<Entity>> mEntities;
     Entity *mCameraEntity = nullptr;
+    std::optional<glm::mat4> mCameraOverride;
+
+    // leaves hold entity handles
+    DynamicBVH mBVH;
+    std::unordered_map<entt::entity, int32_t> mBVHProxies;
+    std::vector<uint32_t> mQueryResults;
 
     uint64_t mNextEntityID = 1;
 
@@ -9,6 +9,7 @@
 #include <vk_mem_alloc.h>
 #include "deletion_queue.h"
 #include "vk_enum_string_helper.h"
+#include "mesh_types.h"
 
 #include <fmt/core.h>
 
@@ -23,6 +24,8 @@ struct AllocatedImage {
     VkFormat imageFormat;
     uint32_t mipLevels;
     std::vector<VkImageView> mipViews;
+    // single face views of cubemaps rendered to, indexed by mip * 6 + face
+    std::vector<VkImageView> faceViews;
 };
 
 struct ComputePushConstants {
@@ -46,27 +49,71 @@ struct DescriptorData {
     VkDeviceSize offset;
 };
 
-struct alignas(16) Vertex {
-    glm::vec3 position;
-    float uvX;
-    glm::vec3 normal;
-    float uvY;
+enum class VertexFormat : uint32_t {
+    Full,
+    Compact
 };
 
+// vertex and index ranges inside the geometry pool arenas, indices are relative to
+// the mesh, so draws pass vertexOffset and add firstIndex to the surface start index
 struct GPUMeshBuffers {
-    AllocatedBuffer indexBuffer;
-    AllocatedBuffer vertexBuffer;
+    VkBuffer indexBuffer;
+    // arena base address, read by the cluster culling pass
+    VkDeviceAddress indexBufferAddress;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+
+    VkBuffer vertexBuffer;
+    // arena base address, shared by every mesh in the arena
     VkDeviceAddress vertexBufferAddress;
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+
+    // every arena holds a single index type and vertex format
+    VkIndexType indexType;
+    VertexFormat vertexFormat;
+    // compact positions decode as positionOffset + unorm * positionScale
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+
+    uint32_t vertexArena;
+    uint32_t indexArena;
+
+    // stable id used for draw sorting
+    uint32_t id;
 };
 
 struct PBRPushConstants {
-    glm::mat4 worldMatrix;
     VkDeviceAddress vertexBuffer;
+    // world matrices indexed by gl_InstanceIndex
+    VkDeviceAddress instanceBuffer;
+    glm::vec4 positionOffset;
+    glm::vec3 positionScale;
+    VertexFormat vertexFormat;
+};
+
+// same layout as PBRPushConstants up to the material index
+struct PBRBindlessPushConstants {
+    VkDeviceAddress vertexBuffer;
+    VkDeviceAddress instanceBuffer;
+    glm::vec4 positionOffset;
+    glm::vec3 positionScale;
+    VertexFormat vertexFormat;
+    // index into the global material buffer
+    uint32_t materialIndex;
 };
 
 struct SpritePushConstants {
-    glm::mat4 worldMatrix;
+    glm::mat4 projection;
     VkDeviceAddress vertexBuffer;
+    // SpriteInstance array indexed by gl_InstanceIndex
+    VkDeviceAddress instanceBuffer;
+};
+
+struct SpriteInstance {
+    glm::mat4 transform;
+    glm::vec4 uvRect;
+    glm::vec4 tint;
 };
 
 struct SkyboxPushConstants {
@@ -74,6 +121,70 @@ struct SkyboxPushConstants {
     VkDeviceAddress vertexBuffer;
 };
 
+struct PBRIndirectPushConstants {
+    VkDeviceAddress objectBuffer;
+};
+
+// per object data for gpu driven rendering, layout matches the shaders (std430)
+struct GPUObjectData {
+    glm::mat4 worldMatrix;
+    glm::vec4 boundsOrigin; // w holds the sphere radius
+    glm::vec4 boundsExtents;
+    VkDeviceAddress vertexBuffer;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t drawBucket;
+    uint32_t bucketOffset; // first draw command slot of the bucket
+    int32_t vertexOffset;
+    VertexFormat vertexFormat;
+    glm::vec4 positionOffset;
+    glm::vec4 positionScale;
+};
+
+// object drawn through per cluster culling, its surviving triangles are compacted into
+// the index range of its draw command, layout matches the shaders (std430)
+struct GPUMeshletObject {
+    VkDeviceAddress meshletBuffer;
+    // index arena of the mesh, 16 bit indices are read in pairs
+    VkDeviceAddress indexBuffer;
+    uint32_t firstIndex;
+    uint32_t shortIndices;
+    // into the object buffer, also the draw's first instance
+    uint32_t objectIndex;
+    uint32_t commandIndex;
+};
+
+struct GPUClusterJob {
+    uint32_t meshletObject;
+    uint32_t meshletIndex;
+};
+
+// inputs of the cluster culling pass, too large for push constants
+struct GPUClusterCullData {
+    glm::vec4 frustumPlanes[6];
+    glm::vec4 cameraPosition;
+    VkDeviceAddress objectBuffer;
+    VkDeviceAddress meshletObjectBuffer;
+    VkDeviceAddress jobBuffer;
+    VkDeviceAddress drawCommandBuffer;
+    VkDeviceAddress outputIndexBuffer;
+    uint32_t jobCount;
+    uint32_t enableCulling;
+};
+
+struct GPUClusterCullPushConstants {
+    VkDeviceAddress cullData;
+};
+
+struct GPUCullPushConstants {
+    glm::vec4 frustumPlanes[6];
+    VkDeviceAddress objectBuffer;
+    VkDeviceAddress drawCommandBuffer;
+    VkDeviceAddress drawCountBuffer;
+    uint32_t objectCount;
+    uint32_t enableCulling;
+};
+
 struct SkyboxLoadPushConstants {
     glm::mat4 projViewMatrix;
     VkDeviceAddress vertexBuffer;
@@ -92,13 +203,30 @@ enum class MaterialPass : uint8_t {
 struct Pipeline {
     VkPipeline pipeline;
     VkPipelineLayout layout;
+
+    // stable id used for draw sorting
+    uint32_t id;
+};
+
+// descriptor set memory inside one of the chained descriptor buffers
+struct DescriptorAllocation {
+    uint32_t bufferIndex = 0;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
 };
 
 struct MaterialInstance {
     Pipeline* pipeline;
     MaterialPass passType;
 
-    VkDeviceSize descriptorOffset;
+    DescriptorAllocation descriptor;
+
+    // same pass, but reading the material from the bindless set
+    Pipeline* bindlessPipeline;
+    uint32_t materialIndex;
+
+    // stable id used for draw sorting
+    uint32_t id;
 };
 
 struct alignas(16) MaterialConstants {
@@ -110,6 +238,22 @@ struct alignas(16) MaterialConstants {
     float occlusionStrength;
 };
 
+// material entry of the bindless material buffer, texture fields index the bindless texture array
+struct alignas(16) GPUMaterial {
+    glm::vec4 colorFactors;
+    glm::vec4 metalRoughFactors;
+    glm::vec4 emissiveFactors;
+    float emissiveStrength;
+    float normalScale;
+    float occlusionStrength;
+
+    uint32_t colorTexture;
+    uint32_t metalRoughTexture;
+    uint32_t normalTexture;
+    uint32_t emissiveTexture;
+    uint32_t occlusionTexture;
+};
+
 struct MaterialResources {
     AllocatedImage colorImage;
     VkSampler colorSampler;
@@ -131,28 +275,52 @@ struct MaterialResources {
     VkDeviceAddress dataBufferAddress;
 };
 
-struct Bounds {
-    glm::vec3 origin;
-    float sphereRadius;
-    glm::vec3 extents;
-};
-
 struct GLTFRenderObject {
     uint32_t indexCount;
     uint32_t firstIndex;
+    int32_t vertexOffset;
     VkBuffer indexBuffer;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    VkDeviceAddress indexBufferAddress = 0;
+    uint32_t meshId;
 
     MaterialInstance* material;
 
     glm::mat4 transform;
     VkDeviceAddress vertexBufferAddress;
+    VertexFormat vertexFormat = VertexFormat::Full;
+    glm::vec3 positionOffset{0.f};
+    glm::vec3 positionScale{1.f};
+
+    // EXT_mesh_gpu_instancing transforms relative to transform, owned by the gltf node,
+    // bounds already enclose all instances
+    const glm::mat4* instanceTransforms = nullptr;
+    uint32_t instanceCount = 1;
 
     Bounds bounds;
+
+    // lower detail index ranges from finest to coarsest, owned by the mesh
+    const MeshLod* lods = nullptr;
+    uint32_t lodCount = 0;
+
+    // address of the surface's first meshlet, only large opaque surfaces have meshlets
+    VkDeviceAddress meshletBufferAddress = 0;
+    uint32_t meshletCount = 0;
+
+    // cpu copy of the surface's triangles for occlusion culling, owned by the mesh,
+    // null for meshes that keep none
+    const glm::vec3* occluderPositions = nullptr;
+    const uint32_t* occluderIndices = nullptr;
+    bool designatedOccluder = false;
 };
 
+struct SpriteRegion;
+
 struct SpriteRenderObject {
-    AllocatedImage* image;
+    const SpriteRegion* region;
     glm::mat4 transform;
+    glm::vec4 tint;
+    int layer;
 };
 
 struct SkyboxAsset {
@@ -181,9 +349,11 @@ struct SceneData {
     glm::vec4 data;
 };
 
+class RenderList;
+
 struct RenderContext {
-    std::vector<GLTFRenderObject> opaqueObjects;
-    std::vector<GLTFRenderObject> transparentObjects;
+    // retained gltf surfaces, owned by the scene and shared so they outlive a scene switch
+    std::shared_ptr<const RenderList> renderList;
     std::vector<SpriteRenderObject> sprites;
 
     SceneData sceneData;
@@ -200,6 +370,11 @@ struct GeoSurface {
     std::shared_ptr<GLTFMaterial> material;
 
     Bounds bounds;
+    std::vector<MeshLod> lods;
+
+    // range in the mesh's meshlet buffer
+    uint32_t firstMeshlet = 0;
+    uint32_t meshletCount = 0;
 };
 
 struct MeshAsset {
@@ -207,6 +382,14 @@ struct MeshAsset {
 
     std::vector<GeoSurface> surfaces;
     GPUMeshBuffers meshBuffers;
+    // meshlets of every surface, no buffer for meshes without any
+    AllocatedBuffer meshletBuffer{};
+
+    // positions and mesh relative indices kept on the cpu for occlusion culling, only for
+    // low poly meshes and meshes named as occluders
+    std::vector<glm::vec3> occluderPositions;
+    std::vector<uint32_t> occluderIndices;
+    bool designatedOccluder = false;
 };
 
 
@@ -58,12 +58,11 @@ void EditorApp::draw() {
     // get start time
     auto start = std::chrono::system_clock::now();
 
-    // wait until gpu finishes rendering last frame
-    VK_CHECK(vkWaitForFences(mDevice, 1, &getCurrentFrame().renderFence, VK_TRUE, UINT64_MAX));
-    VK_CHECK(vkResetFences(mDevice, 1, &getCurrentFrame().renderFence));
+    waitForFrame();
 
-    // flush deletion queue of current frame
-    getCurrentFrame().deletionQueue.flush();
+    if (mScene) {
+        mScene->writeSceneData(mFrameNumber);
+    }
 
     VkImage swapchainImage = mWindow->getNextSwapchainImage(getCurrentFrame().swapchainSemaphore);
 
@@ -133,19 +132,31 @@ void EditorApp::draw() {
     // prepare to submit command buffer to queue
     VkCommandBufferSubmitInfo commandBufferSubmitInfo = vkinit::command_buffer_submit_info(commandBuffer);
 
-    VkSemaphoreSubmitInfo waitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, getCurrentFrame().swapchainSemaphore);
-    VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, getCurrentFrame().renderSemaphore);
+    // also wait for uploads the frame may read, this only stalls the gpu if a batch is still in flight
+    VkSemaphoreSubmitInfo waitInfos[] = {
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, getCurrentFrame().swapchainSemaphore),
+        mUploadService->getWaitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)
+    };
+    VkSemaphoreSubmitInfo signalInfos[] = {
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, getCurrentFrame().renderSemaphore),
+        getFrameSignalInfo()
+    };
 
-    VkSubmitInfo2 submitInfo = vkinit::submit_info(&commandBufferSubmitInfo, &signalInfo, &waitInfo);
+    VkSubmitInfo2 submitInfo = vkinit::submit_info(&commandBufferSubmitInfo, signalInfos, waitInfos);
+    submitInfo.waitSemaphoreInfoCount = 2;
+    submitInfo.signalSemaphoreInfoCount = 2;
 
     // submit command buffer to queue
-    VK_CHECK(vkQueueSubmit2(mGraphicsQueue, 1, &submitInfo, getCurrentFrame().renderFence));
+    {
+        std::scoped_lock lock(mQueueMutex);
+
+        VK_CHECK(vkQueueSubmit2(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
 
-    mWindow->presentSwapchainImage(mGraphicsQueue, getCurrentFrame().renderSemaphore);
+        mWindow->presentSwapchainImage(mGraphicsQueue, getCurrentFrame().renderSemaphore);
+    }
 
-    // increment frame number
-    mFrameNumber++;
-    mFrameNumber %= MAX_FRAMES_IN_FLIGHT;
+    // move on to the next frame's resources
+    advanceFrame();
 
     // get end time
     auto end = std::chrono::system_clock::now();
@@ -158,7 +169,7 @@ void EditorApp::update() {
     auto start = std::chrono::system_clock::now();
 
     if (mScene) {
-        mScene->update(mDeltaTime, mWindow->getInput(), mFrameNumber);
+        mScene->update(mDeltaTime, mWindow->getInput());
         mScene->render(mRenderContext);
     }
 
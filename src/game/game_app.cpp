@@ -13,17 +13,30 @@ void GameApp::draw() {
     // get start time
     auto start = std::chrono::system_clock::now();
 
-    // wait until gpu finishes rendering last frame
-    VK_CHECK(vkWaitForFences(mDevice, 1, &getCurrentFrame().renderFence, VK_TRUE, UINT64_MAX));
-    VK_CHECK(vkResetFences(mDevice, 1, &getCurrentFrame().renderFence));
+    VkExtent2D windowExtent = getOutputExtent();
 
+    // set draw extent
+    mDrawExtent.width = std::min(windowExtent.width, mDrawImage.imageExtent.width) * mEngineConfig.renderScale;
+    mDrawExtent.height = std::min(windowExtent.height, mDrawImage.imageExtent.height) * mEngineConfig.renderScale;
+
+    // cpu only work runs while the gpu may still be busy with this frame's resources
+    buildDrawLists();
+
+    waitForFrame();
+
+    mScene->writeSceneData(mFrameNumber);
 
-    // flush deletion queue of current frame
-    getCurrentFrame().deletionQueue.flush();
+    bool headless = mEngineConfig.headless;
+    VkImage swapchainImage = VK_NULL_HANDLE;
 
-    VkImage swapchainImage = mWindow->getNextSwapchainImage(getCurrentFrame().swapchainSemaphore);
+    if (headless) {
+        // the frame that last used these resources has finished, write out its pixels
+        writeFrameOutput(mFrameNumber);
+    } else {
+        swapchainImage = mWindow->getNextSwapchainImage(getCurrentFrame().swapchainSemaphore);
+    }
 
-    if (swapchainImage == VK_NULL_HANDLE) {
+    if (!headless && swapchainImage == VK_NULL_HANDLE) {
         vkDestroySemaphore(mDevice, getCurrentFrame().swapchainSemaphore, nullptr);
         VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphore_create_info();
         VK_CHECK(vkCreateSemaphore(mDevice, &semaphoreCreateInfo, nullptr, &getCurrentFrame().swapchainSemaphore));
@@ -31,13 +44,6 @@ void GameApp::draw() {
         return;
     }
 
-    VkExtent2D windowExtent = mWindow->getExtent();
-
-    // set draw extent
-    mDrawExtent.width = std::min(windowExtent.width, mDrawImage.imageExtent.width) * mEngineConfig.renderScale;
-    mDrawExtent.height = std::min(windowExtent.height, mDrawImage.imageExtent.height) * mEngineConfig.renderScale;
-
-
     // get command buffer from current frame
     VkCommandBuffer commandBuffer = getCurrentFrame().mainCommandBuffer;
 
@@ -48,6 +54,9 @@ void GameApp::draw() {
     VkCommandBufferBeginInfo commandBufferBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
 
+    // reads back the queries of the frame that last used these resources
+    mGPUProfiler->beginFrame(commandBuffer, mFrameNumber);
+
     vkutil::transitionImage(commandBuffer, mDrawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
     vkutil::transitionImage(commandBuffer, mDepthImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 
@@ -61,28 +70,37 @@ void GameApp::draw() {
         // get start time
         auto start = std::chrono::system_clock::now();
 
-        mComputeEffectsManager->executeEffects(commandBuffer, getComputeContext());
+        uint32_t postEffectsScope = mGPUProfiler->beginScope(commandBuffer, "post effects");
+        mComputeEffectsManager->executeEffects(commandBuffer, getComputeContext(), postEffectsScope);
+        mGPUProfiler->endScope(commandBuffer, postEffectsScope);
 
         auto end = std::chrono::system_clock::now();
         auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
         mStats.postEffectsTimeBuffer += elapsed.count() / 1000.f;
     }
 
-    // transition draw and swapchain image into transfer layouts
-    vkutil::transitionImage(commandBuffer, mDrawImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-    vkutil::transitionImage(commandBuffer, swapchainImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    if (headless) {
+        // copy the draw image to a readback buffer instead of presenting it
+        recordFrameOutput(commandBuffer);
+    } else {
+        // transition draw and swapchain image into transfer layouts
+        vkutil::transitionImage(commandBuffer, mDrawImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        vkutil::transitionImage(commandBuffer, swapchainImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-    // copy draw image to swapchain image
-    vkutil::copyImageToImage(commandBuffer, mDrawImage.image, swapchainImage, mDrawExtent, windowExtent);
+        // copy draw image to swapchain image
+        vkutil::copyImageToImage(commandBuffer, mDrawImage.image, swapchainImage, mDrawExtent, windowExtent);
 
-    // transition swapchain image to Attachment Optimal so we can draw directly to it
-    vkutil::transitionImage(commandBuffer, swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        // transition swapchain image to Attachment Optimal so we can draw directly to it
+        vkutil::transitionImage(commandBuffer, swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-    // draw ImGui into the swapchain image
-    drawImGui(commandBuffer, mWindow->getCurrentSwapchainImageView());
+        // draw ImGui into the swapchain image
+        uint32_t imguiScope = mGPUProfiler->beginScope(commandBuffer, "imgui");
+        drawImGui(commandBuffer, mWindow->getCurrentSwapchainImageView());
+        mGPUProfiler->endScope(commandBuffer, imguiScope);
 
-    // transition swapchain image into a presentable layout
-    vkutil::transitionImage(commandBuffer, swapchainImage, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        // transition swapchain image into a presentable layout
+        vkutil::transitionImage(commandBuffer, swapchainImage, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
 
     // finalize command buffer
     VK_CHECK(vkEndCommandBuffer(commandBuffer));
@@ -90,19 +108,36 @@ void GameApp::draw() {
     // prepare to submit command buffer to queue
     VkCommandBufferSubmitInfo commandBufferSubmitInfo = vkinit::command_buffer_submit_info(commandBuffer);
 
-    VkSemaphoreSubmitInfo waitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, getCurrentFrame().swapchainSemaphore);
-    VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, getCurrentFrame().renderSemaphore);
-
-    VkSubmitInfo2 submitInfo = vkinit::submit_info(&commandBufferSubmitInfo, &signalInfo, &waitInfo);
+    // also wait for uploads the frame may read, this only stalls the gpu if a batch is still in flight,
+    // headless frames skip the swapchain semaphores at the end of each array
+    VkSemaphoreSubmitInfo waitInfos[] = {
+        mUploadService->getWaitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT),
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, getCurrentFrame().swapchainSemaphore)
+    };
+    VkSemaphoreSubmitInfo signalInfos[] = {
+        getFrameSignalInfo(),
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, getCurrentFrame().renderSemaphore)
+    };
+
+    VkSubmitInfo2 submitInfo = vkinit::submit_info(&commandBufferSubmitInfo, signalInfos, waitInfos);
+    submitInfo.waitSemaphoreInfoCount = headless ? 1 : 2;
+    submitInfo.signalSemaphoreInfoCount = headless ? 1 : 2;
 
     // submit command buffer to queue
-    VK_CHECK(vkQueueSubmit2(mGraphicsQueue, 1, &submitInfo, getCurrentFrame().renderFence));
+    {
+        PROFILE_SCOPE("submit and present");
+
+        std::scoped_lock lock(mQueueMutex);
 
-    mWindow->presentSwapchainImage(mGraphicsQueue, getCurrentFrame().renderSemaphore);
+        VK_CHECK(vkQueueSubmit2(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
 
-    // increment frame number
-    mFrameNumber++;
-    mFrameNumber %= MAX_FRAMES_IN_FLIGHT;
+        if (!headless) {
+            mWindow->presentSwapchainImage(mGraphicsQueue, getCurrentFrame().renderSemaphore);
+        }
+    }
+
+    // move on to the next frame's resources
+    advanceFrame();
 
     // get end time
     auto end = std::chrono::system_clock::now();
@@ -114,7 +149,7 @@ void GameApp::update() {
     // get start time
     auto start = std::chrono::system_clock::now();
 
-    mScene->update(mDeltaTime, mWindow->getInput(), mFrameNumber);
+    mScene->update(mDeltaTime, getInput());
     mScene->render(mRenderContext);
 
     // get end time
@@ -137,10 +172,88 @@ void GameApp::drawGui() {
         ImGui::Text("frametime %f ms", mStats.frameTime);
         ImGui::Text("update time %f ms", mStats.updateTime);
         ImGui::Text("draw time %f ms", mStats.drawTime);
+        ImGui::Text("cpu wait time %f ms", mStats.cpuWaitTime);
         ImGui::Text("draw geometry time %f ms", mStats.drawGeometryTime);
+        ImGui::Text("cull time %f ms", mStats.cullTime);
+        ImGui::Text("sort time %f ms", mStats.sortTime);
+
+        if (mEngineConfig.enableParallelRecording) {
+            for (uint32_t i = 0; i < mStats.recordTime.size(); i++) {
+                ImGui::Text("record time worker %u %f ms", i, mStats.recordTime[i]);
+            }
+        }
+
         ImGui::Text("post effects time %f ms", mStats.postEffectsTime);
         ImGui::Text("triangles %i", mStats.triangleCount);
         ImGui::Text("draws %i", mStats.drawCallCount);
+        ImGui::Text("occluded %i", mStats.occludedCount);
+
+        auto descriptorStats = mPipelineResourceManager->getDescriptorStats();
+        ImGui::Text("descriptor memory %llu / %llu KB in %u blocks", (unsigned long long)descriptorStats.allocatedSize / 1024, (unsigned long long)descriptorStats.capacity / 1024, descriptorStats.blockCount);
+        ImGui::Text("descriptor sets %u", descriptorStats.allocationCount);
+        ImGui::Text("descriptor occupancy %.1f%%", descriptorStats.occupancy * 100.f);
+        ImGui::Text("descriptor fragmentation %.1f%%", descriptorStats.fragmentation * 100.f);
+
+        auto geometryStats = mGeometryPool->getStats();
+        ImGui::Text("geometry %llu / %llu MB in %u vertex and %u index arenas", (unsigned long long)geometryStats.usedSize >> 20, (unsigned long long)geometryStats.capacity >> 20, geometryStats.vertexArenaCount, geometryStats.indexArenaCount);
+        ImGui::Text("meshes %u", geometryStats.meshCount);
+
+        auto uploadStats = mUploadService->getStats();
+        ImGui::Text("uploaded %llu MB on %s queue", (unsigned long long)uploadStats.uploadedSize >> 20, uploadStats.dedicatedTransferQueue ? "transfer" : "graphics");
+        ImGui::Text("staging %llu KB in %u batches", (unsigned long long)uploadStats.stagingInUse >> 10, uploadStats.batchesInFlight);
+
+        if (ImGui::CollapsingHeader("GPU profiler")) {
+            ImGui::Checkbox("Enable GPU profiling", &mGPUProfiler->enabled);
+
+            bool showStatistics = mGPUProfiler->supportsStatistics();
+            int columnCount = showStatistics ? 4 : 2;
+
+            if (ImGui::BeginTable("gpu scopes", columnCount, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+                ImGui::TableSetupColumn("scope");
+                ImGui::TableSetupColumn("gpu ms");
+
+                if (showStatistics) {
+                    ImGui::TableSetupColumn("vertex invocations");
+                    ImGui::TableSetupColumn("fragment invocations");
+                }
+
+                ImGui::TableHeadersRow();
+
+                for (auto& result : mGPUProfiler->getResults()) {
+                    ImGui::TableNextRow();
+
+                    ImGui::TableNextColumn();
+                    ImGui::Indent(result.depth * ImGui::GetStyle().IndentSpacing);
+                    ImGui::TextUnformatted(result.name.c_str());
+                    ImGui::Unindent(result.depth * ImGui::GetStyle().IndentSpacing);
+
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", result.time);
+
+                    if (showStatistics && result.hasStatistics) {
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%llu", (unsigned long long)result.vertexInvocations);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%llu", (unsigned long long)result.fragmentInvocations);
+                    }
+                }
+
+                ImGui::EndTable();
+            }
+
+            if (ImGui::Button("Export GPU profile CSV")) {
+                mGPUProfiler->exportCSV("gpu_profile.csv");
+            }
+        }
+
+        if (ImGui::Button(CPUProfiler::isCapturing() ? "Stop CPU trace (F9)" : "Capture CPU trace (F9)")) {
+            toggleTraceCapture();
+        }
+
+        if (ImGui::Button(mCameraRecording ? "Save camera path (F10)" : "Record camera path (F10)")) {
+            toggleCameraRecording();
+        }
+
         ImGui::End();
     }
 
@@ -150,8 +263,35 @@ void GameApp::drawGui() {
 
         if (ImGui::Begin("Engine Config", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
             ImGui::Checkbox("Enable frustum culling", &mEngineConfig.enableFrustumCulling);
+            ImGui::Checkbox("Enable GPU driven rendering", &mEngineConfig.enableGPUDrivenRendering);
+            ImGui::Checkbox("Enable meshlet culling", &mEngineConfig.enableMeshletCulling);
             ImGui::Checkbox("Enable draw sorting", &mEngineConfig.enableDrawSorting);
+            ImGui::Checkbox("Enable parallel recording", &mEngineConfig.enableParallelRecording);
+            ImGui::Checkbox("Enable instancing", &mEngineConfig.enableInstancing);
+            ImGui::Checkbox("Enable bindless materials", &mEngineConfig.enableBindlessMaterials);
+            ImGui::SliderFloat("Min screen size", &mEngineConfig.minScreenSize, 0.f, 0.05f);
+            ImGui::Checkbox("Enable occlusion culling", &mEngineConfig.enableOcclusionCulling);
+            ImGui::Checkbox("Enable lods", &mEngineConfig.enableLods);
+            ImGui::SliderFloat("Lod bias", &mEngineConfig.lodBias, -2.f, 4.f);
             ImGui::SliderFloat("Render Scale", &mEngineConfig.renderScale, 0.3f, 2.f);
+
+            if (ImGui::Checkbox("Enable dynamic resolution", &mEngineConfig.enableDynamicResolution) && !mEngineConfig.enableDynamicResolution) {
+                mResolutionGovernor.reset(*mComputeEffectsManager);
+            }
+
+            if (mEngineConfig.enableDynamicResolution) {
+                ResolutionGovernor::Settings& settings = mEngineConfig.dynamicResolution;
+
+                ImGui::SliderFloat("Target frame time", &settings.targetFrameTime, 4.f, 50.f, "%.2f ms");
+                ImGui::SliderFloat("Min render scale", &settings.minScale, 0.3f, 1.f);
+                ImGui::SliderFloat("Max render scale", &settings.maxScale, settings.minScale, 1.f);
+                ImGui::Checkbox("Step down compute effects", &settings.stepDownEffects);
+                ImGui::Text("filtered frame time %.2f ms, %u effects stepped down", mResolutionGovernor.getFilteredFrameTime(), mComputeEffectsManager->getSteppedDownCount());
+            }
+
+            const uint32_t minFramesInFlight = 1;
+            const uint32_t maxFramesInFlight = MAX_FRAMES_IN_FLIGHT;
+            ImGui::SliderScalar("Frames in flight", ImGuiDataType_U32, &mEngineConfig.framesInFlight, &minFramesInFlight, &maxFramesInFlight);
             ImGui::End();
         }
         // mScene->drawGui();
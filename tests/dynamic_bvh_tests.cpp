@@ -0,0 +1,276 @@
+#include "test.h"
+
+#include "dynamic_bvh.h"
+#include "frustum_culler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+namespace {
+    using AABB = DynamicBVH::AABB;
+
+    // random boxes at constant density, with the proxies they were inserted as
+    struct Scene {
+        std::mt19937 random{13};
+        float worldSize;
+        std::vector<AABB> boxes;
+        std::vector<int32_t> proxies;
+        DynamicBVH bvh;
+
+        explicit Scene(uint32_t objectCount) : worldSize(std::cbrt((float)objectCount) * 7.f) {
+            for (uint32_t i = 0; i < objectCount; i++) {
+                boxes.push_back(randomBox(randomPoint()));
+                proxies.push_back(bvh.insert(boxes[i], i));
+            }
+        }
+
+        float getUnit() {
+            return std::uniform_real_distribution<float>(0.f, 1.f)(random);
+        }
+
+        glm::vec3 randomPoint() {
+            return glm::vec3(getUnit(), getUnit(), getUnit()) * worldSize;
+        }
+
+        glm::vec3 randomDirection() {
+            glm::vec3 direction;
+
+            do {
+                direction = glm::vec3(getUnit(), getUnit(), getUnit()) * 2.f - 1.f;
+            } while (glm::length(direction) < 0.01f || glm::length(direction) > 1.f);
+
+            return glm::normalize(direction);
+        }
+
+        AABB randomBox(const glm::vec3& center) {
+            glm::vec3 halfSize = glm::vec3(getUnit(), getUnit(), getUnit()) * 0.75f + 0.25f;
+
+            return AABB{center - halfSize, center + halfSize};
+        }
+
+        // a tenth of the boxes drift, one in a hundred teleports, then every other box leaves and comes back
+        void shuffle() {
+            for (uint32_t i = 0; i < boxes.size(); i += 10) {
+                glm::vec3 offset = i % 100 == 0 ? randomPoint() - boxes[i].min : randomDirection() * 0.5f;
+
+                boxes[i].min += offset;
+                boxes[i].max += offset;
+                bvh.update(proxies[i], boxes[i]);
+            }
+
+            for (uint32_t i = 0; i < boxes.size(); i += 2) {
+                bvh.remove(proxies[i]);
+            }
+
+            for (uint32_t i = 0; i < boxes.size(); i += 2) {
+                proxies[i] = bvh.insert(boxes[i], i);
+            }
+        }
+    };
+
+    float getDistanceSquared(const glm::vec3& point, const AABB& box) {
+        glm::vec3 offset = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.f));
+
+        return glm::dot(offset, offset);
+    }
+
+    // entry distance of the ray into the box, infinity when it misses within maxDistance
+    float getRayDistance(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const AABB& box) {
+        glm::vec3 t0 = (box.min - origin) / direction;
+        glm::vec3 t1 = (box.max - origin) / direction;
+        float entry = std::max({std::min(t0.x, t1.x), std::min(t0.y, t1.y), std::min(t0.z, t1.z), 0.f});
+        float exit = std::min({std::max(t0.x, t1.x), std::max(t0.y, t1.y), std::max(t0.z, t1.z), maxDistance});
+
+        return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+    }
+
+    bool isInFrustum(const FrustumCuller::Frustum& frustum, const AABB& box) {
+        glm::vec3 center = (box.min + box.max) * 0.5f;
+        glm::vec3 extents = (box.max - box.min) * 0.5f;
+
+        return std::all_of(frustum.planes.begin(), frustum.planes.end(), [&](const glm::vec4& plane) {
+            return glm::dot(glm::vec3(plane), center) + plane.w >= -glm::dot(glm::abs(glm::vec3(plane)), extents);
+        });
+    }
+
+    std::vector<uint32_t> sorted(std::vector<uint32_t> userData) {
+        std::sort(userData.begin(), userData.end());
+
+        return userData;
+    }
+}
+
+TEST_CASE("dynamic bvh: trees stay valid through inserts, moves and removes") {
+    Scene scene(2000);
+
+    CHECK(scene.bvh.validate());
+    CHECK_EQ(scene.bvh.getProxyCount(), 2000u);
+
+    // a balanced tree of 2000 leaves is 11 levels high
+    CHECK_LE(scene.bvh.getHeight(), 22);
+
+    scene.shuffle();
+
+    CHECK(scene.bvh.validate());
+    CHECK_EQ(scene.bvh.getProxyCount(), 2000u);
+
+    for (uint32_t i = 0; i < scene.boxes.size(); i++) {
+        CHECK_EQ(scene.bvh.getUserData(scene.proxies[i]), i);
+        CHECK(scene.bvh.getBounds(scene.proxies[i]).min == scene.boxes[i].min);
+        CHECK(scene.bvh.getBounds(scene.proxies[i]).max == scene.boxes[i].max);
+    }
+
+    // small moves stay inside the enlarged leaf box and leave the tree alone
+    AABB nudged = scene.boxes[1];
+    nudged.min += glm::vec3(0.01f);
+    nudged.max += glm::vec3(0.01f);
+
+    CHECK(!scene.bvh.update(scene.proxies[1], nudged));
+    CHECK(scene.bvh.getBounds(scene.proxies[1]).min == nudged.min);
+
+    AABB moved = scene.randomBox(glm::vec3(-100.f));
+    CHECK(scene.bvh.update(scene.proxies[1], moved));
+    CHECK(scene.bvh.validate());
+
+    for (uint32_t i = 0; i < scene.boxes.size(); i += 3) {
+        scene.bvh.remove(scene.proxies[i]);
+    }
+
+    CHECK(scene.bvh.validate());
+    CHECK_EQ(scene.bvh.getProxyCount(), 2000u - 667u);
+
+    scene.bvh.clear();
+
+    CHECK(scene.bvh.validate());
+    CHECK_EQ(scene.bvh.getProxyCount(), 0u);
+    CHECK_EQ(scene.bvh.getHeight(), 0);
+}
+
+TEST_CASE("dynamic bvh: frustum queries match brute force") {
+    Scene scene(3000);
+    scene.shuffle();
+
+    for (uint32_t q = 0; q < 100; q++) {
+        glm::vec3 position = scene.randomPoint();
+        glm::mat4 view = glm::lookAt(position, position + scene.randomDirection(), glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 200.f, 0.1f);
+        FrustumCuller::Frustum frustum = FrustumCuller::extractFrustum(projection * view, position, projection[1][1]);
+
+        std::vector<uint32_t> expected;
+
+        for (uint32_t i = 0; i < scene.boxes.size(); i++) {
+            if (isInFrustum(frustum, scene.boxes[i])) {
+                expected.push_back(i);
+            }
+        }
+
+        std::vector<uint32_t> results;
+        scene.bvh.queryFrustum(frustum, results);
+
+        CHECK(sorted(results) == expected);
+    }
+}
+
+TEST_CASE("dynamic bvh: sphere and nearest queries match brute force") {
+    Scene scene(3000);
+    scene.shuffle();
+
+    const float radius = 6.f;
+
+    for (uint32_t q = 0; q < 200; q++) {
+        glm::vec3 point = scene.randomPoint();
+
+        std::vector<uint32_t> expected;
+        float closest = std::numeric_limits<float>::max();
+
+        for (uint32_t i = 0; i < scene.boxes.size(); i++) {
+            float distanceSquared = getDistanceSquared(point, scene.boxes[i]);
+
+            if (distanceSquared <= radius * radius) {
+                expected.push_back(i);
+            }
+
+            closest = std::min(closest, distanceSquared);
+        }
+
+        std::vector<uint32_t> results;
+        scene.bvh.querySphere(point, radius, results);
+
+        CHECK(sorted(results) == expected);
+
+        // ties between boxes are fine as long as the distance is the smallest one
+        auto nearest = scene.bvh.findNearest(point, scene.worldSize);
+
+        CHECK(nearest.has_value());
+
+        if (nearest) {
+            CHECK_EQ(getDistanceSquared(point, scene.boxes[nearest->userData]), closest);
+            CHECK_LT(std::abs(nearest->distance - std::sqrt(closest)), 1e-4f);
+        }
+
+        // nothing is found beyond maxDistance
+        if (closest > 0.f) {
+            CHECK(!scene.bvh.findNearest(point, std::sqrt(closest) * 0.99f).has_value());
+        }
+    }
+}
+
+TEST_CASE("dynamic bvh: raycasts find the closest box") {
+    Scene scene(3000);
+    scene.shuffle();
+
+    uint32_t hitCount = 0;
+
+    for (uint32_t q = 0; q < 200; q++) {
+        glm::vec3 origin = scene.randomPoint();
+        glm::vec3 direction = scene.randomDirection();
+        float maxDistance = scene.worldSize * 0.5f;
+        float closest = std::numeric_limits<float>::infinity();
+
+        for (const auto& box : scene.boxes) {
+            closest = std::min(closest, getRayDistance(origin, direction, maxDistance, box));
+        }
+
+        auto hit = scene.bvh.raycast(origin, direction, maxDistance);
+
+        CHECK_EQ(hit.has_value(), std::isfinite(closest));
+
+        // the tree multiplies by the inverse direction, so distances may differ in the last bits
+        if (hit) {
+            CHECK_LT(std::abs(hit->distance - closest), 1e-4f * scene.worldSize);
+            CHECK_LT(std::abs(getRayDistance(origin, direction, maxDistance, scene.boxes[hit->userData]) - closest), 1e-4f * scene.worldSize);
+            hitCount++;
+        }
+    }
+
+    // most rays through a filled world hit something, some miss
+    CHECK_GT(hitCount, 0u);
+    CHECK_LT(hitCount, 200u);
+
+    // rays starting inside a box hit at 0, whatever the length of their direction
+    glm::vec3 inside = (scene.boxes[5].min + scene.boxes[5].max) * 0.5f;
+    auto hit = scene.bvh.raycast(inside, glm::vec3(0.f, 0.f, 2.f), 1.f);
+
+    CHECK(hit.has_value());
+
+    if (hit) {
+        CHECK_EQ(hit->distance, 0.f);
+    }
+}
+
+TEST_CASE("dynamic bvh: empty trees find nothing") {
+    DynamicBVH bvh;
+    std::vector<uint32_t> results;
+
+    bvh.querySphere(glm::vec3(0.f), 100.f, results);
+
+    CHECK(results.empty());
+    CHECK(!bvh.raycast(glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), 100.f).has_value());
+    CHECK(!bvh.findNearest(glm::vec3(0.f), 100.f).has_value());
+    CHECK(bvh.validate());
+}
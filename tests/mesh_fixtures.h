@@ -0,0 +1,113 @@
+#pragma once
+
+#include "mesh_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/constants.hpp>
+
+// procedural meshes shared by the mesh tests and core_benchmarks, every triangle is counter clockwise
+// seen from the front, +z for flat grids and outside for spheres
+namespace fixtures {
+    struct Mesh {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // grid of (columns + 1) * (rows + 1) vertices, the last column repeats the first with other uvs
+    template<typename F>
+    Mesh createGrid(uint32_t columns, uint32_t rows, F&& position) {
+        Mesh mesh;
+
+        for (uint32_t y = 0; y <= rows; y++) {
+            for (uint32_t x = 0; x <= columns; x++) {
+                float u = (float)x / columns;
+                float v = (float)y / rows;
+
+                Vertex vertex;
+                vertex.position = position(u, v);
+                vertex.normal = glm::vec3(0.f, 0.f, 1.f);
+                vertex.uvX = u;
+                vertex.uvY = v;
+                mesh.vertices.push_back(vertex);
+            }
+        }
+
+        for (uint32_t y = 0; y < rows; y++) {
+            for (uint32_t x = 0; x < columns; x++) {
+                uint32_t i = y * (columns + 1) + x;
+
+                mesh.indices.insert(mesh.indices.end(), {i, i + 1, i + columns + 1, i + 1, i + columns + 2, i + columns + 1});
+            }
+        }
+
+        return mesh;
+    }
+
+    // uv sphere, the pole rows collapse into single points so their triangles are degenerate
+    inline Mesh createSphere(uint32_t segmentCount, const glm::vec3& center = glm::vec3(0.f), float radius = 1.f) {
+        Mesh mesh = createGrid(segmentCount, segmentCount / 2, [](float u, float v) {
+            float theta = u * glm::two_pi<float>();
+            float phi = v * glm::pi<float>();
+
+            return glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+        });
+
+        for (auto& vertex : mesh.vertices) {
+            vertex.normal = vertex.position;
+            vertex.position = center + vertex.position * radius;
+        }
+
+        return mesh;
+    }
+
+    // overlapping spheres with shuffled triangles and a duplicate for every third corner, like unwelded exports
+    inline Mesh createUnweldedSpheres(uint32_t sphereCount, uint32_t segmentCount) {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> offset(-1.f, 1.f);
+        std::uniform_real_distribution<float> radius(0.3f, 0.8f);
+
+        Mesh spheres;
+
+        for (uint32_t s = 0; s < sphereCount; s++) {
+            glm::vec3 center(offset(random), offset(random), offset(random));
+            Mesh sphere = createSphere(segmentCount, center, radius(random));
+            uint32_t firstVertex = spheres.vertices.size();
+
+            spheres.vertices.insert(spheres.vertices.end(), sphere.vertices.begin(), sphere.vertices.end());
+
+            for (uint32_t index : sphere.indices) {
+                spheres.indices.push_back(firstVertex + index);
+            }
+        }
+
+        std::vector<uint32_t> order(spheres.indices.size() / 3);
+
+        for (uint32_t t = 0; t < order.size(); t++) {
+            order[t] = t;
+        }
+
+        std::shuffle(order.begin(), order.end(), random);
+
+        Mesh mesh;
+        mesh.vertices = std::move(spheres.vertices);
+
+        for (uint32_t t : order) {
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t index = spheres.indices[t * 3 + k];
+
+                if ((t + k) % 3 == 0) {
+                    mesh.vertices.push_back(mesh.vertices[index]);
+                    index = mesh.vertices.size() - 1;
+                }
+
+                mesh.indices.push_back(index);
+            }
+        }
+
+        return mesh;
+    }
+}
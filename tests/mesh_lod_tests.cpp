@@ -0,0 +1,205 @@
+#include "test.h"
+#include "mesh_fixtures.h"
+
+#include "mesh_lod.h"
+#include "mesh_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glm/ext/matrix_transform.hpp>
+
+namespace {
+    using fixtures::Mesh;
+    using fixtures::createGrid;
+    using fixtures::createSphere;
+
+    double getSegmentDistance(const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b) {
+        glm::dvec3 ab = b - a;
+        double t = glm::dot(ab, ab) > 0.0 ? std::clamp(glm::dot(p - a, ab) / glm::dot(ab, ab), 0.0, 1.0) : 0.0;
+
+        return glm::distance(p, a + ab * t);
+    }
+
+    // closest point is either the projection onto the plane or on one of the edges
+    double getTriangleDistance(const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c) {
+        glm::dvec3 normal = glm::cross(b - a, c - a);
+        double area = glm::length(normal);
+
+        if (area > 0.0) {
+            normal /= area;
+
+            glm::dvec3 projected = p - normal * glm::dot(p - a, normal);
+            bool inside = glm::dot(glm::cross(b - a, projected - a), normal) >= 0.0
+                       && glm::dot(glm::cross(c - b, projected - b), normal) >= 0.0
+                       && glm::dot(glm::cross(a - c, projected - c), normal) >= 0.0;
+
+            if (inside) {
+                return std::abs(glm::dot(p - a, normal));
+            }
+        }
+
+        return std::min({getSegmentDistance(p, a, b), getSegmentDistance(p, b, c), getSegmentDistance(p, c, a)});
+    }
+
+    // largest distance from a dense grid of points on the triangles of from to the closest triangle of to
+    double getOneSidedDistance(const std::vector<Vertex>& vertices, std::span<const uint32_t> from, std::span<const uint32_t> to) {
+        const uint32_t steps = 7;
+        double maxDistance = 0.0;
+
+        auto getPosition = [&](uint32_t index) {
+            return glm::dvec3(vertices[index].position);
+        };
+
+        auto getDistance = [&](const glm::dvec3& p, size_t s) {
+            return getTriangleDistance(p, getPosition(to[s]), getPosition(to[s + 1]), getPosition(to[s + 2]));
+        };
+
+        // neighbouring samples mostly share their closest triangle
+        size_t previous = 0;
+
+        for (size_t t = 0; t < from.size(); t += 3) {
+            for (uint32_t i = 0; i <= steps; i++) {
+                for (uint32_t j = 0; i + j <= steps; j++) {
+                    uint32_t k = steps - i - j;
+                    glm::dvec3 p = (getPosition(from[t]) * (double)i + getPosition(from[t + 1]) * (double)j + getPosition(from[t + 2]) * (double)k) / (double)steps;
+
+                    double distance = getDistance(p, previous);
+
+                    for (size_t s = 0; s < to.size() && distance > maxDistance; s += 3) {
+                        double triangleDistance = getDistance(p, s);
+
+                        if (triangleDistance < distance) {
+                            distance = triangleDistance;
+                            previous = s;
+                        }
+                    }
+
+                    maxDistance = std::max(maxDistance, distance);
+                }
+            }
+        }
+
+        return maxDistance;
+    }
+
+    double getArea(const std::vector<Vertex>& vertices, std::span<const uint32_t> indices) {
+        double area = 0.0;
+
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            glm::dvec3 a = vertices[indices[t]].position;
+            glm::dvec3 b = vertices[indices[t + 1]].position;
+            glm::dvec3 c = vertices[indices[t + 2]].position;
+
+            area += glm::length(glm::cross(b - a, c - a)) * 0.5;
+        }
+
+        return area;
+    }
+
+    void checkErrorBound(const Mesh& mesh) {
+        std::vector<MeshLod> lods;
+        std::vector<uint32_t> lodIndices;
+        meshlod::buildLods(mesh.vertices, mesh.indices, lods, lodIndices);
+
+        CHECK_GE(lods.size(), 2u);
+
+        uint32_t previousCount = mesh.indices.size();
+        float previousError = 0.f;
+
+        for (const auto& lod : lods) {
+            std::span<const uint32_t> indices(lodIndices.data() + lod.indexOffset, lod.indexCount);
+
+            double measured = std::max(getOneSidedDistance(mesh.vertices, indices, mesh.indices), getOneSidedDistance(mesh.vertices, mesh.indices, indices));
+
+            CHECK_LE(measured, (double)lod.error);
+            CHECK_LT(lod.indexCount, previousCount);
+            CHECK_GE(lod.error, previousError);
+
+            previousCount = lod.indexCount;
+            previousError = lod.error;
+        }
+    }
+}
+
+TEST_CASE("mesh lod: reported error bounds the distance to a sphere") {
+    checkErrorBound(createSphere(48));
+}
+
+TEST_CASE("mesh lod: reported error bounds the distance to a bumpy terrain") {
+    checkErrorBound(createGrid(32, 32, [](float u, float v) {
+        return glm::vec3(u * 4.f, v * 4.f, std::sin(u * 9.f) * std::cos(v * 7.f) * 0.2f);
+    }));
+}
+
+TEST_CASE("mesh lod: flat grids keep their outline without error") {
+    Mesh grid = createGrid(32, 32, [](float u, float v) {
+        return glm::vec3(u * 2.f - 1.f, v * 2.f - 1.f, 1.f);
+    });
+
+    std::vector<MeshLod> lods;
+    std::vector<uint32_t> lodIndices;
+    meshlod::buildLods(grid.vertices, grid.indices, lods, lodIndices);
+
+    CHECK_GE(lods.size(), 2u);
+
+    for (const auto& lod : lods) {
+        std::span<const uint32_t> indices(lodIndices.data() + lod.indexOffset, lod.indexCount);
+
+        CHECK_LT(lod.error, 1e-6f);
+        CHECK_LT(std::abs(getArea(grid.vertices, indices) - 4.0), 1e-4);
+    }
+}
+
+TEST_CASE("mesh lod: small surfaces get no levels") {
+    Mesh grid = createGrid(8, 8, [](float u, float v) {
+        return glm::vec3(u, v, 0.f);
+    });
+
+    std::vector<MeshLod> lods;
+    std::vector<uint32_t> lodIndices;
+    meshlod::buildLods(grid.vertices, grid.indices, lods, lodIndices);
+
+    CHECK(lods.empty());
+    CHECK(lodIndices.empty());
+}
+
+TEST_CASE("mesh lod: selected levels stay within the pixel budget") {
+    const std::vector<MeshLod> lods{{0, 600, 0.001f}, {600, 300, 0.004f}, {900, 150, 0.016f}, {1050, 75, 0.064f}};
+    const Bounds bounds{glm::vec3(0.f), 1.f, glm::vec3(1.f)};
+    const float maxError = 1.f;
+
+    // 1080 pixels high at a 70 degree field of view
+    meshlod::View view = meshlod::makeView(glm::vec3(0.f), 1.f / std::tan(glm::radians(35.f)), 1080.f, maxError);
+
+    CHECK_EQ(meshlod::selectLod({}, bounds, glm::mat4(1.f), view), 0u);
+    CHECK_EQ(meshlod::selectLod(lods, bounds, glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, 0.5f)), view), 0u);
+
+    uint32_t previous = 0;
+
+    for (float distance = 2.f; distance < 2000.f; distance *= 1.5f) {
+        glm::mat4 transform = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -distance)), glm::vec3(2.f));
+        uint32_t lod = meshlod::selectLod(lods, bounds, transform, view);
+
+        // projected at the closest point of the scaled bounding sphere
+        float pixelsPerUnit = view.pixelScale * 2.f / (distance - 2.f);
+
+        CHECK_GE(lod, previous);
+
+        if (lod > 0) {
+            CHECK_LE(lods[lod - 1].error * pixelsPerUnit, maxError);
+        }
+
+        if (lod < lods.size()) {
+            CHECK_GT(lods[lod].error * pixelsPerUnit, maxError);
+        }
+
+        previous = lod;
+    }
+
+    CHECK_EQ(previous, (uint32_t)lods.size());
+
+    meshlod::View fullDetail = meshlod::makeView(glm::vec3(0.f), 1.f, 1080.f, 0.f);
+    CHECK_EQ(meshlod::selectLod(lods, bounds, glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -1000.f)), fullDetail), 0u);
+}
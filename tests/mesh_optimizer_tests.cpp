@@ -0,0 +1,171 @@
+#include "test.h"
+#include "mesh_fixtures.h"
+
+#include "mesh_optimizer.h"
+#include "mesh_types.h"
+
+#include <algorithm>
+#include <array>
+#include <tuple>
+
+namespace {
+    using fixtures::Mesh;
+
+    const uint32_t SPHERE_COUNT = 6;
+    const uint32_t SEGMENT_COUNT = 24;
+    // unique vertices of the spheres, the poles and seams stay split by their uvs
+    const uint32_t UNIQUE_VERTEX_COUNT = SPHERE_COUNT * (SEGMENT_COUNT + 1) * (SEGMENT_COUNT / 2 + 1);
+
+    // triangles as sorted position triples, rotated so the smallest position comes first to keep the winding
+    std::vector<std::array<float, 9>> collectTriangles(const Mesh& mesh) {
+        std::vector<std::array<float, 9>> triangles;
+
+        auto positionLess = [](const glm::vec3& a, const glm::vec3& b) {
+            return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+        };
+
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            std::array<glm::vec3, 3> p = {mesh.vertices[mesh.indices[i]].position, mesh.vertices[mesh.indices[i + 1]].position, mesh.vertices[mesh.indices[i + 2]].position};
+
+            std::rotate(p.begin(), std::min_element(p.begin(), p.end(), positionLess), p.end());
+            triangles.push_back({p[0].x, p[0].y, p[0].z, p[1].x, p[1].y, p[1].z, p[2].x, p[2].y, p[2].z});
+        }
+
+        std::sort(triangles.begin(), triangles.end());
+
+        return triangles;
+    }
+
+    uint32_t countUniqueIndices(const std::vector<uint32_t>& indices) {
+        std::vector<uint32_t> unique(indices);
+        std::sort(unique.begin(), unique.end());
+
+        return std::unique(unique.begin(), unique.end()) - unique.begin();
+    }
+}
+
+TEST_CASE("mesh optimizer: acmr and atvr count cache misses") {
+    // a strip of quads, every triangle after the first reuses two vertices
+    std::vector<uint32_t> strip;
+
+    for (uint32_t i = 0; i < 10; i++) {
+        strip.insert(strip.end(), {i * 2, i * 2 + 1, i * 2 + 2, i * 2 + 2, i * 2 + 1, i * 2 + 3});
+    }
+
+    CHECK_EQ(meshopt::computeACMR(strip), 22.f / 20.f);
+    CHECK_EQ(meshopt::computeATVR(strip), 1.f);
+
+    // no shared vertices at all
+    std::vector<uint32_t> soup{0, 1, 2, 3, 4, 5, 6, 7, 8};
+    CHECK_EQ(meshopt::computeACMR(soup), 3.f);
+
+    // a single entry cache only keeps the corner shared by consecutive triangles
+    CHECK_EQ(meshopt::computeACMR(strip, 1), 2.5f);
+}
+
+TEST_CASE("mesh optimizer: deduplication merges exactly the identical vertices") {
+    Mesh mesh = fixtures::createUnweldedSpheres(SPHERE_COUNT, SEGMENT_COUNT);
+    auto triangles = collectTriangles(mesh);
+
+    CHECK_GT(countUniqueIndices(mesh.indices), UNIQUE_VERTEX_COUNT);
+
+    meshopt::deduplicateVertices(mesh.indices, mesh.vertices);
+
+    CHECK_EQ(countUniqueIndices(mesh.indices), UNIQUE_VERTEX_COUNT);
+    CHECK(collectTriangles(mesh) == triangles);
+
+    // vertices differing in a single attribute stay apart
+    std::vector<Vertex> vertices(2, Vertex{glm::vec3(1.f), 0.5f, glm::vec3(0.f, 1.f, 0.f), 0.5f});
+    vertices[1].uvY = 0.25f;
+
+    std::vector<uint32_t> indices{0, 1, 0};
+    meshopt::deduplicateVertices(indices, vertices);
+
+    CHECK(indices == std::vector<uint32_t>({0, 1, 0}));
+}
+
+TEST_CASE("mesh optimizer: reordering keeps every triangle and its winding") {
+    Mesh mesh = fixtures::createUnweldedSpheres(SPHERE_COUNT, SEGMENT_COUNT);
+    meshopt::deduplicateVertices(mesh.indices, mesh.vertices);
+
+    auto triangles = collectTriangles(mesh);
+
+    meshopt::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    CHECK(collectTriangles(mesh) == triangles);
+
+    meshopt::optimizeOverdraw(mesh.indices, mesh.vertices);
+    CHECK(collectTriangles(mesh) == triangles);
+
+    mesh.vertices.resize(meshopt::optimizeVertexFetch(mesh.vertices, mesh.indices));
+    CHECK(collectTriangles(mesh) == triangles);
+}
+
+TEST_CASE("mesh optimizer: acmr does not get worse") {
+    Mesh mesh = fixtures::createUnweldedSpheres(SPHERE_COUNT, SEGMENT_COUNT);
+    meshopt::deduplicateVertices(mesh.indices, mesh.vertices);
+
+    float shuffledACMR = meshopt::computeACMR(mesh.indices);
+
+    meshopt::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    float cacheACMR = meshopt::computeACMR(mesh.indices);
+
+    CHECK_LT(cacheACMR, shuffledACMR);
+    // close to the 0.5 of an infinite cache, the spheres share no vertices
+    CHECK_LT(cacheACMR, 0.8f);
+
+    float cacheOverdraw = meshopt::computeOverdraw(mesh.indices, mesh.vertices);
+
+    meshopt::optimizeOverdraw(mesh.indices, mesh.vertices);
+
+    CHECK_LE(meshopt::computeACMR(mesh.indices), cacheACMR * meshopt::OVERDRAW_THRESHOLD);
+    CHECK_LE(meshopt::computeOverdraw(mesh.indices, mesh.vertices), cacheOverdraw);
+
+    // an ordered grid is already close to ideal, the cache order must not undo that
+    Mesh grid = fixtures::createGrid(32, 32, [](float u, float v) {
+        return glm::vec3(u * 32.f, v * 32.f, 0.f);
+    });
+
+    float gridACMR = meshopt::computeACMR(grid.indices);
+    meshopt::optimizeVertexCache(grid.indices, grid.vertices.size());
+
+    CHECK_LE(meshopt::computeACMR(grid.indices), gridACMR);
+}
+
+TEST_CASE("mesh optimizer: vertex fetch order follows first use") {
+    Mesh mesh = fixtures::createUnweldedSpheres(SPHERE_COUNT, SEGMENT_COUNT);
+    meshopt::deduplicateVertices(mesh.indices, mesh.vertices);
+    meshopt::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+
+    uint32_t vertexCount = meshopt::optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+    CHECK_EQ(vertexCount, UNIQUE_VERTEX_COUNT);
+
+    // every index is either a vertex seen before or the next new one
+    uint32_t next = 0;
+    bool ordered = true;
+
+    for (uint32_t index : mesh.indices) {
+        if (index == next) {
+            next++;
+        } else {
+            ordered &= index < next;
+        }
+    }
+
+    CHECK(ordered);
+    CHECK_EQ(next, vertexCount);
+}
+
+TEST_CASE("mesh optimizer: optimize reports what it did") {
+    Mesh mesh = fixtures::createUnweldedSpheres(SPHERE_COUNT, SEGMENT_COUNT);
+    auto triangles = collectTriangles(mesh);
+
+    meshopt::Stats stats = meshopt::optimize(mesh.vertices, mesh.indices, true);
+
+    CHECK(collectTriangles(mesh) == triangles);
+    CHECK_LT(stats.acmrAfter, stats.acmrBefore);
+    CHECK_LT(stats.atvrAfter, stats.atvrBefore);
+    CHECK_EQ(stats.vertexCountAfter, UNIQUE_VERTEX_COUNT);
+    CHECK_EQ((uint32_t)mesh.vertices.size(), UNIQUE_VERTEX_COUNT);
+    CHECK_EQ(stats.acmrAfter, meshopt::computeACMR(mesh.indices));
+}
@@ -0,0 +1,156 @@
+#include "test.h"
+
+#include "mesh_quantization.h"
+#include "mesh_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+    // angle between unit vectors in degrees, acos loses the small angles to float precision
+    float getAngle(const glm::vec3& a, const glm::vec3& b) {
+        return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+    }
+
+    // axes, edges and corners of the octahedron fold, where the encoding changes direction
+    std::vector<glm::vec3> getFoldNormals() {
+        std::vector<glm::vec3> normals;
+
+        for (int x = -1; x <= 1; x++) {
+            for (int y = -1; y <= 1; y++) {
+                for (int z = -1; z <= 1; z++) {
+                    if (x != 0 || y != 0 || z != 0) {
+                        normals.push_back(glm::normalize(glm::vec3(x, y, z)));
+                    }
+                }
+            }
+        }
+
+        return normals;
+    }
+}
+
+TEST_CASE("mesh quantization: compact vertices are half the size") {
+    CHECK_EQ(sizeof(CompactVertex), 16u);
+    CHECK_EQ(sizeof(CompactVertex) * 2, sizeof(Vertex));
+}
+
+TEST_CASE("mesh quantization: octahedral normals survive the fold") {
+    std::vector<glm::vec3> normals = getFoldNormals();
+
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+    while (normals.size() < 20000) {
+        glm::vec3 normal(unit(random), unit(random), unit(random));
+
+        if (glm::length(normal) > 0.01f) {
+            normals.push_back(glm::normalize(normal));
+        }
+    }
+
+    float maxError = 0.f;
+
+    for (const auto& normal : normals) {
+        glm::vec2 encoded = meshquant::encodeOctahedral(normal);
+
+        CHECK_LE(std::max(std::abs(encoded.x), std::abs(encoded.y)), 1.f);
+        CHECK_LT(getAngle(meshquant::decodeOctahedral(encoded), normal), 1e-3f);
+
+        // through the snorm16 pair of the compact vertex
+        Vertex vertex{};
+        vertex.normal = normal;
+
+        maxError = std::max(maxError, getAngle(meshquant::decompress(meshquant::compress(vertex, {}), {}).normal, normal));
+    }
+
+    CHECK_LT(maxError, 0.01f);
+
+    // zero length normals encode to the center instead of nan
+    glm::vec2 zero = meshquant::encodeOctahedral(glm::vec3(0.f));
+    CHECK_EQ(zero.x, 0.f);
+    CHECK_EQ(zero.y, 0.f);
+}
+
+TEST_CASE("mesh quantization: positions round to the closest step") {
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+    // a building sized box, so position steps are in the millimeter range
+    glm::vec3 size(120.f, 40.f, 80.f);
+    std::vector<Vertex> vertices;
+
+    for (uint32_t i = 0; i < 10000; i++) {
+        Vertex vertex{};
+        vertex.position = glm::vec3(unit(random), unit(random), unit(random)) * size * 0.5f + glm::vec3(500.f, 0.f, -200.f);
+        vertices.push_back(vertex);
+    }
+
+    meshquant::PositionRange range = meshquant::getPositionRange(vertices);
+    std::vector<CompactVertex> compact = meshquant::compressVertices(vertices, range);
+
+    CHECK_EQ(compact.size(), vertices.size());
+
+    glm::vec3 step = range.scale / 65535.f;
+    float maxError = 0.f;
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        glm::vec3 error = glm::abs(meshquant::decompress(compact[i], range).position - vertices[i].position) / step;
+        maxError = std::max({maxError, error.x, error.y, error.z});
+    }
+
+    // half a step, up to float precision of the input
+    CHECK_LE(maxError, 0.51f);
+
+    // the bounds decode exactly, so surfaces sharing the range meet at the same positions
+    Vertex corner{};
+    corner.position = range.offset + range.scale;
+
+    CHECK(meshquant::decompress(meshquant::compress(corner, range), range).position == corner.position);
+
+    corner.position = range.offset;
+    CHECK(meshquant::decompress(meshquant::compress(corner, range), range).position == corner.position);
+}
+
+TEST_CASE("mesh quantization: flat meshes keep their plane") {
+    std::vector<Vertex> vertices(3, Vertex{});
+    vertices[0].position = glm::vec3(0.f, 2.f, 0.f);
+    vertices[1].position = glm::vec3(1.f, 2.f, 0.f);
+    vertices[2].position = glm::vec3(0.f, 2.f, 1.f);
+
+    meshquant::PositionRange range = meshquant::getPositionRange(vertices);
+
+    CHECK_EQ(range.scale.y, 0.f);
+
+    for (const auto& vertex : vertices) {
+        CHECK(meshquant::decompress(meshquant::compress(vertex, range), range).position == vertex.position);
+    }
+}
+
+TEST_CASE("mesh quantization: uvs keep a texel of a 4096 texture") {
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> texCoord(0.f, 1.f);
+
+    float maxError = 0.f;
+
+    for (uint32_t i = 0; i < 10000; i++) {
+        Vertex vertex{};
+        vertex.uvX = texCoord(random);
+        vertex.uvY = texCoord(random);
+
+        Vertex decoded = meshquant::decompress(meshquant::compress(vertex, {}), {});
+        maxError = std::max({maxError, std::abs(decoded.uvX - vertex.uvX), std::abs(decoded.uvY - vertex.uvY)});
+    }
+
+    CHECK_LE(maxError * 4096.f, 1.f);
+
+    // tiled uvs lose precision relative to their magnitude only
+    Vertex tiled{};
+    tiled.uvX = 7.3f;
+    tiled.uvY = -3.9f;
+
+    Vertex decoded = meshquant::decompress(meshquant::compress(tiled, {}), {});
+    CHECK_LE(std::abs(decoded.uvX - tiled.uvX), 7.3f / 1024.f);
+    CHECK_LE(std::abs(decoded.uvY - tiled.uvY), 3.9f / 1024.f);
+}
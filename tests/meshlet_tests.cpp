@@ -0,0 +1,186 @@
+#include "test.h"
+#include "mesh_fixtures.h"
+
+#include "mesh_optimizer.h"
+#include "mesh_types.h"
+#include "meshlet_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace {
+    using fixtures::Mesh;
+
+    // unit sphere in the cache order the loader builds meshlets from
+    Mesh createSphere(uint32_t segmentCount) {
+        Mesh mesh = fixtures::createSphere(segmentCount);
+        meshopt::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+
+        return mesh;
+    }
+
+    // a wavy sheet facing +z, meshlets get narrow but not flat cones
+    Mesh createTerrain(uint32_t size) {
+        Mesh mesh = fixtures::createGrid(size, size, [](float u, float v) {
+            return glm::vec3(u * 8.f, v * 8.f, std::sin(u * 11.f) * std::cos(v * 7.f) * 0.3f);
+        });
+
+        meshopt::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+
+        return mesh;
+    }
+
+    // builds the meshlets and checks that they cut the indices in order within the limits
+    std::vector<Meshlet> buildChecked(const Mesh& mesh) {
+        std::vector<Meshlet> meshletList;
+        meshlets::build(mesh.vertices, mesh.indices, meshletList);
+
+        CHECK(!meshletList.empty());
+
+        uint32_t nextIndex = 0;
+        std::vector<uint32_t> vertexMeshlet(mesh.vertices.size(), std::numeric_limits<uint32_t>::max());
+
+        for (uint32_t m = 0; m < meshletList.size(); m++) {
+            const Meshlet& meshlet = meshletList[m];
+            uint32_t vertexCount = 0;
+
+            for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.triangleCount * 3; i++) {
+                if (vertexMeshlet[mesh.indices[i]] != m) {
+                    vertexMeshlet[mesh.indices[i]] = m;
+                    vertexCount++;
+                }
+            }
+
+            CHECK_GT(meshlet.triangleCount, 0u);
+            CHECK_LE(meshlet.triangleCount, meshlets::MAX_TRIANGLES);
+            CHECK_LE(vertexCount, meshlets::MAX_VERTICES);
+            CHECK_EQ(meshlet.firstIndex, nextIndex);
+
+            nextIndex = meshlet.firstIndex + meshlet.triangleCount * 3;
+        }
+
+        CHECK_EQ(nextIndex, (uint32_t)mesh.indices.size());
+
+        return meshletList;
+    }
+
+    // culled triangles that would have been rasterized, returns how many meshlets were culled
+    uint32_t checkCulledFacingAway(const Mesh& mesh, const std::vector<Meshlet>& meshletList, const glm::vec3& cameraPosition) {
+        uint32_t culledMeshlets = 0;
+        uint32_t frontFacing = 0;
+
+        for (const Meshlet& meshlet : meshletList) {
+            if (!meshlets::isBackfacing(meshlet, cameraPosition)) {
+                continue;
+            }
+
+            culledMeshlets++;
+
+            for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.triangleCount * 3; i += 3) {
+                glm::vec3 p0 = mesh.vertices[mesh.indices[i]].position;
+                glm::vec3 p1 = mesh.vertices[mesh.indices[i + 1]].position;
+                glm::vec3 p2 = mesh.vertices[mesh.indices[i + 2]].position;
+
+                frontFacing += glm::dot(p0 - cameraPosition, glm::cross(p1 - p0, p2 - p0)) < 0.f;
+            }
+        }
+
+        CHECK_EQ(frontFacing, 0u);
+
+        return culledMeshlets;
+    }
+}
+
+TEST_CASE("meshlets: cache ordered surfaces stay within the limits") {
+    Mesh sphere = createSphere(64);
+    std::vector<Meshlet> meshletList = buildChecked(sphere);
+
+    // cache order shares most vertices, meshlets should fill up on triangles, not on vertices
+    CHECK_GT(sphere.indices.size() / 3.f / meshletList.size(), 80.f);
+
+    buildChecked(createTerrain(48));
+}
+
+TEST_CASE("meshlets: shuffled triangles stay within the vertex limit") {
+    Mesh sphere = createSphere(32);
+
+    // no shared vertices between consecutive triangles, every triangle brings three new ones
+    std::vector<uint32_t> order(sphere.indices.size() / 3);
+
+    for (uint32_t t = 0; t < order.size(); t++) {
+        order[t] = t;
+    }
+
+    std::shuffle(order.begin(), order.end(), std::mt19937(17));
+
+    std::vector<uint32_t> indices;
+
+    for (uint32_t t : order) {
+        for (uint32_t k = 0; k < 3; k++) {
+            sphere.vertices.push_back(sphere.vertices[sphere.indices[t * 3 + k]]);
+            indices.push_back(sphere.vertices.size() - 1);
+        }
+    }
+
+    sphere.indices = indices;
+
+    for (const Meshlet& meshlet : buildChecked(sphere)) {
+        CHECK_LE(meshlet.triangleCount, meshlets::MAX_VERTICES / 3);
+    }
+}
+
+TEST_CASE("meshlets: bounding spheres contain their vertices") {
+    Mesh sphere = createSphere(64);
+    Mesh terrain = createTerrain(48);
+
+    for (const Mesh* mesh : {&sphere, &terrain}) {
+        for (const Meshlet& meshlet : buildChecked(*mesh)) {
+            for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.triangleCount * 3; i++) {
+                CHECK_LE(glm::distance(glm::vec3(meshlet.sphere), mesh->vertices[mesh->indices[i]].position), meshlet.sphere.w * (1.f + 1e-6f));
+            }
+        }
+    }
+}
+
+TEST_CASE("meshlets: cone culled triangles face away from the camera") {
+    Mesh sphere = createSphere(64);
+    std::vector<Meshlet> sphereMeshlets = buildChecked(sphere);
+
+    std::mt19937 random(23);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+    uint32_t culledMeshlets = 0;
+
+    // up close the camera sees less than half of the sphere, far away the cones still have to hold
+    for (float distance : {1.05f, 1.5f, 3.f, 10.f, 100.f}) {
+        for (uint32_t v = 0; v < 16; v++) {
+            glm::vec3 direction(unit(random), unit(random), unit(random));
+
+            if (glm::length(direction) < 0.01f) {
+                continue;
+            }
+
+            culledMeshlets += checkCulledFacingAway(sphere, sphereMeshlets, glm::normalize(direction) * distance);
+        }
+    }
+
+    // a test that culls nothing would pass trivially
+    CHECK_GT(culledMeshlets, 0u);
+
+    Mesh terrain = createTerrain(48);
+    std::vector<Meshlet> terrainMeshlets = buildChecked(terrain);
+
+    culledMeshlets = 0;
+
+    for (uint32_t v = 0; v < 64; v++) {
+        glm::vec3 cameraPosition = glm::vec3(unit(random) * 12.f + 4.f, unit(random) * 12.f + 4.f, unit(random) * 6.f);
+
+        culledMeshlets += checkCulledFacingAway(terrain, terrainMeshlets, cameraPosition);
+    }
+
+    // from below the sheet every meshlet faces away
+    CHECK_EQ(checkCulledFacingAway(terrain, terrainMeshlets, glm::vec3(4.f, 4.f, -50.f)), (uint32_t)terrainMeshlets.size());
+    CHECK_GT(culledMeshlets, 0u);
+}
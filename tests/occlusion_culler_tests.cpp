@@ -0,0 +1,321 @@
+#include "test.h"
+
+#include "occlusion_culler.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <random>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+namespace {
+    struct Box {
+        glm::vec3 center;
+        glm::vec3 extents;
+
+        glm::mat4 getTransform() const {
+            return glm::scale(glm::translate(glm::mat4(1.f), center), extents);
+        }
+    };
+
+    // unit cube, buildings and props are scaled copies
+    const std::vector<glm::vec3> CUBE_POSITIONS{
+        {-1.f, -1.f, -1.f}, {1.f, -1.f, -1.f}, {1.f, 1.f, -1.f}, {-1.f, 1.f, -1.f},
+        {-1.f, -1.f, 1.f}, {1.f, -1.f, 1.f}, {1.f, 1.f, 1.f}, {-1.f, 1.f, 1.f}
+    };
+
+    const std::vector<uint32_t> CUBE_INDICES{
+        0, 1, 2, 0, 2, 3,
+        4, 6, 5, 4, 7, 6,
+        0, 3, 7, 0, 7, 4,
+        1, 5, 6, 1, 6, 2,
+        3, 2, 6, 3, 6, 7,
+        0, 4, 5, 0, 5, 1
+    };
+
+    // same projection setup as the camera component (reversed depth)
+    glm::mat4 getViewProjection(const glm::vec3& position, const glm::vec3& direction) {
+        glm::mat4 view = glm::lookAt(position, position + direction, glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 projection = glm::perspective(glm::radians(70.f), 16.f / 9.f, 1000.f, 0.1f);
+
+        return projection * view;
+    }
+
+    // one building per block with streets in between and props scattered on the ground
+    struct City {
+        std::vector<Box> buildings;
+        std::vector<Box> props;
+        float extent;
+    };
+
+    City createCity(uint32_t blockCount, uint32_t propCount) {
+        const float blockSize = 20.f;
+
+        City city;
+        city.extent = blockCount * blockSize * 0.5f;
+
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<float> footprint(6.f, 9.f);
+        std::uniform_real_distribution<float> height(4.f, 30.f);
+        std::uniform_real_distribution<float> propPosition(-city.extent, city.extent);
+        std::uniform_real_distribution<float> propSize(0.3f, 1.5f);
+
+        for (uint32_t x = 0; x < blockCount; x++) {
+            for (uint32_t z = 0; z < blockCount; z++) {
+                glm::vec3 extents(footprint(generator), height(generator), footprint(generator));
+                glm::vec3 center((x + 0.5f) * blockSize - city.extent, extents.y, (z + 0.5f) * blockSize - city.extent);
+
+                city.buildings.push_back({center, extents});
+            }
+        }
+
+        for (uint32_t i = 0; i < propCount; i++) {
+            glm::vec3 extents(propSize(generator));
+            city.props.push_back({glm::vec3(propPosition(generator), extents.y, propPosition(generator)), extents});
+        }
+
+        return city;
+    }
+
+    void addOccluders(OcclusionCuller& culler, const std::vector<Box>& occluders) {
+        for (const auto& occluder : occluders) {
+            culler.addOccluder(CUBE_POSITIONS.data(), CUBE_INDICES.data(), CUBE_INDICES.size(), occluder.getTransform());
+        }
+    }
+
+    bool isVisible(const OcclusionCuller& culler, const Box& box) {
+        return culler.isVisible(glm::vec3(0.f), box.extents, glm::translate(glm::mat4(1.f), box.center));
+    }
+
+    // ray against an axis aligned box, true if it hits before maxDistance
+    bool rayHitsBox(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const Box& box) {
+        glm::vec3 inverse = 1.f / direction;
+        glm::vec3 t0 = (box.center - box.extents - origin) * inverse;
+        glm::vec3 t1 = (box.center + box.extents - origin) * inverse;
+
+        glm::vec3 near = glm::min(t0, t1);
+        glm::vec3 far = glm::max(t0, t1);
+
+        float enter = std::max({near.x, near.y, near.z, 0.f});
+        float exit = std::min({far.x, far.y, far.z, maxDistance});
+
+        return enter <= exit;
+    }
+
+    // a corner or the center of the box is on screen with no occluder on the way from the camera
+    bool isExposed(const Box& box, const std::vector<Box>& occluders, const glm::vec3& viewPosition, const glm::mat4& viewProjection) {
+        for (uint32_t c = 0; c < 9; c++) {
+            glm::vec3 corner(c & 1 ? 1.f : -1.f, c & 2 ? 1.f : -1.f, c & 4 ? 1.f : -1.f);
+            glm::vec3 target = c == 8 ? box.center : box.center + corner * box.extents * 0.99f;
+
+            glm::vec4 clip = viewProjection * glm::vec4(target, 1.f);
+
+            if (clip.w <= 0.f || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w || clip.z < 0.f || clip.z > clip.w) {
+                continue;
+            }
+
+            glm::vec3 direction = target - viewPosition;
+            float distance = glm::length(direction);
+            direction /= distance;
+
+            bool blocked = std::any_of(occluders.begin(), occluders.end(), [&](const Box& occluder) {
+                return rayHitsBox(viewPosition, direction, distance, occluder);
+            });
+
+            if (!blocked) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+TEST_CASE("occlusion culler: scalar, sse and threaded paths write the same depth") {
+    City city = createCity(24, 0);
+    glm::vec3 viewPosition(-city.extent + 2.f, 1.8f, 0.5f);
+
+    OcclusionCuller culler;
+    ThreadPool threadPool(4);
+
+    auto rasterize = [&](OcclusionCuller::Path path, ThreadPool* pool) {
+        culler.beginFrame(getViewProjection(viewPosition, glm::vec3(1.f, 0.f, 0.35f)));
+        addOccluders(culler, city.buildings);
+        culler.rasterize(pool, path);
+
+        return culler.getDepth();
+    };
+
+    std::vector<float> scalarDepth = rasterize(OcclusionCuller::Path::SCALAR, nullptr);
+
+    CHECK(std::any_of(scalarDepth.begin(), scalarDepth.end(), [](float depth) { return depth > 0.f; }));
+    CHECK(rasterize(OcclusionCuller::Path::SSE, nullptr) == scalarDepth);
+    CHECK(rasterize(OcclusionCuller::Path::SCALAR, &threadPool) == scalarDepth);
+    CHECK(rasterize(OcclusionCuller::Path::AUTO, &threadPool) == scalarDepth);
+}
+
+TEST_CASE("occlusion culler: written pixels lie inside the triangle and behind it") {
+    glm::vec3 viewPosition(0.f, 0.f, 5.f);
+    glm::mat4 viewProjection = getViewProjection(viewPosition, glm::vec3(0.f, 0.f, -1.f));
+
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+    OcclusionCuller culler;
+
+    for (uint32_t iteration = 0; iteration < 50; iteration++) {
+        std::vector<glm::vec3> positions{
+            glm::vec3(unit(generator) * 3.f, unit(generator) * 2.f, unit(generator)),
+            glm::vec3(unit(generator) * 3.f, unit(generator) * 2.f, unit(generator)),
+            glm::vec3(unit(generator) * 3.f, unit(generator) * 2.f, unit(generator))
+        };
+        std::vector<uint32_t> indices{0, 1, 2};
+
+        culler.beginFrame(viewProjection);
+        culler.addOccluder(positions.data(), indices.data(), indices.size(), glm::mat4(1.f));
+        culler.rasterize(nullptr, OcclusionCuller::Path::SCALAR);
+
+        // screen positions and depths of the corners, following the culler's conventions
+        glm::vec2 screen[3];
+        float depth[3];
+
+        for (uint32_t v = 0; v < 3; v++) {
+            glm::vec4 clip = viewProjection * glm::vec4(positions[v], 1.f);
+            screen[v] = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(OcclusionCuller::WIDTH, OcclusionCuller::HEIGHT);
+            depth[v] = 1.f / clip.w;
+        }
+
+        float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+
+        // barycentric weights of a screen point
+        auto getWeights = [&](const glm::vec2& point) {
+            auto edge = [&](const glm::vec2& a, const glm::vec2& b) {
+                return ((b.x - a.x) * (point.y - a.y) - (b.y - a.y) * (point.x - a.x)) / area;
+            };
+
+            return glm::vec3(edge(screen[1], screen[2]), edge(screen[2], screen[0]), edge(screen[0], screen[1]));
+        };
+
+        const auto& buffer = culler.getDepth();
+
+        for (uint32_t y = 0; y < OcclusionCuller::HEIGHT; y++) {
+            for (uint32_t x = 0; x < OcclusionCuller::WIDTH; x++) {
+                float written = buffer[y * OcclusionCuller::WIDTH + x];
+
+                if (written == 0.f) {
+                    continue;
+                }
+
+                for (uint32_t c = 0; c < 4; c++) {
+                    glm::vec3 weights = getWeights(glm::vec2(x + (c & 1), y + (c >> 1)));
+                    float cornerDepth = weights.x * depth[0] + weights.y * depth[1] + weights.z * depth[2];
+
+                    CHECK_GE(std::min({weights.x, weights.y, weights.z}), -1e-4f);
+                    CHECK_LE(written, cornerDepth + 1e-6f);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("occlusion culler: quads cover the pixels along their diagonal") {
+    glm::mat4 viewProjection = getViewProjection(glm::vec3(0.f, 0.f, 5.f), glm::vec3(0.f, 0.f, -1.f));
+
+    // one flat quad and one folded along its diagonal
+    std::vector<glm::vec3> flat{{-1.f, -1.f, 0.f}, {1.f, -1.f, 0.f}, {1.f, 1.f, 0.f}, {-1.f, 1.f, 0.f}};
+    std::vector<glm::vec3> folded{{-1.f, -1.f, 0.f}, {1.f, -1.f, 0.f}, {1.f, 1.f, 0.f}, {-1.f, 1.f, 1.f}};
+    std::vector<uint32_t> indices{0, 1, 2, 0, 2, 3};
+
+    OcclusionCuller culler;
+
+    auto getCoverage = [&](const std::vector<glm::vec3>& positions, uint32_t& outPolygonCount) {
+        culler.beginFrame(viewProjection);
+        culler.addOccluder(positions.data(), indices.data(), indices.size(), glm::mat4(1.f));
+        culler.rasterize();
+        outPolygonCount = culler.getPolygonCount();
+
+        // pixels on the diagonal through the center of the screen
+        uint32_t covered = 0;
+
+        for (uint32_t y = OcclusionCuller::HEIGHT / 2 - 4; y < OcclusionCuller::HEIGHT / 2 + 4; y++) {
+            float written = culler.getDepth()[y * OcclusionCuller::WIDTH + OcclusionCuller::WIDTH / 2 + (y - OcclusionCuller::HEIGHT / 2)];
+            covered += written > 0.f;
+        }
+
+        return covered;
+    };
+
+    uint32_t polygonCount;
+
+    CHECK_EQ(getCoverage(flat, polygonCount), 8u);
+    CHECK_EQ(polygonCount, 1u);
+
+    // folded halves can't share one depth plane
+    getCoverage(folded, polygonCount);
+    CHECK_EQ(polygonCount, 2u);
+}
+
+TEST_CASE("occlusion culler: boxes are culled only when hidden") {
+    glm::vec3 viewPosition(0.f, 0.f, 10.f);
+    glm::mat4 viewProjection = getViewProjection(viewPosition, glm::vec3(0.f, 0.f, -1.f));
+
+    // wall from -2 to 2 on both axes at the origin
+    std::vector<Box> wall{{glm::vec3(0.f), glm::vec3(2.f, 2.f, 0.1f)}};
+
+    OcclusionCuller culler;
+    culler.beginFrame(viewProjection);
+    addOccluders(culler, wall);
+    culler.rasterize();
+
+    CHECK(!isVisible(culler, {glm::vec3(0.f, 0.f, -5.f), glm::vec3(1.f)}));
+    // in front of the wall
+    CHECK(isVisible(culler, {glm::vec3(0.f, 0.f, 3.f), glm::vec3(0.5f)}));
+    // behind it but peeking past the edge
+    CHECK(isVisible(culler, {glm::vec3(4.f, 0.f, -5.f), glm::vec3(0.5f)}));
+    // beside it
+    CHECK(isVisible(culler, {glm::vec3(-6.f, 0.f, -5.f), glm::vec3(0.5f)}));
+    // crossing the near plane
+    CHECK(isVisible(culler, {viewPosition, glm::vec3(0.5f)}));
+    // behind the camera
+    CHECK(isVisible(culler, {glm::vec3(0.f, 0.f, 20.f), glm::vec3(0.5f)}));
+}
+
+TEST_CASE("occlusion culler: no occluded prop can be seen from the camera") {
+    City city = createCity(24, 20000);
+
+    // street level views along and across the streets
+    const std::vector<std::pair<glm::vec3, glm::vec3>> views{
+        {glm::vec3(-city.extent + 2.f, 1.8f, 0.5f), glm::vec3(1.f, 0.f, 0.35f)},
+        {glm::vec3(0.3f, 1.8f, -city.extent + 2.f), glm::vec3(0.2f, 0.f, 1.f)},
+        {glm::vec3(10.f, 2.5f, 10.f), glm::vec3(-1.f, -0.05f, -0.6f)},
+        {glm::vec3(-city.extent, 40.f, -city.extent), glm::vec3(1.f, -0.6f, 1.f)}
+    };
+
+    OcclusionCuller culler;
+    ThreadPool threadPool(4);
+
+    for (const auto& [viewPosition, direction] : views) {
+        glm::mat4 viewProjection = getViewProjection(viewPosition, direction);
+
+        culler.beginFrame(viewProjection);
+        addOccluders(culler, city.buildings);
+        culler.rasterize(&threadPool);
+
+        uint32_t occludedCount = 0;
+        uint32_t exposedCount = 0;
+
+        for (const auto& prop : city.props) {
+            if (isVisible(culler, prop)) {
+                continue;
+            }
+
+            occludedCount++;
+            exposedCount += isExposed(prop, city.buildings, viewPosition, viewProjection);
+        }
+
+        // the culler has to do its job as well
+        CHECK_GT(occludedCount, 0u);
+        CHECK_EQ(exposedCount, 0u);
+    }
+}
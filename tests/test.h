@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+// minimal cpu test runner, cases register themselves at startup and failed checks
+// are reported without stopping the case, so one run shows every broken expectation
+namespace test {
+    struct Case {
+        const char* name;
+        void (*function)();
+    };
+
+    std::vector<Case>& getCases();
+    void reportFailure(std::string_view message, const char* file, int line);
+
+    struct Registrar {
+        Registrar(const char* name, void (*function)()) {
+            getCases().push_back({name, function});
+        }
+    };
+}
+
+#define TEST_CONCAT_INNER(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_INNER(a, b)
+
+#define TEST_CASE(name) \
+    static void TEST_CONCAT(testCase, __LINE__)(); \
+    static test::Registrar TEST_CONCAT(testRegistrar, __LINE__)(name, TEST_CONCAT(testCase, __LINE__)); \
+    static void TEST_CONCAT(testCase, __LINE__)()
+
+#define CHECK(expression) \
+    do { \
+        if (!(expression)) { \
+            test::reportFailure(#expression, __FILE__, __LINE__); \
+        } \
+    } while (false)
+
+// comparisons print both values on failure, operands are copied since they are often temporaries
+#define TEST_COMPARE(a, op, b) \
+    do { \
+        const auto testA = (a); \
+        const auto testB = (b); \
+        if (!(testA op testB)) { \
+            test::reportFailure(fmt::format("{} {} {} ({} vs {})", #a, #op, #b, testA, testB), __FILE__, __LINE__); \
+        } \
+    } while (false)
+
+#define CHECK_EQ(a, b) TEST_COMPARE(a, ==, b)
+#define CHECK_LE(a, b) TEST_COMPARE(a, <=, b)
+#define CHECK_LT(a, b) TEST_COMPARE(a, <, b)
+#define CHECK_GE(a, b) TEST_COMPARE(a, >=, b)
+#define CHECK_GT(a, b) TEST_COMPARE(a, >, b)
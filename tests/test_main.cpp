@@ -0,0 +1,43 @@
+#include "test.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+    uint32_t failureCount = 0;
+}
+
+std::vector<test::Case>& test::getCases() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+void test::reportFailure(std::string_view message, const char* file, int line) {
+    fmt::println("  {}:{}: check failed: {}", file, line, message);
+    failureCount++;
+}
+
+// runs every case, or the ones whose name contains the first argument
+int main(int argc, char** argv) {
+    uint32_t failedCases = 0;
+    uint32_t runCases = 0;
+
+    for (const auto& testCase : test::getCases()) {
+        if (argc > 1 && std::strstr(testCase.name, argv[1]) == nullptr) {
+            continue;
+        }
+
+        uint32_t previousFailures = failureCount;
+        testCase.function();
+        runCases++;
+
+        bool passed = failureCount == previousFailures;
+        failedCases += !passed;
+
+        fmt::println("[{}] {}", passed ? "pass" : "FAIL", testCase.name);
+    }
+
+    fmt::println("{} of {} cases passed", runCases - failedCases, runCases);
+
+    return failedCases == 0 ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+#include "test.h"
+
+#include "components/transform.h"
+#include "transform_hierarchy.h"
+
+#include <random>
+
+#include <glm/gtc/constants.hpp>
+
+namespace {
+    // random forest in depth first order, every node hangs below a node of the current path
+    struct Forest {
+        std::vector<Transform> transforms;
+        std::vector<uint32_t> parents;
+        TransformHierarchy hierarchy;
+        std::vector<Entity*> changedEntities;
+
+        Forest(uint32_t nodeCount, uint32_t seed) : transforms(nodeCount) {
+            std::mt19937 random(seed);
+            std::uniform_real_distribution<float> unit(0.f, 1.f);
+            std::vector<uint32_t> path;
+
+            for (uint32_t i = 0; i < nodeCount; i++) {
+                // one in twenty nodes starts a new root, the others attach somewhere up the path
+                if (unit(random) < 0.05f) {
+                    path.clear();
+                } else if (!path.empty()) {
+                    path.resize(std::uniform_int_distribution<size_t>(1, path.size())(random));
+                }
+
+                Transform& transform = transforms[i];
+                transform.position = (glm::vec3(unit(random), unit(random), unit(random)) * 2.f - 1.f) * 10.f;
+                transform.rotation = glm::quat(glm::vec3(unit(random), unit(random), unit(random)) * glm::two_pi<float>());
+                transform.scale = glm::vec3(0.9f + unit(random) * 0.2f);
+
+                parents.push_back(path.empty() ? TransformHierarchy::NO_PARENT : path.back());
+                path.push_back(i);
+            }
+
+            hierarchy.clear();
+
+            for (uint32_t i = 0; i < nodeCount; i++) {
+                hierarchy.addNode(transforms[i], parents[i]);
+            }
+        }
+
+        // global matrices recomputed from scratch, what a propagation has to end with
+        std::vector<glm::mat4> computeGlobalMatrices() const {
+            std::vector<glm::mat4> matrices(transforms.size());
+
+            for (uint32_t i = 0; i < transforms.size(); i++) {
+                Transform copy(transforms[i]);
+                copy.updateLocalMatrix();
+
+                matrices[i] = parents[i] == TransformHierarchy::NO_PARENT ? copy.localMatrix : matrices[parents[i]] * copy.localMatrix;
+            }
+
+            return matrices;
+        }
+
+        bool matchesFullUpdate() const {
+            std::vector<glm::mat4> matrices = computeGlobalMatrices();
+
+            for (uint32_t i = 0; i < transforms.size(); i++) {
+                if (transforms[i].globalMatrix != matrices[i]) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool isBelow(uint32_t node, const std::vector<uint8_t>& moved) const {
+            for (; node != TransformHierarchy::NO_PARENT; node = parents[node]) {
+                if (moved[node]) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    };
+}
+
+TEST_CASE("transform hierarchy: the first propagation computes every node") {
+    Forest forest(2000, 3);
+
+    CHECK_EQ(forest.hierarchy.getDirtyCount(), 2000u);
+
+    forest.hierarchy.propagate(forest.changedEntities);
+
+    CHECK_EQ(forest.hierarchy.getUpdatedCount(), 2000u);
+    CHECK_EQ(forest.hierarchy.getDirtyCount(), 0u);
+    CHECK(forest.matchesFullUpdate());
+
+    // nothing moved, nothing is touched
+    forest.hierarchy.propagate(forest.changedEntities);
+
+    CHECK_EQ(forest.hierarchy.getUpdatedCount(), 0u);
+}
+
+TEST_CASE("transform hierarchy: dirty flags recompute only the subtrees below moved nodes") {
+    Forest forest(2000, 5);
+    forest.hierarchy.propagate(forest.changedEntities);
+
+    std::mt19937 random(9);
+
+    for (uint32_t frame = 0; frame < 20; frame++) {
+        std::vector<uint8_t> moved(forest.transforms.size(), 0);
+
+        for (uint32_t m = 0; m < 10; m++) {
+            uint32_t node = std::uniform_int_distribution<uint32_t>(0, forest.transforms.size() - 1)(random);
+            Transform& transform = forest.transforms[node];
+
+            // the setters, and a write in place followed by markDirty as the scripts do after a call
+            switch (m % 4) {
+                case 0: transform.translate(glm::vec3(0.f, 0.f, 1.f), 0.5f); break;
+                case 1: transform.rotate(glm::vec3(0.f, 1.f, 0.f), 10.f); break;
+                case 2: transform.setScale(transform.scale * 1.1f); break;
+                case 3: transform.position.x += 1.f; transform.markDirty(); break;
+            }
+
+            moved[node] = 1;
+        }
+
+        uint32_t expectedCount = 0;
+
+        for (uint32_t i = 0; i < forest.transforms.size(); i++) {
+            expectedCount += forest.isBelow(i, moved);
+        }
+
+        forest.hierarchy.propagate(forest.changedEntities);
+
+        CHECK_EQ(forest.hierarchy.getUpdatedCount(), expectedCount);
+        CHECK(forest.matchesFullUpdate());
+    }
+}
+
+TEST_CASE("transform hierarchy: copies don't mark the original") {
+    Forest forest(10, 7);
+    forest.hierarchy.propagate(forest.changedEntities);
+
+    // copies, like Transform.new(other) in lua, keep the hierarchy pointer but must not touch the scene
+    Transform copy(forest.transforms[0]);
+    copy.setPosition(glm::vec3(100.f));
+
+    CHECK_EQ(forest.hierarchy.getDirtyCount(), 0u);
+
+    // marking a node twice queues it once
+    forest.transforms[3].markDirty();
+    forest.transforms[3].markDirty();
+
+    CHECK_EQ(forest.hierarchy.getDirtyCount(), 1u);
+}